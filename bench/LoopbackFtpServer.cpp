@@ -0,0 +1,332 @@
+#include "LoopbackFtpServer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+#define CLOSE_SOCKET closesocket
+#define SHUT_RDWR SD_BOTH
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+#define CLOSE_SOCKET close
+#endif
+
+#if defined(MSG_NOSIGNAL)
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+namespace {
+    constexpr int kPollMs = 100;
+    constexpr int kDataAcceptTimeoutMs = 10000;
+
+    bool waitReadable(SocketHandle s, int timeoutMs) {
+#if defined(_WIN32)
+        WSAPOLLFD pfd{s, POLLRDNORM, 0};
+        return WSAPoll(&pfd, 1, timeoutMs) > 0;
+#else
+        pollfd pfd{s, POLLIN, 0};
+        return poll(&pfd, 1, timeoutMs) > 0;
+#endif
+    }
+
+    // Listening socket on 127.0.0.1 with an ephemeral port
+    SocketHandle listenLoopback(int& portOut) {
+        SocketHandle s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == static_cast<SocketHandle>(-1)) return s;
+        int one = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 8) != 0
+            || getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+            CLOSE_SOCKET(s);
+            return static_cast<SocketHandle>(-1);
+        }
+        portOut = ntohs(addr.sin_port);
+        return s;
+    }
+
+    void reply(SocketHandle s, const std::string& line) {
+        std::string out = line + "\r\n";
+        send(s, out.data(), static_cast<int>(out.size()), SEND_FLAGS);
+    }
+
+    // One CRLF-terminated command; false when the peer is gone
+    bool readLine(SocketHandle s, std::string& buffer, std::string& line) {
+        for (;;) {
+            std::size_t eol = buffer.find("\r\n");
+            if (eol != std::string::npos) {
+                line = buffer.substr(0, eol);
+                buffer.erase(0, eol + 2);
+                return true;
+            }
+            char chunk[512];
+            int n = static_cast<int>(recv(s, chunk, sizeof(chunk), 0));
+            if (n <= 0) return false;
+            buffer.append(chunk, static_cast<std::size_t>(n));
+        }
+    }
+
+    std::string resolvePath(const std::string& cwd, const std::string& arg) {
+        if (!arg.empty() && arg.front() == '/') return arg;
+        return cwd == "/" ? "/" + arg : cwd + "/" + arg;
+    }
+}
+
+LoopbackFtpServer::LoopbackFtpServer() = default;
+
+LoopbackFtpServer::~LoopbackFtpServer() { stop(); }
+
+void LoopbackFtpServer::start() {
+    if (running.load()) return;
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) throw std::runtime_error("WSAStartup failed");
+#endif
+    SocketHandle s = listenLoopback(port);
+    if (s == static_cast<SocketHandle>(-1)) {
+        throw std::runtime_error("LoopbackFtpServer: cannot listen on 127.0.0.1");
+    }
+    listenSocket = static_cast<std::intptr_t>(s);
+    running.store(true);
+    acceptThread = std::thread(&LoopbackFtpServer::acceptLoop, this);
+}
+
+void LoopbackFtpServer::stop() {
+    if (!running.exchange(false)) return;
+    if (acceptThread.joinable()) acceptThread.join();
+
+    std::vector<std::thread> toJoin;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // Unblock sessions waiting for the next command
+        for (std::intptr_t s : openSockets) shutdown(static_cast<SocketHandle>(s), SHUT_RDWR);
+        toJoin.swap(sessions);
+    }
+    for (auto& t : toJoin) t.join();
+
+    CLOSE_SOCKET(static_cast<SocketHandle>(listenSocket));
+    listenSocket = -1;
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+std::int64_t LoopbackFtpServer::fileSize(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(sizesMtx);
+    auto it = sizes.find(path);
+    return it == sizes.end() ? -1 : it->second;
+}
+
+void LoopbackFtpServer::putFile(const std::string& path, const std::string& content) {
+    storeFiles.store(true);
+    std::lock_guard<std::mutex> lock(sizesMtx);
+    contents[path] = content;
+    sizes[path] = static_cast<std::int64_t>(content.size());
+}
+
+bool LoopbackFtpServer::hasFile(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(sizesMtx);
+    return contents.count(path) != 0;
+}
+
+void LoopbackFtpServer::failDelete(const std::string& path) {
+    std::lock_guard<std::mutex> lock(sizesMtx);
+    failingDeletes.insert(path);
+}
+
+void LoopbackFtpServer::acceptLoop() {
+    const auto listener = static_cast<SocketHandle>(listenSocket);
+    while (running.load()) {
+        if (!waitReadable(listener, kPollMs)) continue;
+        SocketHandle client = accept(listener, nullptr, nullptr);
+        if (client == static_cast<SocketHandle>(-1)) continue;
+        std::lock_guard<std::mutex> lock(mtx);
+        openSockets.push_back(static_cast<std::intptr_t>(client));
+        sessions.emplace_back(&LoopbackFtpServer::serve, this, static_cast<std::intptr_t>(client));
+    }
+}
+
+void LoopbackFtpServer::serve(std::intptr_t controlHandle) {
+    const auto control = static_cast<SocketHandle>(controlHandle);
+    std::string buffer, line, cwd = "/";
+    SocketHandle passive = static_cast<SocketHandle>(-1);
+    std::vector<char> data(256 * 1024);
+    std::int64_t restOffset = 0;
+
+    // Accept the data connection of the last EPSV/PASV; -1 (after a 425) if none
+    auto openData = [&]() {
+        if (passive == static_cast<SocketHandle>(-1)) {
+            reply(control, "425 Use PASV or EPSV first");
+            return static_cast<SocketHandle>(-1);
+        }
+        reply(control, "150 Opening data connection");
+        SocketHandle conn = waitReadable(passive, kDataAcceptTimeoutMs)
+                                ? accept(passive, nullptr, nullptr)
+                                : static_cast<SocketHandle>(-1);
+        CLOSE_SOCKET(passive);
+        passive = static_cast<SocketHandle>(-1);
+        if (conn == static_cast<SocketHandle>(-1)) reply(control, "425 No data connection");
+        return conn;
+    };
+    auto sendData = [&](const std::string& bytes) {
+        SocketHandle conn = openData();
+        if (conn == static_cast<SocketHandle>(-1)) return;
+        for (std::size_t off = 0; off < bytes.size();) {
+            int n = static_cast<int>(send(conn, bytes.data() + off, static_cast<int>(bytes.size() - off), SEND_FLAGS));
+            if (n <= 0) break;   // a ranged download hangs up early
+            off += static_cast<std::size_t>(n);
+        }
+        CLOSE_SOCKET(conn);
+        reply(control, "226 Transfer complete");
+    };
+
+    reply(control, "220 SqliteFtpBackup loopback server");
+    while (running.load() && readLine(control, buffer, line)) {
+        std::string cmd = line.substr(0, line.find(' '));
+        std::string arg = line.size() > cmd.size() + 1 ? line.substr(cmd.size() + 1) : "";
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), [](unsigned char c) { return std::toupper(c); });
+
+        if (cmd == "USER") {
+            reply(control, "331 Password required");
+        } else if (cmd == "PASS") {
+            reply(control, "230 Logged in");
+        } else if (cmd == "PWD") {
+            reply(control, "257 \"" + cwd + "\"");
+        } else if (cmd == "CWD") {
+            // Every directory exists: uploads never need MKD round trips
+            cwd = resolvePath(cwd, arg);
+            reply(control, "250 OK");
+        } else if (cmd == "MKD") {
+            reply(control, "257 \"" + resolvePath(cwd, arg) + "\" created");
+        } else if (cmd == "TYPE") {
+            reply(control, "200 Type set");
+        } else if (cmd == "EPSV" || cmd == "PASV") {
+            if (passive != static_cast<SocketHandle>(-1)) CLOSE_SOCKET(passive);
+            int dataPort = 0;
+            passive = listenLoopback(dataPort);
+            if (passive == static_cast<SocketHandle>(-1)) {
+                reply(control, "425 Cannot open data connection");
+            } else if (cmd == "EPSV") {
+                reply(control, "229 Entering Extended Passive Mode (|||" + std::to_string(dataPort) + "|)");
+            } else {
+                char msg[96];
+                std::snprintf(msg, sizeof(msg), "227 Entering Passive Mode (127,0,0,1,%d,%d)",
+                              dataPort >> 8, dataPort & 0xff);
+                reply(control, msg);
+            }
+        } else if (cmd == "STOR" || cmd == "APPE") {
+            SocketHandle conn = openData();
+            if (conn == static_cast<SocketHandle>(-1)) continue;
+
+            const bool keep = storeFiles.load();
+            std::string kept;
+            std::int64_t n = 0;
+            while (running.load()) {
+                if (!waitReadable(conn, kPollMs)) continue;
+                int got = static_cast<int>(recv(conn, data.data(), static_cast<int>(data.size()), 0));
+                if (got <= 0) break;
+                n += got;
+                if (keep) kept.append(data.data(), static_cast<std::size_t>(got));
+            }
+            CLOSE_SOCKET(conn);
+            received.fetch_add(static_cast<std::uint64_t>(n), std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(sizesMtx);
+                const std::string path = resolvePath(cwd, arg);
+                std::int64_t& size = sizes[path];
+                size = (cmd == "APPE" ? size : 0) + n;
+                if (keep) {
+                    std::string& content = contents[path];
+                    if (cmd == "STOR") content.clear();
+                    content += kept;
+                }
+            }
+            reply(control, "226 Transfer complete");
+        } else if (cmd == "REST") {
+            restOffset = std::stoll(arg.empty() ? "0" : arg);
+            reply(control, "350 Restarting at " + std::to_string(restOffset));
+        } else if (cmd == "RETR") {
+            std::string bytes;
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> lock(sizesMtx);
+                auto it = contents.find(resolvePath(cwd, arg));
+                if (it != contents.end()) {
+                    found = true;
+                    if (restOffset < static_cast<std::int64_t>(it->second.size())) bytes = it->second.substr(static_cast<std::size_t>(restOffset));
+                }
+            }
+            restOffset = 0;
+            if (!found) {
+                reply(control, "550 No such file");
+                continue;
+            }
+            sendData(bytes);
+        } else if (cmd == "MLSD") {
+            // Files directly in the directory, and the subdirectories leading to deeper ones
+            const std::string dir = arg.empty() ? cwd : resolvePath(cwd, arg);
+            const std::string prefix = dir == "/" ? "/" : dir + "/";
+            std::string listing;
+            std::set<std::string> subdirs;
+            {
+                std::lock_guard<std::mutex> lock(sizesMtx);
+                for (const auto& [path, content] : contents) {
+                    if (path.compare(0, prefix.size(), prefix) != 0) continue;
+                    const std::string rest = path.substr(prefix.size());
+                    const std::size_t slash = rest.find('/');
+                    if (slash != std::string::npos) {
+                        subdirs.insert(rest.substr(0, slash));
+                    } else {
+                        listing += "type=file;size=" + std::to_string(content.size()) + "; " + rest + "\r\n";
+                    }
+                }
+            }
+            for (const std::string& sub : subdirs) listing += "type=dir; " + sub + "\r\n";
+            sendData(listing);
+        } else if (cmd == "DELE") {
+            const std::string path = resolvePath(cwd, arg);
+            bool deleted = false;
+            {
+                std::lock_guard<std::mutex> lock(sizesMtx);
+                if (!failingDeletes.count(path) && contents.erase(path)) {
+                    sizes.erase(path);
+                    deleted = true;
+                }
+            }
+            reply(control, deleted ? "250 Deleted" : "550 Cannot delete");
+        } else if (cmd == "SIZE") {
+            std::int64_t size = fileSize(resolvePath(cwd, arg));
+            reply(control, size < 0 ? "550 No such file" : "213 " + std::to_string(size));
+        } else if (cmd == "QUIT") {
+            reply(control, "221 Bye");
+            break;
+        } else {
+            reply(control, "502 Not implemented");
+        }
+    }
+
+    if (passive != static_cast<SocketHandle>(-1)) CLOSE_SOCKET(passive);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        openSockets.erase(std::remove(openSockets.begin(), openSockets.end(), controlHandle), openSockets.end());
+    }
+    CLOSE_SOCKET(control);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Minimal plain-text FTP server on 127.0.0.1 for benchmarks and tests
+ *
+ * Understands just enough of RFC 959 for FtpUploader (USER, PASS, PWD, CWD,
+ * MKD, TYPE, EPSV/PASV, STOR, APPE, SIZE, REST, QUIT). Uploaded data is
+ * counted and discarded, so a benchmark measures the client and the
+ * loopback network path rather than the server's disk. With
+ * setStoreFiles(true) files are kept in memory and RETR, MLSD and DELE
+ * work too, for tests. No TLS: pair it with FtpUploader::setUseTls(false).
+ */
+class LoopbackFtpServer {
+public:
+    LoopbackFtpServer();
+    ~LoopbackFtpServer();
+
+    LoopbackFtpServer(const LoopbackFtpServer&) = delete;
+    LoopbackFtpServer& operator=(const LoopbackFtpServer&) = delete;
+
+    /**
+     * Listen on an ephemeral port and start serving
+     * @throws std::runtime_error if the socket cannot be set up
+     */
+    void start();
+    void stop();
+
+    int getPort() const { return port; }
+
+    /** Bytes received across all uploads */
+    std::uint64_t bytesReceived() const { return received.load(std::memory_order_relaxed); }
+
+    /** Size of a stored file as the server saw it, -1 if never uploaded */
+    std::int64_t fileSize(const std::string& path) const;
+
+    /** Keep uploaded bytes so they can be downloaded, listed and deleted */
+    void setStoreFiles(bool on) { storeFiles.store(on); }
+
+    /** Add a file as if it had been uploaded (implies setStoreFiles(true)) */
+    void putFile(const std::string& path, const std::string& content);
+
+    /** Whether a kept file exists */
+    bool hasFile(const std::string& path) const;
+
+    /** Answer DELE of `path` with 550, as a server refusing the delete would */
+    void failDelete(const std::string& path);
+
+private:
+    std::intptr_t listenSocket = -1;
+    int port = 0;
+    std::atomic<bool> running{false};
+    std::atomic<std::uint64_t> received{0};
+    std::atomic<bool> storeFiles{false};
+    std::thread acceptThread;
+
+    std::mutex mtx;   // guards sessions and sizes
+    std::vector<std::thread> sessions;
+    std::vector<std::intptr_t> openSockets;
+    mutable std::mutex sizesMtx;   // guards sizes, contents and failingDeletes
+    std::map<std::string, std::int64_t> sizes;
+    std::map<std::string, std::string> contents;
+    std::set<std::string> failingDeletes;
+
+    void acceptLoop();
+    void serve(std::intptr_t control);
+};
@@ -0,0 +1,367 @@
+// Micro- and macro-benchmarks for every backup phase (Google Benchmark)
+//
+//   SqliteFtpBackupBench                          # sizes up to 100 MB, JSON to SqliteFtpBackupBench.json
+//   SqliteFtpBackupBench --max_db_mb=10240        # include the 1 GB and 10 GB runs
+//   SqliteFtpBackupBench --benchmark_filter=Micro # any Google Benchmark flag works
+//
+// Fixture databases are cached in ./bench_data (or $SFB_BENCH_DIR) so the
+// expensive large ones are only generated once.
+
+#include "BackupManager.h"
+#include "BackupPipeline.h"
+#include "Checksum.h"
+#include "ChunkCipher.h"
+#include "FtpUploader.h"
+#include "LoopbackFtpServer.h"
+#include "Logger.h"
+#include "SqliteHelper.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr std::int64_t kMiB = 1024 * 1024;
+    constexpr std::int64_t kMaxFillBatchRows = 500000;
+
+    fs::path workDir() {
+        const char* env = std::getenv("SFB_BENCH_DIR");
+        fs::path dir = env ? env : "bench_data";
+        fs::create_directories(dir);
+        return dir;
+    }
+
+    // Database with at least `rows` rows, created on first use
+    std::string fixtureWithRows(int rows) {
+        fs::path path = workDir() / ("rows_" + std::to_string(rows) + ".sqlite");
+        if (!fs::exists(path)) {
+            SqliteHelper db(path.string(), false);
+            db.createTable();
+            db.insertRandomRows(rows);
+        }
+        return path.string();
+    }
+
+    // Database of at least `sizeMb` MiB, grown in batches and cached across runs
+    std::string fixtureOfSize(std::int64_t sizeMb) {
+        fs::path path = workDir() / ("db_" + std::to_string(sizeMb) + "MB.sqlite");
+        std::error_code ec;
+        auto currentSize = [&] { return static_cast<std::int64_t>(fs::file_size(path, ec)); };
+        if (fs::exists(path) && currentSize() >= sizeMb * kMiB) return path.string();
+
+        std::cerr << "Generating " << sizeMb << " MB fixture " << path.string() << "...\n";
+        SqliteHelper db(path.string(), false);
+        db.createTable();
+        // Rows are ~70 bytes on disk: small batches keep small fixtures close to their size
+        const auto batch = static_cast<int>(std::min(kMaxFillBatchRows, sizeMb * 2000));
+        while (currentSize() < sizeMb * kMiB) db.insertRandomRows(batch);
+        return path.string();
+    }
+
+    // Copy of the `sizeMb` fixture with `deletedPct` percent of its rows
+    // deleted all over the table, cached like the other fixtures
+    std::string fragmentedFixture(std::int64_t sizeMb, int deletedPct) {
+        fs::path path = workDir() / ("fragmented_" + std::to_string(sizeMb) + "MB_" + std::to_string(deletedPct) + ".sqlite");
+        if (fs::exists(path)) return path.string();
+
+        const fs::path part = path.string() + ".part";
+        fs::copy_file(fixtureOfSize(sizeMb), part, fs::copy_options::overwrite_existing);
+        sqlite3* db = nullptr;
+        const std::string sql = "DELETE FROM people WHERE id % 100 < " + std::to_string(deletedPct) + ";";
+        bool ok = sqlite3_open(part.string().c_str(), &db) == SQLITE_OK
+                  && sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        sqlite3_close(db);
+        if (!ok) throw std::runtime_error("Cannot fragment " + part.string());
+        fs::rename(part, path);
+        return path.string();
+    }
+
+    // Server shared by all upload benchmarks
+    LoopbackFtpServer& ftpServer() {
+        static LoopbackFtpServer server;
+        static bool started = (server.start(), true);
+        (void)started;
+        return server;
+    }
+
+    std::unique_ptr<FtpUploader> loopbackUploader() {
+        auto up = std::make_unique<FtpUploader>("127.0.0.1", ftpServer().getPort(), "bench", "bench");
+        up->setUseTls(false);
+        up->setRetries(1);
+        return up;
+    }
+
+    // Swallows Logger's console copy so terminal speed doesn't skew Logger::log
+    class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    };
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+// -----------------------
+// Micro-benchmarks
+// -----------------------
+static void BM_Micro_InsertRandomRows(benchmark::State& state) {
+    const int rows = static_cast<int>(state.range(0));
+    fs::path path = workDir() / "insert.sqlite";
+    fs::remove(path);
+    SqliteHelper db(path.string(), false);
+    db.createTable();
+    for (auto _ : state) db.insertRandomRows(rows);
+    state.SetItemsProcessed(state.iterations() * rows);
+    state.counters["db_bytes"] = static_cast<double>(fs::file_size(path));
+}
+BENCHMARK(BM_Micro_InsertRandomRows)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+static void BM_Micro_GetRowCount(benchmark::State& state) {
+    SqliteHelper db(fixtureWithRows(static_cast<int>(state.range(0))), false);
+    for (auto _ : state) benchmark::DoNotOptimize(db.getRowCount());
+}
+BENCHMARK(BM_Micro_GetRowCount)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+static void BM_Micro_DumpToFile(benchmark::State& state) {
+    SqliteHelper db(fixtureWithRows(static_cast<int>(state.range(0))), false);
+    const std::string out = (workDir() / "dump.sql").string();
+    for (auto _ : state) db.dumpToFile(out);
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(fs::file_size(out)));
+    fs::remove(out);
+}
+BENCHMARK(BM_Micro_DumpToFile)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_Micro_BackupToFile(benchmark::State& state) {
+    const std::string src = fixtureWithRows(static_cast<int>(state.range(0)));
+    SqliteHelper db(src, false);
+    const std::string out = (workDir() / "backup.sqlite").string();
+    for (auto _ : state) db.backupToFile(out);
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(fs::file_size(src)));
+    fs::remove(out);
+}
+BENCHMARK(BM_Micro_BackupToFile)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_Micro_BuildUrl(benchmark::State& state) {
+    FtpUploader up("ftp.example.com", 21, "user", "pass");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(up.buildUrl("/backups/nightly/", "db_backup_2024-01-01_00-00-00.sqlite"));
+    }
+}
+BENCHMARK(BM_Micro_BuildUrl);
+
+// 1 MiB pipeline chunk in 64 KiB frames, sealed in parallel on the TaskScheduler
+static void BM_Micro_EncryptChunk(benchmark::State& state) {
+    EncryptionConfig config;
+    config.algorithm = static_cast<CipherAlgorithm>(state.range(0));
+    const std::size_t size = 1 << 20;
+    ChunkCipher cipher(config, size, ChunkCipher::randomSalt());
+    std::vector<unsigned char> plain(size, 0x5a);
+    PipelineChunk chunk;
+    for (auto _ : state) {
+        chunk.offset = 0;
+        chunk.data = plain;
+        cipher.encryptChunk(chunk);
+        benchmark::DoNotOptimize(chunk.data.data());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * static_cast<std::int64_t>(size));
+    state.SetLabel(ChunkCipher::algorithmName(config.algorithm));
+}
+BENCHMARK(BM_Micro_EncryptChunk)
+    ->Arg(static_cast<int>(CipherAlgorithm::Aes256Gcm))
+    ->Arg(static_cast<int>(CipherAlgorithm::ChaCha20Poly1305))
+    ->UseRealTime();
+
+// 1 MiB chunk through the hash stage's checksum, best kernel for this CPU
+static void BM_Micro_Checksum(benchmark::State& state) {
+    const auto algorithm = static_cast<ChecksumAlgorithm>(state.range(0));
+    std::vector<unsigned char> data(1 << 20, 0x5a);
+    auto checksum = Checksum::create(algorithm);
+    for (auto _ : state) {
+        checksum->update(data.data(), data.size());
+    }
+    benchmark::DoNotOptimize(checksum->digest());
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * static_cast<std::int64_t>(data.size()));
+    state.SetLabel(std::string(Checksum::algorithmName(algorithm)) + "/" + checksum->implementation());
+}
+BENCHMARK(BM_Micro_Checksum)
+    ->Arg(static_cast<int>(ChecksumAlgorithm::Sha256))
+    ->Arg(static_cast<int>(ChecksumAlgorithm::Crc32c))
+    ->Arg(static_cast<int>(ChecksumAlgorithm::Xxh3))
+    ->Arg(static_cast<int>(ChecksumAlgorithm::Blake3));
+
+static void BM_Micro_LoggerLog(benchmark::State& state) {
+    Logger& log = Logger::instance();
+    NullBuffer null;
+    std::streambuf* console = std::cout.rdbuf(&null);
+    log.setLevel(Logger::Level::INFO);
+    for (auto _ : state) log.info("Upload progress: ", 42, "%");
+    log.setLevel(Logger::Level::ERROR);
+    std::cout.rdbuf(console);
+}
+BENCHMARK(BM_Micro_LoggerLog);
+
+static void BM_Micro_LoggerLogFiltered(benchmark::State& state) {
+    Logger& log = Logger::instance();
+    for (auto _ : state) log.debug("Upload progress: ", 42, "%");
+}
+BENCHMARK(BM_Micro_LoggerLogFiltered);
+
+// -----------------------
+// Macro-benchmarks
+// -----------------------
+
+// Binary backup of a fixed-size database plus upload to the loopback server
+static void BM_Macro_BackupAndUpload(benchmark::State& state) {
+    const std::int64_t sizeMb = state.range(0);
+    const std::string src = fixtureOfSize(sizeMb);
+    const auto srcBytes = static_cast<std::int64_t>(fs::file_size(src));
+    SqliteHelper db(src, false);
+    auto up = loopbackUploader();
+    const std::string snapshot = (workDir() / ("snapshot_" + std::to_string(sizeMb) + "MB.sqlite")).string();
+
+    double backupSeconds = 0, uploadSeconds = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        db.backupToFile(snapshot);
+        backupSeconds += secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        up->uploadFile(snapshot, "bench");
+        uploadSeconds += secondsSince(start);
+    }
+    fs::remove(snapshot);
+
+    state.SetBytesProcessed(state.iterations() * srcBytes);
+    state.counters["db_bytes"] = static_cast<double>(srcBytes);
+    state.counters["backup_s"] = benchmark::Counter(backupSeconds, benchmark::Counter::kAvgIterations);
+    state.counters["upload_s"] = benchmark::Counter(uploadSeconds, benchmark::Counter::kAvgIterations);
+}
+
+// Snapshot of a database with deleted rows plus its upload: the online
+// backup copies free and half-empty pages as they are, VACUUM INTO
+// (compact = 1) packs the live rows. upload_bytes is the snapshot size.
+static void BM_Macro_FragmentedUpload(benchmark::State& state) {
+    const std::int64_t sizeMb = state.range(0);
+    const int deletedPct = static_cast<int>(state.range(1));
+    const bool compact = state.range(2) != 0;
+    const std::string src = fragmentedFixture(sizeMb, deletedPct);
+    SqliteHelper db(src, false);
+    auto up = loopbackUploader();
+    const std::string snapshot = (workDir() / ("fragmented_snapshot_" + std::to_string(sizeMb) + "MB.sqlite")).string();
+
+    double backupSeconds = 0, uploadSeconds = 0;
+    std::int64_t uploadBytes = 0;
+    for (auto _ : state) {
+        // VACUUM INTO needs a missing or empty target
+        fs::remove(snapshot);
+        auto start = std::chrono::steady_clock::now();
+        if (compact) {
+            db.vacuumToFile(snapshot);
+        } else {
+            db.backupToFile(snapshot);
+        }
+        backupSeconds += secondsSince(start);
+        uploadBytes = static_cast<std::int64_t>(fs::file_size(snapshot));
+
+        start = std::chrono::steady_clock::now();
+        up->uploadFile(snapshot, "bench");
+        uploadSeconds += secondsSince(start);
+    }
+    fs::remove(snapshot);
+
+    state.SetBytesProcessed(state.iterations() * uploadBytes);
+    state.counters["db_bytes"] = static_cast<double>(fs::file_size(src));
+    state.counters["upload_bytes"] = static_cast<double>(uploadBytes);
+    state.counters["backup_s"] = benchmark::Counter(backupSeconds, benchmark::Counter::kAvgIterations);
+    state.counters["upload_s"] = benchmark::Counter(uploadSeconds, benchmark::Counter::kAvgIterations);
+}
+
+// Whole BackupManager::run() cycle as the CLI runs it: insert, backup,
+// pipelined upload, cleanup. The database grows by `rows` every iteration,
+// so the iteration count is fixed to keep runs comparable.
+static void BM_Macro_BackupManagerRun(benchmark::State& state) {
+    const int rows = static_cast<int>(state.range(0));
+    const fs::path dir = workDir() / ("manager_" + std::to_string(rows));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    BackupManager manager((dir / "db").string(), "127.0.0.1", ftpServer().getPort(), "bench", "bench",
+                          "bench", false, rows, 1, 30);
+    manager.setFtpTls(false);
+    manager.setLogLevel(Logger::Level::ERROR);
+    for (auto _ : state) {
+        if (!manager.run()) {
+            state.SkipWithError("BackupManager::run failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+    fs::remove_all(dir);
+}
+BENCHMARK(BM_Macro_BackupManagerRun)->Arg(1000)->Arg(10000)->Iterations(10)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// -----------------------
+// main
+// -----------------------
+int main(int argc, char** argv) {
+    // --max_db_mb=N caps the macro sizes (1 MB .. 10 GB); default keeps a run short
+    std::int64_t maxDbMb = 100;
+    std::vector<char*> args;
+    bool hasOut = false;
+    for (int i = 0; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.rfind("--max_db_mb=", 0) == 0) {
+            maxDbMb = std::stoll(a.substr(12));
+            continue;
+        }
+        if (a.rfind("--benchmark_out=", 0) == 0) hasOut = true;
+        args.push_back(argv[i]);
+    }
+
+    // Results always land in a JSON file unless the caller picked one
+    std::string outFlag = "--benchmark_out=SqliteFtpBackupBench.json";
+    std::string formatFlag = "--benchmark_out_format=json";
+    if (!hasOut) {
+        args.push_back(outFlag.data());
+        args.push_back(formatFlag.data());
+    }
+
+    for (std::int64_t mb : {1LL, 10LL, 100LL, 1024LL, 10240LL}) {
+        if (mb > maxDbMb) continue;
+        auto* b = benchmark::RegisterBenchmark("BM_Macro_BackupAndUpload", BM_Macro_BackupAndUpload)
+                      ->Arg(mb)->Unit(benchmark::kMillisecond)->UseRealTime();
+        if (mb >= 1024) b->Iterations(1);
+    }
+    // Online backup vs VACUUM INTO with half and 90% of the rows deleted
+    for (std::int64_t mb : {10LL, 100LL, 1024LL}) {
+        if (mb > maxDbMb) continue;
+        for (std::int64_t deleted : {50LL, 90LL}) {
+            for (std::int64_t compact : {0LL, 1LL}) {
+                auto* b = benchmark::RegisterBenchmark("BM_Macro_FragmentedUpload", BM_Macro_FragmentedUpload)
+                              ->Args({mb, deleted, compact})->Unit(benchmark::kMillisecond)->UseRealTime();
+                if (mb >= 1024) b->Iterations(1);
+            }
+        }
+    }
+
+    Logger::instance().setLevel(Logger::Level::ERROR);
+
+    int benchArgc = static_cast<int>(args.size());
+    benchmark::Initialize(&benchArgc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(benchArgc, args.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
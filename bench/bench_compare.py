@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""Benchmark regression tracking for SqliteFtpBackupBench.
+
+Baselines are JSON files in a results store (bench/baselines by default),
+one per name, holding every repetition of every benchmark so comparisons
+can account for noise:
+
+    # Record a baseline from a run with repetitions
+    SqliteFtpBackupBench --benchmark_repetitions=5 --benchmark_out=run.json
+    bench_compare.py record main run.json
+
+    # Compare a later run against it; exit code 1 on regression
+    bench_compare.py compare main run.json
+
+    # Run the benchmark binary and compare in one step (used by ctest)
+    bench_compare.py run --bench ./SqliteFtpBackupBench main
+
+A benchmark regresses when its mean time grows by more than its threshold
+(bench/thresholds.json) AND the 95% confidence interval of the difference
+(Welch's t-test over the repetitions) lies entirely above zero, so a noisy
+single run does not fail the build. Uses only the Python standard library.
+"""
+
+import argparse
+import fnmatch
+import json
+import math
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_STORE = os.path.join(HERE, "baselines")
+DEFAULT_THRESHOLDS = os.path.join(HERE, "thresholds.json")
+
+# ctest treats this exit code as "skipped" (SKIP_RETURN_CODE)
+EXIT_SKIPPED = 77
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+# Two-sided 95% critical values of Student's t by degrees of freedom
+T95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+       2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+       2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+
+def t_critical(df):
+    if df < 1:
+        return float("inf")
+    if df <= len(T95):
+        return T95[int(math.floor(df)) - 1]
+    for limit, value in ((40, 2.021), (60, 2.000), (120, 1.980)):
+        if df <= limit:
+            return value
+    return 1.960
+
+
+def mean(xs):
+    return sum(xs) / len(xs)
+
+
+def variance(xs):
+    if len(xs) < 2:
+        return 0.0
+    m = mean(xs)
+    return sum((x - m) ** 2 for x in xs) / (len(xs) - 1)
+
+
+def welch_interval(base, cur):
+    """95% CI of mean(cur) - mean(base), or None with fewer than 2 samples each."""
+    if len(base) < 2 or len(cur) < 2:
+        return None
+    vb, vc = variance(base) / len(base), variance(cur) / len(cur)
+    diff = mean(cur) - mean(base)
+    se = math.sqrt(vb + vc)
+    if se == 0:
+        return (diff, diff)
+    df = (vb + vc) ** 2 / ((vb ** 2) / (len(base) - 1) + (vc ** 2) / (len(cur) - 1))
+    half = t_critical(df) * se
+    return (diff - half, diff + half)
+
+
+# -----------------------
+# Loading results
+# -----------------------
+def samples_from_gbench(doc):
+    """{benchmark name: [real time in ns per repetition]} from Google Benchmark JSON."""
+    samples = {}
+    for b in doc.get("benchmarks", []):
+        if b.get("run_type", "iteration") != "iteration" or b.get("error_occurred"):
+            continue
+        name = b.get("run_name", b["name"])
+        scale = TIME_UNITS.get(b.get("time_unit", "ns"), 1.0)
+        samples.setdefault(name, []).append(b["real_time"] * scale)
+    return samples
+
+
+def load_samples(path):
+    with open(path) as f:
+        doc = json.load(f)
+    if "samples" in doc:  # a stored baseline
+        return doc["samples"]
+    return samples_from_gbench(doc)
+
+
+def load_thresholds(path):
+    if not path or not os.path.exists(path):
+        return {"default": 0.10, "benchmarks": {}}
+    with open(path) as f:
+        return json.load(f)
+
+
+def threshold_for(name, thresholds):
+    for pattern, value in thresholds.get("benchmarks", {}).items():
+        if fnmatch.fnmatchcase(name, pattern):
+            return value
+    return thresholds.get("default", 0.10)
+
+
+def baseline_path(store, name):
+    return os.path.join(store, name + ".json")
+
+
+# -----------------------
+# Commands
+# -----------------------
+def cmd_record(args):
+    with open(args.results) as f:
+        doc = json.load(f)
+    samples = samples_from_gbench(doc)
+    if not samples:
+        print("No benchmark results in " + args.results, file=sys.stderr)
+        return 2
+    os.makedirs(args.store, exist_ok=True)
+    context = doc.get("context", {})
+    entry = {
+        "name": args.name,
+        "recorded_at": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "host": context.get("host_name", platform.node()),
+        "num_cpus": context.get("num_cpus"),
+        "mhz_per_cpu": context.get("mhz_per_cpu"),
+        "build_type": context.get("library_build_type"),
+        "unit": "ns",
+        "samples": samples,
+    }
+    path = baseline_path(args.store, args.name)
+    tmp = path + ".tmp"
+    with open(tmp, "w") as f:
+        json.dump(entry, f, indent=2, sort_keys=True)
+    os.replace(tmp, path)
+    print("Recorded baseline '%s' (%d benchmarks) at %s" % (args.name, len(samples), path))
+    return 0
+
+
+def compare(base, cur, thresholds, out=sys.stdout):
+    """Print a comparison table; return the number of regressions."""
+    regressions = 0
+    rows = []
+    for name in sorted(cur):
+        if name not in base:
+            rows.append((name, "-", "%.4g" % mean(cur[name]), "", "", "", "new"))
+            continue
+        b, c = base[name], cur[name]
+        mb, mc = mean(b), mean(c)
+        change = (mc - mb) / mb if mb else 0.0
+        limit = threshold_for(name, thresholds)
+        ci = welch_interval(b, c)
+        if ci is None:
+            # Nothing to judge noise by: fall back to the raw threshold
+            slower, faster = change > 0, change < 0
+            ci_text = "n/a"
+        else:
+            slower, faster = ci[0] > 0, ci[1] < 0
+            ci_text = "[%+.1f%%, %+.1f%%]" % (100 * ci[0] / mb, 100 * ci[1] / mb) if mb else "n/a"
+        if slower and change > limit:
+            status = "REGRESSION"
+            regressions += 1
+        elif slower:
+            status = "slower (within limit)"
+        elif faster:
+            status = "faster"
+        else:
+            status = "ok"
+        rows.append((name, "%.4g" % mb, "%.4g" % mc, "%+.1f%%" % (100 * change),
+                     ci_text, "%.0f%%" % (100 * limit), status))
+
+    header = ("benchmark", "base ns", "current ns", "change", "95% CI", "limit", "status")
+    widths = [max(len(str(r[i])) for r in rows + [header]) for i in range(len(header))]
+    for r in [header] + rows:
+        print("  ".join(str(v).ljust(w) for v, w in zip(r, widths)).rstrip(), file=out)
+    missing = sorted(set(base) - set(cur))
+    if missing:
+        print("Not in current run: " + ", ".join(missing), file=out)
+    return regressions
+
+
+def cmd_compare(args):
+    path = baseline_path(args.store, args.baseline)
+    if not os.path.exists(path):
+        print("Baseline '%s' not found in %s; record one with 'bench_compare.py record'"
+              % (args.baseline, args.store), file=sys.stderr)
+        return EXIT_SKIPPED
+    base = load_samples(path)
+    cur = load_samples(args.results)
+    regressions = compare(base, cur, load_thresholds(args.thresholds))
+    if regressions:
+        print("%d benchmark(s) regressed against baseline '%s'" % (regressions, args.baseline))
+        return 1
+    print("No regressions against baseline '%s'" % args.baseline)
+    return 0
+
+
+def cmd_run(args):
+    path = baseline_path(args.store, args.baseline)
+    if not os.path.exists(path):
+        print("Baseline '%s' not found in %s; skipping" % (args.baseline, args.store))
+        return EXIT_SKIPPED
+    fd, out = tempfile.mkstemp(suffix=".json")
+    os.close(fd)
+    try:
+        cmd = [args.bench,
+               "--benchmark_repetitions=%d" % args.repetitions,
+               "--benchmark_out=" + out,
+               "--benchmark_out_format=json"]
+        if args.filter:
+            cmd.append("--benchmark_filter=" + args.filter)
+        print("Running: " + " ".join(cmd))
+        rc = subprocess.call(cmd, stdout=subprocess.DEVNULL)
+        if rc != 0:
+            print("Benchmark binary failed with exit code %d" % rc, file=sys.stderr)
+            return 2
+        args.results = out
+        return cmd_compare(args)
+    finally:
+        os.remove(out)
+
+
+def cmd_list(args):
+    if not os.path.isdir(args.store):
+        return 0
+    for fn in sorted(os.listdir(args.store)):
+        if not fn.endswith(".json"):
+            continue
+        with open(os.path.join(args.store, fn)) as f:
+            doc = json.load(f)
+        print("%-20s %s  %s  %d benchmarks" % (doc.get("name", fn[:-5]), doc.get("recorded_at", "?"),
+                                              doc.get("host", "?"), len(doc.get("samples", {}))))
+    return 0
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="Benchmark baselines and regression checks")
+    parser.add_argument("--store", default=DEFAULT_STORE, help="baseline directory (default: bench/baselines)")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("record", help="store a Google Benchmark JSON run as a named baseline")
+    p.add_argument("name")
+    p.add_argument("results")
+    p.set_defaults(func=cmd_record)
+
+    p = sub.add_parser("compare", help="compare a run against a baseline")
+    p.add_argument("baseline")
+    p.add_argument("results")
+    p.add_argument("--thresholds", default=DEFAULT_THRESHOLDS)
+    p.set_defaults(func=cmd_compare)
+
+    p = sub.add_parser("run", help="run the benchmark binary with repetitions and compare")
+    p.add_argument("baseline")
+    p.add_argument("--bench", required=True, help="path to SqliteFtpBackupBench")
+    p.add_argument("--filter", default="", help="--benchmark_filter regex")
+    p.add_argument("--repetitions", type=int, default=5)
+    p.add_argument("--thresholds", default=DEFAULT_THRESHOLDS)
+    p.set_defaults(func=cmd_run)
+
+    p = sub.add_parser("list", help="list stored baselines")
+    p.set_defaults(func=cmd_list)
+
+    args = parser.parse_args(argv)
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,6 +1,16 @@
-#include "SqliteHelper.h"
+#include "BackupManager.h"
+#include "Cancellation.h"
+#include "Checksum.h"
+#include "ChunkCipher.h"
 #include "FtpUploader.h"
+#include "GarbageCollector.h"
+#include "Scheduler.h"
+#include "TaskScheduler.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
 #include "Logger.h"
+#include <atomic>
 #include <iostream>
 #include <filesystem>
 #include <chrono>
@@ -8,140 +18,115 @@
 #include <sstream>
 #include <thread>
 #include <cstdlib>
+#include <csignal>
+#include <ctime>
 #include <map>
+#include <optional>
 
 // Exit codes
 constexpr int EXIT_INVALID_ARGS   = 1;
 constexpr int EXIT_UPLOAD_FAILED  = 2;
 constexpr int EXIT_CONFIG_ERROR   = 3;
-
-// Utility to get current timestamp string
-std::string currentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm_now;
-#if defined(_WIN32)
-    localtime_s(&tm_now, &t);
-#else
-    localtime_r(&t, &tm_now);
-#endif
-
-    std::ostringstream oss;
-    oss << std::put_time(&tm_now, "%Y-%m-%d_%H-%M-%S");
-    return oss.str();
-}
+constexpr int EXIT_CANCELLED      = 4;
+constexpr int EXIT_VERIFY_FAILED  = 5;
+constexpr int EXIT_NOT_FOUND      = 6;
+constexpr int EXIT_RESTORE_FAILED = 7;
 
 // Print usage instructions
 void printUsage(const std::string& exeName) {
     std::cerr << "Usage:\n"
               << "  " << exeName
               << " <sqlite_prefix> <ftp_host> <ftp_port> <ftp_user> <ftp_pass_or_-> <ftp_dir>\n"
+              << "  " << exeName << " --decrypt <encrypted_file> <output_file> <key_file>\n"
               << "Options:\n"
               << "  --no-ssl-verify        Disable SSL peer/host verification (default: enabled)\n"
-              << "  --rows N               Number of rows to insert into DB (default: 100)\n"
+              << "  --rows N               Number of rows to insert into DB before each backup; 0 = none (default: 100)\n"
               << "  --retries N            FTP retries on failure (default: 3)\n"
               << "  --timeout SECONDS      FTP connection & response timeout (default: 30)\n"
               << "  --log-level LEVEL      Set log level: debug|info|warn|error (default: info)\n"
+              << "  --daemon               Keep running and back up on a schedule\n"
+              << "  --schedule SPEC        Daemon schedule: interval (90s, 5m, 1h) or cron \"*/5 * * * *\" (default: 5m)\n"
+              << "  --jitter SECONDS       Random delay added to each scheduled run (default: 0)\n"
+              << "  --workers N            Worker threads for CPU-bound stages (default: CPU count)\n"
+              << "  --pin-workers          Pin each worker thread to its own CPU\n"
+              << "  --journal PATH         Job journal for resuming interrupted backups (default: off)\n"
+              << "  --metrics-port PORT    Serve Prometheus metrics on http://127.0.0.1:PORT/metrics in daemon mode\n"
+              << "  --metrics-file PATH    Write Prometheus metrics to PATH after each run (textfile collector)\n"
+              << "  --trace PATH           Write a Chrome/Perfetto trace of each run to PATH\n"
+              << "  --perf-counters        Record CPU performance counters per phase (Linux perf_event_open)\n"
+              << "  --spill-dir DIR        Directory for snapshot copies too large for RAM (default: system temp)\n"
+              << "  --spill-mem-mb MB      Largest snapshot kept in RAM; 0 = never (default: 1/4 of available memory)\n"
+              << "  --background           Read the source DB at idle I/O priority, dropping the pages it cached\n"
+              << "  --io-class CLASS       Background I/O class: idle|be (default: idle; implies --background)\n"
+              << "  --direct-io            Read the source DB with O_DIRECT (implies --background)\n"
+              << "  --read-mbps N          Cap source reads at N MB/s (implies --background)\n"
+              << "  --read-iops N          Cap source reads at N operations/s (implies --background)\n"
+              << "  --max-runtime SECONDS  Stop a run that has not finished within SECONDS (default: no limit)\n"
+              << "  --encrypt-key-file PATH Encrypt uploads with the 32-byte key in PATH (raw or 64 hex digits)\n"
+              << "  --encrypt-cipher NAME  auto|aes-256-gcm|chacha20-poly1305 (default: auto)\n"
+              << "  --encrypt-frame-kb KB  Plaintext bytes per authenticated frame (default: 64)\n"
+              << "  --checksum NAME        Upload digest: xxh3|crc32c|blake3|sha256 (default: xxh3)\n"
+              << "  --manifest-leaf-kb KB  Bytes per Merkle manifest range; 0 = no manifest (default: 1024)\n"
+              << "  --verify NAME          Check remote backup NAME against its manifest instead of backing up\n"
+              << "  --verify-leaves N      Check only N ranges spread over the file (default: all)\n"
+              << "  --chunked              Store backups as deduplicated content-defined chunks plus a recipe\n"
+              << "  --chunk-kb KB          Average chunk size in chunked mode (default: 64)\n"
+              << "  --ftp-sessions N       Parallel FTP sessions for chunk uploads, restores and GC (default: 4)\n"
+              << "  --restore NAME         Download and check backup NAME over parallel sessions instead of backing up\n"
+              << "  --restore-to PATH      Output file of --restore (default: NAME without .enc, in the current directory)\n"
+              << "  --restore-at WHEN      Restore the newest cataloged backup at or before WHEN, applying page deltas\n"
+              << "  --incremental N        Upload page deltas against the previous backup, a full backup every N runs\n"
+              << "  --compact              Snapshot with VACUUM INTO, leaving out free pages (smaller uploads)\n"
+              << "  --skip-unchanged       Skip a run when the database has not changed since the last backup\n"
+              << "  --verify-upload MODE   quick|full: restore each upload in a sandbox and compare its tables\n"
+              << "  --gc                   Collect garbage in the FTP directory instead of backing up;\n"
+              << "                         with --daemon, after every successful backup\n"
+              << "  --gc-keep N            Delete all but the newest N backups first (default: 0 = keep all)\n"
+              << "  --gc-min-age SECONDS   Keep unreferenced chunks younger than this (default: 3600)\n"
+              << "  --gc-dry-run           Log what --gc would delete without deleting\n"
+              << "  --catalog PATH         Record every upload in a local SQLite catalog, copied next to the backups\n"
+              << "  --find-backup WHEN     Print the newest cataloged backup at or before WHEN\n"
+              << "                         ('latest' or local time 'YYYY-MM-DD HH:MM[:SS]') instead of backing up\n"
               << "\n"
               << "Notes:\n"
               << "  - If <ftp_pass_or_-> is '-', password will be read from FTP_PASS environment variable.\n"
               << "  - Exit codes: "
               << EXIT_INVALID_ARGS << " (bad args), "
               << EXIT_UPLOAD_FAILED << " (upload failed), "
-              << EXIT_CONFIG_ERROR << " (config error)\n";
+              << EXIT_CONFIG_ERROR << " (config error), "
+              << EXIT_CANCELLED << " (stopped by SIGINT/SIGTERM), "
+              << EXIT_VERIFY_FAILED << " (verification found differences, also of --verify-upload), "
+              << EXIT_NOT_FOUND << " (no backup matches --find-backup or --restore-at), "
+              << EXIT_RESTORE_FAILED << " (--restore, --restore-at or --decrypt failed)\n";
 }
 
-// RAII helper to ensure temporary file is removed if created
-class TempFileRemover {
-public:
-    explicit TempFileRemover(const std::filesystem::path& p) : path_(p), active_(true) {}
-    ~TempFileRemover() {
-        if (active_ && !path_.empty()) {
-            try {
-                std::filesystem::remove(path_);
-                Logger::instance().info("Temporary file removed: " + path_.string());
-            } catch (...) {
-                // Avoid throwing in destructor
-            }
-        }
-    }
-private:
-    std::filesystem::path path_;
-    bool active_;
-};
-
-// Backup orchestrator
-class BackupManager {
-public:
-    BackupManager(const std::string& sqlitePrefix,
-                  const std::string& ftpHost, int ftpPort,
-                  const std::string& ftpUser, const std::string& ftpPass,
-                  const std::string& ftpDir,
-                  bool sslVerify, int rows, int retries, long timeout)
-        : sqlitePrefix(sqlitePrefix), ftpHost(ftpHost), ftpPort(ftpPort),
-          ftpUser(ftpUser), ftpPass(ftpPass), ftpDir(ftpDir),
-          sslVerify(sslVerify), rows(rows), retries(retries), timeout(timeout) {}
-
-    bool run() {
-        Logger& log = Logger::instance();
-        try {
-            std::filesystem::create_directories("logs");
-
-            log.setLevel(logLevel);
-
-            SqliteHelper db(sqlitePrefix);
-            db.createTable();
-            db.insertRandomRows(rows);
-            log.info("Total rows after insert: " + std::to_string(db.getRowCount()));
-
-            std::string dumpFile = sqlitePrefix + "_backup_" + currentTimestamp() + ".sqlite";
-            TempFileRemover remover(dumpFile);
+// Daemon scheduler and the running backup, both stopped from the signal handler
+std::atomic<Scheduler*> g_scheduler{nullptr};
+static_assert(std::atomic<Scheduler*>::is_always_lock_free, "the signal handler needs a lock-free pointer");
+CancellationToken g_stopToken;
 
-            db.backupToFile(dumpFile);
-            log.info("Database binary backup created at: " + dumpFile);
-
-            FtpUploader uploader(ftpHost, ftpPort, ftpUser, ftpPass);
-            uploader.enableVerbose(true);
-            uploader.setRetries(retries);
-            uploader.setTimeout(timeout);
-            uploader.setSslVerify(sslVerify);
+extern "C" void handleStopSignal(int sig) {
+    g_stopToken.cancelFromSignal(sig);
+    if (Scheduler* scheduler = g_scheduler.load()) scheduler->stop();
+    // A second signal kills the process if cleanup hangs
+    std::signal(sig, SIG_DFL);
+}
 
-            uploader.setProgressCallback([](double, double, double ultotal, double ulnow) {
-                if (ultotal > 0) {
-                    int percent = static_cast<int>((ulnow / ultotal) * 100.0);
-                    Logger::instance().debug("Upload progress: " + std::to_string(percent) + "%");
-                }
-            });
-
-            log.info("Starting upload to directory: " + ftpDir);
-            uploader.uploadFile(dumpFile, ftpDir);
-            log.info("Upload finished successfully.");
-
-        } catch (const std::exception& ex) {
-            Logger::instance().error("Exception during backup/upload: " + std::string(ex.what()));
-            return false;
-        } catch (...) {
-            Logger::instance().error("Unknown exception during backup/upload.");
-            return false;
-        }
-        return true;
+// Helper: parse a --find-backup time ("YYYY-MM-DD HH:MM[:SS]", 'T' or '_'
+// separators allowed, local time) to Unix time; -1 if malformed
+std::int64_t parseLocalTime(std::string text) {
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (i == 10 && (text[i] == 'T' || text[i] == '_')) text[i] = ' ';
+        if (i > 10 && text[i] == '-') text[i] = ':';
     }
-
-    void setLogLevel(Logger::Level lvl) { logLevel = lvl; }
-
-private:
-    std::string sqlitePrefix;
-    std::string ftpHost;
-    int ftpPort;
-    std::string ftpUser;
-    std::string ftpPass;
-    std::string ftpDir;
-    bool sslVerify;
-    int rows;
-    int retries;
-    long timeout;
-    Logger::Level logLevel = Logger::Level::INFO;
-};
+    if (text.size() == 16) text += ":59";   // a whole minute includes its last second
+    std::tm tm{};
+    std::istringstream in(text);
+    in >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (in.fail() || in.peek() != std::char_traits<char>::eof()) return -1;
+    tm.tm_isdst = -1;
+    return static_cast<std::int64_t>(std::mktime(&tm));
+}
 
 // Helper: parse --flag=value or --flag value style
 bool parseOptionalFlag(int& i, int argc, char** argv,
@@ -164,6 +149,23 @@ bool parseOptionalFlag(int& i, int argc, char** argv,
 
 
 int main(int argc, char** argv) {
+    // Before any thread exists: libcurl's global init is not thread-safe
+    CurlGlobal curl;
+    if (argc >= 2 && std::string_view(argv[1]) == "--decrypt") {
+        if (argc != 5) {
+            printUsage(argv[0]);
+            return EXIT_INVALID_ARGS;
+        }
+        try {
+            ChunkCipher::decryptFile(argv[2], argv[3], ChunkCipher::loadKeyFile(argv[4]));
+        } catch (const std::exception& e) {
+            std::cerr << "Decryption failed: " << e.what() << "\n";
+            return EXIT_RESTORE_FAILED;
+        }
+        std::cout << "Decrypted " << argv[2] << " to " << argv[3] << "\n";
+        return 0;
+    }
+
     if (argc < 7) {
         std::cerr << "Invalid number of arguments.\n";
         printUsage(argv[0]);
@@ -195,8 +197,81 @@ int main(int argc, char** argv) {
     int retries = 3;
     long timeout = 30;
     Logger::Level logLevel = Logger::Level::INFO;
+    bool daemon = false;
+    std::string scheduleSpec = "5m";
+    long jitter = 0;
+    long workers = 0;
+    bool pinWorkers = false;
+    bool perfCounters = false;
+    std::string journalPath;
+    int metricsPort = 0;
+    std::string metricsFile;
+    std::string tracePath;
+    SpillPolicy spillPolicy;
+    BackgroundIoPolicy backgroundIo;
+    long maxRuntime = 0;
+    EncryptionConfig encryption;
+    encryption.algorithm = ChunkCipher::preferredAlgorithm();
+    std::string encryptKeyFile;
+    ChecksumAlgorithm checksum = ChecksumAlgorithm::Xxh3;
+    long manifestLeafKb = BackupManifest::kDefaultLeafSize / 1024;
+    std::string verifyName;
+    long verifyLeaves = 0;
+    bool chunked = false;
+    bool skipUnchanged = false;
+    bool compact = false;
+    long chunkKb = 64;
+    long ftpSessions = 4;
+    std::string restoreName;
+    std::optional<CatalogEntry> restoreEntry;
+    std::string restoreTo;
+    std::string restoreAt;
+    long incremental = 0;
+    std::string verifyUpload;
+    bool gc = false;
+    GcOptions gcOptions;
+    std::string catalogPath;
+    std::string findBackup;
 
     for (int i = 7; i < argc; ++i) {
+        // Boolean flags take no value
+        std::string_view arg = argv[i];
+        if (arg == "--no-ssl-verify") {
+            sslVerify = false;
+            continue;
+        } else if (arg == "--daemon") {
+            daemon = true;
+            continue;
+        } else if (arg == "--pin-workers") {
+            pinWorkers = true;
+            continue;
+        } else if (arg == "--perf-counters") {
+            perfCounters = true;
+            continue;
+        } else if (arg == "--background") {
+            backgroundIo.enabled = true;
+            continue;
+        } else if (arg == "--chunked") {
+            chunked = true;
+            continue;
+        } else if (arg == "--compact") {
+            compact = true;
+            continue;
+        } else if (arg == "--skip-unchanged") {
+            skipUnchanged = true;
+            continue;
+        } else if (arg == "--gc") {
+            gc = true;
+            continue;
+        } else if (arg == "--gc-dry-run") {
+            gcOptions.dryRun = true;
+            continue;
+        } else if (arg == "--direct-io") {
+            backgroundIo.enabled = true;
+            backgroundIo.directIo = true;
+            continue;
+        }
+
         std::string_view flag, value;
         if (!parseOptionalFlag(i, argc, argv, flag, value)) {
             std::cerr << "Invalid option format: " << argv[i] << "\n";
@@ -204,11 +279,9 @@ int main(int argc, char** argv) {
         }
 
         try {
-            if (flag == "--no-ssl-verify") {
-                sslVerify = false;
-            } else if (flag == "--rows") {
+            if (flag == "--rows") {
                 rows = std::stoi(std::string(value));
-                if (rows <= 0) throw std::out_of_range("must be > 0");
+                if (rows < 0) throw std::out_of_range("must be >= 0");
             } else if (flag == "--retries") {
                 retries = std::stoi(std::string(value));
                 if (retries < 0) throw std::out_of_range("must be >= 0");
@@ -221,6 +294,113 @@ int main(int argc, char** argv) {
                 else if (value == "warn") logLevel = Logger::Level::WARNING;
                 else if (value == "error") logLevel = Logger::Level::ERROR;
                 else throw std::invalid_argument("invalid log level");
+            } else if (flag == "--schedule") {
+                scheduleSpec = std::string(value);
+                Schedule{scheduleSpec}; // validate now, not when the daemon starts
+            } else if (flag == "--jitter") {
+                jitter = std::stol(std::string(value));
+                if (jitter < 0) throw std::out_of_range("must be >= 0");
+            } else if (flag == "--workers") {
+                workers = std::stol(std::string(value));
+                if (workers < 0) throw std::out_of_range("must be >= 0");
+            } else if (flag == "--journal") {
+                journalPath = std::string(value);
+                if (journalPath.empty()) throw std::invalid_argument("path is empty");
+            } else if (flag == "--metrics-port") {
+                metricsPort = std::stoi(std::string(value));
+                if (metricsPort <= 0 || metricsPort > 65535) throw std::out_of_range("must be 1-65535");
+            } else if (flag == "--metrics-file") {
+                metricsFile = std::string(value);
+                if (metricsFile.empty()) throw std::invalid_argument("path is empty");
+            } else if (flag == "--trace") {
+                tracePath = std::string(value);
+                if (tracePath.empty()) throw std::invalid_argument("path is empty");
+            } else if (flag == "--spill-dir") {
+                spillPolicy.directory = std::string(value);
+                if (spillPolicy.directory.empty()) throw std::invalid_argument("path is empty");
+            } else if (flag == "--spill-mem-mb") {
+                long long mb = std::stoll(std::string(value));
+                if (mb < 0) throw std::out_of_range("must be >= 0");
+                spillPolicy.allowMemory = mb > 0;
+                spillPolicy.memoryLimitBytes = static_cast<std::uint64_t>(mb) << 20;
+            } else if (flag == "--max-runtime") {
+                maxRuntime = std::stol(std::string(value));
+                if (maxRuntime < 0) throw std::out_of_range("must be >= 0");
+            } else if (flag == "--encrypt-key-file") {
+                encryptKeyFile = std::string(value);
+                if (encryptKeyFile.empty()) throw std::invalid_argument("path is empty");
+            } else if (flag == "--encrypt-cipher") {
+                if (value == "auto") encryption.algorithm = ChunkCipher::preferredAlgorithm();
+                else if (value == "aes-256-gcm") encryption.algorithm = CipherAlgorithm::Aes256Gcm;
+                else if (value == "chacha20-poly1305") encryption.algorithm = CipherAlgorithm::ChaCha20Poly1305;
+                else throw std::invalid_argument("expected auto, aes-256-gcm or chacha20-poly1305");
+            } else if (flag == "--encrypt-frame-kb") {
+                long kb = std::stol(std::string(value));
+                if (kb <= 0 || kb > 64 * 1024) throw std::out_of_range("must be 1-65536");
+                encryption.frameSize = static_cast<std::uint32_t>(kb) * 1024;
+            } else if (flag == "--checksum") {
+                checksum = Checksum::parseAlgorithm(std::string(value));
+            } else if (flag == "--manifest-leaf-kb") {
+                manifestLeafKb = std::stol(std::string(value));
+                if (manifestLeafKb < 0 || manifestLeafKb > 1024 * 1024) throw std::out_of_range("must be 0-1048576");
+            } else if (flag == "--verify") {
+                verifyName = std::string(value);
+                if (verifyName.empty()) throw std::invalid_argument("name is empty");
+            } else if (flag == "--verify-leaves") {
+                verifyLeaves = std::stol(std::string(value));
+                if (verifyLeaves < 0) throw std::out_of_range("must be >= 0");
+            } else if (flag == "--chunk-kb") {
+                chunkKb = std::stol(std::string(value));
+                if (chunkKb < 1 || chunkKb > 4096) throw std::out_of_range("must be 1-4096");
+            } else if (flag == "--ftp-sessions") {
+                ftpSessions = std::stol(std::string(value));
+                if (ftpSessions < 1 || ftpSessions > 64) throw std::out_of_range("must be 1-64");
+            } else if (flag == "--restore") {
+                restoreName = std::string(value);
+                if (restoreName.empty()) throw std::invalid_argument("name is empty");
+            } else if (flag == "--restore-to") {
+                restoreTo = std::string(value);
+                if (restoreTo.empty()) throw std::invalid_argument("path is empty");
+            } else if (flag == "--restore-at") {
+                restoreAt = std::string(value);
+                if (restoreAt != "latest" && parseLocalTime(restoreAt) < 0) {
+                    throw std::invalid_argument("expected 'latest' or YYYY-MM-DD HH:MM[:SS]");
+                }
+            } else if (flag == "--incremental") {
+                incremental = std::stol(std::string(value));
+                if (incremental < 0) throw std::out_of_range("must be >= 0");
+            } else if (flag == "--verify-upload") {
+                verifyUpload = std::string(value);
+                if (verifyUpload != "quick" && verifyUpload != "full") throw std::invalid_argument("expected quick or full");
+            } else if (flag == "--catalog") {
+                catalogPath = std::string(value);
+                if (catalogPath.empty()) throw std::invalid_argument("path is empty");
+            } else if (flag == "--find-backup") {
+                findBackup = std::string(value);
+                if (findBackup != "latest" && parseLocalTime(findBackup) < 0) {
+                    throw std::invalid_argument("expected 'latest' or YYYY-MM-DD HH:MM[:SS]");
+                }
+            } else if (flag == "--gc-keep") {
+                long keep = std::stol(std::string(value));
+                if (keep < 0) throw std::out_of_range("must be >= 0");
+                gcOptions.keepBackups = static_cast<std::size_t>(keep);
+            } else if (flag == "--gc-min-age") {
+                long age = std::stol(std::string(value));
+                if (age < 0) throw std::out_of_range("must be >= 0");
+                gcOptions.minChunkAge = std::chrono::seconds(age);
+            } else if (flag == "--io-class") {
+                if (value == "idle") backgroundIo.ioClass = IoPriorityClass::Idle;
+                else if (value == "be") backgroundIo.ioClass = IoPriorityClass::BestEffortLow;
+                else throw std::invalid_argument("expected idle or be");
+                backgroundIo.enabled = true;
+            } else if (flag == "--read-mbps") {
+                backgroundIo.maxMBps = std::stod(std::string(value));
+                if (backgroundIo.maxMBps <= 0) throw std::out_of_range("must be > 0");
+                backgroundIo.enabled = true;
+            } else if (flag == "--read-iops") {
+                backgroundIo.maxIops = std::stod(std::string(value));
+                if (backgroundIo.maxIops <= 0) throw std::out_of_range("must be > 0");
+                backgroundIo.enabled = true;
             } else {
                 std::cerr << "Unknown option: " << flag << "\n";
                 printUsage(argv[0]);
@@ -233,6 +413,30 @@ int main(int argc, char** argv) {
 
     }
 
+    if (!findBackup.empty() && catalogPath.empty()) {
+        std::cerr << "--find-backup needs --catalog\n";
+        return EXIT_INVALID_ARGS;
+    }
+    if ((!restoreAt.empty() || incremental > 0) && catalogPath.empty()) {
+        std::cerr << (incremental > 0 ? "--incremental" : "--restore-at") << " needs --catalog\n";
+        return EXIT_INVALID_ARGS;
+    }
+    if (chunked && incremental > 0) {
+        std::cerr << "--chunked cannot be combined with --incremental\n";
+        return EXIT_INVALID_ARGS;
+    }
+    if (chunked && !encryptKeyFile.empty()) {
+        std::cerr << "--chunked cannot be combined with --encrypt-key-file\n";
+        return EXIT_INVALID_ARGS;
+    }
+
+    TaskScheduler::configure(static_cast<std::size_t>(workers), pinWorkers);
+    PerfCounters::instance().setEnabled(perfCounters);
+    if (!tracePath.empty()) {
+        Tracer::instance().setEnabled(true);
+        Tracer::instance().setThreadName("main");
+    }
+
     // Read password from environment if requested
     std::string ftpPass;
     if (ftpPassArg == "-") {
@@ -255,14 +459,193 @@ int main(int argc, char** argv) {
                       std::string(ftpUser), ftpPass, std::string(ftpDir),
                       sslVerify, rows, retries, timeout);
     mgr.setLogLevel(logLevel);
+    mgr.setSpillPolicy(spillPolicy);
+    mgr.setBackgroundIo(backgroundIo);
+    mgr.setChecksumAlgorithm(checksum);
+    mgr.setManifestLeafSize(static_cast<std::uint32_t>(manifestLeafKb) * 1024);
+    mgr.setChunkedStorage(chunked, ChunkingParams::forAverage(static_cast<std::uint32_t>(chunkKb) * 1024));
+    mgr.setFtpSessions(static_cast<std::size_t>(ftpSessions));
+    mgr.setIncremental(static_cast<std::size_t>(incremental));
+    mgr.setSkipUnchanged(skipUnchanged);
+    mgr.setCompaction(compact);
+    if (!verifyUpload.empty()) mgr.setUploadVerification(true, verifyUpload == "full");
+    if (!encryptKeyFile.empty()) {
+        try {
+            encryption.key = ChunkCipher::loadKeyFile(encryptKeyFile);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return EXIT_CONFIG_ERROR;
+        }
+        encryption.enabled = true;
+        mgr.setEncryption(encryption);
+    }
+    mgr.setStopToken(&g_stopToken);
+    mgr.setMaxRunDuration(std::chrono::seconds(maxRuntime));
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+    if (!catalogPath.empty()) mgr.setCatalog(catalogPath);
+    if (!journalPath.empty()) {
+        try {
+            mgr.setJournal(journalPath);
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot open job journal: " << e.what() << "\n";
+            return EXIT_CONFIG_ERROR;
+        }
+    }
+
+    if (!findBackup.empty()) {
+        std::vector<CatalogEntry> chain;
+        try {
+            chain = mgr.findBackup(findBackup == "latest" ? std::nullopt
+                                                          : std::optional<std::int64_t>(parseLocalTime(findBackup)));
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot read the backup catalog: " << e.what() << "\n";
+            return EXIT_CONFIG_ERROR;
+        }
+        if (chain.empty()) {
+            std::cerr << "No backup found at or before " << findBackup << ".\n";
+            return EXIT_NOT_FOUND;
+        }
+        // One line per backup the restore needs, base first
+        for (const CatalogEntry& e : chain) {
+            std::time_t created = static_cast<std::time_t>(e.createdAt);
+            std::tm tm{};
+#if defined(_WIN32)
+            localtime_s(&tm, &created);
+#else
+            localtime_r(&created, &tm);
+#endif
+            std::cout << e.remoteDir << "/" << e.remoteName << "  " << std::put_time(&tm, "%Y-%m-%d %H:%M:%S")
+                      << "  " << e.size << " bytes  " << BackupCatalog::formatToString(e.format) << "  " << e.hash
+                      << "\n";
+        }
+        return 0;
+    }
+
+    if (!restoreAt.empty()) {
+        // The planner: the catalog names the restore point, restore() fetches its chain
+        std::vector<CatalogEntry> chain;
+        try {
+            chain = mgr.findBackup(restoreAt == "latest" ? std::nullopt
+                                                         : std::optional<std::int64_t>(parseLocalTime(restoreAt)));
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot read the backup catalog: " << e.what() << "\n";
+            return EXIT_CONFIG_ERROR;
+        }
+        if (chain.empty()) {
+            std::cerr << "No backup found at or before " << restoreAt << ".\n";
+            return EXIT_NOT_FOUND;
+        }
+        restoreEntry = chain.back();
+        restoreName = restoreEntry->remoteName;
+    }
+
+    if (!restoreName.empty()) {
+        std::string output = restoreTo;
+        if (output.empty()) {
+            // The restored file is plaintext whatever the backup's name says
+            output = std::filesystem::path(restoreName).filename().string();
+            for (const std::string suffix : {".enc", PageDelta::kSuffix}) {
+                if (output.size() > suffix.size() && output.compare(output.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                    output.resize(output.size() - suffix.size());
+                }
+            }
+        }
+        // A cataloged backup is fetched from the directory it was uploaded to
+        if (!(restoreEntry ? mgr.restore(*restoreEntry, output) : mgr.restore(restoreName, output))) {
+            std::cerr << "Restore of " << restoreName << " failed. See logs for details.\n";
+            return EXIT_RESTORE_FAILED;
+        }
+        std::cout << "Restored " << restoreName << " to " << output << ".\n";
+        return 0;
+    }
+
+    if (!verifyName.empty()) {
+        if (!mgr.verifyRemote(verifyName, static_cast<std::size_t>(verifyLeaves))) {
+            std::cerr << "Verification of " << verifyName << " failed. See logs for details.\n";
+            return EXIT_VERIFY_FAILED;
+        }
+        std::cout << "Verified " << verifyName << " against its manifest.\n";
+        return 0;
+    }
+
+    if (gc && !daemon) {
+        if (!mgr.collectGarbage(gcOptions)) {
+            std::cerr << "Garbage collection failed. See logs for details.\n";
+            return EXIT_UPLOAD_FAILED;
+        }
+        std::cout << "Garbage collection completed.\n";
+        return 0;
+    }
+
+    // After each run: metrics textfile, and the trace of that run (the
+    // buffer is cleared so a daemon's trace file always holds the last run)
+    auto writeRunOutputs = [&metricsFile, &tracePath] {
+        if (!metricsFile.empty()) {
+            try {
+                MetricsRegistry::instance().writeTextfile(metricsFile);
+            } catch (const std::exception& e) {
+                Logger::instance().warn(std::string("Failed to write metrics file: ") + e.what());
+            }
+        }
+        if (!tracePath.empty()) {
+            try {
+                Tracer::instance().writeChromeTrace(tracePath);
+                Tracer::instance().clear();
+                Logger::instance().info("Trace written to " + tracePath);
+            } catch (const std::exception& e) {
+                Logger::instance().warn(std::string("Failed to write trace: ") + e.what());
+            }
+        }
+    };
+
+    if (daemon) {
+        MetricsServer metricsServer(MetricsRegistry::instance(), metricsPort);
+        if (metricsPort > 0) {
+            try {
+                metricsServer.start();
+            } catch (const std::exception& e) {
+                std::cerr << "Cannot start metrics endpoint: " << e.what() << "\n";
+                return EXIT_CONFIG_ERROR;
+            }
+        }
+
+        Scheduler scheduler;
+        scheduler.addJob("backup", Schedule(scheduleSpec), [&mgr, &writeRunOutputs, gc, &gcOptions] {
+                             // Same process as the backups, so a collection never races an upload
+                             if (mgr.run() && gc) mgr.collectGarbage(gcOptions);
+                             writeRunOutputs();
+                         },
+                         std::chrono::seconds(jitter));
+
+        g_scheduler.store(&scheduler);
+        if (g_stopToken.isCancelled()) scheduler.stop();   // signalled during start-up
+
+        scheduler.run();
+        g_scheduler.store(nullptr);
+
+        std::cout << "Daemon stopped after " << mgr.getRunCount() << " run(s).\n";
+        return 0;
+    }
 
     bool success = mgr.run();
+    const bool verified = mgr.waitForVerification();
+    writeRunOutputs();
 
+    if (!success && g_stopToken.isCancelled()) {
+        std::cerr << "Backup stopped: " << g_stopToken.reason() << ".\n";
+        return EXIT_CANCELLED;
+    }
     if (!success) {
         std::cerr << "Backup and upload failed. See logs for details.\n";
         return EXIT_UPLOAD_FAILED;
     }
 
+    if (!verified) {
+        std::cerr << "The uploaded backup failed verification. See logs for details.\n";
+        return EXIT_VERIFY_FAILED;
+    }
+
     std::cout << "Backup and upload completed successfully.\n";
     return 0;
 }
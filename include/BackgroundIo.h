@@ -0,0 +1,91 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+
+/** I/O scheduling class for the thread doing the backup */
+enum class IoPriorityClass {
+    Normal,         // leave as is
+    BestEffortLow,  // best-effort class, lowest level
+    Idle            // only served when the disk is otherwise idle
+};
+
+/**
+ * @brief How the backup reads the source database when it must not
+ * disturb the application using it ("background citizen" mode)
+ */
+struct BackgroundIoPolicy {
+    bool enabled = false;
+    IoPriorityClass ioClass = IoPriorityClass::Idle;
+    /** Drop pages the backup pulled into the page cache once read (fadvise DONTNEED) */
+    bool dropCache = true;
+    /** Read with O_DIRECT, bypassing the page cache entirely (falls back if unsupported) */
+    bool directIo = false;
+    /** Caps on source reads; 0 = unlimited */
+    double maxMBps = 0;
+    double maxIops = 0;
+};
+
+/**
+ * @brief Token bucket: acquire() blocks until the requested amount fits
+ *
+ * Requests larger than the burst are admitted and paid back by the
+ * following callers, so the long-run rate holds for any request size.
+ */
+class RateLimiter {
+public:
+    /**
+     * @param perSecond - sustained rate (> 0)
+     * @param burst - bucket size; 0 = a tenth of a second's worth
+     */
+    explicit RateLimiter(double perSecond, double burst = 0);
+
+    /** Take n units, sleeping if needed; returns the seconds slept */
+    double acquire(double n);
+
+private:
+    std::mutex mtx;
+    double rate;
+    double capacity;
+    double tokens;
+    std::chrono::steady_clock::time_point last;
+};
+
+/**
+ * @brief Lowers the calling thread's I/O priority for its lifetime
+ *
+ * Linux: ioprio_set (honoured by the BFQ and CFQ schedulers). Windows:
+ * background processing mode, which also lowers I/O and memory priority.
+ * Elsewhere, or if the call fails, it does nothing.
+ */
+class ScopedIoPriority {
+public:
+    explicit ScopedIoPriority(IoPriorityClass ioClass);
+    ~ScopedIoPriority();
+
+    ScopedIoPriority(const ScopedIoPriority&) = delete;
+    ScopedIoPriority& operator=(const ScopedIoPriority&) = delete;
+
+    bool applied() const { return active; }
+
+private:
+    bool active = false;
+    int previous = 0;
+};
+
+/**
+ * @brief SQLite VFS that reads a database file like a background job
+ *
+ * Wraps the default VFS. Main database files opened through it are read
+ * under the policy passed in the URI (see uri()): MB/s and IOPS caps,
+ * O_DIRECT reads, and page-cache cleanup behind the reader that only
+ * drops pages which were not cached before the backup touched them, so
+ * the application's hot pages stay resident.
+ */
+namespace BackgroundIoVfs {
+    /** Registered VFS name */
+    const char* name();
+
+    /** "file:" URI opening `path` read-only through this VFS under `policy` */
+    std::string uri(const std::string& path, const BackgroundIoPolicy& policy);
+}
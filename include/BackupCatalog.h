@@ -0,0 +1,88 @@
+#pragma once
+#include <sqlite3.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/** How a backup is stored on the server; a Delta (see PageDelta) needs its parent chain */
+enum class BackupFormat { Plain, Encrypted, Chunked, Delta };
+
+/** One uploaded backup */
+struct CatalogEntry {
+    std::int64_t id = 0;
+    std::string dbId;               // source database, as named in backup file names
+    std::int64_t createdAt = 0;     // Unix time of the snapshot
+    std::int64_t size = 0;          // bytes of the backup as restored
+    std::string hash;               // Checksum::label() of the uploaded bytes
+    std::string remoteDir;
+    std::string remoteName;         // backup name (a chunked backup's recipe is name + ".recipe")
+    BackupFormat format = BackupFormat::Plain;
+    std::int64_t parentId = 0;      // backup this one is a delta against; 0 = self-contained
+};
+
+/**
+ * @brief Local SQLite catalog of every uploaded backup
+ *
+ * Answers "latest backup of X" and "latest backup of X at or before T" from
+ * an index on (db_id, created_at) instead of listing and parsing the FTP
+ * directory, and walks parent links to the chain a delta needs. One row per
+ * remote file: recording the same remote name again replaces the row.
+ *
+ * The catalog is small, so after every change BackupManager uploads a
+ * compacted copy (exportTo) next to the backups, and a machine without a
+ * local catalog starts from that copy.
+ */
+class BackupCatalog {
+public:
+    /** Name of the catalog copy in the backup directory */
+    static constexpr const char* kRemoteName = "catalog.sqlite";
+
+    /**
+     * Open (or create) the catalog database
+     * @throws std::runtime_error on failure
+     */
+    explicit BackupCatalog(const std::string& path);
+    ~BackupCatalog();
+
+    BackupCatalog(const BackupCatalog&) = delete;
+    BackupCatalog& operator=(const BackupCatalog&) = delete;
+
+    /** Record an upload; returns its id */
+    std::int64_t record(const CatalogEntry& entry);
+
+    /** Newest backup of dbId, or the newest at or before `atOrBefore` (Unix time) */
+    std::optional<CatalogEntry> latest(const std::string& dbId,
+                                       std::optional<std::int64_t> atOrBefore = std::nullopt);
+
+    std::optional<CatalogEntry> find(const std::string& remoteDir, const std::string& remoteName);
+
+    /**
+     * The backups needed to restore `id`: its self-contained ancestor first, `id` last
+     * @throws std::runtime_error if a link is missing or the chain has a cycle
+     */
+    std::vector<CatalogEntry> chain(std::int64_t id);
+
+    /** Backups of dbId, newest first; limit 0 = all */
+    std::vector<CatalogEntry> list(const std::string& dbId, std::size_t limit = 0);
+
+    /** Forget a deleted backup; returns false if it was not recorded */
+    bool remove(const std::string& remoteDir, const std::string& remoteName);
+
+    std::size_t size();
+
+    /**
+     * Write a compacted, self-contained copy (VACUUM INTO) for upload
+     * @throws std::runtime_error on failure
+     */
+    void exportTo(const std::string& file);
+
+    static std::string formatToString(BackupFormat format);
+    static BackupFormat formatFromString(const std::string& s);
+
+private:
+    sqlite3* db = nullptr;
+    std::string path;
+
+    void exec(const char* sql);
+};
@@ -0,0 +1,311 @@
+#pragma once
+#include "Logger.h"
+#include "BackgroundIo.h"
+#include "BackupCatalog.h"
+#include "BackupManifest.h"
+#include "BackupPipeline.h"
+#include "Cancellation.h"
+#include "Checksum.h"
+#include "ChunkCipher.h"
+#include "ChunkStore.h"
+#include "PageDelta.h"
+#include "SpillFile.h"
+#include <chrono>
+#include <future>
+#include <string>
+#include <memory>
+#include <optional>
+#include <vector>
+
+class SqliteHelper;
+struct TableDigest;
+struct ChangeStamp;
+class FtpUploader;
+class JobJournal;
+struct GcOptions;
+
+/**
+ * @brief Backup orchestrator: populate DB → binary backup → FTP upload → cleanup
+ *
+ * The upload streams the snapshot through a BackupPipeline
+ * (read → [encrypt →] hash → upload) so disk reads, CPU work and the network overlap.
+ * A BackupManifest (Merkle tree over fixed ranges of the uploaded bytes) is
+ * built alongside and uploaded next to each backup. In chunked mode the
+ * sink splits the stream into content-defined chunks instead and uploads
+ * only those the remote store lacks, plus a recipe.
+ *
+ * The SQLite handle and the FTP session are created on the first run() and
+ * kept for the lifetime of the manager, so repeated runs (daemon mode) reuse
+ * the open database, curl's DNS/TLS caches and the logged-in control connection.
+ */
+class BackupManager {
+public:
+    BackupManager(const std::string& sqlitePrefix,
+                  const std::string& ftpHost, int ftpPort,
+                  const std::string& ftpUser, const std::string& ftpPass,
+                  const std::string& ftpDir,
+                  bool sslVerify, int rows, int retries, long timeout);
+
+    ~BackupManager();
+
+    /**
+     * Run one backup cycle
+     *
+     * Stops early, releasing the snapshot and the partial remote file, when
+     * the stop token fires or the run exceeds its maximum duration.
+     * @return true on success; errors and cancellations are logged, never thrown
+     */
+    bool run();
+
+    /**
+     * Process-wide token (e.g. cancelled from SIGTERM/SIGINT) that stops the
+     * current run at the next safe point. Not owned; nullptr to detach.
+     */
+    void setStopToken(const CancellationToken* token) { stopToken = token; }
+
+    /** Deadline for each run, measured from its start; 0 = none */
+    void setMaxRunDuration(std::chrono::seconds limit) { maxRunDuration = limit; }
+
+    void setLogLevel(Logger::Level lvl) { logLevel = lvl; }
+
+    /** Number of completed run() calls, successful or not */
+    std::size_t getRunCount() const { return runCount; }
+
+    /**
+     * Record job progress in a durable journal at `path` so a crashed or
+     * failed run can be resumed: the next run() reuses the snapshot and
+     * continues the upload from the bytes already on the server.
+     * @throws std::runtime_error if the journal cannot be opened
+     */
+    void setJournal(const std::string& path);
+
+    /** Chunk size and ring depth of the read → hash → upload pipeline */
+    void setPipelineChunkSize(std::size_t bytes) { pipelineChunkSize = bytes; }
+    void setPipelineDepth(std::size_t depth) { pipelineDepth = depth; }
+
+    /**
+     * Where the snapshot copy lives between backup and upload: a memfd when
+     * it fits the memory limit, else an anonymous file in the spill
+     * directory. With a journal the snapshot must survive a crash, so it is
+     * a named file next to the source database instead.
+     */
+    void setSpillPolicy(const SpillPolicy& policy) { spillPolicy = policy; }
+
+    /** Read the source database as a low-priority, throttled background job */
+    void setBackgroundIo(const BackgroundIoPolicy& policy);
+
+    /**
+     * Encrypt uploads with framed AES-256-GCM/ChaCha20-Poly1305 (see
+     * ChunkCipher); remote files get a ".enc" suffix
+     */
+    void setEncryption(const EncryptionConfig& config) { encryption = config; }
+
+    /**
+     * Digest computed by the pipeline's hash stage over the uploaded bytes,
+     * logged and stored in the journal (default XXH3)
+     */
+    void setChecksumAlgorithm(ChecksumAlgorithm algorithm) { checksumAlgorithm = algorithm; }
+
+    /**
+     * Bytes per leaf of the Merkle manifest uploaded next to each backup
+     * (default 1 MiB); 0 skips the manifest
+     */
+    void setManifestLeafSize(std::uint32_t bytes) { manifestLeafSize = bytes; }
+
+    /**
+     * Check a remote backup against its manifest, downloading only the
+     * checked ranges
+     * @param remoteName - backup file name in the FTP directory
+     * @param sampleLeaves - number of leaves to check, spread over the file; 0 = all
+     * @return true if every checked range matches; failures are logged, never thrown
+     */
+    bool verifyRemote(const std::string& remoteName, std::size_t sampleLeaves = 0);
+
+    /**
+     * Store backups as content-defined chunks shared between backups (see
+     * ChunkStore): each run uploads only the chunks missing from the remote
+     * chunk index, then "<backup>.recipe". Cannot be combined with
+     * encryption, which makes every backup's bytes unique.
+     */
+    void setChunkedStorage(bool on, const ChunkingParams& params = ChunkingParams()) {
+        chunkedStorage = on;
+        chunking = params;
+    }
+
+    /**
+     * Upload page deltas (see PageDelta) against the previous backup, with
+     * a full backup every `fullEvery` runs; 0 turns deltas off. Needs a
+     * catalog: it links each delta to its parent, and the page map of the
+     * last backup is kept next to it ("<catalog>.<db>.pages").
+     */
+    void setIncremental(std::size_t fullEvery) { fullBackupEvery = fullEvery; }
+
+    /**
+     * Skip a run whose database has not changed since the last successful
+     * backup, judged by SqliteHelper::changeStamp before anything is copied.
+     * The stamp is kept in memory, so only daemon runs after the first skip.
+     */
+    void setSkipUnchanged(bool on) { skipUnchanged = on; }
+
+    /**
+     * Take snapshots with SqliteHelper::vacuumToFile instead of the online
+     * backup: free pages are left out and pages packed, so a database with
+     * many deleted rows uploads at the size of its live data
+     */
+    void setCompaction(bool on) { compactSnapshots = on; }
+
+    /**
+     * Check every upload by restoring it on a background thread: the backup
+     * is downloaded into a sandbox file in the spill directory, checked
+     * with PRAGMA quick_check (integrity_check with `fullCheck`), and each
+     * table's row count and digest are compared with the snapshot's, which
+     * are computed while the upload runs. One check runs at a time.
+     */
+    void setUploadVerification(bool on, bool fullCheck = false) {
+        uploadVerification = on;
+        fullIntegrityCheck = fullCheck;
+    }
+
+    /**
+     * Wait for the check of the last upload
+     * @return false if it failed; true if it passed or none was started
+     */
+    bool waitForVerification();
+
+    /** Parallel FTP sessions for chunk uploads, restores and garbage collection (default 4) */
+    void setFtpSessions(std::size_t sessions) { ftpSessions = sessions; }
+
+    /**
+     * Download a backup over parallel FTP sessions into `outputFile` and
+     * check it with PRAGMA quick_check. Plain and encrypted backups are
+     * fetched as byte ranges (REST offsets) written in place into a
+     * preallocated file, each range checked against the manifest as it
+     * arrives; chunked backups are rebuilt from their recipe. Encrypted
+     * backups need the key (setEncryption).
+     *
+     * A delta is restored as the chain the catalog records for it: the
+     * full backup, then each delta applied in order while the next one
+     * downloads, so any backup in the chain is a restore point.
+     * @param remoteName - backup file name (for a chunked backup, without ".recipe")
+     * @param outputFile - local file to create; removed again on failure
+     * @return true on success; failures are logged, never thrown
+     */
+    bool restore(const std::string& remoteName, const std::string& outputFile);
+
+    /**
+     * Restore a backup found in the catalog (findBackup()) from the
+     * directory it was uploaded to, which need not be the current one
+     * @return true on success; failures are logged, never thrown
+     */
+    bool restore(const CatalogEntry& entry, const std::string& outputFile);
+
+    /**
+     * Apply retention and delete unreferenced chunks from the FTP directory
+     * (see GarbageCollector); deletes run over the parallel FTP sessions
+     * @return true on success; failures are logged, never thrown
+     */
+    bool collectGarbage(const GcOptions& options);
+
+    /**
+     * Record every upload in a local catalog at `path` (see BackupCatalog)
+     * and keep a copy of it next to the backups. Opened on first use; a
+     * missing file is first fetched from that copy.
+     */
+    void setCatalog(const std::string& path) { catalogPath = path; catalogDb.reset(); }
+
+    /**
+     * Newest backup of this database, or the newest at or before
+     * `atOrBefore` (Unix time), looked up in the catalog
+     * @return the backups needed to restore it, self-contained base first; empty if none
+     * @throws std::runtime_error without a catalog, or if it cannot be read
+     */
+    std::vector<CatalogEntry> findBackup(std::optional<std::int64_t> atOrBefore = std::nullopt);
+
+    /** Require TLS on the FTP connection (default); only benchmarks turn it off */
+    void setFtpTls(bool on) { ftpTls = on; }
+
+    /** Per-stage utilization and stall times of the last upload attempt */
+    const std::vector<StageStats>& getPipelineStats() const { return pipelineStats; }
+
+private:
+    std::string sqlitePrefix;
+    std::string ftpHost;
+    int ftpPort;
+    std::string ftpUser;
+    std::string ftpPass;
+    std::string ftpDir;
+    bool sslVerify;
+    bool ftpTls = true;
+    int rows;
+    int retries;
+    long timeout;
+    Logger::Level logLevel = Logger::Level::INFO;
+    std::size_t runCount = 0;
+    std::size_t pipelineChunkSize = 1 << 20;
+    std::size_t pipelineDepth = 8;
+    std::vector<StageStats> pipelineStats;
+    SpillPolicy spillPolicy;
+    BackgroundIoPolicy backgroundIo;
+    EncryptionConfig encryption;
+    ChecksumAlgorithm checksumAlgorithm = ChecksumAlgorithm::Xxh3;
+    std::uint32_t manifestLeafSize = BackupManifest::kDefaultLeafSize;
+    std::unique_ptr<BackupManifest> previousManifest;   // last uploaded backup, for delta reporting
+    bool chunkedStorage = false;
+    ChunkingParams chunking;
+    std::size_t ftpSessions = 4;
+    std::size_t fullBackupEvery = 0;
+    bool skipUnchanged = false;
+    bool compactSnapshots = false;
+    std::unique_ptr<ChangeStamp> lastBackupStamp;   // source state at the last successful backup
+    bool uploadVerification = false;
+    bool fullIntegrityCheck = false;
+    std::future<bool> verification;     // check of the last upload, running in the background
+    bool lastVerificationOk = true;
+    std::string catalogPath;
+    const CancellationToken* stopToken = nullptr;
+    std::chrono::seconds maxRunDuration{0};
+    const CancellationToken* runCancel = nullptr;   // token of the run in progress
+
+    // Warm resources, reused across runs
+    std::unique_ptr<SqliteHelper> dbHelper;
+    std::unique_ptr<FtpUploader> uploader;
+    std::unique_ptr<JobJournal> journal;
+    std::unique_ptr<BackupCatalog> catalogDb;
+
+    SqliteHelper& database();
+    FtpUploader& ftp();
+    std::unique_ptr<FtpUploader> makeUploader(const CancellationToken* cancel) const;
+    bool runOnce();
+    bool resumeUnfinishedJob();
+    std::string remoteNameFor(const std::string& snapshotFile) const;
+    void discardPartialUpload(const std::string& remoteDir, const std::string& remoteName);
+    std::int64_t uploadSnapshot(const std::string& snapshotFile, const std::string& remoteName,
+                        const std::string& remoteDir, std::int64_t jobId, std::int64_t resumeOffset,
+                        const CipherSalt& cipherSalt, std::int64_t parentId = 0);
+    std::vector<std::size_t> findMismatchedLeaves(const BackupManifest& manifest, const std::string& remoteDir,
+                                                  const std::string& remoteName, const std::vector<std::size_t>& leaves);
+    void uploadManifest(const BackupManifest& manifest, const std::string& remoteDir, const std::string& remoteName);
+    void reportDelta(const BackupManifest& manifest);
+    void uploadChunks(PipelineReader& in, const std::string& remoteDir, ChunkRecipe& recipe);
+    bool restoreBackup(const std::string& remoteDir, const std::string& remoteName,
+                       const std::optional<CatalogEntry>& entry, const std::string& outputFile);
+    std::uint64_t fetchBackup(FtpUploader& control, const std::string& remoteDir, const std::string& remoteName,
+                              const std::string& outputFile);
+    std::uint64_t restoreRanges(FtpUploader& control, const std::string& remoteDir, const std::string& remoteName,
+                                const std::string& outputFile);
+    std::uint64_t restoreChunked(FtpUploader& control, const std::string& remoteDir, const std::string& remoteName,
+                                 const std::string& outputFile);
+    std::uint64_t restoreChain(FtpUploader& control, const std::vector<CatalogEntry>& chain,
+                               const std::string& outputFile);
+    BackupCatalog& catalog();
+    std::string catalogDbId() const;
+    std::string pageMapPath() const;
+    std::optional<std::pair<std::int64_t, PageMap>> deltaBase();
+    void pullCatalog();
+    void syncCatalog();
+    std::int64_t recordInCatalog(const CatalogEntry& entry);
+    void startVerification(const std::string& remoteName, std::int64_t catalogId, bool delta,
+                           std::future<std::vector<TableDigest>>& sourceDigests);
+    bool verifyUpload(FtpUploader& session, const std::vector<CatalogEntry>& chain,
+                      const std::vector<TableDigest>& sourceDigests);
+};
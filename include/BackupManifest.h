@@ -0,0 +1,106 @@
+#pragma once
+#include "Checksum.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Merkle tree over fixed-size ranges of one backup file
+ *
+ * The file is cut into leaves of `leafSize` bytes (default 1 MiB, i.e. 256
+ * SQLite pages of 4 KiB); each leaf is hashed with the configured Checksum
+ * and pairs of nodes are hashed up to a single root. Leaf and inner hashes
+ * get distinct one-byte prefixes, and an unpaired last node is carried up
+ * unchanged.
+ *
+ * The manifest is uploaded next to the backup as "<name>.manifest". Two
+ * manifests with equal roots describe the same bytes; otherwise diff()
+ * descends only into subtrees whose hashes differ, so verification, delta
+ * reporting and resume checks read just the ranges that changed.
+ *
+ * Text format, one field per line:
+ *     sqliteftpbackup-manifest 1
+ *     algorithm <name>
+ *     leaf-size <bytes>
+ *     size <bytes>
+ *     root <hex>
+ *     <hex of leaf 0>
+ *     ...
+ */
+class BackupManifest {
+public:
+    using Digest = std::vector<unsigned char>;
+
+    static constexpr std::uint32_t kDefaultLeafSize = 1u << 20;
+
+    /** @throws std::invalid_argument if leafSize is 0 */
+    explicit BackupManifest(ChecksumAlgorithm algorithm = ChecksumAlgorithm::Xxh3,
+                            std::uint32_t leafSize = kDefaultLeafSize);
+
+    BackupManifest(BackupManifest&&) noexcept = default;
+    BackupManifest& operator=(BackupManifest&&) noexcept = default;
+
+    /** Hash the next bytes of the file, in order */
+    void update(const void* data, std::size_t len);
+
+    /** Seal the last partial leaf and build the tree; update() is an error afterwards */
+    void finish();
+    bool isFinished() const { return finished; }
+
+    /** Convenience: manifest of a local file */
+    static BackupManifest fromFile(const std::string& path, ChecksumAlgorithm algorithm,
+                                   std::uint32_t leafSize = kDefaultLeafSize);
+
+    ChecksumAlgorithm algorithm() const { return algo; }
+    std::uint32_t leafSize() const { return leafBytes; }
+    std::uint64_t fileSize() const { return size; }
+    std::size_t leafCount() const { return levels.empty() ? 0 : levels.front().size(); }
+    const Digest& leaf(std::size_t index) const { return levels.front().at(index); }
+    const Digest& root() const { return levels.back().front(); }
+    std::string rootHex() const;
+
+    /** Byte range [offset, offset + length) covered by a leaf */
+    std::pair<std::uint64_t, std::uint64_t> leafRange(std::size_t index) const;
+
+    /** Leaf containing a byte offset (the last leaf for offset == fileSize()) */
+    std::size_t leafAt(std::uint64_t offset) const;
+
+    /**
+     * Leaves whose bytes differ from `other`, including leaves only one of
+     * the two files has, in ascending order. Equal subtrees are skipped
+     * without visiting their leaves.
+     * @throws std::invalid_argument if the algorithms or leaf sizes differ
+     */
+    std::vector<std::size_t> diff(const BackupManifest& other) const;
+
+    /** Whether `data` is exactly the content of leaf `index` */
+    bool verifyLeaf(std::size_t index, const void* data, std::size_t len) const;
+
+    std::string serialize() const;
+
+    /** @throws std::runtime_error if the text is not a well-formed manifest */
+    static BackupManifest parse(const std::string& text);
+
+    /** Remote name of the manifest that describes `remoteName` */
+    static std::string manifestNameFor(const std::string& remoteName) { return remoteName + ".manifest"; }
+
+private:
+    ChecksumAlgorithm algo;
+    std::uint32_t leafBytes;
+    std::uint64_t size = 0;
+    bool finished = false;
+
+    // levels[0] are the leaves, levels.back() holds only the root
+    std::vector<std::vector<Digest>> levels;
+
+    // Hasher of the leaf being filled and its byte count
+    std::unique_ptr<Checksum> current;
+    std::uint64_t currentBytes = 0;
+
+    Digest hashLeaf(const void* data, std::size_t len) const;
+    void sealLeaf();
+    void buildTree();
+    const Digest* node(std::size_t level, std::size_t index) const;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include "SpscRing.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+/** One unit of data flowing through the pipeline */
+struct PipelineChunk {
+    std::uint64_t index = 0;            // sequence number, 0-based
+    std::uint64_t offset = 0;           // offset of the chunk in the source
+    std::vector<unsigned char> data;
+};
+
+/** Per-stage counters, available after run() */
+struct StageStats {
+    std::string name;
+    std::uint64_t items = 0;
+    std::uint64_t bytes = 0;
+    double busySeconds = 0;         // time spent doing the stage's own work
+    double inputStallSeconds = 0;   // waiting for the upstream stage (ring empty)
+    double outputStallSeconds = 0;  // blocked by the downstream stage (ring full)
+    double wallSeconds = 0;
+
+    /** Fraction of the stage's wall time spent doing useful work */
+    double utilization() const { return wallSeconds > 0 ? busySeconds / wallSeconds : 0.0; }
+};
+
+using ChunkRing = SpscRing<PipelineChunk>;
+
+/**
+ * @brief Pull-side view of the last ring, handed to the sink stage
+ *
+ * Lets a byte-oriented consumer (e.g. a curl read callback) read the
+ * chunk stream as a contiguous byte stream.
+ */
+class PipelineReader {
+public:
+    explicit PipelineReader(ChunkRing& ring) : ring(ring) {}
+
+    /** Copy up to len bytes into buf; returns 0 at end of stream */
+    std::size_t read(char* buf, std::size_t len);
+
+    /** Pop the next whole chunk; returns false at end of stream */
+    bool next(PipelineChunk& chunk);
+
+    std::uint64_t getBytesRead() const { return bytesRead; }
+
+    /** Called after every chunk taken off the ring (wakes the upstream stage) */
+    void setOnPop(std::function<void()> fn) { onPop = std::move(fn); }
+
+private:
+    ChunkRing& ring;
+    std::function<void()> onPop;
+    PipelineChunk current;
+    std::size_t pos = 0;
+    std::uint64_t bytesRead = 0;
+};
+
+/**
+ * @brief Staged backup pipeline: source → transforms → sink
+ *
+ * Stages are connected by bounded SPSC rings, so reading, CPU work and the
+ * upload overlap and the total time approaches that of the slowest stage.
+ * Backpressure from a slow sink throttles the source instead of buffering
+ * the whole file in memory. The source and sink block on I/O and get their
+ * own threads; transforms are CPU-bound and run as tasks on the shared
+ * TaskScheduler so they never oversubscribe the host.
+ *
+ * If any stage throws, all rings are aborted, every thread is joined and
+ * the first exception is rethrown from run().
+ */
+class BackupPipeline {
+public:
+    /** Fill the chunk; return false at end of input */
+    using Source = std::function<bool(PipelineChunk&)>;
+    /** Transform a chunk in place (compress, encrypt, hash, ...) */
+    using Transform = std::function<void(PipelineChunk&)>;
+    /** Consume the whole stream */
+    using Sink = std::function<void(PipelineReader&)>;
+
+    /**
+     * @param queueDepth - capacity of each ring between stages
+     */
+    explicit BackupPipeline(std::size_t queueDepth = 8);
+
+    void setSource(const std::string& name, Source fn);
+    void addStage(const std::string& name, Transform fn);
+    void setSink(const std::string& name, Sink fn);
+
+    /**
+     * Run all stages to completion
+     * @throws the first exception raised by any stage
+     */
+    void run();
+
+    /** Stats in stage order (source, transforms..., sink) */
+    const std::vector<StageStats>& getStats() const { return stats; }
+
+    /** Log one line per stage with utilization and stall times */
+    void logStats() const;
+
+    /**
+     * Source reading a file in fixed-size chunks
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    static Source fileSource(const std::string& path, std::size_t chunkSize = 1 << 20);
+
+private:
+    std::size_t queueDepth;
+    std::string sourceName;
+    Source source;
+    std::vector<std::pair<std::string, Transform>> stages;
+    std::string sinkName;
+    Sink sink;
+    std::vector<StageStats> stats;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Fixed-size Bloom filter over string keys
+ *
+ * Sized up front for an expected number of keys and a false-positive
+ * rate: about 9.6 bits per key at 1%, so millions of chunk ids fit in a
+ * few MiB regardless of key length. mayContain() never misses a key that
+ * was added; beyond the expected count the false-positive rate rises but
+ * the memory does not.
+ *
+ * Keys are hashed once with XXH3 and the k probe positions are derived
+ * from the two halves of that hash (Kirsch–Mitzenmacher double hashing).
+ */
+class BloomFilter {
+public:
+    /**
+     * @param expectedKeys - keys the filter is sized for (at least 1)
+     * @param falsePositiveRate - target rate at expectedKeys, in (0, 1)
+     * @throws std::invalid_argument if the rate is out of range
+     */
+    explicit BloomFilter(std::uint64_t expectedKeys, double falsePositiveRate = 0.01);
+
+    void add(const std::string& key);
+    bool mayContain(const std::string& key) const;
+
+    std::uint64_t bitCount() const { return bits; }
+    unsigned hashCount() const { return probes; }
+    std::size_t memoryBytes() const { return words.size() * sizeof(std::uint64_t); }
+
+private:
+    std::uint64_t bits;
+    unsigned probes;
+    std::vector<std::uint64_t> words;
+};
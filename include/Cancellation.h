@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+/** Thrown when work stops because its CancellationToken fired */
+class OperationCancelled : public std::runtime_error {
+public:
+    explicit OperationCancelled(const std::string& reason)
+        : std::runtime_error("Operation cancelled: " + reason) {}
+};
+
+/**
+ * @brief Cooperative cancellation with an optional deadline
+ *
+ * Long-running phases poll isCancelled() at safe points (between backup
+ * steps, in curl's progress callback, during retry sleeps) and unwind with
+ * OperationCancelled, so RAII cleanup still runs. A token fires when
+ * cancel() is called, its deadline passes, or its parent fires; per-run
+ * tokens hang off one process-wide token that the signal handler cancels.
+ */
+class CancellationToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** @param parent - token whose cancellation also cancels this one (may be nullptr) */
+    explicit CancellationToken(const CancellationToken* parent = nullptr) : parent(parent) {}
+
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    /** Fire the token; the first reason wins */
+    void cancel(const std::string& reason = "cancelled");
+
+    /**
+     * Fire from a signal handler: only touches lock-free atomics.
+     * @param signal - signal number, reported as the reason
+     */
+    void cancelFromSignal(int signal) noexcept;
+
+    /** Fire once `deadline` has passed */
+    void setDeadline(Clock::time_point deadline);
+    void setTimeout(Clock::duration timeout) { setDeadline(Clock::now() + timeout); }
+
+    /** True once cancelled, past the deadline, or the parent is cancelled */
+    bool isCancelled() const;
+
+    /** Why the token fired; empty while it has not */
+    std::string reason() const;
+
+    /** @throws OperationCancelled if isCancelled() */
+    void throwIfCancelled() const;
+
+    /**
+     * Sleep for `duration` unless the token fires first (checked every
+     * 50 ms, so signal-originated cancellations are noticed too)
+     * @throws OperationCancelled if the token fires
+     */
+    void sleepFor(Clock::duration duration) const;
+
+    /** Time left until the nearest deadline (own or parent's); Clock::duration::max() if none */
+    Clock::duration remaining() const;
+
+private:
+    const CancellationToken* parent;
+    std::atomic<bool> cancelled{false};
+    std::atomic<int> signalNumber{0};
+    std::atomic<Clock::rep> deadlineTicks{0};   // 0 = no deadline
+    mutable std::mutex mtx;
+    std::string cancelReason;
+};
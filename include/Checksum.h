@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Digest recorded for every uploaded backup */
+enum class ChecksumAlgorithm {
+    Sha256,     // OpenSSL; the historical default
+    Crc32c,     // error detection only; SSE4.2 / ARMv8 CRC instructions
+    Xxh3,       // 64-bit XXH3; SSE2 / AVX2 / AVX-512 accumulators
+    Blake3      // cryptographic like SHA-256; AVX2 hashes 8 chunks at once
+};
+
+/** Widest instruction set the checksum kernels may use */
+enum class SimdLevel {
+    Scalar,     // portable code only
+    Sse,        // SSE2 / SSE4.2 on x86, the CRC extension on ARMv8
+    Avx2,
+    Avx512
+};
+
+/**
+ * @brief Streaming checksum with runtime CPU dispatch
+ *
+ * Kernels for every instruction set are compiled into the same binary
+ * (per-function target attributes, no global -m flags); the widest one
+ * the CPU and OS support is picked when a Checksum is created, so one
+ * build runs everywhere and still hashes at memory bandwidth.
+ *
+ * Digests are the algorithms' standard values (CRC32C as in iSCSI,
+ * XXH3-64 with seed 0, BLAKE3-256, SHA-256) so they can be checked with
+ * the usual command-line tools. hex() prints integers big-endian, like
+ * xxhsum and the crc32c reference.
+ */
+class Checksum {
+public:
+    virtual ~Checksum() = default;
+
+    /** New hasher using the best kernel allowed by maxSimdLevel() */
+    static std::unique_ptr<Checksum> create(ChecksumAlgorithm algorithm);
+
+    virtual void update(const void* data, std::size_t len) = 0;
+
+    /** Digest of the bytes so far; does not end the stream */
+    virtual std::vector<unsigned char> digest() const = 0;
+
+    std::string hex() const;
+
+    /** "blake3:<hex>", or bare hex for SHA-256 (the format journals always used) */
+    std::string label() const;
+
+    virtual ChecksumAlgorithm algorithm() const = 0;
+
+    /** Kernel this hasher runs, e.g. "avx2" */
+    virtual const char* implementation() const = 0;
+
+    static const char* algorithmName(ChecksumAlgorithm algorithm);
+
+    /** @throws std::invalid_argument for unknown names */
+    static ChecksumAlgorithm parseAlgorithm(const std::string& name);
+
+    /** Widest level the running CPU supports */
+    static SimdLevel detectedSimdLevel();
+
+    /**
+     * Cap the kernels used by hashers created afterwards (tests and
+     * benchmarks compare kernels this way); returns the previous cap
+     */
+    static SimdLevel setMaxSimdLevel(SimdLevel level);
+    static SimdLevel maxSimdLevel();
+
+    /** One-shot helpers */
+    static std::uint32_t crc32c(const void* data, std::size_t len, std::uint32_t crc = 0);
+    static std::uint64_t xxh3(const void* data, std::size_t len);
+    static std::string hexDigest(ChecksumAlgorithm algorithm, const void* data, std::size_t len);
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct PipelineChunk;
+
+/** AEAD used for the frames of an encrypted backup */
+enum class CipherAlgorithm : std::uint8_t {
+    Aes256Gcm = 1,          // AES-NI / ARMv8 crypto extensions
+    ChaCha20Poly1305 = 2    // faster where AES has no hardware support
+};
+
+using EncryptionKey = std::array<unsigned char, 32>;
+
+/** Per-stream salt, carried in the stream header */
+using CipherSalt = std::array<unsigned char, 32>;
+
+/** Backup encryption settings */
+struct EncryptionConfig {
+    bool enabled = false;
+    CipherAlgorithm algorithm = CipherAlgorithm::Aes256Gcm;
+    EncryptionKey key{};
+    /** Plaintext bytes per independently authenticated frame */
+    std::uint32_t frameSize = 64 * 1024;
+};
+
+/**
+ * @brief Framed authenticated encryption of a backup stream
+ *
+ * Format: a 64-byte header (magic, version, algorithm, frame size,
+ * plaintext size, salt), then one frame per `frameSize` bytes of
+ * plaintext, each the ciphertext followed by its 16-byte tag. Frames are
+ * sealed under a per-stream key derived with HKDF-SHA256 from the master
+ * key and the salt; the nonce is the frame index and the AAD is the header
+ * plus the index, so frames cannot be reordered, swapped between backups
+ * or truncated away without failing authentication.
+ *
+ * Every frame stands alone, so frames are encrypted in parallel on the
+ * shared TaskScheduler, and a reader can decrypt any byte range by
+ * fetching only the frames that cover it (frameOffset()).
+ */
+class ChunkCipher {
+public:
+    static constexpr std::size_t kHeaderSize = 64;
+    static constexpr std::size_t kTagSize = 16;
+
+    /**
+     * Encrypting side
+     * @param config - algorithm, master key and frame size
+     * @param plaintextSize - exact size of the stream to encrypt
+     * @param salt - per-stream salt; reusing one for different plaintext
+     *               under the same key breaks confidentiality (see randomSalt())
+     */
+    ChunkCipher(const EncryptionConfig& config, std::uint64_t plaintextSize, const CipherSalt& salt);
+
+    /**
+     * Decrypting side: parse and check a stream header
+     * @throws std::runtime_error if the header is malformed
+     */
+    static ChunkCipher fromHeader(const EncryptionKey& key, const unsigned char* header, std::size_t len);
+
+    /**
+     * Fresh salt for a new snapshot, from the OpenSSL CSPRNG. A resumed
+     * upload must reuse the salt it started with (journal or stream header)
+     * to re-encrypt to exactly the bytes already on the server.
+     * @throws std::runtime_error if the CSPRNG fails
+     */
+    static CipherSalt randomSalt();
+
+    /** Size of the encrypted stream for `plaintextSize` bytes */
+    static std::uint64_t encryptedSize(std::uint64_t plaintextSize, std::uint32_t frameSize);
+
+    /** AES-256-GCM where the CPU accelerates AES, else ChaCha20-Poly1305 */
+    static CipherAlgorithm preferredAlgorithm();
+
+    static const char* algorithmName(CipherAlgorithm algorithm);
+
+    /**
+     * Read a 32-byte key: raw binary, or 64 hex digits (whitespace ignored)
+     * @throws std::runtime_error if the file is missing or malformed
+     */
+    static EncryptionKey loadKeyFile(const std::string& path);
+
+    /**
+     * Encrypt a pipeline chunk in place, frames in parallel. Chunks must
+     * start on a frame boundary and, except for the last, hold whole
+     * frames; the chunk at offset 0 also gets the header.
+     */
+    void encryptChunk(PipelineChunk& chunk) const;
+
+    /**
+     * Decrypt frame `index` (ciphertext plus tag, frameCipherSize(index) bytes)
+     * @throws std::runtime_error if authentication fails
+     */
+    void decryptFrame(std::uint64_t index, const unsigned char* in, std::size_t len, unsigned char* out) const;
+
+    /**
+     * Decrypt plaintext bytes [offset, offset + length) from an encrypted
+     * file, reading only the frames that cover them
+     */
+    std::vector<unsigned char> decryptRange(const std::string& encryptedFile, std::uint64_t offset,
+                                            std::size_t length) const;
+
+    /**
+     * Decrypt a whole encrypted file into `plainFile`, frames in parallel
+     * @throws std::runtime_error on I/O errors or failed authentication
+     */
+    static void decryptFile(const std::string& encryptedFile, const std::string& plainFile,
+                            const EncryptionKey& key);
+
+    std::uint64_t plaintextSize() const { return plainSize; }
+    std::uint32_t frameSize() const { return frame; }
+    CipherAlgorithm algorithm() const { return algo; }
+    CipherSalt salt() const;
+    std::uint64_t frameCount() const { return (plainSize + frame - 1) / frame; }
+
+    /** Offset of frame `index` in the encrypted stream */
+    std::uint64_t frameOffset(std::uint64_t index) const { return kHeaderSize + index * (frame + kTagSize); }
+
+    /** Encrypted size of frame `index`, tag included */
+    std::size_t frameCipherSize(std::uint64_t index) const;
+
+private:
+    ChunkCipher() = default;
+
+    CipherAlgorithm algo = CipherAlgorithm::Aes256Gcm;
+    std::uint32_t frame = 0;
+    std::uint64_t plainSize = 0;
+    std::array<unsigned char, kHeaderSize> header{};
+    EncryptionKey streamKey{};
+
+    void init(const EncryptionKey& masterKey);
+    void sealFrame(std::uint64_t index, const unsigned char* in, std::size_t len, unsigned char* out) const;
+};
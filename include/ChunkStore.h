@@ -0,0 +1,122 @@
+#pragma once
+#include "Checksum.h"
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/** Size targets of content-defined chunking */
+struct ChunkingParams {
+    std::uint32_t minSize = 16 * 1024;
+    std::uint32_t avgSize = 64 * 1024;
+    std::uint32_t maxSize = 256 * 1024;
+
+    /** min = avg / 4, max = avg * 4 */
+    static ChunkingParams forAverage(std::uint32_t avgSize);
+};
+
+/**
+ * @brief FastCDC content-defined chunker
+ *
+ * A Gear rolling hash (hash = (hash << 1) + gear[byte]) runs over each
+ * candidate chunk and a cut is made where its top bits are all zero, so
+ * boundaries depend only on the bytes around them: inserting rows shifts
+ * the data after them but leaves most chunk boundaries, and therefore most
+ * chunks, unchanged. The first minSize bytes are skipped, and normalized
+ * chunking uses a stricter mask before avgSize and a looser one after it,
+ * which keeps chunk sizes close to the average.
+ *
+ * The gear table is generated from a fixed seed. Changing it (or the
+ * masks) moves every boundary and defeats deduplication against existing
+ * stores.
+ */
+class ContentChunker {
+public:
+    /** @throws std::invalid_argument unless 0 < minSize <= avgSize <= maxSize */
+    explicit ContentChunker(const ChunkingParams& params = ChunkingParams());
+
+    /**
+     * Length of the chunk that starts at `data`
+     * @param len - bytes available; must be at least maxSize unless the
+     *              stream ends at data + len
+     * @return cut point in [1, min(len, maxSize)], 0 only for len == 0
+     */
+    std::size_t cut(const unsigned char* data, std::size_t len) const;
+
+    const ChunkingParams& params() const { return p; }
+
+private:
+    ChunkingParams p;
+    std::uint64_t maskSmall;   // before avgSize: 2 bits more than log2(avg)
+    std::uint64_t maskLarge;   // after avgSize: 2 bits fewer
+};
+
+/** One chunk of a recipe, in file order */
+struct ChunkRef {
+    std::string id;            // hex digest of the chunk's bytes
+    std::uint32_t length = 0;
+};
+
+/**
+ * @brief Per-backup list of the chunks that make up the file
+ *
+ * Uploaded as "<backup>.recipe" in place of the backup itself:
+ *     sqliteftpbackup-recipe 1
+ *     hash <algorithm>
+ *     size <bytes>
+ *     <chunk id> <length>
+ *     ...
+ */
+class ChunkRecipe {
+public:
+    ChecksumAlgorithm algorithm = ChecksumAlgorithm::Blake3;
+    std::uint64_t size = 0;
+    std::vector<ChunkRef> chunks;
+
+    std::string serialize() const;
+
+    /** @throws std::runtime_error if the text is not a well-formed recipe */
+    static ChunkRecipe parse(const std::string& text);
+
+    static std::string recipeNameFor(const std::string& remoteName) { return remoteName + ".recipe"; }
+};
+
+/**
+ * @brief Chunks known to be stored on the server
+ *
+ * Kept remotely as "<dir>/chunks/index", one chunk id per line, and only
+ * ever appended to after the chunks it lists are uploaded, so a crash
+ * leaves at worst unlisted chunks (uploaded again next time) but never a
+ * listed chunk that is missing. Chunks live in 256 subdirectories named
+ * after the first two hex digits of their id, which keeps directory
+ * listings short.
+ */
+class ChunkIndex {
+public:
+    /** Chunk ids are collision-resistant digests of the content */
+    static constexpr ChecksumAlgorithm kChunkHash = ChecksumAlgorithm::Blake3;
+    static constexpr const char* kChunkDir = "chunks";
+    static constexpr const char* kIndexName = "index";
+
+    /** Add the ids of an index file; a torn last line is ignored */
+    void load(const std::string& text);
+
+    bool contains(const std::string& id) const { return ids.count(id) != 0; }
+
+    /** @return true if `id` was not in the index yet */
+    bool add(const std::string& id) { return ids.insert(id).second; }
+
+    std::size_t size() const { return ids.size(); }
+
+    /** Id of a chunk's bytes */
+    static std::string chunkId(const void* data, std::size_t len);
+
+    /** Remote directory of the index: "<baseDir>/chunks" */
+    static std::string indexDir(const std::string& baseDir);
+
+    /** Remote directory of a chunk: "<baseDir>/chunks/<first two hex digits>" */
+    static std::string chunkDir(const std::string& baseDir, const std::string& id);
+
+private:
+    std::unordered_set<std::string> ids;
+};
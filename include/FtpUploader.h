@@ -1,24 +1,61 @@
 #pragma once
+#include "Cancellation.h"
 #include <string>
 #include <functional>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+/** One entry of a directory listing (MLSD) */
+struct RemoteEntry {
+    std::string name;
+    bool isDirectory = false;
+    std::int64_t size = -1;         // -1 if the server did not say
+    std::time_t modified = 0;       // UTC; 0 if the server did not say
+};
+
+/**
+ * @brief Holds libcurl's process-wide state for its lifetime
+ *
+ * curl_global_init and curl_global_cleanup are not thread-safe, so they
+ * must not run per uploader: main() holds one for the whole process, and
+ * FtpWorkerPool holds one while its workers create their sessions.
+ * Nested guards are reference-counted by libcurl.
+ */
+class CurlGlobal {
+public:
+    CurlGlobal();
+    ~CurlGlobal();
+
+    CurlGlobal(const CurlGlobal&) = delete;
+    CurlGlobal& operator=(const CurlGlobal&) = delete;
+};
 
 /**
  * @brief Simple FTP uploader using libcurl
  *
  * Supports uploading files to an FTP server with
  * timeouts, retries, progress callbacks, SSL verification,
- * and verbose logging.
+ * and verbose logging. A single uploader reuses its logged-in
+ * control connection for consecutive uploads.
  */
 class FtpUploader {
 public:
     using ProgressCallback = std::function<void(double dltotal, double dlnow,
                                                 double ultotal, double ulnow)>;
+    /** Fill buf with up to len bytes; return 0 at end of stream */
+    using ReadCallback = std::function<std::size_t(char* buf, std::size_t len)>;
+    /** Consume len downloaded bytes; throwing aborts the transfer */
+    using WriteCallback = std::function<void(const char* data, std::size_t len)>;
 
     FtpUploader(const std::string& host, int port,
                 const std::string& user, const std::string& pass);
 
     ~FtpUploader();
 
+    FtpUploader(const FtpUploader&) = delete;
+    FtpUploader& operator=(const FtpUploader&) = delete;
+
     /**
      * @brief Upload a local file to the remote directory on the FTP server
      * @param localFile Full path to the local file
@@ -27,12 +64,86 @@ public:
      */
     void uploadFile(const std::string& localFile, const std::string& remoteDir);
 
+    /**
+     * @brief Upload data pulled from a callback instead of a local file
+     *
+     * Single attempt: a stream cannot be rewound, so retries are up to the
+     * caller (which must be able to restart its producer).
+     * @param read Producer callback
+     * @param remoteDir Directory on server
+     * @param filename Remote file name
+     * @param size Total size in bytes if known, -1 otherwise
+     * @param append Append to the remote file (APPE) instead of replacing it,
+     *               used to resume an interrupted upload
+     * @throws std::runtime_error on failure
+     */
+    void uploadStream(ReadCallback read, const std::string& remoteDir,
+                      const std::string& filename, std::int64_t size = -1,
+                      bool append = false);
+
+    /**
+     * @brief Download a remote file, or a byte range of it, into a callback
+     *
+     * A range is fetched with REST and the transfer is cut off after
+     * `length` bytes, so checking one region of a large backup only moves
+     * that region over the network. Single attempt, like uploadStream.
+     * @param write Consumer callback
+     * @param offset First byte to fetch
+     * @param length Number of bytes, or -1 for the rest of the file
+     * @throws std::runtime_error on failure (including a missing file)
+     */
+    void downloadStream(WriteCallback write, const std::string& remoteDir,
+                        const std::string& filename, std::int64_t offset = 0,
+                        std::int64_t length = -1);
+
+    /**
+     * @brief List a remote directory with MLSD (RFC 3659)
+     *
+     * One round trip per directory, with type, size and modification time
+     * for every entry; "." and ".." are left out.
+     * @throws std::runtime_error if the directory cannot be listed
+     */
+    std::vector<RemoteEntry> listDirectory(const std::string& remoteDir);
+
+    /** Parse MLSD output ("fact=value;...; name" per line) */
+    static std::vector<RemoteEntry> parseMlsd(const std::string& text);
+
+    /**
+     * @brief Size of a remote file (FTP SIZE)
+     * @return size in bytes, or -1 if the file does not exist
+     * @throws std::runtime_error if the server cannot be reached
+     */
+    std::int64_t getRemoteFileSize(const std::string& remoteDir, const std::string& filename);
+
+    /**
+     * @brief Delete a remote file (FTP DELE), e.g. a partial upload
+     * @return false if the server refused or could not be reached
+     */
+    bool deleteRemoteFile(const std::string& remoteDir, const std::string& filename);
+
+    /**
+     * @brief Rename a remote file within a directory (FTP RNFR/RNTO), e.g.
+     *        to replace a file atomically with a fully uploaded copy
+     * @return false if the server refused or could not be reached
+     */
+    bool renameRemoteFile(const std::string& remoteDir, const std::string& from, const std::string& to);
+
+    /**
+     * @brief Abort transfers and retry sleeps once `token` fires
+     *
+     * Checked from curl's progress callback, so a stalled transfer stops
+     * within about a second. Aborted calls throw OperationCancelled.
+     * @param token - not owned; nullptr to detach
+     */
+    void setCancellationToken(const CancellationToken* token) { cancel = token; }
+
     // Optional features
     void setTimeout(long seconds);                  // Connection & read timeout (default 30s)
     void setRetries(int count);                     // Retry failed uploads (default 3)
     void enableVerbose(bool verbose = true);        // Verbose logging
     void setProgressCallback(ProgressCallback cb);  // Progress tracking
     void setSslVerify(bool enable);                 // Enable/disable SSL verification (default true)
+    void setUseTls(bool enable);                    // Require TLS (default true); off only for loopback/test servers
     std::string getLastError() const;               // Last error message
 
     /**
@@ -54,10 +165,19 @@ private:
     int maxRetries = 3;
     bool verbose = false;
     bool sslVerify = true;
+    bool useTls = true;
 
     ProgressCallback progressCb;
+    ProgressCallback transferCb;    // progressCb plus the cancellation check, handed to curl
+    const CancellationToken* cancel = nullptr;
     std::string lastError;
 
+    // CURL* kept across uploads so curl's connection, DNS and TLS session
+    // caches stay warm; reset (not recreated) before every transfer
+    void* curlHandle = nullptr;
+
     // Internal helpers
     void throwIfFailed(int attempt, const std::string& context);
+    void throwIfAborted(int curlCode);                 // OperationCancelled if the token stopped the transfer
+    void* prepareHandle(const std::string& url);    // reset + common options, returns CURL*
 };
@@ -0,0 +1,75 @@
+#pragma once
+#include "FtpUploader.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A few FTP sessions working through a queue of transfers in parallel
+ *
+ * FTP moves one file per data connection, so many small transfers (chunks,
+ * ranges, deletes) are bound by round trips rather than bandwidth. Each
+ * worker thread owns its own FtpUploader, created lazily by the factory
+ * and kept logged in for all the jobs it runs.
+ *
+ * The queue is bounded, so a fast producer (e.g. the upload pipeline's
+ * sink) waits instead of buffering the whole backup. The first exception a
+ * job throws is rethrown from the next submit() or wait(); the jobs still
+ * queued behind it are dropped.
+ */
+class FtpWorkerPool {
+public:
+    using Factory = std::function<std::unique_ptr<FtpUploader>()>;
+    using Job = std::function<void(FtpUploader&)>;
+
+    /**
+     * @param sessions - worker threads, each with its own FTP session (at least 1)
+     * @param factory - creates a configured session on a worker's first job
+     * @param queueDepth - jobs waiting at most; 0 = twice the session count
+     */
+    FtpWorkerPool(std::size_t sessions, Factory factory, std::size_t queueDepth = 0);
+
+    /** Drops jobs not started yet and waits for the running ones; wait() finishes the queue */
+    ~FtpWorkerPool();
+
+    FtpWorkerPool(const FtpWorkerPool&) = delete;
+    FtpWorkerPool& operator=(const FtpWorkerPool&) = delete;
+
+    /**
+     * Queue a job; blocks while the queue is full
+     * @throws the first exception of an earlier job
+     */
+    void submit(Job job);
+
+    /**
+     * Block until every queued job has run
+     * @throws the first exception of any job
+     */
+    void wait();
+
+    std::size_t sessionCount() const { return threads.size(); }
+
+private:
+    CurlGlobal curl;        // initialized before the workers create sessions
+    Factory factory;
+    std::size_t capacity;
+    std::vector<std::thread> threads;
+
+    std::mutex mtx;
+    std::condition_variable workAvailable;
+    std::condition_variable spaceAvailable;
+    std::condition_variable idle;
+    std::deque<Job> jobs;
+    std::size_t running = 0;
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    void workerLoop();
+    void rethrowFailure();   // requires mtx
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include "FtpUploader.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FtpWorkerPool;
+
+/** What a garbage collection should do */
+struct GcOptions {
+    /** Keep only the newest N backups (by modification time); 0 = keep every backup */
+    std::size_t keepBackups = 0;
+    /** Unreferenced chunks younger than this survive: a backup may be uploading them right now */
+    std::chrono::seconds minChunkAge{3600};
+    /** Log what would be deleted without deleting anything */
+    bool dryRun = false;
+    /** Target false-positive rate of the live-chunk filter; a false positive only keeps garbage */
+    double falsePositiveRate = 0.01;
+};
+
+/** Outcome of one garbage collection */
+struct GcStats {
+    std::size_t backupsKept = 0;
+    std::size_t backupsDeleted = 0;
+    std::size_t manifestsDeleted = 0;    // orphaned by a backup deleted by hand
+    std::size_t chunksScanned = 0;
+    std::size_t chunksKept = 0;
+    std::size_t chunksTooYoung = 0;      // unreferenced but inside minChunkAge
+    std::size_t chunksDeleted = 0;
+    std::size_t deleteFailures = 0;
+    std::uint64_t bytesFreed = 0;
+    std::size_t filterBytes = 0;
+    std::vector<std::string> deletedBackups;   // names, as GarbageCollector::Backup::name
+};
+
+/**
+ * @brief Mark-and-sweep garbage collection of a remote backup directory
+ *
+ * 1. Retention: backups beyond the newest keepBackups are deleted (a plain
+ *    backup with its manifest, a chunked one by its recipe), as are
+ *    manifests whose backup is gone. Full backups and page deltas that a
+ *    kept delta builds on are kept regardless. A backup whose file the
+ *    server refuses to delete stays live, chunks included.
+ * 2. Mark: every remaining recipe is downloaded and its chunk ids are
+ *    added to a BloomFilter sized from the chunk index, about 1.2 bytes
+ *    per chunk at the default 1% false-positive rate. One recipe that
+ *    cannot be read aborts the collection before anything is swept.
+ * 3. Sweep: the 256 chunk subdirectories are listed with MLSD one at a
+ *    time. Chunks the filter rejects and older than minChunkAge are
+ *    garbage; the rest form the new chunk index.
+ * 4. The new index replaces the old one before any chunk is deleted, so a
+ *    crash never leaves the index listing a deleted chunk. Deletes then
+ *    run in parallel on the worker pool.
+ *
+ * Memory is bounded by the filter plus one subdirectory listing; the new
+ * index and the delete list are spooled to temporary files. Backups that
+ * run while a collection is in progress may reference chunks it deletes:
+ * run it from the same process between backups (daemon mode does) or
+ * while no chunked backup is uploading.
+ */
+class GarbageCollector {
+public:
+    /** A backup found in the backup directory */
+    struct Backup {
+        std::string name;           // backup name (a chunked backup's recipe is name + ".recipe")
+        bool chunked = false;
+        std::time_t modified = 0;
+        bool delta = false;         // a page delta: needs every older backup back to a full one
+    };
+
+    /**
+     * @param ftp - session for listings and the index (not owned)
+     * @param pool - sessions for recipe downloads and deletes (not owned)
+     * @param remoteDir - backup directory on the server
+     */
+    GarbageCollector(FtpUploader& ftp, FtpWorkerPool& pool, std::string remoteDir);
+
+    /**
+     * Run one collection
+     * @throws std::runtime_error if listing or marking fails; nothing has been swept then
+     */
+    GcStats run(const GcOptions& options);
+
+    /** Backups in a directory listing: "<prefix>_backup_<time>..." files, deltas and recipes */
+    static std::vector<Backup> findBackups(const std::vector<RemoteEntry>& entries);
+
+    /**
+     * Backups beyond the newest `keep`, oldest first; none if keep is 0.
+     * A kept delta keeps the older backups of its database back to the
+     * nearest full one, so every kept backup stays restorable.
+     */
+    static std::vector<Backup> expired(std::vector<Backup> backups, std::size_t keep);
+
+private:
+    FtpUploader& ftp;
+    FtpWorkerPool& pool;
+    std::string remoteDir;
+    std::atomic<std::size_t> failedDeletes{0};
+
+    std::mutex failedMtx;
+    std::vector<std::string> failedNames;   // names (not paths) of the files submitDeletes could not delete
+
+    void submitDeletes(const std::string& dir, const std::vector<std::string>& names);
+};
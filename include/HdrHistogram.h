@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief High-dynamic-range histogram (HdrHistogram layout)
+ *
+ * Records integer values between 1 and `highest` while keeping
+ * `significantDigits` decimal digits of precision across the whole range:
+ * with 3 digits, any reported percentile is within 0.1% of the true value,
+ * whether it is 2 microseconds or 20 minutes. Buckets are powers of two,
+ * each split linearly into sub-buckets, so recording is a couple of bit
+ * operations and one atomic increment, with no locks and no allocation.
+ * Values above `highest` are clamped to it.
+ */
+class HdrHistogram {
+public:
+    /**
+     * @param highest - largest trackable value (>= 2)
+     * @param significantDigits - 1..5
+     * @throws std::invalid_argument on out-of-range parameters
+     */
+    explicit HdrHistogram(std::int64_t highest, int significantDigits = 3);
+
+    HdrHistogram(const HdrHistogram&) = delete;
+    HdrHistogram& operator=(const HdrHistogram&) = delete;
+
+    void record(std::int64_t value, std::uint64_t count = 1);
+
+    /** Value at or below which `percentile` percent of recordings fall (0..100) */
+    std::int64_t valueAtPercentile(double percentile) const;
+
+    std::uint64_t getTotalCount() const { return totalCount.load(std::memory_order_relaxed); }
+    std::int64_t getMin() const;
+    std::int64_t getMax() const { return maxValue.load(std::memory_order_relaxed); }
+    double getMean() const;
+    std::int64_t getHighestTrackable() const { return highest; }
+
+    /** Add all of other's recordings to this histogram (same layout required) */
+    void add(const HdrHistogram& other);
+    void reset();
+
+    /** Smallest and largest values that share a bucket slot with `value` */
+    std::int64_t lowestEquivalentValue(std::int64_t value) const;
+    std::int64_t highestEquivalentValue(std::int64_t value) const;
+
+private:
+    std::int64_t highest;
+    int significantDigits;
+    int subBucketHalfCountMagnitude;
+    std::int64_t subBucketCount;
+    std::int64_t subBucketHalfCount;
+    std::int64_t subBucketMask;
+    int bucketCount;
+    std::size_t countsLength;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> counts;
+    std::atomic<std::uint64_t> totalCount{0};
+    std::atomic<std::int64_t> minValue;
+    std::atomic<std::int64_t> maxValue{0};
+
+    int bucketIndex(std::int64_t value) const;
+    std::size_t countsIndex(std::int64_t value) const;
+    std::int64_t valueFromIndex(std::size_t index) const;
+};
+
+/**
+ * @brief Named latency histograms (nanoseconds) with a percentile summary
+ *
+ * Hot paths look a histogram up once and keep the reference; record()
+ * is lock-free. summaries() is the stats API for SLO checks and
+ * logSummary() prints the end-of-run table.
+ */
+class LatencyStats {
+public:
+    struct Summary {
+        std::string name;
+        std::uint64_t count = 0;
+        std::int64_t p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;  // nanoseconds
+        double mean = 0;
+    };
+
+    LatencyStats() = default;
+    LatencyStats(const LatencyStats&) = delete;
+    LatencyStats& operator=(const LatencyStats&) = delete;
+
+    static LatencyStats& instance();
+
+    /** Get or create a histogram tracking 1ns..1h at 3 significant digits */
+    HdrHistogram& histogram(const std::string& name);
+
+    /** One summary per histogram with recordings, sorted by name */
+    std::vector<Summary> summaries() const;
+
+    /** Log p50/p90/p99/p99.9/max for every histogram */
+    void logSummary() const;
+
+    void reset();
+
+    /** Human-readable duration: 850ns, 12.4us, 3.21ms, 1.50s */
+    static std::string formatNanos(std::int64_t ns);
+
+private:
+    mutable std::mutex mtx;   // guards the map, never recording
+    std::map<std::string, std::unique_ptr<HdrHistogram>> histograms;
+};
+
+/** RAII timer recording its lifetime, in nanoseconds, into a histogram */
+class LatencyTimer {
+public:
+    explicit LatencyTimer(HdrHistogram& hist) : hist(hist), start(std::chrono::steady_clock::now()) {}
+    ~LatencyTimer() {
+        hist.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count());
+    }
+
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+    HdrHistogram& hist;
+    std::chrono::steady_clock::time_point start;
+};
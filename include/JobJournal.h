@@ -0,0 +1,79 @@
+#pragma once
+#include <sqlite3.h>
+#include <string>
+#include <optional>
+#include <cstdint>
+#include <vector>
+
+/** Progress of a backup job, in order */
+enum class JobStage { Started, Snapshot, Uploading, Done, Abandoned };
+
+/** One row of the journal */
+struct JobRecord {
+    std::int64_t id = 0;
+    JobStage stage = JobStage::Started;
+    std::string sourceDb;           // database being backed up
+    std::string artifact;           // local snapshot file
+    std::int64_t artifactSize = 0;
+    std::string artifactDigest;     // Checksum::label() of the artifact, set with the snapshot
+    std::string uploadDigest;       // Checksum::label() of the uploaded bytes, set when done
+    std::string remoteDir;
+    std::string remoteName;
+    std::int64_t remoteOffset = 0;  // last durable upload checkpoint (bytes)
+    std::vector<unsigned char> cipherSalt;  // salt of the encrypted stream; empty when not encrypted
+};
+
+/**
+ * @brief Small on-disk journal of backup jobs, for crash-resumable backups
+ *
+ * Each stage transition is committed durably (WAL, synchronous=FULL), so
+ * after a crash the next run can find the unfinished job, reuse its
+ * snapshot and continue the upload from the last checkpoint instead of
+ * starting over.
+ */
+class JobJournal {
+public:
+    /**
+     * Open (or create) the journal database
+     * @throws std::runtime_error on failure
+     */
+    explicit JobJournal(const std::string& path);
+    ~JobJournal();
+
+    JobJournal(const JobJournal&) = delete;
+    JobJournal& operator=(const JobJournal&) = delete;
+
+    /** Most recent job that is neither Done nor Abandoned */
+    std::optional<JobRecord> findUnfinished();
+
+    /** Start a new job; returns its id */
+    std::int64_t begin(const std::string& sourceDb);
+
+    /**
+     * Snapshot written completely
+     * @param artifactDigest - Checksum::label() of the artifact ("<algo>:<hex>",
+     *                         bare hex for SHA-256), checked before a resume
+     * @param cipherSalt - salt its upload is encrypted with, so a resume
+     *                     re-encrypts to the bytes already on the server
+     */
+    void recordSnapshot(std::int64_t id, const std::string& artifact, std::int64_t size,
+                        const std::string& artifactDigest, const std::vector<unsigned char>& cipherSalt = {});
+
+    /** Upload checkpoint: `offset` bytes are known to be on the server */
+    void recordUploadProgress(std::int64_t id, const std::string& remoteDir,
+                              const std::string& remoteName, std::int64_t offset);
+
+    void markDone(std::int64_t id, const std::string& uploadDigest);
+    void markAbandoned(std::int64_t id);
+
+    static std::string stageToString(JobStage stage);
+    static JobStage stageFromString(const std::string& s);
+
+private:
+    sqlite3* db = nullptr;
+    std::string path;
+
+    void exec(const char* sql);
+    void addColumnIfMissing(const std::string& column, const std::string& definition);
+    void setStage(std::int64_t id, JobStage stage);
+};
@@ -1,4 +1,7 @@
 #pragma once
+#include "Metrics.h"
+#include "HdrHistogram.h"
+#include "Probes.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -49,7 +52,22 @@ private:
     std::mutex mtx_;
     std::size_t maxFileSize_ = 0; // 0 = no rotation
 
+    // Metrics, looked up once (index = Level)
+    Counter* messages_[4] = {};
+    Counter* dropped_ = nullptr;
+    HdrHistogram* writeLatency_ = nullptr;
+
     Logger() {
+        MetricsRegistry& metrics = MetricsRegistry::instance();
+        const char* levels[] = {"debug", "info", "warning", "error"};
+        for (int i = 0; i < 4; ++i) {
+            messages_[i] = &metrics.counter("sqliteftpbackup_log_messages_total", "Log messages emitted, by level",
+                                            std::string("level=\"") + levels[i] + "\"");
+        }
+        dropped_ = &metrics.counter("sqliteftpbackup_log_dropped_total",
+                                    "Log messages that could not be written to the log file");
+        writeLatency_ = &LatencyStats::instance().histogram("log_write");
+
         try {
             std::filesystem::create_directories("logs");
         } catch (const std::filesystem::filesystem_error& e) {
@@ -72,6 +90,8 @@ private:
     void log(Level lvl, Args&&... args) {
         if (lvl < minLevel_) return;
 
+        // Cost to the caller, including waiting for the lock
+        LatencyTimer timer(*writeLatency_);
         std::lock_guard<std::mutex> lock(mtx_);
 
         // Concatenate all arguments
@@ -79,6 +99,8 @@ private:
         (oss << ... << args);
 
         std::string message = timestamp() + " [" + levelToString(lvl) + "] " + oss.str() + "\n";
+        SFB_PROBE2(log__enqueue, static_cast<int>(lvl), message.c_str());
+        messages_[static_cast<int>(lvl)]->inc();
 
         // Console output
         std::cout << levelToColor(lvl) << message << "\033[0m";
@@ -87,12 +109,19 @@ private:
         if (file_.is_open()) {
             file_ << message;
             file_.flush();
+            SFB_PROBE1(log__flush, message.size());
+            if (!file_) {
+                dropped_->inc();
+                file_.clear();
+            }
 
             // Log rotation
             if (maxFileSize_ > 0 && file_.tellp() >= static_cast<std::streampos>(maxFileSize_)) {
                 file_.close();
                 openNewLogFile();
             }
+        } else {
+            dropped_->inc();
         }
     }
 
@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Monotonically increasing count; lock-free */
+class Counter {
+public:
+    void inc(std::uint64_t n = 1) { v.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t value() const { return v.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t> v{0};
+};
+
+/** Value that can go up and down; lock-free */
+class Gauge {
+public:
+    void set(double value) { v.store(value, std::memory_order_relaxed); }
+    void add(double delta);
+    double value() const { return v.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> v{0.0};
+};
+
+/**
+ * @brief Prometheus-style histogram with fixed bucket upper bounds
+ *
+ * observe() is lock-free: one atomic increment for the bucket plus the
+ * running sum and count. Buckets are rendered cumulatively.
+ */
+class Histogram {
+public:
+    struct Snapshot {
+        std::vector<double> bounds;
+        std::vector<std::uint64_t> cumulative;  // one per bound, then +Inf
+        double sum = 0;
+        std::uint64_t count = 0;
+    };
+
+    /** @param bounds - ascending bucket upper bounds (+Inf is implicit) */
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+    Snapshot snapshot() const;
+
+    /** Latency buckets in seconds, 0.5ms .. 60s */
+    static std::vector<double> latencyBuckets();
+
+private:
+    std::vector<double> bounds;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> buckets;  // bounds.size() + 1
+    std::atomic<double> sum{0.0};
+    std::atomic<std::uint64_t> count{0};
+};
+
+/**
+ * @brief Registry of named metrics, rendered in the Prometheus text format
+ *
+ * Metrics are created on first lookup and live as long as the registry, so
+ * callers look them up once and keep the reference; updates never take a
+ * lock. A metric family may have several series told apart by a label set
+ * such as `phase="connect"`.
+ */
+class MetricsRegistry {
+public:
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    /** Process-wide registry used by the instrumented classes */
+    static MetricsRegistry& instance();
+
+    /**
+     * Get or create a metric
+     * @param labels - Prometheus label set without braces, e.g. `level="info"`
+     * @throws std::logic_error if the name is already registered with another type
+     */
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+                         const std::vector<double>& bounds = Histogram::latencyBuckets());
+
+    /** All metrics in the Prometheus text exposition format (version 0.0.4) */
+    std::string renderPrometheus() const;
+
+    /**
+     * Write renderPrometheus() to a file for node_exporter's textfile
+     * collector. The file is written next to the target and renamed into
+     * place so the collector never reads a partial file.
+     * @throws std::runtime_error on I/O failure
+     */
+    void writeTextfile(const std::string& path) const;
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    mutable std::mutex mtx;   // guards registration and rendering, never updates
+    std::map<std::string, Family> families;
+
+    Series& findOrAdd(const std::string& name, const std::string& help,
+                      const std::string& labels, Type type);
+};
+
+/**
+ * @brief Minimal HTTP server exposing GET /metrics
+ *
+ * Serves one request per connection from a single background thread,
+ * which is plenty for a Prometheus scraper. Binds to localhost by default.
+ */
+class MetricsServer {
+public:
+    /**
+     * @param port - TCP port, 0 picks a free port (see getPort())
+     * @param bindAddress - IPv4 address to listen on
+     */
+    explicit MetricsServer(MetricsRegistry& registry, int port, const std::string& bindAddress = "127.0.0.1");
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    /**
+     * Bind, listen and start serving
+     * @throws std::runtime_error if the socket cannot be bound
+     */
+    void start();
+    void stop();
+
+    /** Port actually bound (after start()) */
+    int getPort() const { return port; }
+
+    /** Build the full HTTP response for a raw request */
+    std::string handleRequest(const std::string& request) const;
+
+private:
+    MetricsRegistry& registry;
+    int port;
+    std::string bindAddress;
+    std::intptr_t listenSocket = -1;
+    std::atomic<bool> running{false};
+    std::thread thread;
+
+    void serve();
+};
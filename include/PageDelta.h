@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/** XXH3 of every page of one database snapshot */
+struct PageMap {
+    std::uint32_t pageSize = 0;
+    std::vector<std::uint64_t> hashes;
+
+    std::uint64_t pageCount() const { return hashes.size(); }
+
+    /**
+     * Save next to the catalog, tagged with the catalog id of the backup it describes
+     * @throws std::runtime_error on failure
+     */
+    void save(const std::string& path, std::int64_t backupId) const;
+
+    /** The map and its backup id; nullopt if the file is missing or unreadable */
+    static std::optional<std::pair<std::int64_t, PageMap>> load(const std::string& path);
+};
+
+/** Outcome of writing or applying one delta */
+struct PageDeltaStats {
+    std::uint64_t pages = 0;          // pages of the database after the delta
+    std::uint64_t changedPages = 0;   // pages stored in the delta
+    std::uint64_t runs = 0;           // runs of consecutive changed pages
+    std::uint64_t bytes = 0;          // size of the delta file
+};
+
+/**
+ * @brief Page-level difference between two snapshots of one SQLite database
+ *
+ * A snapshot is compared page by page with the PageMap of the previous
+ * backup; pages whose hash differs, and pages past the old end of the
+ * file, are stored as runs of consecutive pages. Applying the deltas of a
+ * chain in order to a restored full backup reproduces each later snapshot
+ * exactly, so a restore can stop at any backup in the chain.
+ *
+ * File format (integers little-endian):
+ *     "SFBDELTA" u32 version u32 page-size u64 base-pages u64 pages
+ *     { u64 first-page u32 count <count pages> }...
+ *
+ * The base page count is checked on apply, so a delta applied to the
+ * wrong file or out of order fails instead of corrupting it.
+ */
+class PageDelta {
+public:
+    /** Suffix of delta backups ("<backup>.delta", encrypted "<backup>.delta.enc") */
+    static constexpr const char* kSuffix = ".delta";
+
+    static bool isDeltaName(const std::string& remoteName);
+
+    /**
+     * Page size from the database header
+     * @throws std::runtime_error if the file is not an SQLite database of whole pages
+     */
+    static std::uint32_t pageSize(const std::string& dbFile);
+
+    /**
+     * Hash every page of a database file
+     * @throws std::runtime_error if the file is not an SQLite database
+     */
+    static PageMap hashPages(const std::string& dbFile);
+
+    /**
+     * Write the delta from the snapshot `base` describes to `dbFile`, and
+     * return the new snapshot's map in `pages`
+     * @throws std::runtime_error on I/O errors or a page size change
+     */
+    static PageDeltaStats write(const std::string& dbFile, const PageMap& base, const std::string& deltaFile,
+                                PageMap& pages);
+
+    /**
+     * Apply a delta in place to the restored database `dbFile`
+     * @throws std::runtime_error if the delta is malformed or does not follow `dbFile`
+     */
+    static PageDeltaStats apply(const std::string& deltaFile, const std::string& dbFile);
+};
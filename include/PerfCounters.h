@@ -0,0 +1,99 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** Counters collected per phase; index into PerfSample::values */
+enum class PerfEvent { Cycles, Instructions, CacheMisses, BranchMisses, ContextSwitches, PageFaults, Count };
+
+/** Accumulated counter values of one phase */
+struct PerfSample {
+    static constexpr std::size_t kEvents = static_cast<std::size_t>(PerfEvent::Count);
+
+    std::array<std::uint64_t, kEvents> values{};
+    std::array<bool, kEvents> available{};   // false if the counter could not be opened
+    std::uint64_t runs = 0;
+    std::uint64_t bytes = 0;                 // data processed, for per-MB figures
+    double seconds = 0;
+
+    std::uint64_t get(PerfEvent e) const { return values[static_cast<std::size_t>(e)]; }
+    bool has(PerfEvent e) const { return available[static_cast<std::size_t>(e)]; }
+
+    /** Instructions per cycle, or 0 if either counter is unavailable */
+    double ipc() const;
+    /** Events per MiB of `bytes`, or 0 if unknown */
+    double perMiB(PerfEvent e) const;
+};
+
+/**
+ * @brief Hardware/software performance counters per named phase
+ *
+ * Uses perf_event_open on Linux to count cycles, instructions, cache and
+ * branch misses, context switches and page faults for the calling thread
+ * and threads it creates during the phase. Counters that cannot be opened
+ * (no PMU in a VM, perf_event_paranoid, other platforms) are reported as
+ * unavailable and the rest still work; with nothing available a phase only
+ * records wall time.
+ *
+ * Disabled by default; a disabled PerfPhase costs one atomic load.
+ */
+class PerfCounters {
+public:
+    static PerfCounters& instance();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    /** Add one phase measurement */
+    void accumulate(const std::string& phase, const PerfSample& sample);
+
+    /** Accumulated samples by phase name */
+    std::map<std::string, PerfSample> results() const;
+
+    /** Log IPC and misses per MiB for every phase */
+    void logSummary() const;
+
+    void reset();
+
+    static const char* eventName(PerfEvent e);
+
+private:
+    PerfCounters() = default;
+
+    std::atomic<bool> enabled{false};
+    mutable std::mutex mtx;
+    std::map<std::string, PerfSample> phases;
+};
+
+/**
+ * @brief RAII measurement of one phase
+ *
+ *     PerfPhase perf("backupToFile");
+ *     ...
+ *     perf.addBytes(fileSize);
+ */
+class PerfPhase {
+public:
+    explicit PerfPhase(std::string name);
+    ~PerfPhase();
+
+    PerfPhase(const PerfPhase&) = delete;
+    PerfPhase& operator=(const PerfPhase&) = delete;
+
+    void addBytes(std::uint64_t n) { bytes += n; }
+
+private:
+    bool active;
+    std::string name;
+    std::uint64_t bytes = 0;
+    std::array<int, PerfSample::kEvents> fds;
+    std::chrono::steady_clock::time_point start;
+};
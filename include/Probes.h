@@ -0,0 +1,53 @@
+#pragma once
+
+/**
+ * USDT (user-level statically defined tracing) probes.
+ *
+ * Built with -DENABLE_USDT=ON on a system that has <sys/sdt.h> (package
+ * systemtap-sdt-dev / systemtap-sdt-devel), each SFB_PROBEn expands to a
+ * single nop plus an ELF note, so an untraced process pays essentially
+ * nothing. bpftrace/perf can attach to a running process by name:
+ *
+ *     bpftrace -e 'usdt:./SqliteFtpBackup:sqliteftpbackup:backup__step__end { ... }'
+ *
+ * Otherwise the macros compile to nothing and their arguments are not
+ * evaluated, so keep arguments free of side effects.
+ *
+ * Probes (provider "sqliteftpbackup"):
+ *   backup__step__start(remaining_pages)
+ *   backup__step__end(rc, remaining_pages, total_pages)
+ *   transfer__start(url, size)              size is -1 if unknown
+ *   transfer__progress(ulnow, ultotal)
+ *   transfer__end(url, curl_code, bytes, total_us)
+ *   retry(attempt, delay_ms)
+ *   log__enqueue(level, message)
+ *   log__flush(bytes)
+ *   stmt__prepare(sql)
+ *   stmt__step__start(sql)
+ *   stmt__step__end(sql, rc)
+ *
+ * See scripts/bpftrace/ for ready-made latency histograms.
+ */
+
+#if defined(SQLITEFTPBACKUP_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SFB_USDT_ENABLED 1
+#endif
+#endif
+
+#if defined(SFB_USDT_ENABLED)
+#define SFB_PROBE0(name)                   DTRACE_PROBE(sqliteftpbackup, name)
+#define SFB_PROBE1(name, a)                DTRACE_PROBE1(sqliteftpbackup, name, a)
+#define SFB_PROBE2(name, a, b)             DTRACE_PROBE2(sqliteftpbackup, name, a, b)
+#define SFB_PROBE3(name, a, b, c)          DTRACE_PROBE3(sqliteftpbackup, name, a, b, c)
+#define SFB_PROBE4(name, a, b, c, d)       DTRACE_PROBE4(sqliteftpbackup, name, a, b, c, d)
+#else
+#define SFB_USDT_ENABLED 0
+// sizeof keeps the arguments "used" for the compiler without evaluating them
+#define SFB_PROBE0(name)                   do { } while (0)
+#define SFB_PROBE1(name, a)                do { (void)sizeof(a); } while (0)
+#define SFB_PROBE2(name, a, b)             do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#define SFB_PROBE3(name, a, b, c)          do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while (0)
+#define SFB_PROBE4(name, a, b, c, d)       do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); (void)sizeof(d); } while (0)
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Output file of a restore, written at random offsets by many threads
+ *
+ * The file is created at its final size up front (fallocate on Linux, an
+ * allocation hint on Windows), so parallel range downloads neither grow it
+ * piecemeal nor fragment it, and running out of disk fails before the
+ * first byte is downloaded. writeAt() is a positional write (pwrite /
+ * overlapped WriteFile) and needs no lock: concurrent writes to disjoint
+ * ranges are safe.
+ */
+class RestoreFile {
+public:
+    /**
+     * Create (or truncate) `path` and reserve `size` bytes
+     * @throws std::runtime_error if the file cannot be created or the space reserved
+     */
+    RestoreFile(const std::string& path, std::uint64_t size);
+    ~RestoreFile();
+
+    RestoreFile(const RestoreFile&) = delete;
+    RestoreFile& operator=(const RestoreFile&) = delete;
+
+    /** @throws std::runtime_error on a failed or short write */
+    void writeAt(std::uint64_t offset, const void* data, std::size_t len);
+
+    /**
+     * Flush to stable storage and close; writeAt() is an error afterwards
+     * @throws std::runtime_error on failure
+     */
+    void close();
+
+    /** Whether the blocks were reserved, not just the size set (sparse file) */
+    bool preallocated() const { return reserved; }
+
+    const std::string& path() const { return filePath; }
+    std::uint64_t size() const { return fileSize; }
+
+private:
+    std::string filePath;
+    std::uint64_t fileSize;
+    bool reserved = false;
+#if defined(_WIN32)
+    void* handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <bitset>
+#include <chrono>
+#include <functional>
+#include <atomic>
+
+/**
+ * @brief Standard five-field cron expression
+ *
+ * Fields: minute hour day-of-month month day-of-week.
+ * Each field accepts '*', single values, ranges ("1-5"), lists ("1,15")
+ * and steps ("0-30/10", or '*' followed by "/5"). Day-of-week is 0-7
+ * (0 and 7 are Sunday).
+ * The macros @hourly, @daily, @weekly and @monthly are also accepted.
+ * Times are evaluated in local time, like cron(8).
+ */
+class CronExpression {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    /**
+     * @param expr - cron expression
+     * @throws std::invalid_argument if the expression cannot be parsed
+     */
+    explicit CronExpression(const std::string& expr);
+
+    /**
+     * Compute the first matching minute strictly after the given time
+     * @throws std::runtime_error if the expression never matches (e.g. "0 0 30 2 *")
+     */
+    TimePoint next(TimePoint after) const;
+
+    const std::string& str() const { return expr; }
+
+private:
+    std::string expr;
+    std::bitset<60> minutes;
+    std::bitset<24> hours;
+    std::bitset<32> daysOfMonth;
+    std::bitset<13> months;
+    std::bitset<8> daysOfWeek;
+    bool domRestricted = false;
+    bool dowRestricted = false;
+
+    bool dayMatches(int mday, int wday) const;
+};
+
+/**
+ * @brief When a job should fire: a fixed interval or a cron expression
+ *
+ * Accepted specs:
+ *  - "90", "90s", "5m", "2h", "1d" or "@every 5m" → fixed interval
+ *  - anything else → CronExpression
+ */
+class Schedule {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    /** @throws std::invalid_argument on malformed spec */
+    explicit Schedule(const std::string& spec);
+
+    /** Next fire time strictly after the given time */
+    TimePoint next(TimePoint after) const;
+
+    /** Interval schedules fire once immediately when the scheduler starts */
+    bool isInterval() const { return interval.count() > 0; }
+
+    std::chrono::seconds getInterval() const { return interval; }
+    std::string describe() const;
+
+private:
+    std::chrono::seconds interval{0};
+    std::vector<CronExpression> cron; // empty or exactly one element
+};
+
+/**
+ * @brief Single-threaded job scheduler for daemon mode
+ *
+ * Jobs run one at a time on the thread that calls run(), so a job can
+ * never overlap itself or another job and may freely share warm
+ * resources (FTP sessions, SQLite handles). If a run overruns its next
+ * fire time, the missed fires are skipped rather than queued.
+ */
+class Scheduler {
+public:
+    using Job = std::function<void()>;
+
+    /**
+     * Register a job
+     * @param name - job name used in log messages
+     * @param schedule - when to fire
+     * @param job - callable; exceptions are logged and do not stop the scheduler
+     * @param jitter - random delay in [0, jitter] added to every fire time
+     */
+    void addJob(const std::string& name, const Schedule& schedule, Job job,
+                std::chrono::seconds jitter = std::chrono::seconds(0));
+
+    /** Run jobs until stop() is called. Blocks the calling thread. */
+    void run();
+
+    /**
+     * Request the scheduler to stop after the current job finishes.
+     * Only touches a lock-free atomic, so it is safe to call from a signal handler.
+     */
+    void stop() { stopRequested.store(true); }
+
+    bool isStopping() const { return stopRequested.load(); }
+
+    /** Number of fires skipped because the previous run overran (all jobs) */
+    std::size_t getSkippedRuns() const { return skippedRuns; }
+
+private:
+    struct Entry {
+        std::string name;
+        Schedule schedule;
+        Job job;
+        std::chrono::seconds jitter;
+        Schedule::TimePoint baseTime;   // scheduled time without jitter
+        Schedule::TimePoint fireTime;   // baseTime + jitter
+    };
+
+    std::vector<Entry> jobs;
+    std::atomic<bool> stopRequested{false};
+    std::size_t skippedRuns = 0;
+
+    Schedule::TimePoint withJitter(Schedule::TimePoint base, std::chrono::seconds jitter) const;
+    void reschedule(Entry& e);
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/** Where a SpillFile's bytes live */
+enum class SpillKind {
+    Memory,         // memfd: RAM only, gone when closed
+    AnonymousDisk,  // O_TMPFILE (or created and unlinked at once) in the spill directory
+    NamedDisk       // visible file removed on destruction (platforms without anonymous files)
+};
+
+/** Where temporary backup copies may go */
+struct SpillPolicy {
+    /** Largest copy kept in RAM; 0 = a quarter of the currently available memory */
+    std::uint64_t memoryLimitBytes = 0;
+    /** Keep copies off RAM entirely */
+    bool allowMemory = true;
+    /** Fast-disk directory for copies that don't fit in RAM; empty = system temp directory */
+    std::string directory;
+};
+
+/**
+ * @brief Anonymous temporary file for snapshot copies
+ *
+ * Prefers a memfd when the expected size fits the policy's memory limit,
+ * otherwise an O_TMPFILE in the spill directory. Neither has a name in any
+ * directory, so nothing is left behind if the process crashes, and a
+ * memfd copy costs memory bandwidth instead of disk writes. Where neither
+ * is available the file gets a name and is removed by the destructor.
+ *
+ * path() can be opened like a regular file (it is /proc/self/fd/N on
+ * Linux); SqliteHelper knows how to open such paths as databases.
+ */
+class SpillFile {
+public:
+    /**
+     * @param policy - memory limit and spill directory
+     * @param expectedSize - size the file will grow to, used to pick RAM or disk
+     * @param name - logical name, e.g. the remote file name; used for the
+     *               memfd label and for NamedDisk files
+     * @throws std::runtime_error if no temporary file can be created
+     */
+    static std::unique_ptr<SpillFile> create(const SpillPolicy& policy, std::uint64_t expectedSize,
+                                             const std::string& name);
+
+    ~SpillFile();
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    /** Path usable with open()/fopen()/SQLite while this object lives */
+    const std::string& path() const { return path_; }
+    const std::string& name() const { return name_; }
+    SpillKind kind() const { return kind_; }
+
+    /** Current size in bytes */
+    std::uint64_t size() const;
+
+    /** Memory the OS reports as available, 0 if unknown */
+    static std::uint64_t availableMemory();
+
+    static const char* kindToString(SpillKind kind);
+
+private:
+    SpillFile(int fd, std::string path, std::string name, SpillKind kind);
+
+    int fd_;                // -1 for NamedDisk
+    std::string path_;
+    std::string name_;
+    SpillKind kind_;
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief Bounded single-producer/single-consumer ring buffer with backpressure
+ *
+ * push() blocks while the ring is full and pop() blocks while it is empty,
+ * so a fast stage is throttled to the speed of the slowest one. The fast
+ * path is lock-free; the slow path spins briefly, then backs off with short
+ * sleeps. Time spent blocked is accumulated as stall time on each side.
+ *
+ * close() is called by the producer after the last item; pop() drains the
+ * remaining items and then returns false. abort() wakes both sides
+ * immediately and makes push()/pop() fail.
+ */
+template<typename T>
+class SpscRing {
+public:
+    explicit SpscRing(std::size_t capacity)
+        : cap(roundUpPow2(capacity < 2 ? 2 : capacity)), mask(cap - 1),
+          slots(new T[cap]) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /** Producer side. Returns false if the ring was aborted. */
+    bool push(T item) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == cap) {
+            auto start = std::chrono::steady_clock::now();
+            ++pushStalls;
+            for (int spin = 0; t - head.load(std::memory_order_acquire) == cap; ++spin) {
+                if (aborted.load(std::memory_order_relaxed)) return false;
+                backoff(spin);
+            }
+            pushStallNs += elapsedNs(start);
+        }
+        if (aborted.load(std::memory_order_relaxed)) return false;
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer side. Returns false once closed and drained, or aborted. */
+    bool pop(T& out) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h) {
+            auto start = std::chrono::steady_clock::now();
+            ++popStalls;
+            for (int spin = 0; tail.load(std::memory_order_acquire) == h; ++spin) {
+                if (aborted.load(std::memory_order_relaxed)) return false;
+                if (closed.load(std::memory_order_acquire) && tail.load(std::memory_order_acquire) == h) {
+                    popStallNs += elapsedNs(start);
+                    return false;
+                }
+                backoff(spin);
+            }
+            popStallNs += elapsedNs(start);
+        }
+        if (aborted.load(std::memory_order_relaxed)) return false;
+        out = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Non-blocking push; leaves item untouched and returns false if full */
+    bool tryPush(T& item) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == cap) return false;
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Non-blocking pop; returns false if empty */
+    bool tryPop(T& out) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h) return false;
+        out = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool full() const { return size() >= cap; }
+    bool empty() const { return size() == 0; }
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+    void close() { closed.store(true, std::memory_order_release); }
+    void abort() { aborted.store(true, std::memory_order_relaxed); }
+    bool isAborted() const { return aborted.load(std::memory_order_relaxed); }
+
+    std::size_t capacity() const { return cap; }
+    std::size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    // Stall statistics (written by one side each, read after join)
+    std::uint64_t getPushStalls() const { return pushStalls; }
+    std::uint64_t getPopStalls() const { return popStalls; }
+    double getPushStallSeconds() const { return static_cast<double>(pushStallNs) / 1e9; }
+    double getPopStallSeconds() const { return static_cast<double>(popStallNs) / 1e9; }
+
+private:
+    const std::size_t cap;
+    const std::size_t mask;
+    std::unique_ptr<T[]> slots;
+
+    // Keep producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::atomic<bool> closed{false};
+    std::atomic<bool> aborted{false};
+
+    std::uint64_t pushStalls = 0;
+    std::uint64_t pushStallNs = 0;
+    std::uint64_t popStalls = 0;
+    std::uint64_t popStallNs = 0;
+
+    static std::size_t roundUpPow2(std::size_t v) {
+        std::size_t p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    static void backoff(int spin) {
+        if (spin < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    static std::uint64_t elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+};
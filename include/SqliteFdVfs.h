@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+
+/**
+ * @brief SQLite VFS that opens /proc/self/fd/N as the already-open file N
+ *
+ * Anonymous files (memfd, O_TMPFILE; see SpillFile) have no name SQLite
+ * could open: the unix VFS resolves symlinks and opens with O_NOFOLLOW.
+ * This VFS serves such paths from a dup of the descriptor with plain
+ * pread/pwrite and no locking (the file is private to this process), and
+ * delegates every other path to the default VFS. A rollback journal of
+ * such a file ("/proc/self/fd/N-journal") is an anonymous memfd as well,
+ * so every journal mode but WAL works, including for attached databases
+ * such as a VACUUM INTO target.
+ */
+namespace SqliteFdVfs {
+    /** True for paths this VFS serves directly */
+    bool isFdPath(const std::string& path);
+
+    /** Registered VFS name for sqlite3_open_v2, or nullptr where unsupported */
+    const char* name();
+}
@@ -1,7 +1,45 @@
 #pragma once
+#include "BackgroundIo.h"
+#include "Cancellation.h"
 #include <sqlite3.h>
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <stdexcept>
+#include <vector>
+
+/** Row count and content digest of one table */
+struct TableDigest {
+    std::string table;
+    std::int64_t rows = 0;
+    std::string checksum;   // XXH3 over every value with its type, in scan order
+
+    bool operator==(const TableDigest& other) const {
+        return table == other.table && rows == other.rows && checksum == other.checksum;
+    }
+};
+
+/**
+ * One committed state of a database file, read from its header and WAL
+ * files without opening it. Equal stamps mean no transaction committed
+ * in between; a differing stamp may also come from a checkpoint.
+ */
+struct ChangeStamp {
+    std::uint32_t changeCounter = 0;   // header offset 24, bumped by commits in rollback mode
+    std::uint32_t pageCount = 0;       // header offset 28
+    std::uint64_t fileSize = 0;
+    std::int64_t modified = 0;         // last write time of the file, in its clock's ticks
+    std::uint64_t walSize = 0;         // 0 without a WAL file
+    std::int64_t walModified = 0;
+    std::uint64_t walIndex = 0;        // XXH3 of the wal-index header (commit counter, last frame, salts)
+
+    bool operator==(const ChangeStamp& other) const {
+        return changeCounter == other.changeCounter && pageCount == other.pageCount && fileSize == other.fileSize
+               && modified == other.modified && walSize == other.walSize && walModified == other.walModified
+               && walIndex == other.walIndex;
+    }
+    bool operator!=(const ChangeStamp& other) const { return !(*this == other); }
+};
 
 class SqliteHelper {
 public:
@@ -9,9 +47,10 @@ public:
      * Constructor opens (or creates) the SQLite database at dbPathPrefix
      * The final database path will include a timestamp suffix.
      * @param dbPathPrefix - prefix for the SQLite database file
+     * @param appendTimestamp - false to open dbPathPrefix as-is (e.g. reopen an existing database)
      * @throws std::runtime_error if the database cannot be opened
      */
-    explicit SqliteHelper(const std::string& dbPathPrefix);
+    explicit SqliteHelper(const std::string& dbPathPrefix, bool appendTimestamp = true);
 
     /** Destructor closes the SQLite database */
     ~SqliteHelper();
@@ -46,10 +85,56 @@ public:
     /**
      * Perform a binary backup of the entire database to a file
      * using the sqlite3_backup API (more efficient than SQL dump).
-     * @param dumpFile - path to the backup file
+     * @param dumpFile - path to the backup file, or a SpillFile path
+     * @param cancel - checked between backup steps (may be nullptr)
+     * @throws OperationCancelled if `cancel` fires; the copy is then incomplete
      * @throws std::runtime_error on failure
      */
-    void backupToFile(const std::string& dumpFile);
+    void backupToFile(const std::string& dumpFile, const CancellationToken* cancel = nullptr);
+
+    /**
+     * Write a compacted copy of the database with VACUUM INTO: free pages
+     * are left out and partly empty pages packed, so the copy can be much
+     * smaller than backupToFile's page-for-page one. Reads through
+     * BackgroundIoVfs in background mode, like backupToFile.
+     * @param dumpFile - path to the copy, or a SpillFile path; must be missing or empty
+     * @param cancel - polled while the copy is written (may be nullptr)
+     * @throws OperationCancelled if `cancel` fires; the copy is then incomplete
+     * @throws std::runtime_error on failure
+     */
+    void vacuumToFile(const std::string& dumpFile, const CancellationToken* cancel = nullptr);
+
+    /**
+     * Make backupToFile read the source like a background job: lower I/O
+     * priority, capped and cache-friendly reads through BackgroundIoVfs on
+     * a separate read-only connection
+     */
+    void setBackgroundIo(const BackgroundIoPolicy& policy) { backgroundIo = policy; }
+
+    /**
+     * Run PRAGMA quick_check (or the full integrity_check) on a database
+     * file, opened read-only, e.g. a restored backup
+     * @return "ok", or the first problem SQLite reports
+     * @throws std::runtime_error if the file cannot be opened or read as a database
+     */
+    static std::string checkIntegrity(const std::string& path, bool quick = true);
+
+    /**
+     * Digest every table of a database file, opened read-only, one table
+     * per task on the shared TaskScheduler (each on its own connection)
+     * @return digests sorted by table name
+     * @throws std::runtime_error if the file cannot be opened or a table read
+     */
+    static std::vector<TableDigest> tableDigests(const std::string& path);
+
+    /**
+     * Read the change stamp of a database file: its 100-byte header, the
+     * sizes and write times of it and its -wal file, and the wal-index
+     * header in its -shm file. Takes microseconds and no locks.
+     * @return nullopt if the state cannot be told, e.g. a WAL file without
+     *         a readable wal-index or one caught mid-update
+     */
+    static std::optional<ChangeStamp> changeStamp(const std::string& path);
 
     /** Return path to the database */
     std::string getDbPath() const { return dbPath; }
@@ -57,6 +142,7 @@ public:
 private:
     sqlite3* db = nullptr;
     std::string dbPath;
+    BackgroundIoPolicy backgroundIo;
 
     /** Generate random first name for sample data */
     std::string randomFirstName(int idx) const;
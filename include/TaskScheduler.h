@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Work-stealing task scheduler shared by all CPU-bound work
+ *
+ * Each worker owns a deque: it pushes and pops its own tasks at the back
+ * (LIFO, cache-warm) while idle workers steal from the front of other
+ * workers' deques. Tasks submitted from outside the pool are spread
+ * round-robin. Use the process-wide instance() so parallel features
+ * (hashing, encryption, pipeline stages, ...) share one set of threads
+ * instead of oversubscribing the host.
+ */
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    struct WorkerStats {
+        std::size_t queueDepth = 0;
+        std::uint64_t executed = 0;
+        std::uint64_t steals = 0;       // tasks this worker stole from others
+    };
+
+    struct Stats {
+        std::vector<WorkerStats> workers;
+        std::uint64_t submitted = 0;
+        std::uint64_t executed = 0;
+        std::uint64_t steals = 0;
+        std::size_t queueDepth = 0;
+    };
+
+    /**
+     * @param workers - number of worker threads (0 = hardware concurrency)
+     * @param pinWorkers - pin worker i to CPU i (mod CPU count) where supported
+     */
+    explicit TaskScheduler(std::size_t workers = 0, bool pinWorkers = false);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /** Process-wide scheduler, created on first use with the configure()d settings */
+    static TaskScheduler& instance();
+
+    /**
+     * Set worker count/affinity of instance(). Must be called before the
+     * first instance() call; later calls are ignored with a warning.
+     */
+    static void configure(std::size_t workers, bool pinWorkers);
+
+    /** Queue a task; never blocks. Exceptions escaping the task are logged. */
+    void submit(Task task);
+
+    /**
+     * Run one queued task on the calling thread, if any.
+     * Lets threads that wait for tasks help instead of blocking.
+     * @return true if a task was run
+     */
+    bool runOne();
+
+    std::size_t workerCount() const { return workers.size(); }
+
+    Stats getStats() const;
+    void logStats() const;
+
+private:
+    struct Worker {
+        std::deque<Task> tasks;
+        mutable std::mutex mtx;
+        std::atomic<std::uint64_t> executed{0};
+        std::atomic<std::uint64_t> steals{0};
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<std::size_t> pending{0};      // queued, not yet started
+    std::atomic<std::uint64_t> submitted{0};
+    std::atomic<std::size_t> nextWorker{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMtx;
+    std::condition_variable sleepCv;
+
+    void workerLoop(std::size_t index, bool pin);
+    bool popLocal(std::size_t index, Task& out);
+    bool steal(std::size_t thief, Task& out);
+    void execute(Task& task);
+};
+
+/**
+ * @brief Set of tasks that can be waited for as a unit
+ *
+ * wait() helps execute queued tasks while waiting, so it is safe to call
+ * from inside a scheduler task. The first exception thrown by a task is
+ * rethrown from wait().
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler& scheduler = TaskScheduler::instance());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(TaskScheduler::Task task);
+    void wait();
+
+private:
+    TaskScheduler& scheduler;
+    std::atomic<std::size_t> pending{0};
+    std::mutex mtx;
+    std::exception_ptr error;
+};
+
+/**
+ * Run fn(i) for every i in [begin, end) on the shared scheduler, in
+ * ranges of `grain` indices, and wait for completion.
+ * @throws the first exception thrown by fn
+ */
+void parallelFor(std::size_t begin, std::size_t end,
+                 const std::function<void(std::size_t)>& fn, std::size_t grain = 1);
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** One completed span, in microseconds since the tracer started */
+struct TraceEvent {
+    std::string name;
+    const char* category = "";
+    double startUs = 0;
+    double durationUs = 0;
+    const char* argName = nullptr;  // optional numeric argument shown in the viewer
+    std::int64_t argValue = 0;
+};
+
+/**
+ * @brief Process-wide span tracer with Chrome trace-event export
+ *
+ * Spans are appended to a per-thread buffer, so recording never contends
+ * with other threads; buffers are only walked when the trace is written.
+ * The output loads in chrome://tracing and https://ui.perfetto.dev, one
+ * track per thread, which shows how the backup phases overlap and where
+ * a stage waited.
+ *
+ * Tracing is off by default; a disabled TraceSpan costs one atomic load.
+ */
+class Tracer {
+public:
+    static Tracer& instance();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    /** Microseconds since the tracer was created */
+    double nowUs() const;
+
+    /** Append a finished span to the calling thread's buffer */
+    void record(TraceEvent event);
+
+    /** Label the calling thread's track in the viewer */
+    void setThreadName(const std::string& name);
+
+    /** Cap per thread; later events are dropped and counted (default 1M) */
+    void setMaxEventsPerThread(std::size_t max) { maxEventsPerThread = max; }
+
+    /** Trace in the Chrome JSON object format */
+    std::string toChromeJson() const;
+
+    /**
+     * Write toChromeJson() to a file
+     * @throws std::runtime_error on I/O failure
+     */
+    void writeChromeTrace(const std::string& path) const;
+
+    /** Drop all recorded events (thread names are kept) */
+    void clear();
+
+    std::size_t eventCount() const;
+    std::uint64_t droppedCount() const;
+
+private:
+    struct ThreadBuffer {
+        std::mutex mtx;               // uncontended except while writing the trace
+        std::uint32_t tid = 0;
+        std::string name;
+        std::vector<TraceEvent> events;
+        std::uint64_t dropped = 0;
+    };
+
+    Tracer();
+    ThreadBuffer& localBuffer();
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch;
+    std::size_t maxEventsPerThread = 1 << 20;
+    mutable std::mutex mtx;   // guards the buffer list
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+/**
+ * @brief RAII span: records [construction, destruction) on the current thread
+ *
+ *     TraceSpan span("backupToFile", "sqlite");
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* category = "backup",
+                       const char* argName = nullptr, std::int64_t argValue = 0);
+    explicit TraceSpan(const std::string& name, const char* category = "backup",
+                       const char* argName = nullptr, std::int64_t argValue = 0);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    bool active;
+    TraceEvent event;
+};
@@ -0,0 +1,359 @@
+#include "BackgroundIo.h"
+#include "HdrHistogram.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace {
+    struct SourceMetrics {
+        Counter& readBytes;
+        Counter& pagesDropped;
+        HdrHistogram& throttleWait;
+    };
+
+    SourceMetrics& sourceMetrics() {
+        MetricsRegistry& m = MetricsRegistry::instance();
+        static SourceMetrics metrics{
+            m.counter("sqliteftpbackup_source_read_bytes_total", "Bytes the backup read from the source database"),
+            m.counter("sqliteftpbackup_source_cache_pages_dropped_total",
+                      "Page-cache pages released behind the backup reader"),
+            LatencyStats::instance().histogram("source_throttle")};
+        return metrics;
+    }
+
+    std::atomic<bool> warnedDirect{false};
+
+#if defined(__linux__)
+    // ioprio_set(2) encoding; glibc has no wrapper
+    constexpr int kIoprioWhoProcess = 1;   // with id 0: the calling thread
+    constexpr int kIoprioClassShift = 13;
+    constexpr int kIoprioClassBe = 2;
+    constexpr int kIoprioClassIdle = 3;
+
+    constexpr std::int64_t kDropWindow = 1 << 20;
+    constexpr std::size_t kDirectAlign = 4096;
+#endif
+
+    // Per-file read policy, parsed from the URI at open
+    struct ReadState {
+        std::unique_ptr<RateLimiter> bytesLimit;
+        std::unique_ptr<RateLimiter> opsLimit;
+        bool dropCache = false;
+        bool direct = false;
+        int sideFd = -1;   // second descriptor for O_DIRECT reads and fadvise
+
+        // Residency of the current drop window, sampled before reading it
+        std::int64_t windowStart = -1;
+        std::vector<unsigned char> resident;
+
+        std::vector<char> directBuffer;   // over-allocated for alignment
+
+#if defined(__linux__)
+        long pageSize = sysconf(_SC_PAGESIZE);
+
+        void sampleWindow(std::int64_t start) {
+            windowStart = -1;
+            struct stat st;
+            if (fstat(sideFd, &st) != 0 || start >= st.st_size) return;
+            auto len = static_cast<std::size_t>(std::min<std::int64_t>(kDropWindow, st.st_size - start));
+            void* map = mmap(nullptr, len, PROT_READ, MAP_SHARED, sideFd, start);
+            if (map == MAP_FAILED) return;
+            resident.assign((len + static_cast<std::size_t>(pageSize) - 1) / static_cast<std::size_t>(pageSize), 0);
+            bool ok = mincore(map, len, resident.data()) == 0;
+            munmap(map, len);
+            if (ok) windowStart = start;
+        }
+
+        // Release the pages of the finished window that we brought in
+        void finishWindow() {
+            if (windowStart < 0) return;
+            std::uint64_t dropped = 0;
+            for (std::size_t i = 0; i < resident.size();) {
+                if (resident[i] & 1) {
+                    ++i;
+                    continue;
+                }
+                std::size_t run = i;
+                while (run < resident.size() && !(resident[run] & 1)) ++run;
+                posix_fadvise(sideFd, windowStart + static_cast<std::int64_t>(i) * pageSize,
+                              static_cast<off_t>(run - i) * pageSize, POSIX_FADV_DONTNEED);
+                dropped += run - i;
+                i = run;
+            }
+            if (dropped) sourceMetrics().pagesDropped.inc(dropped);
+            windowStart = -1;
+        }
+
+        void track(std::int64_t offset) {
+            std::int64_t window = offset / kDropWindow * kDropWindow;
+            if (window == windowStart) return;
+            finishWindow();
+            sampleWindow(window);
+        }
+
+        int directRead(void* buf, int amount, std::int64_t offset) {
+            std::int64_t begin = offset / static_cast<std::int64_t>(kDirectAlign) * static_cast<std::int64_t>(kDirectAlign);
+            std::int64_t end = offset + amount;
+            end = (end + static_cast<std::int64_t>(kDirectAlign) - 1) / static_cast<std::int64_t>(kDirectAlign)
+                  * static_cast<std::int64_t>(kDirectAlign);
+            auto span = static_cast<std::size_t>(end - begin);
+            if (directBuffer.size() < span + kDirectAlign) directBuffer.resize(span + kDirectAlign);
+            auto addr = reinterpret_cast<std::uintptr_t>(directBuffer.data());
+            char* aligned = reinterpret_cast<char*>((addr + kDirectAlign - 1) & ~(kDirectAlign - 1));
+
+            std::size_t got = 0;
+            while (got < span) {
+                ssize_t n = pread(sideFd, aligned + got, span - got, begin + static_cast<std::int64_t>(got));
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) return SQLITE_IOERR_READ;
+                if (n == 0) break;
+                got += static_cast<std::size_t>(n);
+            }
+            auto skip = static_cast<std::size_t>(offset - begin);
+            std::size_t avail = got > skip ? std::min<std::size_t>(got - skip, static_cast<std::size_t>(amount)) : 0;
+            std::memcpy(buf, aligned + skip, avail);
+            if (avail < static_cast<std::size_t>(amount)) {
+                std::memset(static_cast<char*>(buf) + avail, 0, static_cast<std::size_t>(amount) - avail);
+                return SQLITE_IOERR_SHORT_READ;
+            }
+            return SQLITE_OK;
+        }
+#endif
+
+        ~ReadState() {
+#if defined(__linux__)
+            if (dropCache && !direct) finishWindow();
+            if (sideFd >= 0) close(sideFd);
+#endif
+        }
+    };
+
+    // SQLite allocates szOsFile bytes: this header, then the wrapped file
+    struct BgFile {
+        sqlite3_file base;
+        ReadState* state;
+        sqlite3_file* inner;
+    };
+
+    sqlite3_vfs* defaultVfs = nullptr;
+
+    sqlite3_file* innerOf(sqlite3_file* f) { return reinterpret_cast<BgFile*>(f)->inner; }
+
+    int bgClose(sqlite3_file* f) {
+        auto* p = reinterpret_cast<BgFile*>(f);
+        int rc = p->inner->pMethods->xClose(p->inner);
+        delete p->state;
+        p->state = nullptr;
+        return rc;
+    }
+
+    int bgRead(sqlite3_file* f, void* buf, int amount, sqlite3_int64 offset) {
+        sqlite3_file* in = innerOf(f);
+        ReadState* state = reinterpret_cast<BgFile*>(f)->state;
+        if (!state) return in->pMethods->xRead(in, buf, amount, offset);
+        ReadState& s = *state;
+        double waited = 0;
+        if (s.opsLimit) waited += s.opsLimit->acquire(1);
+        if (s.bytesLimit) waited += s.bytesLimit->acquire(amount);
+        SourceMetrics& metrics = sourceMetrics();
+        if (waited > 0) metrics.throttleWait.record(static_cast<std::int64_t>(waited * 1e9));
+        metrics.readBytes.inc(static_cast<std::uint64_t>(amount));
+
+#if defined(__linux__)
+        if (s.direct) return s.directRead(buf, amount, offset);
+        if (s.dropCache && s.sideFd >= 0) s.track(offset);
+#endif
+        return in->pMethods->xRead(in, buf, amount, offset);
+    }
+
+    // Everything else goes straight to the wrapped file
+    int bgWrite(sqlite3_file* f, const void* b, int n, sqlite3_int64 o) { return innerOf(f)->pMethods->xWrite(innerOf(f), b, n, o); }
+    int bgTruncate(sqlite3_file* f, sqlite3_int64 n) { return innerOf(f)->pMethods->xTruncate(innerOf(f), n); }
+    int bgSync(sqlite3_file* f, int flags) { return innerOf(f)->pMethods->xSync(innerOf(f), flags); }
+    int bgFileSize(sqlite3_file* f, sqlite3_int64* n) { return innerOf(f)->pMethods->xFileSize(innerOf(f), n); }
+    int bgLock(sqlite3_file* f, int l) { return innerOf(f)->pMethods->xLock(innerOf(f), l); }
+    int bgUnlock(sqlite3_file* f, int l) { return innerOf(f)->pMethods->xUnlock(innerOf(f), l); }
+    int bgCheckReservedLock(sqlite3_file* f, int* r) { return innerOf(f)->pMethods->xCheckReservedLock(innerOf(f), r); }
+    int bgFileControl(sqlite3_file* f, int op, void* a) { return innerOf(f)->pMethods->xFileControl(innerOf(f), op, a); }
+    int bgSectorSize(sqlite3_file* f) { return innerOf(f)->pMethods->xSectorSize(innerOf(f)); }
+    int bgDeviceCharacteristics(sqlite3_file* f) { return innerOf(f)->pMethods->xDeviceCharacteristics(innerOf(f)); }
+    int bgShmMap(sqlite3_file* f, int pg, int sz, int ext, void volatile** pp) { return innerOf(f)->pMethods->xShmMap(innerOf(f), pg, sz, ext, pp); }
+    int bgShmLock(sqlite3_file* f, int off, int n, int flags) { return innerOf(f)->pMethods->xShmLock(innerOf(f), off, n, flags); }
+    void bgShmBarrier(sqlite3_file* f) { innerOf(f)->pMethods->xShmBarrier(innerOf(f)); }
+    int bgShmUnmap(sqlite3_file* f, int del) { return innerOf(f)->pMethods->xShmUnmap(innerOf(f), del); }
+
+    // Version 2: shared memory is forwarded so WAL sources still open, but
+    // there is no xFetch, so every page read goes through bgRead
+    const sqlite3_io_methods kBgMethods = {
+        2,
+        bgClose, bgRead, bgWrite, bgTruncate, bgSync, bgFileSize,
+        bgLock, bgUnlock, bgCheckReservedLock, bgFileControl,
+        bgSectorSize, bgDeviceCharacteristics,
+        bgShmMap, bgShmLock, bgShmBarrier, bgShmUnmap, nullptr, nullptr,
+    };
+
+    constexpr int innerOffset() {
+        return static_cast<int>((sizeof(BgFile) + 7) / 8 * 8);
+    }
+
+    double uriDouble(const char* name, const char* key) {
+        const char* v = sqlite3_uri_parameter(name, key);
+        return v ? std::atof(v) : 0.0;
+    }
+
+    int bgOpen(sqlite3_vfs*, const char* name, sqlite3_file* file, int flags, int* outFlags) {
+        auto* p = reinterpret_cast<BgFile*>(file);
+        p->inner = reinterpret_cast<sqlite3_file*>(reinterpret_cast<char*>(file) + innerOffset());
+        p->state = nullptr;
+        file->pMethods = nullptr;
+        int rc = defaultVfs->xOpen(defaultVfs, name, p->inner, flags, outFlags);
+        if (rc != SQLITE_OK) return rc;
+        file->pMethods = &kBgMethods;
+        // Journals and temp files are forwarded without a read policy
+        if (!(flags & SQLITE_OPEN_MAIN_DB)) return SQLITE_OK;
+
+        auto state = std::make_unique<ReadState>();
+        double mbps = uriDouble(name, "max_mbps");
+        double iops = uriDouble(name, "max_iops");
+        // Burst of 1 MiB / a tenth of a second keeps backup steps smooth
+        if (mbps > 0) state->bytesLimit = std::make_unique<RateLimiter>(mbps * 1024 * 1024, std::max(mbps * 1024 * 1024 / 10, 1024.0 * 1024));
+        if (iops > 0) state->opsLimit = std::make_unique<RateLimiter>(iops);
+        state->dropCache = sqlite3_uri_boolean(name, "drop_cache", 0) != 0;
+        bool wantDirect = sqlite3_uri_boolean(name, "direct", 0) != 0;
+
+#if defined(__linux__)
+        if (wantDirect) {
+            state->sideFd = open(name, O_RDONLY | O_DIRECT | O_CLOEXEC);
+            state->direct = state->sideFd >= 0;
+            if (!state->direct && !warnedDirect.exchange(true)) {
+                Logger::instance().warn(std::string("O_DIRECT reads unavailable (") + std::strerror(errno)
+                                        + "), reading through the page cache");
+            }
+        }
+        if (state->sideFd < 0 && state->dropCache) state->sideFd = open(name, O_RDONLY | O_CLOEXEC);
+#else
+        if (wantDirect && !warnedDirect.exchange(true)) {
+            Logger::instance().warn("O_DIRECT reads are only supported on Linux");
+        }
+#endif
+        p->state = state.release();
+        return SQLITE_OK;
+    }
+
+    std::string uriEscape(const std::string& path) {
+        static const char hex[] = "0123456789ABCDEF";
+        std::string out;
+        for (unsigned char c : path) {
+            if (c == '%' || c == '?' || c == '#' || c == '&' || c == '=' || c <= ' ' || c >= 0x7f) {
+                out += '%';
+                out += hex[c >> 4];
+                out += hex[c & 15];
+            } else {
+                out += static_cast<char>(c == '\\' ? '/' : c);
+            }
+        }
+        return out;
+    }
+}
+
+// -----------------------
+// RateLimiter
+// -----------------------
+RateLimiter::RateLimiter(double perSecond, double burst)
+    : rate(perSecond), capacity(burst > 0 ? burst : perSecond / 10), tokens(capacity),
+      last(std::chrono::steady_clock::now()) {}
+
+double RateLimiter::acquire(double n) {
+    double wait;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto now = std::chrono::steady_clock::now();
+        tokens = std::min(capacity, tokens + std::chrono::duration<double>(now - last).count() * rate);
+        last = now;
+        // Go into debt rather than refuse: later callers pay it back
+        tokens -= n;
+        if (tokens >= 0) return 0;
+        wait = -tokens / rate;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    return wait;
+}
+
+// -----------------------
+// ScopedIoPriority
+// -----------------------
+ScopedIoPriority::ScopedIoPriority(IoPriorityClass ioClass) {
+    if (ioClass == IoPriorityClass::Normal) return;
+#if defined(__linux__)
+    long prev = syscall(SYS_ioprio_get, kIoprioWhoProcess, 0);
+    int value = ioClass == IoPriorityClass::Idle ? (kIoprioClassIdle << kIoprioClassShift)
+                                                 : ((kIoprioClassBe << kIoprioClassShift) | 7);
+    if (prev >= 0 && syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, value) == 0) {
+        previous = static_cast<int>(prev);
+        active = true;
+    }
+#elif defined(_WIN32)
+    active = SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) != 0;
+#endif
+    if (!active) Logger::instance().warn("Could not lower the I/O priority of the backup thread");
+}
+
+ScopedIoPriority::~ScopedIoPriority() {
+    if (!active) return;
+#if defined(__linux__)
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, previous);
+#elif defined(_WIN32)
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+#endif
+}
+
+// -----------------------
+// BackgroundIoVfs
+// -----------------------
+const char* BackgroundIoVfs::name() {
+    static const char* registered = [] {
+        defaultVfs = sqlite3_vfs_find(nullptr);
+        static sqlite3_vfs vfs = *defaultVfs;
+        vfs.zName = "sqliteftpbackup-background";
+        vfs.pNext = nullptr;
+        vfs.szOsFile = innerOffset() + defaultVfs->szOsFile;
+        vfs.xOpen = bgOpen;
+        return sqlite3_vfs_register(&vfs, 0) == SQLITE_OK ? vfs.zName : nullptr;
+    }();
+    return registered;
+}
+
+std::string BackgroundIoVfs::uri(const std::string& path, const BackgroundIoPolicy& policy) {
+    std::string escaped = uriEscape(path);
+#if defined(_WIN32)
+    if (escaped.size() > 1 && escaped[1] == ':') escaped = "/" + escaped;   // file:/C:/...
+#endif
+    std::string u = "file:" + escaped + "?mode=ro&vfs=" + name();
+    if (policy.maxMBps > 0) u += "&max_mbps=" + std::to_string(policy.maxMBps);
+    if (policy.maxIops > 0) u += "&max_iops=" + std::to_string(policy.maxIops);
+    if (policy.dropCache) u += "&drop_cache=1";
+    if (policy.directIo) u += "&direct=1";
+    return u;
+}
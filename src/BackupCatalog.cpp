@@ -0,0 +1,204 @@
+#include "BackupCatalog.h"
+#include "Logger.h"
+#include "Probes.h"
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <stdexcept>
+
+namespace {
+    using StmtPtr = std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)>;
+
+    constexpr const char* kColumns =
+        "id, db_id, created_at, size, hash, remote_dir, remote_name, format, parent_id";
+
+    StmtPtr prepare(sqlite3* db, const std::string& sql) {
+        sqlite3_stmt* raw = nullptr;
+        SFB_PROBE1(stmt__prepare, sql.c_str());
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &raw, nullptr) != SQLITE_OK) {
+            throw std::runtime_error(std::string("Catalog: failed to prepare statement: ") + sqlite3_errmsg(db));
+        }
+        return StmtPtr(raw, &sqlite3_finalize);
+    }
+
+    void stepDone(sqlite3* db, sqlite3_stmt* stmt) {
+        const char* sql = sqlite3_sql(stmt);
+        SFB_PROBE1(stmt__step__start, sql);
+        int rc = sqlite3_step(stmt);
+        SFB_PROBE2(stmt__step__end, sql, rc);
+        if (rc != SQLITE_DONE) {
+            throw std::runtime_error(std::string("Catalog: write failed: ") + sqlite3_errmsg(db));
+        }
+    }
+
+    std::string columnText(sqlite3_stmt* stmt, int col) {
+        const unsigned char* t = sqlite3_column_text(stmt, col);
+        return t ? reinterpret_cast<const char*>(t) : "";
+    }
+
+    CatalogEntry readEntry(sqlite3_stmt* stmt) {
+        CatalogEntry e;
+        e.id = sqlite3_column_int64(stmt, 0);
+        e.dbId = columnText(stmt, 1);
+        e.createdAt = sqlite3_column_int64(stmt, 2);
+        e.size = sqlite3_column_int64(stmt, 3);
+        e.hash = columnText(stmt, 4);
+        e.remoteDir = columnText(stmt, 5);
+        e.remoteName = columnText(stmt, 6);
+        e.format = BackupCatalog::formatFromString(columnText(stmt, 7));
+        e.parentId = sqlite3_column_int64(stmt, 8);   // NULL reads as 0
+        return e;
+    }
+
+    std::optional<CatalogEntry> firstEntry(sqlite3_stmt* stmt) {
+        if (sqlite3_step(stmt) != SQLITE_ROW) return std::nullopt;
+        return readEntry(stmt);
+    }
+
+    std::string selectEntries(const std::string& rest) {
+        return std::string("SELECT ") + kColumns + " FROM backups " + rest;
+    }
+}
+
+BackupCatalog::BackupCatalog(const std::string& path) : path(path) {
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::string err = db ? sqlite3_errmsg(db) : "unknown error";
+        sqlite3_close(db);
+        db = nullptr;
+        throw std::runtime_error("Can't open backup catalog " + path + ": " + err);
+    }
+    sqlite3_busy_timeout(db, 5000);
+    exec("PRAGMA journal_mode=WAL;");
+    exec("PRAGMA synchronous=FULL;");
+    exec(R"(CREATE TABLE IF NOT EXISTS backups(
+        id INTEGER PRIMARY KEY AUTOINCREMENT,
+        db_id TEXT NOT NULL,
+        created_at INTEGER NOT NULL,
+        size INTEGER NOT NULL,
+        hash TEXT,
+        remote_dir TEXT NOT NULL,
+        remote_name TEXT NOT NULL,
+        format TEXT NOT NULL,
+        parent_id INTEGER,
+        recorded_at TEXT DEFAULT (strftime('%Y-%m-%dT%H:%M:%SZ','now')),
+        UNIQUE(remote_dir, remote_name)
+    );)");
+    // Point-in-time and latest lookups are one descending index seek
+    exec("CREATE INDEX IF NOT EXISTS backups_by_time ON backups(db_id, created_at);");
+    exec("CREATE INDEX IF NOT EXISTS backups_by_parent ON backups(parent_id) WHERE parent_id IS NOT NULL;");
+    Logger::instance().info("Backup catalog opened: " + path + " (" + std::to_string(size()) + " backups)");
+}
+
+BackupCatalog::~BackupCatalog() {
+    if (db) sqlite3_close(db);
+}
+
+void BackupCatalog::exec(const char* sql) {
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::string e = errMsg ? errMsg : "unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Catalog: " + e);
+    }
+}
+
+std::int64_t BackupCatalog::record(const CatalogEntry& entry) {
+    auto stmt = prepare(db,
+        "INSERT OR REPLACE INTO backups(db_id, created_at, size, hash, remote_dir, remote_name, format, parent_id) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?);");
+    const std::string format = formatToString(entry.format);
+    sqlite3_bind_text(stmt.get(), 1, entry.dbId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt.get(), 2, entry.createdAt);
+    sqlite3_bind_int64(stmt.get(), 3, entry.size);
+    sqlite3_bind_text(stmt.get(), 4, entry.hash.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 5, entry.remoteDir.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 6, entry.remoteName.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 7, format.c_str(), -1, SQLITE_TRANSIENT);
+    if (entry.parentId > 0) {
+        sqlite3_bind_int64(stmt.get(), 8, entry.parentId);
+    } else {
+        sqlite3_bind_null(stmt.get(), 8);
+    }
+    stepDone(db, stmt.get());
+    return sqlite3_last_insert_rowid(db);
+}
+
+std::optional<CatalogEntry> BackupCatalog::latest(const std::string& dbId, std::optional<std::int64_t> atOrBefore) {
+    auto stmt = prepare(db, selectEntries("WHERE db_id=? AND created_at<=? ORDER BY created_at DESC, id DESC LIMIT 1;"));
+    sqlite3_bind_text(stmt.get(), 1, dbId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt.get(), 2, atOrBefore.value_or(INT64_MAX));
+    return firstEntry(stmt.get());
+}
+
+std::optional<CatalogEntry> BackupCatalog::find(const std::string& remoteDir, const std::string& remoteName) {
+    auto stmt = prepare(db, selectEntries("WHERE remote_dir=? AND remote_name=?;"));
+    sqlite3_bind_text(stmt.get(), 1, remoteDir.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 2, remoteName.c_str(), -1, SQLITE_TRANSIENT);
+    return firstEntry(stmt.get());
+}
+
+std::vector<CatalogEntry> BackupCatalog::chain(std::int64_t id) {
+    auto stmt = prepare(db, selectEntries("WHERE id=?;"));
+    std::vector<CatalogEntry> links;
+    std::set<std::int64_t> seen;
+    for (std::int64_t next = id; next > 0;) {
+        if (!seen.insert(next).second) throw std::runtime_error("Catalog: backup chain of #" + std::to_string(id) + " has a cycle");
+        sqlite3_reset(stmt.get());
+        sqlite3_bind_int64(stmt.get(), 1, next);
+        auto entry = firstEntry(stmt.get());
+        if (!entry) throw std::runtime_error("Catalog: backup #" + std::to_string(next) + " is missing from the chain of #"
+                                             + std::to_string(id));
+        next = entry->parentId;
+        links.push_back(std::move(*entry));
+    }
+    return {links.rbegin(), links.rend()};
+}
+
+std::vector<CatalogEntry> BackupCatalog::list(const std::string& dbId, std::size_t limit) {
+    auto stmt = prepare(db, selectEntries("WHERE db_id=? ORDER BY created_at DESC, id DESC LIMIT ?;"));
+    sqlite3_bind_text(stmt.get(), 1, dbId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt.get(), 2, limit == 0 ? -1 : static_cast<std::int64_t>(limit));
+    std::vector<CatalogEntry> entries;
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) entries.push_back(readEntry(stmt.get()));
+    return entries;
+}
+
+bool BackupCatalog::remove(const std::string& remoteDir, const std::string& remoteName) {
+    auto stmt = prepare(db, "DELETE FROM backups WHERE remote_dir=? AND remote_name=?;");
+    sqlite3_bind_text(stmt.get(), 1, remoteDir.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 2, remoteName.c_str(), -1, SQLITE_TRANSIENT);
+    stepDone(db, stmt.get());
+    return sqlite3_changes(db) > 0;
+}
+
+std::size_t BackupCatalog::size() {
+    auto stmt = prepare(db, "SELECT COUNT(*) FROM backups;");
+    if (sqlite3_step(stmt.get()) != SQLITE_ROW) return 0;
+    return static_cast<std::size_t>(sqlite3_column_int64(stmt.get(), 0));
+}
+
+void BackupCatalog::exportTo(const std::string& file) {
+    // VACUUM INTO refuses to overwrite
+    std::error_code ec;
+    std::filesystem::remove(file, ec);
+    auto stmt = prepare(db, "VACUUM INTO ?;");
+    sqlite3_bind_text(stmt.get(), 1, file.c_str(), -1, SQLITE_TRANSIENT);
+    stepDone(db, stmt.get());
+}
+
+std::string BackupCatalog::formatToString(BackupFormat format) {
+    switch (format) {
+        case BackupFormat::Plain:     return "plain";
+        case BackupFormat::Encrypted: return "encrypted";
+        case BackupFormat::Chunked:   return "chunked";
+        case BackupFormat::Delta:     return "delta";
+    }
+    return "plain";
+}
+
+BackupFormat BackupCatalog::formatFromString(const std::string& s) {
+    if (s == "encrypted") return BackupFormat::Encrypted;
+    if (s == "chunked")   return BackupFormat::Chunked;
+    if (s == "delta")     return BackupFormat::Delta;
+    return BackupFormat::Plain;
+}
@@ -0,0 +1,1364 @@
+#include "BackupManager.h"
+#include "SqliteHelper.h"
+#include "FtpUploader.h"
+#include "FtpWorkerPool.h"
+#include "GarbageCollector.h"
+#include "JobJournal.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "HdrHistogram.h"
+#include "PerfCounters.h"
+#include "RestoreFile.h"
+#include "Probes.h"
+#include "TaskScheduler.h"
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <exception>
+#include <future>
+#include <unordered_map>
+#include <map>
+
+namespace {
+    // Utility to get current timestamp string
+    std::string currentTimestamp() {
+        auto now = std::chrono::system_clock::now();
+        auto t = std::chrono::system_clock::to_time_t(now);
+        std::tm tm_now;
+#if defined(_WIN32)
+        localtime_s(&tm_now, &t);
+#else
+        localtime_r(&t, &tm_now);
+#endif
+
+        std::ostringstream oss;
+        oss << std::put_time(&tm_now, "%Y-%m-%d_%H-%M-%S");
+        return oss.str();
+    }
+
+    // RAII helper to ensure temporary file is removed if created.
+    // With keepOnFailure the file survives exception unwinding so an
+    // interrupted job can be resumed from it.
+    class TempFileRemover {
+    public:
+        explicit TempFileRemover(const std::filesystem::path& p, bool keepOnFailure = false)
+            : path_(p), active_(true), keepOnFailure_(keepOnFailure),
+              exceptionsAtStart_(std::uncaught_exceptions()) {}
+        ~TempFileRemover() {
+            if (keepOnFailure_ && std::uncaught_exceptions() > exceptionsAtStart_) {
+                Logger::instance().info("Keeping " + path_.string() + " for resume");
+                return;
+            }
+            if (active_ && !path_.empty()) {
+                try {
+                    std::filesystem::remove(path_);
+                    Logger::instance().info("Temporary file removed: " + path_.string());
+                } catch (...) {
+                    // Avoid throwing in destructor
+                }
+            }
+        }
+    private:
+        std::filesystem::path path_;
+        bool active_;
+        bool keepOnFailure_;
+        int exceptionsAtStart_;
+    };
+
+    // Checksum::label() of a whole file
+    std::string fileDigest(ChecksumAlgorithm algorithm, const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("Cannot read " + path);
+        std::unique_ptr<Checksum> checksum = Checksum::create(algorithm);
+        std::vector<char> buf(1 << 20);
+        while (in.read(buf.data(), static_cast<std::streamsize>(buf.size())) || in.gcount() > 0) {
+            checksum->update(buf.data(), static_cast<std::size_t>(in.gcount()));
+        }
+        return checksum->label();
+    }
+
+    // Algorithm of a Checksum::label(): "<algo>:<hex>", or bare hex for SHA-256
+    ChecksumAlgorithm labelAlgorithm(const std::string& label) {
+        auto colon = label.find(':');
+        return colon == std::string::npos ? ChecksumAlgorithm::Sha256 : Checksum::parseAlgorithm(label.substr(0, colon));
+    }
+
+    // Journal upload checkpoints every this many bytes
+    constexpr std::int64_t kCheckpointBytes = 8LL << 20;
+
+    // Upload a buffer that is already in memory (manifests, recipes, chunks)
+    void uploadBuffer(FtpUploader& ftp, const char* data, std::size_t len, const std::string& remoteDir,
+                      const std::string& name, bool append = false) {
+        std::size_t pos = 0;
+        ftp.uploadStream([data, len, &pos](char* buf, std::size_t max) {
+                             std::size_t n = std::min(max, len - pos);
+                             std::memcpy(buf, data + pos, n);
+                             pos += n;
+                             return n;
+                         },
+                         remoteDir, name, static_cast<std::int64_t>(len), append);
+    }
+
+    // Unix time of a file's last write; C++17 has no clock_cast, so shift by the clocks' offset
+    std::int64_t unixWriteTime(const std::string& file) {
+        std::error_code ec;
+        auto written = std::filesystem::last_write_time(file, ec);
+        auto when = std::chrono::system_clock::now();
+        if (!ec) {
+            when += std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                written - std::filesystem::file_time_type::clock::now());
+        }
+        return std::chrono::duration_cast<std::chrono::seconds>(when.time_since_epoch()).count();
+    }
+
+    std::string downloadText(FtpUploader& ftp, const std::string& remoteDir, const std::string& name) {
+        std::string text;
+        ftp.downloadStream([&text](const char* data, std::size_t len) { text.append(data, len); }, remoteDir, name);
+        return text;
+    }
+
+    // Parallel restores split the file into ranges of this size (whole manifest
+    // leaves): enough ranges that fast sessions pick up a slow one's share,
+    // each long enough to amortize its RETR
+    constexpr std::uint64_t kMinRestoreRange = 4ULL << 20;
+    constexpr std::uint64_t kMaxRestoreRange = 64ULL << 20;
+
+    // Fetch [offset, offset + length) of a remote file into `out` in blocks
+    // of `block` bytes, checking each against the manifest leaf it is
+    void downloadRange(FtpUploader& session, const std::string& remoteDir, const std::string& name,
+                       std::uint64_t offset, std::uint64_t length, std::uint32_t block,
+                       const BackupManifest* manifest, RestoreFile& out, int attempts) {
+        for (int attempt = 1;; ++attempt) {
+            std::vector<char> buf;
+            buf.reserve(block);
+            std::uint64_t pos = offset;   // file offset of buf[0]
+            auto flush = [&] {
+                if (manifest && !manifest->verifyLeaf(static_cast<std::size_t>(pos / block), buf.data(), buf.size())) {
+                    throw std::runtime_error("Bytes " + std::to_string(pos) + "-" + std::to_string(pos + buf.size())
+                                             + " of " + name + " do not match the manifest");
+                }
+                out.writeAt(pos, buf.data(), buf.size());
+                pos += buf.size();
+                buf.clear();
+            };
+            // curl swallows callback exceptions; keep ours for the message
+            std::exception_ptr failure;
+            try {
+                try {
+                    session.downloadStream([&](const char* data, std::size_t len) {
+                                               try {
+                                                   while (len > 0) {
+                                                       std::size_t n = std::min<std::size_t>(len, block - buf.size());
+                                                       buf.insert(buf.end(), data, data + n);
+                                                       data += n;
+                                                       len -= n;
+                                                       if (buf.size() == block) flush();
+                                                   }
+                                               } catch (...) {
+                                                   failure = std::current_exception();
+                                                   throw;
+                                               }
+                                           },
+                                           remoteDir, name, static_cast<std::int64_t>(offset),
+                                           static_cast<std::int64_t>(length));
+                } catch (...) {
+                    if (failure) std::rethrow_exception(failure);
+                    throw;
+                }
+                if (!buf.empty()) flush();
+                if (pos != offset + length) {
+                    throw std::runtime_error("Short download of " + name + ": bytes " + std::to_string(pos) + "-"
+                                             + std::to_string(offset + length) + " missing");
+                }
+                return;
+            } catch (const OperationCancelled&) {
+                throw;
+            } catch (const std::exception& ex) {
+                if (attempt >= attempts) throw;
+                Logger::instance().warn("Range " + std::to_string(offset) + "+" + std::to_string(length) + " of " + name
+                                        + ", attempt " + std::to_string(attempt) + " failed: " + ex.what());
+            }
+        }
+    }
+}
+
+BackupManager::BackupManager(const std::string& sqlitePrefix,
+                             const std::string& ftpHost, int ftpPort,
+                             const std::string& ftpUser, const std::string& ftpPass,
+                             const std::string& ftpDir,
+                             bool sslVerify, int rows, int retries, long timeout)
+    : sqlitePrefix(sqlitePrefix), ftpHost(ftpHost), ftpPort(ftpPort),
+      ftpUser(ftpUser), ftpPass(ftpPass), ftpDir(ftpDir),
+      sslVerify(sslVerify), rows(rows), retries(retries), timeout(timeout) {}
+
+// Out of line so unique_ptr sees the complete SqliteHelper/FtpUploader types
+BackupManager::~BackupManager() {
+    // The check of the last upload uses this object's settings
+    if (verification.valid()) verification.wait();
+}
+
+void BackupManager::setJournal(const std::string& path) {
+    journal = std::make_unique<JobJournal>(path);
+}
+
+void BackupManager::setBackgroundIo(const BackgroundIoPolicy& policy) {
+    backgroundIo = policy;
+    if (dbHelper) dbHelper->setBackgroundIo(policy);
+}
+
+SqliteHelper& BackupManager::database() {
+    if (!dbHelper) {
+        dbHelper = std::make_unique<SqliteHelper>(sqlitePrefix);
+        dbHelper->setBackgroundIo(backgroundIo);
+        dbHelper->createTable();
+    }
+    return *dbHelper;
+}
+
+std::unique_ptr<FtpUploader> BackupManager::makeUploader(const CancellationToken* cancel) const {
+    auto session = std::make_unique<FtpUploader>(ftpHost, ftpPort, ftpUser, ftpPass);
+    session->setRetries(retries);
+    session->setTimeout(timeout);
+    session->setSslVerify(sslVerify);
+    session->setUseTls(ftpTls);
+    session->setCancellationToken(cancel);
+    return session;
+}
+
+FtpUploader& BackupManager::ftp() {
+    if (!uploader) {
+        uploader = makeUploader(runCancel);
+        uploader->enableVerbose(true);
+
+        uploader->setProgressCallback([](double, double, double ultotal, double ulnow) {
+            if (ultotal > 0) {
+                int percent = static_cast<int>((ulnow / ultotal) * 100.0);
+                Logger::instance().debug("Upload progress: " + std::to_string(percent) + "%");
+            }
+        });
+    }
+    return *uploader;
+}
+
+bool BackupManager::run() {
+    static MetricsRegistry& m = MetricsRegistry::instance();
+    static Counter& runs = m.counter("sqliteftpbackup_backup_runs_total", "Backup runs started");
+    static Counter& failures = m.counter("sqliteftpbackup_backup_failures_total", "Backup runs that failed");
+    static Histogram& duration = m.histogram("sqliteftpbackup_backup_duration_seconds", "Wall time of one backup run");
+    static Gauge& lastSuccess = m.gauge("sqliteftpbackup_backup_last_success_timestamp_seconds",
+                                        "Unix time of the last successful backup");
+    static HdrHistogram& runLatency = LatencyStats::instance().histogram("backup_run");
+
+    ++runCount;
+    runs.inc();
+    auto start = std::chrono::steady_clock::now();
+
+    // Everything this run does polls one token: the stop token or the deadline fires it
+    CancellationToken cancel(stopToken);
+    if (maxRunDuration.count() > 0) cancel.setDeadline(start + maxRunDuration);
+    runCancel = &cancel;
+    if (uploader) uploader->setCancellationToken(&cancel);
+    bool ok;
+    {
+        TraceSpan span("backup_run", "backup", "run", static_cast<std::int64_t>(runCount));
+        ok = runOnce();
+    }
+    runCancel = nullptr;
+    if (uploader) uploader->setCancellationToken(nullptr);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    duration.observe(std::chrono::duration<double>(elapsed).count());
+    runLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    if (ok) {
+        lastSuccess.set(std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count());
+    } else {
+        failures.inc();
+    }
+    // Cumulative since start-up, so a daemon's summary covers all runs
+    LatencyStats::instance().logSummary();
+    PerfCounters::instance().logSummary();
+    return ok;
+}
+
+bool BackupManager::runOnce() {
+    Logger& log = Logger::instance();
+    try {
+        std::filesystem::create_directories("logs");
+
+        log.setLevel(logLevel);
+
+        // An interrupted job takes this run's slot: finish it first
+        if (journal && resumeUnfinishedJob()) return true;
+
+        SqliteHelper& db = database();
+        if (rows > 0) {
+            db.insertRandomRows(rows);
+            log.info("Total rows after insert: " + std::to_string(db.getRowCount()));
+        }
+        if (runCancel) runCancel->throwIfCancelled();
+
+        // Read before the snapshot, so a commit racing the backup makes the next run copy it
+        std::optional<ChangeStamp> stamp;
+        if (skipUnchanged) {
+            static Counter& skipped = MetricsRegistry::instance().counter(
+                "sqliteftpbackup_backup_skipped_total", "Runs skipped because the database had not changed");
+            const auto start = std::chrono::steady_clock::now();
+            stamp = SqliteHelper::changeStamp(db.getDbPath());
+            const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            if (stamp && lastBackupStamp && *stamp == *lastBackupStamp) {
+                skipped.inc();
+                log.info("Database unchanged since the last backup (change counter " + std::to_string(stamp->changeCounter)
+                         + ", " + std::to_string(stamp->pageCount) + " pages, checked in " + std::to_string(micros)
+                         + " us): run skipped");
+                return true;
+            }
+            if (!stamp) log.info("Cannot tell whether the database changed (WAL index busy or unreadable): backing up");
+        }
+
+
+        const std::string snapshotName = sqlitePrefix + "_backup_" + currentTimestamp() + ".sqlite";
+        std::string dumpFile = snapshotName;
+        const std::string remoteName = remoteNameFor(dumpFile);
+        std::int64_t jobId = journal ? journal->begin(db.getDbPath()) : 0;
+
+        // Without a journal nothing needs the snapshot after this run: keep
+        // it in an anonymous spill file that cannot leak
+        std::unique_ptr<SpillFile> spill;
+        if (!journal) {
+            std::error_code ec;
+            auto sourceSize = std::filesystem::file_size(db.getDbPath(), ec);
+            spill = SpillFile::create(spillPolicy, ec ? 0 : static_cast<std::uint64_t>(sourceSize), remoteName);
+            dumpFile = spill->path();
+            log.info(std::string("Snapshot spill location: ") + SpillFile::kindToString(spill->kind()));
+        }
+        TempFileRemover remover(spill ? std::string() : dumpFile, journal != nullptr);
+
+        if (compactSnapshots) {
+            db.vacuumToFile(dumpFile, runCancel);
+        } else {
+            db.backupToFile(dumpFile, runCancel);
+        }
+        log.info("Database binary backup created at: " + dumpFile);
+
+        // Incremental mode uploads only the pages changed since the last
+        // backup, unless this run is due for a full one
+        std::string uploadFile = dumpFile;
+        std::string uploadName = remoteName;
+        std::int64_t parentId = 0;
+        PageMap pages;
+        std::unique_ptr<SpillFile> deltaSpill;
+        std::unique_ptr<TempFileRemover> deltaRemover;
+        if (fullBackupEvery > 0) {
+            auto base = deltaBase();
+            // A changed page size (VACUUM with a new page_size) rewrites every page anyway
+            if (base && base->second.pageSize != PageDelta::pageSize(dumpFile)) base.reset();
+            if (base) {
+                const std::string deltaName = snapshotName + PageDelta::kSuffix;
+                uploadName = remoteNameFor(deltaName);
+                if (journal) {
+                    uploadFile = deltaName;
+                    deltaRemover = std::make_unique<TempFileRemover>(uploadFile, true);
+                } else {
+                    deltaSpill = SpillFile::create(spillPolicy, std::filesystem::file_size(dumpFile) / 4, uploadName);
+                    uploadFile = deltaSpill->path();
+                }
+                PageDeltaStats stats = PageDelta::write(dumpFile, base->second, uploadFile, pages);
+                parentId = base->first;
+                log.info("Page delta against backup #" + std::to_string(parentId) + ": " + std::to_string(stats.changedPages)
+                         + " of " + std::to_string(stats.pages) + " pages changed, " + std::to_string(stats.bytes)
+                         + " bytes");
+            } else {
+                pages = PageDelta::hashPages(dumpFile);
+                log.info("Full backup of " + std::to_string(pages.pageCount()) + " pages starts a new delta chain");
+            }
+        }
+        // The snapshot's table digests are computed while it uploads, for
+        // the check of the uploaded copy
+        std::future<std::vector<TableDigest>> sourceDigests;
+        if (uploadVerification) {
+            sourceDigests = std::async(std::launch::async, [dumpFile] { return SqliteHelper::tableDigests(dumpFile); });
+        }
+        // Fresh for every snapshot, so no two streams share a key and nonce
+        const CipherSalt cipherSalt = encryption.enabled ? ChunkCipher::randomSalt() : CipherSalt{};
+        if (journal) {
+            // A delta replaces the snapshot: only the delta is resumed after a crash
+            if (uploadFile != dumpFile) {
+                if (sourceDigests.valid()) sourceDigests.wait();
+                std::filesystem::remove(dumpFile);
+            }
+            journal->recordSnapshot(jobId, uploadFile,
+                                    static_cast<std::int64_t>(std::filesystem::file_size(uploadFile)),
+                                    fileDigest(checksumAlgorithm, uploadFile),
+                                    encryption.enabled ? std::vector<unsigned char>(cipherSalt.begin(), cipherSalt.end())
+                                                       : std::vector<unsigned char>());
+        }
+
+        log.info("Starting upload to directory: " + ftpDir);
+        std::int64_t catalogId = 0;
+        try {
+            catalogId = uploadSnapshot(uploadFile, uploadName, ftpDir, jobId, 0, cipherSalt, parentId);
+        } catch (const OperationCancelled&) {
+            // A journaled job resumes from the partial file; otherwise it is garbage
+            if (!journal) discardPartialUpload(ftpDir, uploadName);
+            throw;
+        }
+        log.info("Upload finished successfully.");
+        if (stamp) {
+            lastBackupStamp = std::make_unique<ChangeStamp>(*stamp);
+        } else {
+            lastBackupStamp.reset();
+        }
+        if (uploadVerification) startVerification(uploadName, catalogId, parentId > 0, sourceDigests);
+        if (fullBackupEvery > 0) {
+            // Without a catalog row the next delta would have no parent: the next run is full
+            try {
+                if (catalogId > 0) {
+                    pages.save(pageMapPath(), catalogId);
+                } else {
+                    std::filesystem::remove(pageMapPath());
+                }
+            } catch (const std::exception& ex) {
+                log.warn(std::string("Could not save the page map; the next backup is full: ") + ex.what());
+            }
+        }
+
+    } catch (const OperationCancelled& ex) {
+        static Counter& cancellations = MetricsRegistry::instance().counter(
+            "sqliteftpbackup_backup_cancellations_total", "Backup runs stopped by a signal or their deadline");
+        cancellations.inc();
+        Logger::instance().warn(std::string("Backup stopped: ") + ex.what()
+                                + (journal ? " (the job will resume on the next run)" : ""));
+        uploader.reset();
+        return false;
+    } catch (const std::exception& ex) {
+        Logger::instance().error("Exception during backup/upload: " + std::string(ex.what()));
+        // Drop the FTP session: the control connection may be in an unknown state
+        uploader.reset();
+        return false;
+    } catch (...) {
+        Logger::instance().error("Unknown exception during backup/upload.");
+        uploader.reset();
+        return false;
+    }
+    return true;
+}
+
+void BackupManager::discardPartialUpload(const std::string& remoteDir, const std::string& remoteName) {
+    // The aborted session may be mid-command; a fresh one without the fired token
+    uploader.reset();
+    try {
+        FtpUploader& cleanup = ftp();
+        cleanup.setCancellationToken(nullptr);
+        if (cleanup.getRemoteFileSize(remoteDir, remoteName) >= 0) cleanup.deleteRemoteFile(remoteDir, remoteName);
+    } catch (const std::exception& ex) {
+        Logger::instance().warn("Could not remove partial upload " + remoteName + ": " + ex.what());
+    }
+}
+
+bool BackupManager::resumeUnfinishedJob() {
+    Logger& log = Logger::instance();
+    auto job = journal->findUnfinished();
+    if (!job) return false;
+
+    log.info("Found unfinished job #" + std::to_string(job->id) + " at stage '"
+             + JobJournal::stageToString(job->stage) + "' for " + job->sourceDb);
+
+    // Keep backing up the same database instead of creating a new one
+    if (!dbHelper && std::filesystem::exists(job->sourceDb)) {
+        dbHelper = std::make_unique<SqliteHelper>(job->sourceDb, false);
+        dbHelper->setBackgroundIo(backgroundIo);
+        dbHelper->createTable();
+    }
+
+    std::error_code ec;
+    bool artifactUsable = job->stage != JobStage::Started && !job->artifact.empty()
+                          && std::filesystem::exists(job->artifact, ec)
+                          && static_cast<std::int64_t>(std::filesystem::file_size(job->artifact, ec)) == job->artifactSize;
+    if (!artifactUsable) {
+        // Crashed before the snapshot was complete: nothing durable to resume from
+        if (!job->artifact.empty()) std::filesystem::remove(job->artifact, ec);
+        journal->markAbandoned(job->id);
+        log.warn("Job #" + std::to_string(job->id) + " has no usable snapshot; starting a new backup");
+        return false;
+    }
+
+    const std::string remoteDir = job->remoteDir.empty() ? ftpDir : job->remoteDir;
+    const std::string name = remoteNameFor(job->artifact);
+
+    // A delta was written against the page map, which is only replaced after its upload
+    std::int64_t parentId = 0;
+    if (PageDelta::isDeltaName(name)) {
+        auto base = PageMap::load(pageMapPath());
+        if (!base) {
+            // Without its parent the delta cannot be restored; the next backup is full anyway
+            std::filesystem::remove(job->artifact, ec);
+            journal->markAbandoned(job->id);
+            discardPartialUpload(remoteDir, name);
+            log.warn("Job #" + std::to_string(job->id) + " uploads delta " + name
+                     + ", but the page map of its parent is gone; starting a new full backup");
+            return false;
+        }
+        parentId = base->first;
+    }
+
+    TraceSpan span("resume_job", "backup", "job", job->id);
+    TempFileRemover remover(job->artifact, true);
+    const std::int64_t uploadSize = encryption.enabled
+        ? static_cast<std::int64_t>(ChunkCipher::encryptedSize(static_cast<std::uint64_t>(job->artifactSize),
+                                                               encryption.frameSize))
+        : job->artifactSize;
+
+    // Appending a snapshot that changed since it was journaled would corrupt the partial upload
+    if (fileDigest(labelAlgorithm(job->artifactDigest), job->artifact) != job->artifactDigest) {
+        std::filesystem::remove(job->artifact, ec);
+        journal->markAbandoned(job->id);
+        discardPartialUpload(remoteDir, name);
+        log.warn("Job #" + std::to_string(job->id) + " snapshot " + job->artifact
+                 + " no longer matches its journaled digest; starting a new backup");
+        return false;
+    }
+
+    // The server is authoritative for how much actually arrived
+    std::int64_t offset = ftp().getRemoteFileSize(remoteDir, name);
+    if (offset < 0 || offset > uploadSize) offset = 0;
+    log.info("Resuming upload of " + name + " at byte " + std::to_string(offset)
+             + " of " + std::to_string(uploadSize));
+
+    // Re-encrypt with the salt the partial upload was encrypted with
+    CipherSalt cipherSalt{};
+    if (encryption.enabled) {
+        if (job->cipherSalt.size() == cipherSalt.size()) {
+            std::copy(job->cipherSalt.begin(), job->cipherSalt.end(), cipherSalt.begin());
+        } else {
+            // Journaled while encryption was off: nothing encrypted to continue
+            log.warn("Salt of " + name + " is unknown; restarting its upload from byte 0");
+            cipherSalt = ChunkCipher::randomSalt();
+            offset = 0;
+            journal->recordSnapshot(job->id, job->artifact, job->artifactSize, job->artifactDigest,
+                                    std::vector<unsigned char>(cipherSalt.begin(), cipherSalt.end()));
+        }
+    }
+
+    uploadSnapshot(job->artifact, name, remoteDir, job->id, offset, cipherSalt, parentId);
+    log.info("Resumed job #" + std::to_string(job->id) + " finished successfully.");
+    return true;
+}
+
+std::string BackupManager::remoteNameFor(const std::string& snapshotFile) const {
+    std::string name = std::filesystem::path(snapshotFile).filename().string();
+    return encryption.enabled ? name + ".enc" : name;
+}
+
+std::int64_t BackupManager::uploadSnapshot(const std::string& snapshotFile, const std::string& filename,
+                                           const std::string& remoteDir, std::int64_t jobId, std::int64_t resumeOffset,
+                                           const CipherSalt& cipherSalt, std::int64_t parentId) {
+    const auto plainSize = static_cast<std::uint64_t>(std::filesystem::file_size(snapshotFile));
+    const int attempts = std::max(1, retries);
+    if (chunkedStorage && encryption.enabled) {
+        throw std::runtime_error("Chunked storage cannot be combined with encryption");
+    }
+    // A chunked upload has no partial remote file: deduplication is its resume
+    if (chunkedStorage) resumeOffset = 0;
+
+    // One salt per snapshot, so every attempt (and a resume after a crash)
+    // produces the bytes already on the server
+    std::unique_ptr<ChunkCipher> cipher;
+    std::size_t chunkSize = pipelineChunkSize;
+    if (encryption.enabled) {
+        cipher = std::make_unique<ChunkCipher>(encryption, plainSize, cipherSalt);
+        // Pipeline chunks must hold whole frames
+        chunkSize = (std::max<std::size_t>(chunkSize, 1) + encryption.frameSize - 1) / encryption.frameSize
+                    * encryption.frameSize;
+        Logger::instance().info(std::string("Encrypting upload with ") + ChunkCipher::algorithmName(encryption.algorithm)
+                                + ", " + std::to_string(encryption.frameSize) + "-byte frames");
+    }
+    const auto size = static_cast<std::int64_t>(cipher ? ChunkCipher::encryptedSize(plainSize, encryption.frameSize)
+                                                       : plainSize);
+
+    for (int attempt = 1;; ++attempt) {
+        TraceSpan attemptSpan("upload_attempt", "backup", "attempt", attempt);
+        if (attempt > 1 && !chunkedStorage) {
+            // Continue a partially transferred file instead of resending it
+            std::int64_t remote = ftp().getRemoteFileSize(remoteDir, filename);
+            resumeOffset = (remote > 0 && remote <= size) ? remote : 0;
+        }
+        Logger::instance().info("FTP upload attempt " + std::to_string(attempt) + " for " + filename
+                                + (resumeOffset > 0 ? " from byte " + std::to_string(resumeOffset) : ""));
+        if (journal) journal->recordUploadProgress(jobId, remoteDir, filename, resumeOffset);
+
+        // read → [encrypt →] hash → upload. The whole file is always read so
+        // the digest covers the uploaded bytes without a second pass; bytes
+        // already on the server are skipped before the upload.
+        std::unique_ptr<Checksum> checksum = Checksum::create(checksumAlgorithm);
+        std::unique_ptr<BackupManifest> manifest;
+        if (manifestLeafSize > 0 && !chunkedStorage) manifest = std::make_unique<BackupManifest>(checksumAlgorithm, manifestLeafSize);
+        BackupPipeline pipeline(pipelineDepth);
+        pipeline.setSource("read", BackupPipeline::fileSource(snapshotFile, chunkSize));
+        if (cipher) {
+            pipeline.addStage("encrypt", [&cipher](PipelineChunk& chunk) { cipher->encryptChunk(chunk); });
+        }
+        pipeline.addStage("hash", [&checksum](PipelineChunk& chunk) {
+            checksum->update(chunk.data.data(), chunk.data.size());
+        });
+        if (manifest) {
+            pipeline.addStage("manifest", [&manifest](PipelineChunk& chunk) {
+                manifest->update(chunk.data.data(), chunk.data.size());
+            });
+        }
+        ChunkRecipe recipe;
+        if (chunkedStorage) {
+            pipeline.setSink("chunk", [this, &remoteDir, &recipe](PipelineReader& in) {
+                uploadChunks(in, remoteDir, recipe);
+            });
+        } else {
+            pipeline.setSink("upload", [this, &filename, &remoteDir, size, resumeOffset, jobId](PipelineReader& in) {
+                std::vector<char> skip(64 * 1024);
+                for (std::int64_t left = resumeOffset; left > 0;) {
+                    std::size_t n = in.read(skip.data(), static_cast<std::size_t>(std::min<std::int64_t>(left, skip.size())));
+                    if (n == 0) throw std::runtime_error("Snapshot shorter than resume offset");
+                    left -= static_cast<std::int64_t>(n);
+                }
+
+                std::int64_t sent = resumeOffset;
+                std::int64_t nextCheckpoint = sent + kCheckpointBytes;
+                ftp().uploadStream([&](char* buf, std::size_t len) {
+                                       if (runCancel) runCancel->throwIfCancelled();
+                                       std::size_t n = in.read(buf, len);
+                                       sent += static_cast<std::int64_t>(n);
+                                       if (journal && sent >= nextCheckpoint) {
+                                           journal->recordUploadProgress(jobId, remoteDir, filename, sent);
+                                           nextCheckpoint = sent + kCheckpointBytes;
+                                       }
+                                       return n;
+                                   },
+                                   remoteDir, filename, size - resumeOffset, resumeOffset > 0);
+            });
+        }
+
+        try {
+            if (runCancel) runCancel->throwIfCancelled();
+            {
+                PerfPhase perf("upload");
+                perf.addBytes(static_cast<std::uint64_t>(size));
+                pipeline.run();
+            }
+            pipelineStats = pipeline.getStats();
+            pipeline.logStats();
+            TaskScheduler::instance().logStats();
+
+            if (resumeOffset > 0) {
+                std::int64_t remote = ftp().getRemoteFileSize(remoteDir, filename);
+                if (remote != size) {
+                    throw std::runtime_error("Resumed upload size mismatch: remote " + std::to_string(remote)
+                                             + " bytes, local " + std::to_string(size));
+                }
+            }
+            if (manifest) {
+                manifest->finish();
+                // The bytes on either side of the resume point are where an
+                // interrupted transfer goes wrong: check just those ranges
+                if (resumeOffset > 0) {
+                    std::vector<std::size_t> boundary{manifest->leafAt(static_cast<std::uint64_t>(resumeOffset - 1))};
+                    std::size_t next = manifest->leafAt(static_cast<std::uint64_t>(resumeOffset));
+                    if (next != boundary.front()) boundary.push_back(next);
+                    if (!findMismatchedLeaves(*manifest, remoteDir, filename, boundary).empty()) {
+                        // Appending again would keep the bad bytes: start over
+                        ftp().deleteRemoteFile(remoteDir, filename);
+                        throw std::runtime_error("Resumed upload differs from the snapshot around byte "
+                                                 + std::to_string(resumeOffset));
+                    }
+                }
+            }
+
+            if (chunkedStorage) {
+                // Written last: a recipe only ever names chunks that are stored
+                const std::string text = recipe.serialize();
+                uploadBuffer(ftp(), text.data(), text.size(), remoteDir, ChunkRecipe::recipeNameFor(filename));
+            }
+
+            if (journal) journal->markDone(jobId, checksum->label());
+            Logger::instance().info("Uploaded " + filename + " " + Checksum::algorithmName(checksumAlgorithm)
+                                    + "=" + checksum->hex() + " (" + checksum->implementation() + ")");
+            if (manifest) {
+                uploadManifest(*manifest, remoteDir, filename);
+                // Ciphertext differs everywhere between backups, so only plain uploads have a
+                // delta; a page delta is not comparable with the snapshots around it
+                if (parentId == 0) {
+                    if (!cipher) reportDelta(*manifest);
+                    previousManifest = std::move(manifest);
+                }
+            }
+            std::int64_t catalogId = 0;
+            if (!catalogPath.empty()) {
+                CatalogEntry entry;
+                entry.dbId = catalogDbId();
+                entry.createdAt = unixWriteTime(snapshotFile);
+                entry.size = static_cast<std::int64_t>(plainSize);
+                entry.hash = checksum->label();
+                entry.remoteDir = remoteDir;
+                entry.remoteName = filename;
+                entry.format = parentId > 0 ? BackupFormat::Delta
+                               : chunkedStorage ? BackupFormat::Chunked
+                               : cipher ? BackupFormat::Encrypted : BackupFormat::Plain;
+                entry.parentId = parentId;
+                catalogId = recordInCatalog(entry);
+            }
+            return catalogId;
+        } catch (const OperationCancelled&) {
+            pipelineStats = pipeline.getStats();
+            throw;
+        } catch (const std::exception& ex) {
+            pipelineStats = pipeline.getStats();
+            if (attempt >= attempts) throw;
+            Logger::instance().warn("Upload attempt " + std::to_string(attempt) + " failed: " + ex.what());
+            // Exponential backoff: base 500ms * 2^(attempt-1)
+            TraceSpan backoffSpan("upload_backoff", "backup");
+            const long long delayMs = 500LL << std::min(attempt - 1, 6);
+            SFB_PROBE2(retry, attempt, delayMs);
+            LatencyTimer delayTimer(LatencyStats::instance().histogram("retry_delay"));
+            if (runCancel) {
+                runCancel->sleepFor(std::chrono::milliseconds(delayMs));
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+            }
+        }
+    }
+}
+
+void BackupManager::uploadManifest(const BackupManifest& manifest, const std::string& remoteDir,
+                                   const std::string& remoteName) {
+    // The backup is complete without it, so a failure only costs range checks
+    const std::string text = manifest.serialize();
+    const std::string name = BackupManifest::manifestNameFor(remoteName);
+    try {
+        uploadBuffer(ftp(), text.data(), text.size(), remoteDir, name);
+        Logger::instance().info("Uploaded manifest " + name + ": " + std::to_string(manifest.leafCount())
+                                + " ranges, root " + manifest.rootHex());
+    } catch (const OperationCancelled&) {
+        throw;
+    } catch (const std::exception& ex) {
+        Logger::instance().warn("Could not upload manifest " + name + ": " + ex.what());
+    }
+}
+
+void BackupManager::reportDelta(const BackupManifest& manifest) {
+    if (!previousManifest || previousManifest->algorithm() != manifest.algorithm()
+        || previousManifest->leafSize() != manifest.leafSize()) {
+        return;
+    }
+    std::uint64_t changedBytes = 0;
+    std::vector<std::size_t> changed = manifest.diff(*previousManifest);
+    for (std::size_t leaf : changed) changedBytes += manifest.leafRange(leaf).second;
+    Logger::instance().info("Changed since previous backup: " + std::to_string(changed.size()) + " of "
+                            + std::to_string(manifest.leafCount()) + " ranges ("
+                            + std::to_string(changedBytes) + " bytes)");
+}
+
+std::vector<std::size_t> BackupManager::findMismatchedLeaves(const BackupManifest& manifest,
+                                                             const std::string& remoteDir,
+                                                             const std::string& remoteName,
+                                                             const std::vector<std::size_t>& leaves) {
+    TraceSpan span("verify_ranges", "backup", "leaves", static_cast<std::int64_t>(leaves.size()));
+    std::vector<std::size_t> mismatched;
+    std::vector<char> buf;
+    buf.reserve(manifest.leafSize());
+
+    // Consecutive leaves are fetched with one ranged download and checked
+    // one leaf at a time as the bytes arrive
+    for (std::size_t i = 0; i < leaves.size();) {
+        std::size_t j = i + 1;
+        while (j < leaves.size() && leaves[j] == leaves[j - 1] + 1) ++j;
+        const std::uint64_t begin = manifest.leafRange(leaves[i]).first;
+        const auto last = manifest.leafRange(leaves[j - 1]);
+        const std::uint64_t length = last.first + last.second - begin;
+
+        std::size_t leaf = leaves[i];
+        buf.clear();
+        auto checkLeaf = [&] {
+            if (!manifest.verifyLeaf(leaf, buf.data(), buf.size())) mismatched.push_back(leaf);
+            buf.clear();
+            ++leaf;
+        };
+        if (length > 0) {
+            ftp().downloadStream([&](const char* data, std::size_t len) {
+                                     // Bytes past the requested range (a server ignoring the cut-off) are dropped
+                                     while (len > 0 && leaf <= leaves[j - 1]) {
+                                         std::size_t want = manifest.leafRange(leaf).second - buf.size();
+                                         std::size_t n = std::min(len, want);
+                                         buf.insert(buf.end(), data, data + n);
+                                         data += n;
+                                         len -= n;
+                                         if (buf.size() == manifest.leafRange(leaf).second) checkLeaf();
+                                     }
+                                 },
+                                 remoteDir, remoteName, static_cast<std::int64_t>(begin),
+                                 static_cast<std::int64_t>(length));
+        }
+        // Whatever did not arrive in full (a short file) is a mismatch too
+        while (leaf < leaves[j - 1] + 1) checkLeaf();
+        i = j;
+    }
+    return mismatched;
+}
+
+bool BackupManager::verifyRemote(const std::string& remoteName, std::size_t sampleLeaves) {
+    Logger& log = Logger::instance();
+    log.setLevel(logLevel);
+    TraceSpan span("verify_backup", "backup");
+    try {
+        BackupManifest manifest = BackupManifest::parse(
+            downloadText(ftp(), ftpDir, BackupManifest::manifestNameFor(remoteName)));
+
+        std::int64_t remoteSize = ftp().getRemoteFileSize(ftpDir, remoteName);
+        if (remoteSize != static_cast<std::int64_t>(manifest.fileSize())) {
+            log.error("Remote " + remoteName + " is " + std::to_string(remoteSize) + " bytes, manifest says "
+                      + std::to_string(manifest.fileSize()));
+            return false;
+        }
+
+        // A sample is spread evenly over the file from a random start and
+        // always includes the last leaf, where truncation shows
+        std::vector<std::size_t> leaves;
+        const std::size_t count = manifest.leafCount();
+        if (sampleLeaves == 0 || sampleLeaves >= count) {
+            for (std::size_t i = 0; i < count; ++i) leaves.push_back(i);
+        } else {
+            const std::size_t stride = count / sampleLeaves;
+            std::mt19937_64 rng(std::random_device{}());
+            for (std::size_t i = rng() % stride; i < count && leaves.size() + 1 < sampleLeaves; i += stride) {
+                leaves.push_back(i);
+            }
+            if (leaves.empty() || leaves.back() != count - 1) leaves.push_back(count - 1);
+        }
+
+        std::vector<std::size_t> bad = findMismatchedLeaves(manifest, ftpDir, remoteName, leaves);
+        for (std::size_t leaf : bad) {
+            auto range = manifest.leafRange(leaf);
+            log.error("Range mismatch in " + remoteName + ": bytes " + std::to_string(range.first) + "-"
+                      + std::to_string(range.first + range.second));
+        }
+        log.info("Verified " + std::to_string(leaves.size()) + " of " + std::to_string(count) + " ranges of "
+                 + remoteName + ": " + (bad.empty() ? "all match" : std::to_string(bad.size()) + " differ"));
+        return bad.empty();
+    } catch (const std::exception& ex) {
+        log.error("Verification of " + remoteName + " failed: " + ex.what());
+        uploader.reset();
+        return false;
+    }
+}
+
+void BackupManager::uploadChunks(PipelineReader& in, const std::string& remoteDir, ChunkRecipe& recipe) {
+    static MetricsRegistry& m = MetricsRegistry::instance();
+    static Counter& uploadedChunks = m.counter("sqliteftpbackup_chunk_uploads_total",
+                                               "Chunks uploaded to the remote chunk store");
+    static Counter& dedupBytes = m.counter("sqliteftpbackup_chunk_dedup_bytes_total",
+                                           "Bytes not uploaded because their chunk was already stored");
+
+    // Re-read every run: a garbage collection may have pruned the store since
+    ChunkIndex index;
+    const std::string indexDir = ChunkIndex::indexDir(remoteDir);
+    if (ftp().getRemoteFileSize(indexDir, ChunkIndex::kIndexName) >= 0) {
+        index.load(downloadText(ftp(), indexDir, ChunkIndex::kIndexName));
+    }
+
+    ContentChunker chunker(chunking);
+    const std::size_t window = chunker.params().maxSize;
+    std::vector<unsigned char> buf(2 * window);
+    std::size_t begin = 0, end = 0;
+    bool eof = false;
+    std::string newIds;
+    std::uint64_t newBytes = 0;
+    std::size_t newChunks = 0;
+    {
+        FtpWorkerPool pool(ftpSessions, [this] { return makeUploader(runCancel); });
+        for (;;) {
+            // cut() must see a whole maximal chunk unless the stream ends first
+            if (!eof && end - begin < window) {
+                std::memmove(buf.data(), buf.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+                while (end < buf.size()) {
+                    std::size_t n = in.read(reinterpret_cast<char*>(buf.data()) + end, buf.size() - end);
+                    if (n == 0) {
+                        eof = true;
+                        break;
+                    }
+                    end += n;
+                }
+            }
+            if (begin == end) break;
+            if (runCancel) runCancel->throwIfCancelled();
+
+            const std::size_t n = chunker.cut(buf.data() + begin, end - begin);
+            std::string id = ChunkIndex::chunkId(buf.data() + begin, n);
+            recipe.chunks.push_back({id, static_cast<std::uint32_t>(n)});
+            recipe.size += n;
+            if (index.add(id)) {
+                auto data = std::make_shared<std::vector<char>>(buf.begin() + begin, buf.begin() + begin + n);
+                const std::string dir = ChunkIndex::chunkDir(remoteDir, id);
+                pool.submit([data, dir, id](FtpUploader& session) {
+                    uploadBuffer(session, data->data(), data->size(), dir, id);
+                });
+                newIds += id + '\n';
+                newBytes += n;
+                ++newChunks;
+            } else {
+                dedupBytes.inc(n);
+            }
+            begin += n;
+        }
+        pool.wait();
+    }
+    uploadedChunks.inc(newChunks);
+
+    // Listed only once every chunk it names is stored
+    if (!newIds.empty()) uploadBuffer(ftp(), newIds.data(), newIds.size(), indexDir, ChunkIndex::kIndexName, true);
+
+    const double saved = recipe.size > 0 ? 100.0 * static_cast<double>(recipe.size - newBytes) / recipe.size : 0.0;
+    std::ostringstream summary;
+    summary << "Chunked upload: " << recipe.chunks.size() << " chunks, " << newChunks << " new (" << newBytes
+            << " of " << recipe.size << " bytes sent, " << std::fixed << std::setprecision(1) << saved
+            << "% deduplicated)";
+    Logger::instance().info(summary.str());
+}
+
+bool BackupManager::restore(const std::string& remoteName, const std::string& outputFile) {
+    return restoreBackup(ftpDir, remoteName, std::nullopt, outputFile);
+}
+
+bool BackupManager::restore(const CatalogEntry& entry, const std::string& outputFile) {
+    return restoreBackup(entry.remoteDir, entry.remoteName, entry, outputFile);
+}
+
+bool BackupManager::restoreBackup(const std::string& remoteDir, const std::string& remoteName,
+                                  const std::optional<CatalogEntry>& entry, const std::string& outputFile) {
+    Logger& log = Logger::instance();
+    log.setLevel(logLevel);
+    TraceSpan span("restore_backup", "backup");
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        std::uint64_t bytes;
+        if (PageDelta::isDeltaName(remoteName)) {
+            // A delta is only a restore point together with its parents
+            if (catalogPath.empty()) throw std::runtime_error(remoteName + " is a page delta: restoring it needs the catalog");
+            auto found = entry ? entry : catalog().find(remoteDir, remoteName);
+            if (!found) throw std::runtime_error(remoteName + " is not in the backup catalog");
+            bytes = restoreChain(ftp(), catalog().chain(found->id), outputFile);
+        } else {
+            bytes = fetchBackup(ftp(), remoteDir, remoteName, outputFile);
+        }
+
+        const std::string check = SqliteHelper::checkIntegrity(outputFile);
+        if (check != "ok") throw std::runtime_error("quick_check of the restored database failed: " + check);
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::ostringstream rate;
+        rate << std::fixed << std::setprecision(1) << (seconds > 0 ? bytes / seconds / (1 << 20) : 0.0);
+        log.info("Restored " + remoteName + " to " + outputFile + ": " + std::to_string(bytes) + " bytes over "
+                 + std::to_string(ftpSessions) + " FTP sessions at " + rate.str() + " MiB/s, quick_check ok");
+        return true;
+    } catch (const std::exception& ex) {
+        log.error("Restore of " + remoteName + " failed: " + ex.what());
+        uploader.reset();
+        std::error_code ec;
+        std::filesystem::remove(outputFile, ec);
+        return false;
+    }
+}
+
+std::uint64_t BackupManager::fetchBackup(FtpUploader& control, const std::string& remoteDir,
+                                         const std::string& remoteName, const std::string& outputFile) {
+    const bool encrypted = remoteName.size() > 4 && remoteName.compare(remoteName.size() - 4, 4, ".enc") == 0;
+    if (encrypted && !encryption.enabled) {
+        throw std::runtime_error(remoteName + " is encrypted: the key file is needed to restore it");
+    }
+    if (control.getRemoteFileSize(remoteDir, ChunkRecipe::recipeNameFor(remoteName)) >= 0) {
+        return restoreChunked(control, remoteDir, remoteName, outputFile);
+    }
+    if (!encrypted) return restoreRanges(control, remoteDir, remoteName, outputFile);
+
+    const std::string cipherFile = outputFile + ".enc.part";
+    TempFileRemover remover(cipherFile);
+    std::uint64_t bytes = restoreRanges(control, remoteDir, remoteName, cipherFile);
+    ChunkCipher::decryptFile(cipherFile, outputFile, encryption.key);
+    return bytes;
+}
+
+std::uint64_t BackupManager::restoreChain(FtpUploader& control, const std::vector<CatalogEntry>& chain,
+                                          const std::string& outputFile) {
+    Logger& log = Logger::instance();
+    if (chain.empty() || chain.front().format == BackupFormat::Delta) {
+        throw std::runtime_error("The backup chain has no full backup to start from");
+    }
+    log.info("Restoring " + chain.back().remoteName + " from " + chain.front().remoteName + " and "
+             + std::to_string(chain.size() - 1) + " page deltas");
+
+    // Depth-one pipeline: one session downloads delta i + 1 (the first one
+    // while the base downloads) as delta i is applied
+    std::unique_ptr<FtpUploader> prefetch = makeUploader(stopToken);
+    auto fetchDelta = [this, &chain, &outputFile, &prefetch](std::size_t i) {
+        return std::async(std::launch::async, [this, &chain, &outputFile, &prefetch, i] {
+            const std::string file = outputFile + ".delta" + std::to_string(i) + ".part";
+            fetchBackup(*prefetch, chain[i].remoteDir, chain[i].remoteName, file);
+            return file;
+        });
+    };
+    std::future<std::string> next;
+    auto removeDeltaFiles = [&chain, &outputFile] {
+        std::error_code ec;
+        for (std::size_t i = 1; i < chain.size(); ++i) {
+            std::filesystem::remove(outputFile + ".delta" + std::to_string(i) + ".part", ec);
+        }
+    };
+
+    std::uint64_t bytes = 0;
+    try {
+        if (chain.size() > 1) next = fetchDelta(1);
+        bytes = fetchBackup(control, chain.front().remoteDir, chain.front().remoteName, outputFile);
+        for (std::size_t i = 1; i < chain.size(); ++i) {
+            const std::string file = next.get();
+            if (i + 1 < chain.size()) next = fetchDelta(i + 1);
+            TempFileRemover remover(file);
+            PageDeltaStats stats = PageDelta::apply(file, outputFile);
+            bytes += stats.bytes;
+            log.info("Applied " + chain[i].remoteName + ": " + std::to_string(stats.changedPages) + " pages in "
+                     + std::to_string(stats.runs) + " runs");
+        }
+    } catch (...) {
+        // Let the download in flight finish before its files are removed
+        if (next.valid()) next.wait();
+        removeDeltaFiles();
+        throw;
+    }
+    return bytes;
+}
+
+std::uint64_t BackupManager::restoreRanges(FtpUploader& control, const std::string& remoteDir,
+                                           const std::string& remoteName, const std::string& outputFile) {
+    Logger& log = Logger::instance();
+    const std::int64_t remoteSize = control.getRemoteFileSize(remoteDir, remoteName);
+    if (remoteSize < 0) throw std::runtime_error(remoteName + " not found in " + remoteDir);
+    const auto size = static_cast<std::uint64_t>(remoteSize);
+
+    // With a manifest each leaf is checked as it arrives, so a bad range is
+    // fetched again instead of failing the whole restore at the end
+    std::unique_ptr<BackupManifest> manifest;
+    const std::string manifestName = BackupManifest::manifestNameFor(remoteName);
+    if (control.getRemoteFileSize(remoteDir, manifestName) >= 0) {
+        manifest = std::make_unique<BackupManifest>(BackupManifest::parse(downloadText(control, remoteDir, manifestName)));
+        if (manifest->fileSize() != size) {
+            throw std::runtime_error(remoteName + " is " + std::to_string(size) + " bytes, its manifest says "
+                                     + std::to_string(manifest->fileSize()));
+        }
+    } else {
+        log.warn("No manifest for " + remoteName + ": only quick_check will verify the restore");
+    }
+
+    const std::uint32_t block = manifest ? manifest->leafSize() : BackupManifest::kDefaultLeafSize;
+    std::uint64_t rangeBytes = std::clamp<std::uint64_t>(size / (std::max<std::size_t>(ftpSessions, 1) * 4),
+                                                         kMinRestoreRange, kMaxRestoreRange);
+    rangeBytes = (rangeBytes + block - 1) / block * block;
+
+    RestoreFile out(outputFile, size);
+    std::size_t ranges = 0;
+    {
+        FtpWorkerPool pool(ftpSessions, [this] { return makeUploader(stopToken); });
+        for (std::uint64_t offset = 0; offset < size; offset += rangeBytes) {
+            const std::uint64_t length = std::min(rangeBytes, size - offset);
+            ++ranges;
+            pool.submit([this, &remoteDir, &remoteName, &manifest, &out, offset, length, block](FtpUploader& session) {
+                downloadRange(session, remoteDir, remoteName, offset, length, block, manifest.get(), out,
+                              std::max(1, retries));
+            });
+        }
+        pool.wait();
+    }
+    out.close();
+    log.info("Downloaded " + remoteName + " in " + std::to_string(ranges) + " ranges of up to "
+             + std::to_string(rangeBytes) + " bytes" + (out.preallocated() ? " into a preallocated file" : "")
+             + (manifest ? ", every range matching the manifest" : ""));
+    return size;
+}
+
+std::uint64_t BackupManager::restoreChunked(FtpUploader& control, const std::string& remoteDir,
+                                            const std::string& remoteName, const std::string& outputFile) {
+    ChunkRecipe recipe = ChunkRecipe::parse(downloadText(control, remoteDir, ChunkRecipe::recipeNameFor(remoteName)));
+
+    // Each distinct chunk is fetched once and written wherever the recipe uses it
+    std::unordered_map<std::string, std::vector<std::uint64_t>> offsets;
+    std::vector<std::string> order;
+    std::uint64_t offset = 0;
+    for (const ChunkRef& chunk : recipe.chunks) {
+        auto& at = offsets[chunk.id];
+        if (at.empty()) order.push_back(chunk.id);
+        at.push_back(offset);
+        offset += chunk.length;
+    }
+
+    RestoreFile out(outputFile, recipe.size);
+    {
+        FtpWorkerPool pool(ftpSessions, [this] { return makeUploader(stopToken); });
+        for (const std::string& id : order) {
+            pool.submit([&, id](FtpUploader& session) {
+                std::vector<char> data;
+                session.downloadStream([&data](const char* p, std::size_t len) { data.insert(data.end(), p, p + len); },
+                                       ChunkIndex::chunkDir(remoteDir, id), id);
+                if (Checksum::hexDigest(recipe.algorithm, data.data(), data.size()) != id) {
+                    throw std::runtime_error("Chunk " + id + " does not match its id");
+                }
+                for (std::uint64_t at : offsets.at(id)) out.writeAt(at, data.data(), data.size());
+            });
+        }
+        pool.wait();
+    }
+    out.close();
+    Logger::instance().info("Fetched " + std::to_string(order.size()) + " distinct chunks of " + remoteName);
+    return recipe.size;
+}
+
+bool BackupManager::collectGarbage(const GcOptions& options) {
+    static MetricsRegistry& m = MetricsRegistry::instance();
+    static Counter& deletedChunks = m.counter("sqliteftpbackup_gc_deleted_chunks_total",
+                                              "Unreferenced chunks deleted by garbage collection");
+    static Counter& freedBytes = m.counter("sqliteftpbackup_gc_freed_bytes_total",
+                                           "Bytes of chunks deleted by garbage collection");
+    Logger& log = Logger::instance();
+    log.setLevel(logLevel);
+    try {
+        FtpWorkerPool pool(ftpSessions, [this] { return makeUploader(runCancel); });
+        GcStats stats = GarbageCollector(ftp(), pool, ftpDir).run(options);
+        if (!options.dryRun) {
+            deletedChunks.inc(stats.chunksDeleted);
+            freedBytes.inc(stats.bytesFreed);
+        }
+        if (!catalogPath.empty() && !stats.deletedBackups.empty()) {
+            try {
+                for (const std::string& name : stats.deletedBackups) catalog().remove(ftpDir, name);
+                syncCatalog();
+            } catch (const std::exception& ex) {
+                log.warn(std::string("Could not update the backup catalog: ") + ex.what());
+            }
+        }
+        return stats.deleteFailures == 0;
+    } catch (const std::exception& ex) {
+        log.error("Garbage collection of " + ftpDir + " failed: " + ex.what());
+        uploader.reset();
+        return false;
+    }
+}
+
+BackupCatalog& BackupManager::catalog() {
+    if (!catalogDb) {
+        if (catalogPath.empty()) throw std::runtime_error("No backup catalog configured");
+        if (!std::filesystem::exists(catalogPath)) pullCatalog();
+        catalogDb = std::make_unique<BackupCatalog>(catalogPath);
+    }
+    return *catalogDb;
+}
+
+std::string BackupManager::catalogDbId() const {
+    // Backup names start with the same file name, so the id survives a move of the prefix directory
+    return std::filesystem::path(sqlitePrefix).filename().string();
+}
+
+std::string BackupManager::pageMapPath() const {
+    return catalogPath + "." + catalogDbId() + ".pages";
+}
+
+std::optional<std::pair<std::int64_t, PageMap>> BackupManager::deltaBase() {
+    // Anything doubtful makes this run a full backup, which is always safe
+    try {
+        auto base = PageMap::load(pageMapPath());
+        if (!base || base->first <= 0) return std::nullopt;
+        // The parent must still be cataloged (GC may have dropped it) and the chain not yet full
+        const std::vector<CatalogEntry> chain = catalog().chain(base->first);
+        if (chain.size() >= fullBackupEvery) return std::nullopt;
+        // A chain is encrypted throughout or not at all, so restoring it never
+        // needs a key the current settings lack
+        for (const CatalogEntry& entry : chain) {
+            const std::string& name = entry.remoteName;
+            const bool encrypted = name.size() > 4 && name.compare(name.size() - 4, 4, ".enc") == 0;
+            if (encrypted != encryption.enabled) return std::nullopt;
+        }
+        return base;
+    } catch (const std::exception& ex) {
+        Logger::instance().warn(std::string("No delta base, taking a full backup: ") + ex.what());
+        return std::nullopt;
+    }
+}
+
+void BackupManager::pullCatalog() {
+    // Not finding the copy means a new store. Failing to fetch it throws:
+    // starting empty would overwrite the copy with the next sync.
+    if (ftp().getRemoteFileSize(ftpDir, BackupCatalog::kRemoteName) < 0) return;
+    const std::string part = catalogPath + ".download";
+    try {
+        std::ofstream out(part, std::ios::binary | std::ios::trunc);
+        ftp().downloadStream([&out](const char* data, std::size_t len) {
+                                 out.write(data, static_cast<std::streamsize>(len));
+                             },
+                             ftpDir, BackupCatalog::kRemoteName);
+        out.close();
+        if (out.fail()) throw std::runtime_error("Write to " + part + " failed");
+        std::filesystem::rename(part, catalogPath);
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove(part, ec);
+        throw;
+    }
+    Logger::instance().info("Backup catalog fetched from " + ftpDir + "/" + BackupCatalog::kRemoteName);
+}
+
+void BackupManager::syncCatalog() {
+    // Uploaded under a temporary name and renamed, so the copy is never torn
+    const std::string exported = catalogPath + ".upload";
+    const std::string part = std::string(BackupCatalog::kRemoteName) + ".part";
+    TempFileRemover remover(exported, false);
+    catalog().exportTo(exported);
+    std::ifstream in(exported, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open " + exported);
+    ftp().uploadStream([&in](char* buf, std::size_t len) {
+                           in.read(buf, static_cast<std::streamsize>(len));
+                           return static_cast<std::size_t>(in.gcount());
+                       },
+                       ftpDir, part, static_cast<std::int64_t>(std::filesystem::file_size(exported)));
+    // Some servers refuse to rename over an existing file
+    if (!ftp().renameRemoteFile(ftpDir, part, BackupCatalog::kRemoteName)) {
+        ftp().deleteRemoteFile(ftpDir, BackupCatalog::kRemoteName);
+        if (!ftp().renameRemoteFile(ftpDir, part, BackupCatalog::kRemoteName)) {
+            throw std::runtime_error("Cannot replace " + std::string(BackupCatalog::kRemoteName) + ": "
+                                     + ftp().getLastError());
+        }
+    }
+}
+
+std::int64_t BackupManager::recordInCatalog(const CatalogEntry& entry) {
+    // The backup is on the server already: a catalog failure must not fail
+    // (and, without a journal, delete) it
+    try {
+        const std::int64_t id = catalog().record(entry);
+        syncCatalog();
+        Logger::instance().info("Recorded " + entry.remoteName + " in the backup catalog");
+        return id;
+    } catch (const std::exception& ex) {
+        Logger::instance().warn(std::string("Could not update the backup catalog: ") + ex.what());
+        return 0;
+    }
+}
+
+bool BackupManager::waitForVerification() {
+    if (verification.valid()) lastVerificationOk = verification.get();
+    return lastVerificationOk;
+}
+
+void BackupManager::startVerification(const std::string& remoteName, std::int64_t catalogId, bool delta,
+                                      std::future<std::vector<TableDigest>>& sourceDigests) {
+    static Counter& failures = MetricsRegistry::instance().counter(
+        "sqliteftpbackup_upload_verification_failures_total", "Uploads whose restored copy failed its check");
+    // One check at a time: the previous upload's finishes first
+    waitForVerification();
+    try {
+        std::vector<TableDigest> source = sourceDigests.get();
+        std::vector<CatalogEntry> chain;
+        if (delta) {
+            if (catalogId <= 0) throw std::runtime_error("the delta is not in the catalog, so its chain is unknown");
+            chain = catalog().chain(catalogId);
+        } else {
+            CatalogEntry entry;
+            entry.remoteDir = ftpDir;
+            entry.remoteName = remoteName;
+            chain.push_back(entry);
+        }
+        // Its own session, tied to the process-wide token rather than this run's
+        std::unique_ptr<FtpUploader> session = makeUploader(stopToken);
+        verification = std::async(std::launch::async,
+                                  [this, session = std::move(session), chain = std::move(chain), source = std::move(source)] {
+                                      bool ok = verifyUpload(*session, chain, source);
+                                      if (!ok) failures.inc();
+                                      return ok;
+                                  });
+        Logger::instance().info("Verifying the upload of " + remoteName + " in the background");
+    } catch (const std::exception& ex) {
+        Logger::instance().error("Cannot verify the upload of " + remoteName + ": " + ex.what());
+        failures.inc();
+        lastVerificationOk = false;
+    }
+}
+
+bool BackupManager::verifyUpload(FtpUploader& session, const std::vector<CatalogEntry>& chain,
+                                 const std::vector<TableDigest>& sourceDigests) {
+    static Counter& verified = MetricsRegistry::instance().counter(
+        "sqliteftpbackup_upload_verifications_total", "Uploads restored into a sandbox and checked");
+    Logger& log = Logger::instance();
+    const std::string& name = chain.back().remoteName;
+    TraceSpan span("verify_upload", "backup");
+    verified.inc();
+
+    // A named file: restores write delta and ciphertext parts next to it
+    const std::filesystem::path dir = spillPolicy.directory.empty() ? std::filesystem::temp_directory_path()
+                                                                    : std::filesystem::path(spillPolicy.directory);
+    const std::string sandbox = (dir / (std::filesystem::path(name).filename().string() + ".verify")).string();
+    TempFileRemover remover(sandbox);
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        if (chain.size() > 1) {
+            restoreChain(session, chain, sandbox);
+        } else {
+            fetchBackup(session, chain.back().remoteDir, name, sandbox);
+        }
+        const char* checkName = fullIntegrityCheck ? "integrity_check" : "quick_check";
+        const std::string check = SqliteHelper::checkIntegrity(sandbox, !fullIntegrityCheck);
+        if (check != "ok") throw std::runtime_error(std::string(checkName) + " of the restored copy failed: " + check);
+
+        std::vector<TableDigest> restored = SqliteHelper::tableDigests(sandbox);
+        std::map<std::string, TableDigest> byTable;
+        for (TableDigest& d : restored) byTable.emplace(d.table, std::move(d));
+        std::size_t mismatches = 0;
+        for (const TableDigest& want : sourceDigests) {
+            auto it = byTable.find(want.table);
+            if (it == byTable.end()) {
+                log.error("Uploaded " + name + " lacks table " + want.table);
+                ++mismatches;
+                continue;
+            }
+            if (!(it->second == want)) {
+                log.error("Table " + want.table + " of uploaded " + name + ": " + std::to_string(it->second.rows)
+                          + " rows, digest " + it->second.checksum + "; snapshot has " + std::to_string(want.rows)
+                          + " rows, digest " + want.checksum);
+                ++mismatches;
+            }
+            byTable.erase(it);
+        }
+        for (const auto& extra : byTable) {
+            log.error("Uploaded " + name + " has table " + extra.first + ", which the snapshot lacks");
+            ++mismatches;
+        }
+        if (mismatches > 0) {
+            log.error("Verification of uploaded " + name + ": " + std::to_string(mismatches) + " of "
+                      + std::to_string(sourceDigests.size()) + " tables differ from the snapshot");
+            return false;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::ostringstream took;
+        took << std::fixed << std::setprecision(1) << seconds;
+        log.info("Verified uploaded " + name + ": " + checkName + " ok, " + std::to_string(sourceDigests.size())
+                 + " tables match the snapshot (" + took.str() + "s)");
+        return true;
+    } catch (const std::exception& ex) {
+        log.error("Verification of uploaded " + name + " failed: " + ex.what());
+        return false;
+    }
+}
+
+std::vector<CatalogEntry> BackupManager::findBackup(std::optional<std::int64_t> atOrBefore) {
+    auto entry = catalog().latest(catalogDbId(), atOrBefore);
+    if (!entry) return {};
+    return catalog().chain(entry->id);
+}
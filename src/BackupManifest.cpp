@@ -0,0 +1,242 @@
+#include "BackupManifest.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    // Domain separation: a leaf can never collide with an inner node
+    constexpr unsigned char kLeafPrefix = 0x00;
+    constexpr unsigned char kNodePrefix = 0x01;
+
+    constexpr const char* kMagic = "sqliteftpbackup-manifest 1";
+
+    std::string toHex(const BackupManifest::Digest& digest) {
+        static const char* digits = "0123456789abcdef";
+        std::string out;
+        out.reserve(digest.size() * 2);
+        for (unsigned char b : digest) {
+            out += digits[b >> 4];
+            out += digits[b & 0x0f];
+        }
+        return out;
+    }
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    BackupManifest::Digest fromHex(const std::string& hex) {
+        if (hex.empty() || hex.size() % 2 != 0) throw std::runtime_error("Malformed manifest digest: " + hex);
+        BackupManifest::Digest out(hex.size() / 2);
+        for (std::size_t i = 0; i < out.size(); ++i) {
+            int hi = hexValue(hex[2 * i]);
+            int lo = hexValue(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) throw std::runtime_error("Malformed manifest digest: " + hex);
+            out[i] = static_cast<unsigned char>(hi << 4 | lo);
+        }
+        return out;
+    }
+
+    // "key value" line; throws if the key does not match
+    std::string field(std::istream& in, const std::string& key) {
+        std::string line;
+        if (!std::getline(in, line) || line.compare(0, key.size() + 1, key + " ") != 0) {
+            throw std::runtime_error("Malformed manifest: expected '" + key + "'");
+        }
+        return line.substr(key.size() + 1);
+    }
+
+    std::uint64_t number(const std::string& text, const std::string& key) {
+        try {
+            std::size_t used = 0;
+            unsigned long long value = std::stoull(text, &used);
+            if (used == text.size()) return value;
+        } catch (const std::exception&) {}
+        throw std::runtime_error("Malformed manifest: bad " + key + " '" + text + "'");
+    }
+}
+
+BackupManifest::BackupManifest(ChecksumAlgorithm algorithm, std::uint32_t leafSize)
+    : algo(algorithm), leafBytes(leafSize) {
+    if (leafSize == 0) throw std::invalid_argument("Manifest leaf size must be positive");
+    levels.emplace_back();
+}
+
+BackupManifest::Digest BackupManifest::hashLeaf(const void* data, std::size_t len) const {
+    auto h = Checksum::create(algo);
+    h->update(&kLeafPrefix, 1);
+    h->update(data, len);
+    return h->digest();
+}
+
+void BackupManifest::update(const void* data, std::size_t len) {
+    if (finished) throw std::logic_error("BackupManifest::update after finish");
+    const auto* p = static_cast<const unsigned char*>(data);
+    size += len;
+    while (len > 0) {
+        if (!current) {
+            current = Checksum::create(algo);
+            current->update(&kLeafPrefix, 1);
+            currentBytes = 0;
+        }
+        auto n = static_cast<std::size_t>(std::min<std::uint64_t>(len, leafBytes - currentBytes));
+        current->update(p, n);
+        currentBytes += n;
+        p += n;
+        len -= n;
+        if (currentBytes == leafBytes) sealLeaf();
+    }
+}
+
+void BackupManifest::sealLeaf() {
+    levels.front().push_back(current->digest());
+    current.reset();
+    currentBytes = 0;
+}
+
+void BackupManifest::finish() {
+    if (finished) return;
+    // An empty file still has one (empty) leaf, so every manifest has a root
+    if (current) {
+        sealLeaf();
+    } else if (levels.front().empty()) {
+        levels.front().push_back(hashLeaf(nullptr, 0));
+    }
+    buildTree();
+    finished = true;
+}
+
+void BackupManifest::buildTree() {
+    levels.resize(1);
+    while (levels.back().size() > 1) {
+        const std::vector<Digest>& below = levels.back();
+        std::vector<Digest> above;
+        above.reserve((below.size() + 1) / 2);
+        for (std::size_t i = 0; i + 1 < below.size(); i += 2) {
+            auto h = Checksum::create(algo);
+            h->update(&kNodePrefix, 1);
+            h->update(below[i].data(), below[i].size());
+            h->update(below[i + 1].data(), below[i + 1].size());
+            above.push_back(h->digest());
+        }
+        if (below.size() % 2 != 0) above.push_back(below.back());
+        levels.push_back(std::move(above));
+    }
+}
+
+BackupManifest BackupManifest::fromFile(const std::string& path, ChecksumAlgorithm algorithm,
+                                        std::uint32_t leafSize) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open " + path);
+    BackupManifest manifest(algorithm, leafSize);
+    std::vector<char> buf(1 << 20);
+    while (in) {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        if (in.gcount() > 0) manifest.update(buf.data(), static_cast<std::size_t>(in.gcount()));
+    }
+    if (in.bad()) throw std::runtime_error("Read error on " + path);
+    manifest.finish();
+    return manifest;
+}
+
+std::string BackupManifest::rootHex() const {
+    return toHex(root());
+}
+
+std::pair<std::uint64_t, std::uint64_t> BackupManifest::leafRange(std::size_t index) const {
+    std::uint64_t offset = static_cast<std::uint64_t>(index) * leafBytes;
+    if (offset > size) return {size, 0};
+    return {offset, std::min<std::uint64_t>(leafBytes, size - offset)};
+}
+
+std::size_t BackupManifest::leafAt(std::uint64_t offset) const {
+    std::size_t index = static_cast<std::size_t>(offset / leafBytes);
+    return leafCount() == 0 ? 0 : std::min(index, leafCount() - 1);
+}
+
+const BackupManifest::Digest* BackupManifest::node(std::size_t level, std::size_t index) const {
+    if (level >= levels.size() || index >= levels[level].size()) return nullptr;
+    return &levels[level][index];
+}
+
+std::vector<std::size_t> BackupManifest::diff(const BackupManifest& other) const {
+    if (algo != other.algo || leafBytes != other.leafBytes) {
+        throw std::invalid_argument("Manifests use different algorithms or leaf sizes");
+    }
+    if (!finished || !other.finished) throw std::logic_error("BackupManifest::diff before finish");
+
+    // Node (level, i) covers the same leaves in both trees, so a matching
+    // hash proves the whole subtree equal; a node only one tree has differs.
+    std::vector<std::size_t> changed;
+    std::vector<std::pair<std::size_t, std::size_t>> stack;
+    stack.emplace_back(std::max(levels.size(), other.levels.size()) - 1, 0);
+    while (!stack.empty()) {
+        auto [level, index] = stack.back();
+        stack.pop_back();
+        const Digest* a = node(level, index);
+        const Digest* b = other.node(level, index);
+        if (!a && !b) continue;
+        if (a && b && *a == *b) continue;
+        if (level == 0) {
+            changed.push_back(index);
+            continue;
+        }
+        // Right child first so leaves come off the stack in ascending order
+        stack.emplace_back(level - 1, 2 * index + 1);
+        stack.emplace_back(level - 1, 2 * index);
+    }
+    return changed;
+}
+
+bool BackupManifest::verifyLeaf(std::size_t index, const void* data, std::size_t len) const {
+    if (index >= leafCount() || len != leafRange(index).second) return false;
+    return hashLeaf(data, len) == leaf(index);
+}
+
+std::string BackupManifest::serialize() const {
+    if (!finished) throw std::logic_error("BackupManifest::serialize before finish");
+    std::ostringstream out;
+    out << kMagic << '\n'
+        << "algorithm " << Checksum::algorithmName(algo) << '\n'
+        << "leaf-size " << leafBytes << '\n'
+        << "size " << size << '\n'
+        << "root " << rootHex() << '\n';
+    for (const Digest& d : levels.front()) out << toHex(d) << '\n';
+    return out.str();
+}
+
+BackupManifest BackupManifest::parse(const std::string& text) {
+    std::istringstream in(text);
+    std::string line;
+    if (!std::getline(in, line) || line != kMagic) throw std::runtime_error("Not a backup manifest");
+
+    ChecksumAlgorithm algorithm;
+    try {
+        algorithm = Checksum::parseAlgorithm(field(in, "algorithm"));
+    } catch (const std::invalid_argument& ex) {
+        throw std::runtime_error(std::string("Malformed manifest: ") + ex.what());
+    }
+    std::uint64_t leafSize = number(field(in, "leaf-size"), "leaf-size");
+    if (leafSize == 0 || leafSize > UINT32_MAX) throw std::runtime_error("Malformed manifest: bad leaf-size");
+    BackupManifest manifest(algorithm, static_cast<std::uint32_t>(leafSize));
+    manifest.size = number(field(in, "size"), "size");
+    Digest root = fromHex(field(in, "root"));
+
+    const std::uint64_t expected = manifest.size == 0 ? 1 : (manifest.size + leafSize - 1) / leafSize;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        manifest.levels.front().push_back(fromHex(line));
+    }
+    if (manifest.levels.front().size() != expected) {
+        throw std::runtime_error("Malformed manifest: " + std::to_string(manifest.levels.front().size())
+                                 + " leaves for " + std::to_string(manifest.size) + " bytes");
+    }
+    manifest.buildTree();
+    manifest.finished = true;
+    if (manifest.root() != root) throw std::runtime_error("Manifest root does not match its leaves");
+    return manifest;
+}
@@ -0,0 +1,313 @@
+#include "BackupPipeline.h"
+#include "Logger.h"
+#include "TaskScheduler.h"
+#include "Tracer.h"
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+    using SteadyClock = std::chrono::steady_clock;
+
+    double secondsSince(SteadyClock::time_point start) {
+        return std::chrono::duration<double>(SteadyClock::now() - start).count();
+    }
+
+    // First exception wins; later ones are consequences of the abort
+    class ErrorSlot {
+    public:
+        void set(std::exception_ptr e) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!error) error = e;
+        }
+        void rethrowIfSet() {
+            if (error) std::rethrow_exception(error);
+        }
+    private:
+        std::mutex mtx;
+        std::exception_ptr error;
+    };
+}
+
+// -----------------------
+// PipelineReader
+// -----------------------
+bool PipelineReader::next(PipelineChunk& chunk) {
+    if (pos < current.data.size()) {
+        // Hand out the unread remainder of a partially read chunk
+        chunk = std::move(current);
+        chunk.data.erase(chunk.data.begin(), chunk.data.begin() + static_cast<std::ptrdiff_t>(pos));
+        chunk.offset += pos;
+        current = PipelineChunk{};
+        pos = 0;
+    } else if (!ring.pop(chunk)) {
+        return false;
+    } else if (onPop) {
+        onPop();
+    }
+    bytesRead += chunk.data.size();
+    return true;
+}
+
+std::size_t PipelineReader::read(char* buf, std::size_t len) {
+    std::size_t copied = 0;
+    while (copied < len) {
+        if (pos == current.data.size()) {
+            current.data.clear();
+            pos = 0;
+            if (!ring.pop(current)) break;
+            if (onPop) onPop();
+            continue; // chunk may be empty
+        }
+        std::size_t n = std::min(len - copied, current.data.size() - pos);
+        std::memcpy(buf + copied, current.data.data() + pos, n);
+        pos += n;
+        copied += n;
+    }
+    bytesRead += copied;
+    return copied;
+}
+
+// -----------------------
+// BackupPipeline
+// -----------------------
+BackupPipeline::BackupPipeline(std::size_t queueDepth) : queueDepth(queueDepth) {}
+
+void BackupPipeline::setSource(const std::string& name, Source fn) {
+    sourceName = name;
+    source = std::move(fn);
+}
+
+void BackupPipeline::addStage(const std::string& name, Transform fn) {
+    stages.emplace_back(name, std::move(fn));
+}
+
+void BackupPipeline::setSink(const std::string& name, Sink fn) {
+    sinkName = name;
+    sink = std::move(fn);
+}
+
+void BackupPipeline::run() {
+    if (!source || !sink) {
+        throw std::logic_error("BackupPipeline requires a source and a sink");
+    }
+
+    // rings[i] connects stage i to stage i+1 (stage 0 is the source)
+    std::vector<std::unique_ptr<ChunkRing>> rings;
+    for (std::size_t i = 0; i <= stages.size(); ++i) {
+        rings.push_back(std::make_unique<ChunkRing>(queueDepth));
+    }
+
+    stats.assign(stages.size() + 2, StageStats{});
+    stats.front().name = sourceName;
+    for (std::size_t i = 0; i < stages.size(); ++i) stats[i + 1].name = stages[i].first;
+    stats.back().name = sinkName;
+
+    ErrorSlot error;
+    const auto pipelineStart = SteadyClock::now();
+    auto abortAll = [&rings] { for (auto& r : rings) r->abort(); };
+
+    // Transforms: CPU-bound, so they run as tasks on the shared scheduler
+    // instead of owning threads. A stage's pump task is (re)scheduled when
+    // its input gains an item or its output frees a slot, and processes
+    // chunks until it runs out of either; at most one pump per stage runs
+    // at a time, which keeps the rings single-producer/single-consumer.
+    struct PumpState {
+        std::atomic<bool> scheduled{false};
+        std::atomic<bool> done{false};
+        SteadyClock::time_point idleSince;
+        bool idleOnOutput = false;
+    };
+    std::vector<std::unique_ptr<PumpState>> pumps;
+    for (std::size_t i = 0; i < stages.size(); ++i) {
+        pumps.push_back(std::make_unique<PumpState>());
+        pumps.back()->idleSince = pipelineStart;
+    }
+    TaskGroup pumpTasks;
+    std::function<void(std::size_t)> schedulePump;
+
+    auto hasWork = [&](std::size_t i) {
+        const ChunkRing& in = *rings[i];
+        const ChunkRing& out = *rings[i + 1];
+        return in.isAborted() || (!out.full() && (!in.empty() || in.isClosed()));
+    };
+
+    auto pumpOnce = [&](std::size_t i) {
+        PumpState& ps = *pumps[i];
+        StageStats& st = stats[i + 1];
+        ChunkRing& in = *rings[i];
+        ChunkRing& out = *rings[i + 1];
+
+        double idle = secondsSince(ps.idleSince);
+        (ps.idleOnOutput ? st.outputStallSeconds : st.inputStallSeconds) += idle;
+
+        try {
+            for (;;) {
+                if (in.isAborted()) {
+                    ps.done = true;
+                    break;
+                }
+                if (out.full()) {
+                    ps.idleOnOutput = true;
+                    break;
+                }
+                bool closedBefore = in.isClosed();
+                PipelineChunk chunk;
+                if (!in.tryPop(chunk)) {
+                    if (closedBefore) {
+                        out.close();
+                        ps.done = true;
+                        st.wallSeconds = secondsSince(pipelineStart);
+                        if (i + 1 < stages.size()) schedulePump(i + 1);
+                    }
+                    ps.idleOnOutput = false;
+                    break;
+                }
+                if (i > 0) schedulePump(i - 1); // freed a slot upstream
+
+                auto t0 = SteadyClock::now();
+                {
+                    TraceSpan span(stages[i].first, "pipeline", "chunk", static_cast<std::int64_t>(chunk.index));
+                    stages[i].second(chunk);
+                }
+                st.busySeconds += secondsSince(t0);
+                ++st.items;
+                st.bytes += chunk.data.size();
+
+                out.tryPush(chunk); // cannot fail: we are the only producer and out wasn't full
+                if (i + 1 < stages.size()) schedulePump(i + 1);
+            }
+        } catch (...) {
+            error.set(std::current_exception());
+            abortAll();
+            ps.done = true;
+        }
+        ps.idleSince = SteadyClock::now();
+    };
+
+    schedulePump = [&](std::size_t i) {
+        PumpState& ps = *pumps[i];
+        if (ps.done.load() || ps.scheduled.exchange(true)) return;
+        pumpTasks.run([&, i] {
+            PumpState& self = *pumps[i];
+            for (;;) {
+                pumpOnce(i);
+                self.scheduled.store(false);
+                // Re-check after releasing the flag so a wakeup racing with
+                // the release is not lost
+                if (self.done.load() || !hasWork(i) || self.scheduled.exchange(true)) return;
+            }
+        });
+    };
+
+    std::vector<std::thread> threads;
+
+    // Source
+    threads.emplace_back([&] {
+        Tracer::instance().setThreadName("pipeline " + sourceName);
+        StageStats& st = stats.front();
+        auto started = SteadyClock::now();
+        try {
+            ChunkRing& out = *rings.front();
+            for (std::uint64_t index = 0;; ++index) {
+                PipelineChunk chunk;
+                chunk.index = index;
+                auto t0 = SteadyClock::now();
+                bool more;
+                {
+                    TraceSpan span(sourceName, "pipeline", "chunk", static_cast<std::int64_t>(index));
+                    more = source(chunk);
+                }
+                st.busySeconds += secondsSince(t0);
+                if (!more) break;
+                ++st.items;
+                st.bytes += chunk.data.size();
+                if (!out.push(std::move(chunk))) break;
+                if (!stages.empty()) schedulePump(0);
+            }
+            out.close();
+            if (!stages.empty()) schedulePump(0);
+        } catch (...) {
+            error.set(std::current_exception());
+            abortAll();
+        }
+        st.outputStallSeconds = rings.front()->getPushStallSeconds();
+        st.wallSeconds = secondsSince(started);
+    });
+
+    // Sink
+    threads.emplace_back([&] {
+        Tracer::instance().setThreadName("pipeline " + sinkName);
+        StageStats& st = stats.back();
+        ChunkRing& in = *rings.back();
+        auto started = SteadyClock::now();
+        PipelineReader reader(in);
+        if (!stages.empty()) {
+            reader.setOnPop([&] { schedulePump(stages.size() - 1); });
+        }
+        try {
+            {
+                TraceSpan span(sinkName, "pipeline");
+                sink(reader);
+            }
+            // A sink that returns before end of stream would leave upstream
+            // blocked on a full ring forever
+            PipelineChunk leftover;
+            if (!in.isAborted() && reader.next(leftover)) {
+                throw std::runtime_error("Pipeline sink '" + sinkName + "' stopped before end of stream");
+            }
+        } catch (...) {
+            error.set(std::current_exception());
+            abortAll();
+        }
+        st.wallSeconds = secondsSince(started);
+        st.inputStallSeconds = in.getPopStallSeconds();
+        st.busySeconds = std::max(0.0, st.wallSeconds - st.inputStallSeconds);
+        st.bytes = reader.getBytesRead();
+    });
+
+    for (auto& t : threads) t.join();
+    pumpTasks.wait();
+    for (std::size_t i = 0; i < stages.size(); ++i) {
+        if (stats[i + 1].wallSeconds == 0) stats[i + 1].wallSeconds = secondsSince(pipelineStart);
+    }
+    error.rethrowIfSet();
+}
+
+void BackupPipeline::logStats() const {
+    for (const auto& st : stats) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(3)
+            << "Pipeline stage '" << st.name << "': "
+            << st.bytes << " bytes, wall " << st.wallSeconds << "s, busy " << st.busySeconds
+            << "s (" << std::setprecision(1) << st.utilization() * 100.0 << "% util), "
+            << std::setprecision(3)
+            << "input stall " << st.inputStallSeconds << "s, output stall " << st.outputStallSeconds << "s";
+        Logger::instance().info(oss.str());
+    }
+}
+
+BackupPipeline::Source BackupPipeline::fileSource(const std::string& path, std::size_t chunkSize) {
+    std::shared_ptr<FILE> fp(std::fopen(path.c_str(), "rb"), [](FILE* f) { if (f) std::fclose(f); });
+    if (!fp) {
+        throw std::runtime_error("Failed to open pipeline source: " + path);
+    }
+    auto offset = std::make_shared<std::uint64_t>(0);
+    return [fp, offset, chunkSize, path](PipelineChunk& chunk) {
+        chunk.data.resize(chunkSize);
+        std::size_t n = std::fread(chunk.data.data(), 1, chunkSize, fp.get());
+        if (n == 0) {
+            if (std::ferror(fp.get())) throw std::runtime_error("Read error on " + path);
+            return false;
+        }
+        chunk.data.resize(n);
+        chunk.offset = *offset;
+        *offset += n;
+        return true;
+    };
+}
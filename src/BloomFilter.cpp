@@ -0,0 +1,47 @@
+#include "BloomFilter.h"
+#include "Checksum.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    // Two independent-enough 64-bit hashes from one XXH3; h2 is odd so the
+    // probe sequence h1 + i*h2 never repeats early
+    std::pair<std::uint64_t, std::uint64_t> keyHashes(const std::string& key) {
+        const std::uint64_t h = Checksum::xxh3(key.data(), key.size());
+        const std::uint64_t h2 = ((h >> 29) ^ (h * 0x9E3779B97F4A7C15ULL)) | 1;
+        return {h, h2};
+    }
+}
+
+BloomFilter::BloomFilter(std::uint64_t expectedKeys, double falsePositiveRate) {
+    if (!(falsePositiveRate > 0.0 && falsePositiveRate < 1.0)) {
+        throw std::invalid_argument("Bloom filter false-positive rate must be in (0, 1)");
+    }
+    // m = -n ln p / (ln 2)^2, k = (m / n) ln 2
+    const double n = static_cast<double>(std::max<std::uint64_t>(expectedKeys, 1));
+    const double ln2 = std::log(2.0);
+    const double m = std::ceil(-n * std::log(falsePositiveRate) / (ln2 * ln2));
+    bits = std::max<std::uint64_t>(64, static_cast<std::uint64_t>(m));
+    bits = (bits + 63) / 64 * 64;
+    probes = static_cast<unsigned>(std::clamp(std::lround(static_cast<double>(bits) / n * ln2), 1L, 30L));
+    words.assign(bits / 64, 0);
+}
+
+void BloomFilter::add(const std::string& key) {
+    const auto [h1, h2] = keyHashes(key);
+    for (unsigned i = 0; i < probes; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) % bits;
+        words[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool BloomFilter::mayContain(const std::string& key) const {
+    const auto [h1, h2] = keyHashes(key);
+    for (unsigned i = 0; i < probes; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) % bits;
+        if (!(words[bit / 64] & (1ULL << (bit % 64)))) return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#include "Cancellation.h"
+#include <algorithm>
+#include <csignal>
+#include <thread>
+
+void CancellationToken::cancel(const std::string& why) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (cancelled.load()) return;
+    cancelReason = why;
+    cancelled.store(true);
+}
+
+void CancellationToken::cancelFromSignal(int signal) noexcept {
+    int expected = 0;
+    signalNumber.compare_exchange_strong(expected, signal);
+    cancelled.store(true);
+}
+
+void CancellationToken::setDeadline(Clock::time_point deadline) {
+    // Tick 0 means "none"; a deadline exactly at the epoch is already past anyway
+    deadlineTicks.store(std::max<Clock::rep>(deadline.time_since_epoch().count(), 1));
+}
+
+bool CancellationToken::isCancelled() const {
+    if (cancelled.load()) return true;
+    Clock::rep ticks = deadlineTicks.load();
+    if (ticks != 0 && Clock::now().time_since_epoch().count() >= ticks) return true;
+    return parent && parent->isCancelled();
+}
+
+std::string CancellationToken::reason() const {
+    if (cancelled.load()) {
+        if (int sig = signalNumber.load()) {
+            if (sig == SIGINT) return "interrupted (SIGINT)";
+            if (sig == SIGTERM) return "terminated (SIGTERM)";
+            return "signal " + std::to_string(sig);
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        return cancelReason;
+    }
+    Clock::rep ticks = deadlineTicks.load();
+    if (ticks != 0 && Clock::now().time_since_epoch().count() >= ticks) return "deadline exceeded";
+    return parent ? parent->reason() : std::string();
+}
+
+void CancellationToken::throwIfCancelled() const {
+    if (isCancelled()) throw OperationCancelled(reason());
+}
+
+void CancellationToken::sleepFor(Clock::duration duration) const {
+    const auto slice = std::chrono::milliseconds(50);
+    const auto until = Clock::now() + duration;
+    for (auto now = Clock::now(); now < until; now = Clock::now()) {
+        throwIfCancelled();
+        std::this_thread::sleep_for(std::min<Clock::duration>(until - now, slice));
+    }
+    throwIfCancelled();
+}
+
+CancellationToken::Clock::duration CancellationToken::remaining() const {
+    Clock::duration left = parent ? parent->remaining() : Clock::duration::max();
+    Clock::rep ticks = deadlineTicks.load();
+    if (ticks != 0) {
+        left = std::min(left, Clock::time_point(Clock::duration(ticks)) - Clock::now());
+    }
+    return left;
+}
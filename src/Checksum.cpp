@@ -0,0 +1,985 @@
+#include "Checksum.h"
+#include <openssl/evp.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SFB_X86_KERNELS 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define SFB_ARM_CRC 1
+#include <arm_acle.h>
+#endif
+
+// Kernels for wider instruction sets are compiled per function, so the rest
+// of the binary keeps the baseline ISA. MSVC needs no flags for intrinsics.
+#if defined(__GNUC__) || defined(__clang__)
+#define SFB_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SFB_TARGET(isa)
+#endif
+
+namespace {
+    inline std::uint32_t load32(const unsigned char* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;   // every supported target is little-endian
+    }
+
+    inline std::uint64_t load64(const unsigned char* p) {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline void putBe(std::vector<unsigned char>& out, std::uint64_t v, int bytes) {
+        for (int i = bytes - 1; i >= 0; --i) out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+    }
+
+    SimdLevel detectSimdLevel() {
+#if defined(SFB_X86_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        // libgcc/compiler-rt also check that the OS saves the wide registers
+        if (!__builtin_cpu_supports("sse4.2") || !__builtin_cpu_supports("pclmul")) return SimdLevel::Scalar;
+        if (!__builtin_cpu_supports("avx2")) return SimdLevel::Sse;
+        if (!__builtin_cpu_supports("avx512f")) return SimdLevel::Avx2;
+        return SimdLevel::Avx512;
+#elif defined(SFB_X86_KERNELS) && defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 1);
+        bool sse42 = (regs[2] & (1 << 20)) != 0, pclmul = (regs[2] & (1 << 1)) != 0;
+        bool osxsave = (regs[2] & (1 << 27)) != 0;
+        if (!sse42 || !pclmul) return SimdLevel::Scalar;
+        if (!osxsave) return SimdLevel::Sse;
+        unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(regs, 7, 0);
+        bool avx2 = (regs[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+        bool avx512 = (regs[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+        if (!avx2) return SimdLevel::Sse;
+        return avx512 ? SimdLevel::Avx512 : SimdLevel::Avx2;
+#elif defined(SFB_ARM_CRC)
+        return SimdLevel::Sse;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    const SimdLevel kDetectedLevel = detectSimdLevel();
+    std::atomic<SimdLevel> maxLevel{kDetectedLevel};
+
+    SimdLevel effectiveLevel() {
+        return std::min(kDetectedLevel, maxLevel.load(std::memory_order_relaxed));
+    }
+
+    // -----------------------
+    // CRC32C (Castagnoli, reflected polynomial 0x82F63B78)
+    // Kernels take and return the raw register (no pre/post inversion)
+    // -----------------------
+    constexpr std::uint32_t kCrcPoly = 0x82F63B78u;
+
+    using CrcKernel = std::uint32_t (*)(std::uint32_t crc, const unsigned char* p, std::size_t n);
+
+    struct CrcTables {
+        std::uint32_t t[8][256];
+        CrcTables() {
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                std::uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ kCrcPoly : c >> 1;
+                t[0][i] = c;
+            }
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                for (int s = 1; s < 8; ++s) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+            }
+        }
+    };
+    const CrcTables kCrcTables;
+
+    // Slicing-by-8
+    std::uint32_t crc32cScalar(std::uint32_t crc, const unsigned char* p, std::size_t n) {
+        const auto& t = kCrcTables.t;
+        while (n >= 8) {
+            std::uint64_t v = load64(p) ^ crc;
+            crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^ t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff]
+                  ^ t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^ t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+            p += 8;
+            n -= 8;
+        }
+        while (n--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+        return crc;
+    }
+
+#if defined(SFB_X86_KERNELS)
+    // a * b mod P, bit-reflected (bit 31 is x^0)
+    std::uint32_t crcMultModP(std::uint32_t a, std::uint32_t b) {
+        std::uint32_t p = 0;
+        for (std::uint32_t m = 1u << 31; m != 0; m >>= 1) {
+            if (a & m) p ^= b;
+            b = (b & 1) ? (b >> 1) ^ kCrcPoly : b >> 1;
+        }
+        return p;
+    }
+
+    std::uint32_t crcXPowModP(std::uint64_t n) {
+        std::uint32_t result = 1u << 31, square = 1u << 30;   // x^0, x^1
+        for (; n != 0; n >>= 1) {
+            if (n & 1) result = crcMultModP(result, square);
+            square = crcMultModP(square, square);
+        }
+        return result;
+    }
+
+    // Three independent streams hide the 3-cycle latency of the crc32
+    // instruction; they are stitched together with carry-less multiplies
+    constexpr std::size_t kCrcStreamBytes = 4096;
+    const std::uint32_t kCrcShiftStream = crcXPowModP(8 * kCrcStreamBytes - 33);
+
+    // crc * x^(8 * kCrcStreamBytes) mod P: the clmul yields crc * K * x, the
+    // crc32 of the 64-bit product multiplies by x^32 and reduces
+    SFB_TARGET("sse4.2,pclmul")
+    inline std::uint64_t crcShiftStream(std::uint64_t crc) {
+        __m128i product = _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<long long>(crc)),
+                                               _mm_cvtsi32_si128(static_cast<int>(kCrcShiftStream)), 0x00);
+        return _mm_crc32_u64(0, static_cast<std::uint64_t>(_mm_cvtsi128_si64(product)));
+    }
+
+    SFB_TARGET("sse4.2,pclmul")
+    std::uint32_t crc32cSse42(std::uint32_t crc32, const unsigned char* p, std::size_t n) {
+        std::uint64_t crc = crc32;
+        while (n > 0 && (reinterpret_cast<std::uintptr_t>(p) & 7) != 0) {
+            crc = _mm_crc32_u8(static_cast<std::uint32_t>(crc), *p++);
+            --n;
+        }
+        while (n >= 3 * kCrcStreamBytes) {
+            std::uint64_t c0 = crc, c1 = 0, c2 = 0;
+            for (std::size_t i = 0; i < kCrcStreamBytes; i += 8) {
+                c0 = _mm_crc32_u64(c0, load64(p + i));
+                c1 = _mm_crc32_u64(c1, load64(p + kCrcStreamBytes + i));
+                c2 = _mm_crc32_u64(c2, load64(p + 2 * kCrcStreamBytes + i));
+            }
+            crc = crcShiftStream(crcShiftStream(c0) ^ c1) ^ c2;
+            p += 3 * kCrcStreamBytes;
+            n -= 3 * kCrcStreamBytes;
+        }
+        for (; n >= 8; p += 8, n -= 8) crc = _mm_crc32_u64(crc, load64(p));
+        while (n--) crc = _mm_crc32_u8(static_cast<std::uint32_t>(crc), *p++);
+        return static_cast<std::uint32_t>(crc);
+    }
+#endif
+
+#if defined(SFB_ARM_CRC)
+    std::uint32_t crc32cArm(std::uint32_t crc, const unsigned char* p, std::size_t n) {
+        for (; n >= 8; p += 8, n -= 8) crc = __crc32cd(crc, load64(p));
+        while (n--) crc = __crc32cb(crc, *p++);
+        return crc;
+    }
+#endif
+
+    struct CrcImpl {
+        CrcKernel fn;
+        const char* name;
+    };
+
+    CrcImpl selectCrc(SimdLevel level) {
+#if defined(SFB_X86_KERNELS)
+        if (level >= SimdLevel::Sse) return {crc32cSse42, "sse4.2"};
+#elif defined(SFB_ARM_CRC)
+        if (level >= SimdLevel::Sse) return {crc32cArm, "armv8-crc"};
+#endif
+        (void)level;
+        return {crc32cScalar, "scalar"};
+    }
+
+    // -----------------------
+    // XXH3-64, seed 0, default secret
+    // -----------------------
+    alignas(64) const unsigned char kXxhSecret[192] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    constexpr std::uint32_t kPrime32_1 = 0x9E3779B1u;
+    constexpr std::uint32_t kPrime32_2 = 0x85EBCA77u;
+    constexpr std::uint32_t kPrime32_3 = 0xC2B2AE3Du;
+    constexpr std::uint64_t kPrime64_1 = 0x9E3779B185EBCA87ull;
+    constexpr std::uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr std::uint64_t kPrime64_3 = 0x165667B19E3779F9ull;
+    constexpr std::uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ull;
+    constexpr std::uint64_t kPrime64_5 = 0x27D4EB2F165667C5ull;
+    constexpr std::uint64_t kPrimeMx1 = 0x165667919E3779F9ull;
+    constexpr std::uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ull;
+
+    constexpr std::size_t kStripeLen = 64;
+    constexpr std::size_t kStripesPerBlock = (sizeof(kXxhSecret) - kStripeLen) / 8;
+    constexpr std::size_t kXxhBufferSize = 256;
+    constexpr std::size_t kMidSizeMax = 240;
+
+    inline std::uint64_t rotl64(std::uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+    inline std::uint64_t swap64(std::uint64_t v) {
+        v = ((v & 0x00ff00ff00ff00ffull) << 8) | ((v >> 8) & 0x00ff00ff00ff00ffull);
+        v = ((v & 0x0000ffff0000ffffull) << 16) | ((v >> 16) & 0x0000ffff0000ffffull);
+        return (v << 32) | (v >> 32);
+    }
+
+    inline std::uint64_t mul128Fold64(std::uint64_t a, std::uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 p = static_cast<unsigned __int128>(a) * b;
+        return static_cast<std::uint64_t>(p) ^ static_cast<std::uint64_t>(p >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        std::uint64_t hi;
+        std::uint64_t lo = _umul128(a, b, &hi);
+        return lo ^ hi;
+#else
+        std::uint64_t lolo = (a & 0xffffffff) * (b & 0xffffffff);
+        std::uint64_t hilo = (a >> 32) * (b & 0xffffffff);
+        std::uint64_t lohi = (a & 0xffffffff) * (b >> 32);
+        std::uint64_t hihi = (a >> 32) * (b >> 32);
+        std::uint64_t cross = (lolo >> 32) + (hilo & 0xffffffff) + lohi;
+        std::uint64_t hi = (hilo >> 32) + (cross >> 32) + hihi;
+        std::uint64_t lo = (cross << 32) | (lolo & 0xffffffff);
+        return lo ^ hi;
+#endif
+    }
+
+    inline std::uint64_t xxh64Avalanche(std::uint64_t h) {
+        h ^= h >> 33;
+        h *= kPrime64_2;
+        h ^= h >> 29;
+        h *= kPrime64_3;
+        return h ^ (h >> 32);
+    }
+
+    inline std::uint64_t xxh3Avalanche(std::uint64_t h) {
+        h ^= h >> 37;
+        h *= kPrimeMx1;
+        return h ^ (h >> 32);
+    }
+
+    inline std::uint64_t xxh3Rrmxmx(std::uint64_t h, std::uint64_t len) {
+        h ^= rotl64(h, 49) ^ rotl64(h, 24);
+        h *= kPrimeMx2;
+        h ^= (h >> 35) + len;
+        h *= kPrimeMx2;
+        return h ^ (h >> 28);
+    }
+
+    inline std::uint64_t xxh3Mix16(const unsigned char* in, const unsigned char* secret) {
+        return mul128Fold64(load64(in) ^ load64(secret), load64(in + 8) ^ load64(secret + 8));
+    }
+
+    // Inputs up to kMidSizeMax bytes
+    std::uint64_t xxh3Short(const unsigned char* in, std::size_t len) {
+        const unsigned char* s = kXxhSecret;
+        if (len > 128) {
+            std::uint64_t acc = len * kPrime64_1;
+            for (std::size_t i = 0; i < 8; ++i) acc += xxh3Mix16(in + 16 * i, s + 16 * i);
+            std::uint64_t accEnd = xxh3Mix16(in + len - 16, s + 136 - 17);
+            acc = xxh3Avalanche(acc);
+            for (std::size_t i = 8; i < len / 16; ++i) accEnd += xxh3Mix16(in + 16 * i, s + 16 * (i - 8) + 3);
+            return xxh3Avalanche(acc + accEnd);
+        }
+        if (len > 16) {
+            std::uint64_t acc = len * kPrime64_1;
+            if (len > 32) {
+                if (len > 64) {
+                    if (len > 96) {
+                        acc += xxh3Mix16(in + 48, s + 96);
+                        acc += xxh3Mix16(in + len - 64, s + 112);
+                    }
+                    acc += xxh3Mix16(in + 32, s + 64);
+                    acc += xxh3Mix16(in + len - 48, s + 80);
+                }
+                acc += xxh3Mix16(in + 16, s + 32);
+                acc += xxh3Mix16(in + len - 32, s + 48);
+            }
+            acc += xxh3Mix16(in, s);
+            acc += xxh3Mix16(in + len - 16, s + 16);
+            return xxh3Avalanche(acc);
+        }
+        if (len > 8) {
+            std::uint64_t lo = load64(in) ^ (load64(s + 24) ^ load64(s + 32));
+            std::uint64_t hi = load64(in + len - 8) ^ (load64(s + 40) ^ load64(s + 48));
+            return xxh3Avalanche(len + swap64(lo) + hi + mul128Fold64(lo, hi));
+        }
+        if (len >= 4) {
+            std::uint64_t in64 = load32(in + len - 4) + (static_cast<std::uint64_t>(load32(in)) << 32);
+            return xxh3Rrmxmx(in64 ^ (load64(s + 8) ^ load64(s + 16)), len);
+        }
+        if (len > 0) {
+            std::uint32_t combined = (static_cast<std::uint32_t>(in[0]) << 16)
+                                     | (static_cast<std::uint32_t>(in[len >> 1]) << 24)
+                                     | static_cast<std::uint32_t>(in[len - 1])
+                                     | (static_cast<std::uint32_t>(len) << 8);
+            return xxh64Avalanche(combined ^ static_cast<std::uint64_t>(load32(s) ^ load32(s + 4)));
+        }
+        return xxh64Avalanche(load64(s + 56) ^ load64(s + 64));
+    }
+
+    // Long inputs: 8 lanes of 64-bit accumulators fed one 64-byte stripe at a time
+    using XxhAccumulate = void (*)(std::uint64_t* acc, const unsigned char* in, const unsigned char* secret,
+                                   std::size_t stripes);
+    using XxhScramble = void (*)(std::uint64_t* acc, const unsigned char* secret);
+
+    void xxhAccumulateScalar(std::uint64_t* acc, const unsigned char* in, const unsigned char* secret,
+                             std::size_t stripes) {
+        for (std::size_t n = 0; n < stripes; ++n, in += kStripeLen, secret += 8) {
+            for (std::size_t i = 0; i < 8; ++i) {
+                std::uint64_t data = load64(in + 8 * i);
+                std::uint64_t key = data ^ load64(secret + 8 * i);
+                acc[i ^ 1] += data;
+                acc[i] += (key & 0xffffffff) * (key >> 32);
+            }
+        }
+    }
+
+    void xxhScrambleScalar(std::uint64_t* acc, const unsigned char* secret) {
+        for (std::size_t i = 0; i < 8; ++i) {
+            std::uint64_t a = acc[i];
+            a ^= a >> 47;
+            a ^= load64(secret + 8 * i);
+            acc[i] = a * kPrime32_1;
+        }
+    }
+
+#if defined(SFB_X86_KERNELS)
+    void xxhAccumulateSse2(std::uint64_t* acc, const unsigned char* in, const unsigned char* secret,
+                           std::size_t stripes) {
+        __m128i a[4];
+        for (int i = 0; i < 4; ++i) a[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(acc) + i);
+        for (std::size_t n = 0; n < stripes; ++n, in += kStripeLen, secret += 8) {
+            for (int i = 0; i < 4; ++i) {
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in) + i);
+                __m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+                __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                a[i] = _mm_add_epi64(product, _mm_add_epi64(a[i], swapped));
+            }
+        }
+        for (int i = 0; i < 4; ++i) _mm_store_si128(reinterpret_cast<__m128i*>(acc) + i, a[i]);
+    }
+
+    void xxhScrambleSse2(std::uint64_t* acc, const unsigned char* secret) {
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32_1));
+        for (int i = 0; i < 4; ++i) {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(acc) + i);
+            a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+            a = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+            __m128i lo = _mm_mul_epu32(a, prime);
+            __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            _mm_store_si128(reinterpret_cast<__m128i*>(acc) + i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+        }
+    }
+
+    SFB_TARGET("avx2")
+    void xxhAccumulateAvx2(std::uint64_t* acc, const unsigned char* in, const unsigned char* secret,
+                           std::size_t stripes) {
+        __m256i a0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc));
+        __m256i a1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc) + 1);
+        for (std::size_t n = 0; n < stripes; ++n, in += kStripeLen, secret += 8) {
+            __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+            __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in) + 1);
+            __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret)));
+            __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + 1));
+            __m256i p0 = _mm256_mul_epu32(k0, _mm256_shuffle_epi32(k0, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m256i p1 = _mm256_mul_epu32(k1, _mm256_shuffle_epi32(k1, _MM_SHUFFLE(0, 3, 0, 1)));
+            a0 = _mm256_add_epi64(p0, _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+            a1 = _mm256_add_epi64(p1, _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(acc), a0);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(acc) + 1, a1);
+    }
+
+    SFB_TARGET("avx2")
+    void xxhScrambleAvx2(std::uint64_t* acc, const unsigned char* secret) {
+        const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+        for (int i = 0; i < 2; ++i) {
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc) + i);
+            a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+            a = _mm256_xor_si256(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + i));
+            __m256i lo = _mm256_mul_epu32(a, prime);
+            __m256i hi = _mm256_mul_epu32(_mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(acc) + i, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+        }
+    }
+
+    SFB_TARGET("avx512f")
+    void xxhAccumulateAvx512(std::uint64_t* acc, const unsigned char* in, const unsigned char* secret,
+                             std::size_t stripes) {
+        __m512i a = _mm512_load_si512(acc);
+        for (std::size_t n = 0; n < stripes; ++n, in += kStripeLen, secret += 8) {
+            __m512i data = _mm512_loadu_si512(in);
+            __m512i key = _mm512_xor_si512(data, _mm512_loadu_si512(secret));
+            __m512i product = _mm512_mul_epu32(key, _mm512_shuffle_epi32(key, static_cast<_MM_PERM_ENUM>(
+                                                                                   _MM_SHUFFLE(0, 3, 0, 1))));
+            __m512i swapped = _mm512_shuffle_epi32(data, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(1, 0, 3, 2)));
+            a = _mm512_add_epi64(product, _mm512_add_epi64(a, swapped));
+        }
+        _mm512_store_si512(acc, a);
+    }
+
+    SFB_TARGET("avx512f")
+    void xxhScrambleAvx512(std::uint64_t* acc, const unsigned char* secret) {
+        const __m512i prime = _mm512_set1_epi32(static_cast<int>(kPrime32_1));
+        __m512i a = _mm512_load_si512(acc);
+        a = _mm512_xor_si512(a, _mm512_srli_epi64(a, 47));
+        a = _mm512_xor_si512(a, _mm512_loadu_si512(secret));
+        __m512i lo = _mm512_mul_epu32(a, prime);
+        __m512i hi = _mm512_mul_epu32(_mm512_shuffle_epi32(a, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(0, 3, 0, 1))),
+                                      prime);
+        _mm512_store_si512(acc, _mm512_add_epi64(lo, _mm512_slli_epi64(hi, 32)));
+    }
+#endif
+
+    struct XxhImpl {
+        XxhAccumulate accumulate;
+        XxhScramble scramble;
+        const char* name;
+    };
+
+    XxhImpl selectXxh(SimdLevel level) {
+#if defined(SFB_X86_KERNELS)
+        if (level >= SimdLevel::Avx512) return {xxhAccumulateAvx512, xxhScrambleAvx512, "avx512"};
+        if (level >= SimdLevel::Avx2) return {xxhAccumulateAvx2, xxhScrambleAvx2, "avx2"};
+        if (level >= SimdLevel::Sse) return {xxhAccumulateSse2, xxhScrambleSse2, "sse2"};
+#endif
+        (void)level;
+        return {xxhAccumulateScalar, xxhScrambleScalar, "scalar"};
+    }
+
+    // -----------------------
+    // BLAKE3
+    // -----------------------
+    const std::uint32_t kBlakeIv[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                                       0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+    const std::uint8_t kBlakeSchedule[7][16] = {
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+        {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+        {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+        {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+        {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+        {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+        {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+    };
+
+    constexpr std::size_t kBlakeBlockLen = 64;
+    constexpr std::size_t kBlakeChunkLen = 1024;
+    constexpr std::uint32_t kChunkStart = 1, kChunkEnd = 2, kParent = 4, kRoot = 8;
+
+    inline std::uint32_t rotr32(std::uint32_t v, int r) { return (v >> r) | (v << (32 - r)); }
+
+    inline void blakeG(std::uint32_t* v, int a, int b, int c, int d, std::uint32_t x, std::uint32_t y) {
+        v[a] = v[a] + v[b] + x;
+        v[d] = rotr32(v[d] ^ v[a], 16);
+        v[c] = v[c] + v[d];
+        v[b] = rotr32(v[b] ^ v[c], 12);
+        v[a] = v[a] + v[b] + y;
+        v[d] = rotr32(v[d] ^ v[a], 8);
+        v[c] = v[c] + v[d];
+        v[b] = rotr32(v[b] ^ v[c], 7);
+    }
+
+    // Full 16-word output; the first 8 words are the chaining value
+    void blakeCompress(const std::uint32_t cv[8], const std::uint32_t m[16], std::uint64_t counter,
+                       std::uint32_t blockLen, std::uint32_t flags, std::uint32_t out[16]) {
+        std::uint32_t v[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                               kBlakeIv[0], kBlakeIv[1], kBlakeIv[2], kBlakeIv[3],
+                               static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32),
+                               blockLen, flags};
+        for (const auto& s : kBlakeSchedule) {
+            blakeG(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+            blakeG(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+            blakeG(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+            blakeG(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+            blakeG(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+            blakeG(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+            blakeG(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+            blakeG(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+        for (int i = 0; i < 8; ++i) {
+            out[i] = v[i] ^ v[i + 8];
+            out[i + 8] = v[i + 8] ^ cv[i];
+        }
+    }
+
+    inline void blakeWords(const unsigned char* block, std::uint32_t m[16]) {
+        for (int i = 0; i < 16; ++i) m[i] = load32(block + 4 * i);
+    }
+
+    // Chaining values of 8 consecutive whole chunks, hashed side by side
+    using BlakeHashChunks8 = void (*)(const std::uint32_t key[8], const unsigned char* in, std::uint64_t counter,
+                                      std::uint32_t out[8][8]);
+
+#if defined(SFB_X86_KERNELS)
+    SFB_TARGET("avx2")
+    inline __m256i rotr16x8(__m256i v) {
+        return _mm256_shuffle_epi8(v, _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                                       2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+    }
+
+    SFB_TARGET("avx2")
+    inline __m256i rotr8x8(__m256i v) {
+        return _mm256_shuffle_epi8(v, _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+                                                       1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+    }
+
+    SFB_TARGET("avx2")
+    inline void blakeGx8(__m256i* v, int a, int b, int c, int d, __m256i x, __m256i y) {
+        v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), x);
+        v[d] = rotr16x8(_mm256_xor_si256(v[d], v[a]));
+        v[c] = _mm256_add_epi32(v[c], v[d]);
+        __m256i t = _mm256_xor_si256(v[b], v[c]);
+        v[b] = _mm256_or_si256(_mm256_srli_epi32(t, 12), _mm256_slli_epi32(t, 20));
+        v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), y);
+        v[d] = rotr8x8(_mm256_xor_si256(v[d], v[a]));
+        v[c] = _mm256_add_epi32(v[c], v[d]);
+        t = _mm256_xor_si256(v[b], v[c]);
+        v[b] = _mm256_or_si256(_mm256_srli_epi32(t, 7), _mm256_slli_epi32(t, 25));
+    }
+
+    // 8x8 transpose of 32-bit words: row i of `r` becomes lane i of every output
+    SFB_TARGET("avx2")
+    inline void transpose8x8(__m256i r[8]) {
+        __m256i ab0 = _mm256_unpacklo_epi32(r[0], r[1]), ab1 = _mm256_unpackhi_epi32(r[0], r[1]);
+        __m256i cd0 = _mm256_unpacklo_epi32(r[2], r[3]), cd1 = _mm256_unpackhi_epi32(r[2], r[3]);
+        __m256i ef0 = _mm256_unpacklo_epi32(r[4], r[5]), ef1 = _mm256_unpackhi_epi32(r[4], r[5]);
+        __m256i gh0 = _mm256_unpacklo_epi32(r[6], r[7]), gh1 = _mm256_unpackhi_epi32(r[6], r[7]);
+        __m256i abcd04 = _mm256_unpacklo_epi64(ab0, cd0), abcd15 = _mm256_unpackhi_epi64(ab0, cd0);
+        __m256i abcd26 = _mm256_unpacklo_epi64(ab1, cd1), abcd37 = _mm256_unpackhi_epi64(ab1, cd1);
+        __m256i efgh04 = _mm256_unpacklo_epi64(ef0, gh0), efgh15 = _mm256_unpackhi_epi64(ef0, gh0);
+        __m256i efgh26 = _mm256_unpacklo_epi64(ef1, gh1), efgh37 = _mm256_unpackhi_epi64(ef1, gh1);
+        r[0] = _mm256_permute2x128_si256(abcd04, efgh04, 0x20);
+        r[4] = _mm256_permute2x128_si256(abcd04, efgh04, 0x31);
+        r[1] = _mm256_permute2x128_si256(abcd15, efgh15, 0x20);
+        r[5] = _mm256_permute2x128_si256(abcd15, efgh15, 0x31);
+        r[2] = _mm256_permute2x128_si256(abcd26, efgh26, 0x20);
+        r[6] = _mm256_permute2x128_si256(abcd26, efgh26, 0x31);
+        r[3] = _mm256_permute2x128_si256(abcd37, efgh37, 0x20);
+        r[7] = _mm256_permute2x128_si256(abcd37, efgh37, 0x31);
+    }
+
+    SFB_TARGET("avx2")
+    void blakeHashChunks8Avx2(const std::uint32_t key[8], const unsigned char* in, std::uint64_t counter,
+                              std::uint32_t out[8][8]) {
+        __m256i h[8];
+        for (int i = 0; i < 8; ++i) h[i] = _mm256_set1_epi32(static_cast<int>(key[i]));
+        alignas(32) std::uint32_t counterLo[8], counterHi[8];
+        for (int lane = 0; lane < 8; ++lane) {
+            counterLo[lane] = static_cast<std::uint32_t>(counter + lane);
+            counterHi[lane] = static_cast<std::uint32_t>((counter + lane) >> 32);
+        }
+        const __m256i ctrLo = _mm256_load_si256(reinterpret_cast<const __m256i*>(counterLo));
+        const __m256i ctrHi = _mm256_load_si256(reinterpret_cast<const __m256i*>(counterHi));
+
+        for (std::size_t block = 0; block < kBlakeChunkLen / kBlakeBlockLen; ++block) {
+            __m256i m[16];
+            for (int half = 0; half < 2; ++half) {
+                for (int lane = 0; lane < 8; ++lane) {
+                    m[half * 8 + lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                        in + lane * kBlakeChunkLen + block * kBlakeBlockLen + half * 32));
+                }
+                transpose8x8(m + half * 8);
+            }
+            std::uint32_t flags = (block == 0 ? kChunkStart : 0)
+                                  | (block + 1 == kBlakeChunkLen / kBlakeBlockLen ? kChunkEnd : 0);
+            __m256i v[16] = {h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                             _mm256_set1_epi32(static_cast<int>(kBlakeIv[0])),
+                             _mm256_set1_epi32(static_cast<int>(kBlakeIv[1])),
+                             _mm256_set1_epi32(static_cast<int>(kBlakeIv[2])),
+                             _mm256_set1_epi32(static_cast<int>(kBlakeIv[3])),
+                             ctrLo, ctrHi,
+                             _mm256_set1_epi32(static_cast<int>(kBlakeBlockLen)),
+                             _mm256_set1_epi32(static_cast<int>(flags))};
+            for (const auto& s : kBlakeSchedule) {
+                blakeGx8(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+                blakeGx8(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+                blakeGx8(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+                blakeGx8(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+                blakeGx8(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+                blakeGx8(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+                blakeGx8(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+                blakeGx8(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+            }
+            for (int i = 0; i < 8; ++i) h[i] = _mm256_xor_si256(v[i], v[i + 8]);
+        }
+        transpose8x8(h);
+        for (int lane = 0; lane < 8; ++lane) _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[lane]), h[lane]);
+    }
+#endif
+
+    struct BlakeImpl {
+        BlakeHashChunks8 chunks8;   // nullptr: one chunk at a time
+        const char* name;
+    };
+
+    BlakeImpl selectBlake(SimdLevel level) {
+#if defined(SFB_X86_KERNELS)
+        if (level >= SimdLevel::Avx2) return {blakeHashChunks8Avx2, "avx2"};
+#endif
+        (void)level;
+        return {nullptr, "scalar"};
+    }
+
+    // -----------------------
+    // Hashers
+    // -----------------------
+    class Sha256Checksum : public Checksum {
+    public:
+        Sha256Checksum() : ctx(EVP_MD_CTX_new()) {
+            if (!ctx || EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
+                EVP_MD_CTX_free(ctx);
+                throw std::runtime_error("Failed to initialize SHA-256");
+            }
+        }
+        ~Sha256Checksum() override { EVP_MD_CTX_free(ctx); }
+        Sha256Checksum(const Sha256Checksum&) = delete;
+        Sha256Checksum& operator=(const Sha256Checksum&) = delete;
+
+        void update(const void* data, std::size_t len) override { EVP_DigestUpdate(ctx, data, len); }
+
+        std::vector<unsigned char> digest() const override {
+            std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> copy(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+            unsigned char md[EVP_MAX_MD_SIZE];
+            unsigned int len = 0;
+            if (!copy || EVP_MD_CTX_copy_ex(copy.get(), ctx) != 1 || EVP_DigestFinal_ex(copy.get(), md, &len) != 1) {
+                throw std::runtime_error("Failed to finalize SHA-256");
+            }
+            return std::vector<unsigned char>(md, md + len);
+        }
+
+        ChecksumAlgorithm algorithm() const override { return ChecksumAlgorithm::Sha256; }
+        const char* implementation() const override { return "openssl"; }
+
+    private:
+        EVP_MD_CTX* ctx;
+    };
+
+    class Crc32cChecksum : public Checksum {
+    public:
+        explicit Crc32cChecksum(SimdLevel level) : impl(selectCrc(level)) {}
+
+        void update(const void* data, std::size_t len) override {
+            crc = ~impl.fn(~crc, static_cast<const unsigned char*>(data), len);
+        }
+
+        std::vector<unsigned char> digest() const override {
+            std::vector<unsigned char> out;
+            putBe(out, crc, 4);
+            return out;
+        }
+
+        ChecksumAlgorithm algorithm() const override { return ChecksumAlgorithm::Crc32c; }
+        const char* implementation() const override { return impl.name; }
+
+        std::uint32_t value() const { return crc; }
+
+    private:
+        CrcImpl impl;
+        std::uint32_t crc = 0;
+    };
+
+    class Xxh3Checksum : public Checksum {
+    public:
+        explicit Xxh3Checksum(SimdLevel level) : impl(selectXxh(level)) {}
+
+        // Mirrors the reference streaming state: the last input byte always
+        // stays buffered so the final stripe can be taken at digest time
+        void update(const void* data, std::size_t len) override {
+            auto in = static_cast<const unsigned char*>(data);
+            totalLen += len;
+            if (len <= kXxhBufferSize - buffered) {
+                if (len > 0) std::memcpy(buffer + buffered, in, len);
+                buffered += len;
+                return;
+            }
+            if (buffered > 0) {
+                std::size_t fill = kXxhBufferSize - buffered;
+                std::memcpy(buffer + buffered, in, fill);
+                in += fill;
+                len -= fill;
+                consumeStripes(acc, stripesSoFar, buffer, kXxhBufferSize / kStripeLen);
+                buffered = 0;
+            }
+            if (len > kXxhBufferSize) {
+                std::size_t stripes = (len - 1) / kStripeLen;
+                consumeStripes(acc, stripesSoFar, in, stripes);
+                // Keep the last consumed stripe for a short tail's final stripe
+                std::memcpy(buffer + kXxhBufferSize - kStripeLen, in + (stripes - 1) * kStripeLen, kStripeLen);
+                in += stripes * kStripeLen;
+                len -= stripes * kStripeLen;
+            }
+            std::memcpy(buffer, in, len);
+            buffered = len;
+        }
+
+        std::vector<unsigned char> digest() const override {
+            std::vector<unsigned char> out;
+            putBe(out, value(), 8);
+            return out;
+        }
+
+        std::uint64_t value() const {
+            if (totalLen <= kMidSizeMax) return xxh3Short(buffer, static_cast<std::size_t>(totalLen));
+
+            alignas(64) std::uint64_t a[8];
+            std::memcpy(a, acc, sizeof(a));
+            std::size_t soFar = stripesSoFar;
+            alignas(64) unsigned char last[kStripeLen];
+            const unsigned char* lastStripe = last;
+            if (buffered >= kStripeLen) {
+                consumeStripes(a, soFar, buffer, (buffered - 1) / kStripeLen);
+                lastStripe = buffer + buffered - kStripeLen;
+            } else {
+                std::size_t catchUp = kStripeLen - buffered;
+                std::memcpy(last, buffer + kXxhBufferSize - catchUp, catchUp);
+                std::memcpy(last + catchUp, buffer, buffered);
+            }
+            impl.accumulate(a, lastStripe, kXxhSecret + sizeof(kXxhSecret) - kStripeLen - 7, 1);
+
+            std::uint64_t result = totalLen * kPrime64_1;
+            for (int i = 0; i < 4; ++i) {
+                result += mul128Fold64(a[2 * i] ^ load64(kXxhSecret + 11 + 16 * i),
+                                       a[2 * i + 1] ^ load64(kXxhSecret + 11 + 16 * i + 8));
+            }
+            return xxh3Avalanche(result);
+        }
+
+        ChecksumAlgorithm algorithm() const override { return ChecksumAlgorithm::Xxh3; }
+        const char* implementation() const override { return impl.name; }
+
+    private:
+        XxhImpl impl;
+        alignas(64) std::uint64_t acc[8] = {kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+                                            kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1};
+        alignas(64) unsigned char buffer[kXxhBufferSize] = {};
+        std::size_t buffered = 0;
+        std::size_t stripesSoFar = 0;
+        std::uint64_t totalLen = 0;
+
+        void consumeStripes(std::uint64_t* a, std::size_t& soFar, const unsigned char* in, std::size_t stripes) const {
+            while (stripes > 0) {
+                std::size_t n = std::min(stripes, kStripesPerBlock - soFar);
+                impl.accumulate(a, in, kXxhSecret + soFar * 8, n);
+                soFar += n;
+                in += n * kStripeLen;
+                stripes -= n;
+                if (soFar == kStripesPerBlock) {
+                    impl.scramble(a, kXxhSecret + sizeof(kXxhSecret) - kStripeLen);
+                    soFar = 0;
+                }
+            }
+        }
+    };
+
+    class Blake3Checksum : public Checksum {
+    public:
+        explicit Blake3Checksum(SimdLevel level) : impl(selectBlake(level)) { resetChunk(0); }
+
+        void update(const void* data, std::size_t len) override {
+            auto in = static_cast<const unsigned char*>(data);
+            while (len > 0) {
+                if (chunkLen() == kBlakeChunkLen) {
+                    std::uint32_t cv[8];
+                    chunkChainingValue(cv);
+                    std::uint64_t total = chunkCounter + 1;
+                    addChunkChainingValue(cv, total);
+                    resetChunk(total);
+                }
+                // Whole chunks go through the wide kernel, but never the
+                // last one: it may turn out to be the root
+                if (impl.chunks8 && chunkLen() == 0 && len > 8 * kBlakeChunkLen) {
+                    std::uint32_t cvs[8][8];
+                    impl.chunks8(kBlakeIv, in, chunkCounter, cvs);
+                    for (int i = 0; i < 8; ++i) addChunkChainingValue(cvs[i], chunkCounter + i + 1);
+                    resetChunk(chunkCounter + 8);
+                    in += 8 * kBlakeChunkLen;
+                    len -= 8 * kBlakeChunkLen;
+                    continue;
+                }
+                std::size_t take = std::min(kBlakeChunkLen - chunkLen(), len);
+                chunkUpdate(in, take);
+                in += take;
+                len -= take;
+            }
+        }
+
+        std::vector<unsigned char> digest() const override {
+            // Output node: the current chunk, folded into every pending subtree
+            std::uint32_t cv[8], m[16], out[16];
+            std::memcpy(cv, chunkCv, sizeof(cv));
+            blakeWords(block, m);
+            std::uint64_t counter = chunkCounter;
+            std::uint32_t len = static_cast<std::uint32_t>(blockLen);
+            std::uint32_t flags = startFlag() | kChunkEnd;
+            for (std::size_t i = stackLen; i-- > 0;) {
+                blakeCompress(cv, m, counter, len, flags, out);
+                std::memcpy(m, cvStack[i], 8 * sizeof(std::uint32_t));
+                std::memcpy(m + 8, out, 8 * sizeof(std::uint32_t));
+                std::memcpy(cv, kBlakeIv, sizeof(cv));
+                counter = 0;
+                len = kBlakeBlockLen;
+                flags = kParent;
+            }
+            blakeCompress(cv, m, 0, len, flags | kRoot, out);
+            std::vector<unsigned char> digestBytes;
+            for (int i = 0; i < 8; ++i) {
+                for (int b = 0; b < 4; ++b) digestBytes.push_back(static_cast<unsigned char>(out[i] >> (8 * b)));
+            }
+            return digestBytes;
+        }
+
+        ChecksumAlgorithm algorithm() const override { return ChecksumAlgorithm::Blake3; }
+        const char* implementation() const override { return impl.name; }
+
+    private:
+        BlakeImpl impl;
+        std::uint32_t chunkCv[8];
+        std::uint64_t chunkCounter = 0;
+        unsigned char block[kBlakeBlockLen];
+        std::size_t blockLen = 0;
+        std::size_t blocksCompressed = 0;
+        std::uint32_t cvStack[54][8];   // one per level of a 2^64-byte tree
+        std::size_t stackLen = 0;
+
+        std::size_t chunkLen() const { return blocksCompressed * kBlakeBlockLen + blockLen; }
+        std::uint32_t startFlag() const { return blocksCompressed == 0 ? kChunkStart : 0; }
+
+        void resetChunk(std::uint64_t counter) {
+            std::memcpy(chunkCv, kBlakeIv, sizeof(chunkCv));
+            chunkCounter = counter;
+            std::memset(block, 0, sizeof(block));
+            blockLen = 0;
+            blocksCompressed = 0;
+        }
+
+        void chunkUpdate(const unsigned char* in, std::size_t len) {
+            while (len > 0) {
+                if (blockLen == kBlakeBlockLen) {
+                    std::uint32_t m[16], out[16];
+                    blakeWords(block, m);
+                    blakeCompress(chunkCv, m, chunkCounter, kBlakeBlockLen, startFlag(), out);
+                    std::memcpy(chunkCv, out, sizeof(chunkCv));
+                    ++blocksCompressed;
+                    std::memset(block, 0, sizeof(block));
+                    blockLen = 0;
+                }
+                std::size_t take = std::min(kBlakeBlockLen - blockLen, len);
+                std::memcpy(block + blockLen, in, take);
+                blockLen += take;
+                in += take;
+                len -= take;
+            }
+        }
+
+        void chunkChainingValue(std::uint32_t cv[8]) const {
+            std::uint32_t m[16], out[16];
+            blakeWords(block, m);
+            blakeCompress(chunkCv, m, chunkCounter, static_cast<std::uint32_t>(blockLen), startFlag() | kChunkEnd, out);
+            std::memcpy(cv, out, 8 * sizeof(std::uint32_t));
+        }
+
+        // Merge completed subtrees: one parent per trailing zero bit of the chunk count
+        void addChunkChainingValue(const std::uint32_t chunkCvIn[8], std::uint64_t totalChunks) {
+            std::uint32_t cv[8];
+            std::memcpy(cv, chunkCvIn, sizeof(cv));
+            while ((totalChunks & 1) == 0) {
+                std::uint32_t m[16], out[16];
+                std::memcpy(m, cvStack[--stackLen], 8 * sizeof(std::uint32_t));
+                std::memcpy(m + 8, cv, 8 * sizeof(std::uint32_t));
+                blakeCompress(kBlakeIv, m, 0, kBlakeBlockLen, kParent, out);
+                std::memcpy(cv, out, sizeof(cv));
+                totalChunks >>= 1;
+            }
+            std::memcpy(cvStack[stackLen++], cv, sizeof(cv));
+        }
+    };
+
+    const char kHexDigits[] = "0123456789abcdef";
+}
+
+std::unique_ptr<Checksum> Checksum::create(ChecksumAlgorithm algorithm) {
+    const SimdLevel level = effectiveLevel();
+    switch (algorithm) {
+        case ChecksumAlgorithm::Sha256: return std::make_unique<Sha256Checksum>();
+        case ChecksumAlgorithm::Crc32c: return std::make_unique<Crc32cChecksum>(level);
+        case ChecksumAlgorithm::Xxh3:   return std::make_unique<Xxh3Checksum>(level);
+        case ChecksumAlgorithm::Blake3: return std::make_unique<Blake3Checksum>(level);
+    }
+    throw std::invalid_argument("Unknown checksum algorithm");
+}
+
+std::string Checksum::hex() const {
+    std::string out;
+    for (unsigned char b : digest()) {
+        out.push_back(kHexDigits[b >> 4]);
+        out.push_back(kHexDigits[b & 0xf]);
+    }
+    return out;
+}
+
+std::string Checksum::label() const {
+    if (algorithm() == ChecksumAlgorithm::Sha256) return hex();
+    return std::string(algorithmName(algorithm())) + ":" + hex();
+}
+
+const char* Checksum::algorithmName(ChecksumAlgorithm algorithm) {
+    switch (algorithm) {
+        case ChecksumAlgorithm::Sha256: return "sha256";
+        case ChecksumAlgorithm::Crc32c: return "crc32c";
+        case ChecksumAlgorithm::Xxh3:   return "xxh3";
+        case ChecksumAlgorithm::Blake3: return "blake3";
+    }
+    return "sha256";
+}
+
+ChecksumAlgorithm Checksum::parseAlgorithm(const std::string& name) {
+    if (name == "sha256") return ChecksumAlgorithm::Sha256;
+    if (name == "crc32c") return ChecksumAlgorithm::Crc32c;
+    if (name == "xxh3")   return ChecksumAlgorithm::Xxh3;
+    if (name == "blake3") return ChecksumAlgorithm::Blake3;
+    throw std::invalid_argument("expected sha256, crc32c, xxh3 or blake3");
+}
+
+SimdLevel Checksum::detectedSimdLevel() {
+    return kDetectedLevel;
+}
+
+SimdLevel Checksum::setMaxSimdLevel(SimdLevel level) {
+    return maxLevel.exchange(level);
+}
+
+SimdLevel Checksum::maxSimdLevel() {
+    return maxLevel.load();
+}
+
+std::uint32_t Checksum::crc32c(const void* data, std::size_t len, std::uint32_t crc) {
+    return ~selectCrc(effectiveLevel()).fn(~crc, static_cast<const unsigned char*>(data), len);
+}
+
+std::uint64_t Checksum::xxh3(const void* data, std::size_t len) {
+    if (len <= kMidSizeMax) return xxh3Short(static_cast<const unsigned char*>(data), len);
+    Xxh3Checksum h(effectiveLevel());
+    h.update(data, len);
+    return h.value();
+}
+
+std::string Checksum::hexDigest(ChecksumAlgorithm algorithm, const void* data, std::size_t len) {
+    auto h = create(algorithm);
+    h->update(data, len);
+    return h->hex();
+}
@@ -0,0 +1,329 @@
+#include "ChunkCipher.h"
+#include "BackupPipeline.h"
+#include "TaskScheduler.h"
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace {
+    const unsigned char kMagic[8] = {'S', 'F', 'B', 'C', 'R', 'Y', 'P', 'T'};
+    constexpr unsigned char kVersion = 1;
+    constexpr std::size_t kNonceSize = 12;
+    const char kKeyInfo[] = "sqliteftpbackup frame key v1";
+
+    // Frames decrypted per batch by decryptFile
+    constexpr std::size_t kDecryptBatchFrames = 64;
+
+    void putLe(unsigned char* p, std::uint64_t v, int bytes) {
+        for (int i = 0; i < bytes; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+
+    std::uint64_t getLe(const unsigned char* p, int bytes) {
+        std::uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+        return v;
+    }
+
+    const EVP_CIPHER* evpCipher(CipherAlgorithm algorithm) {
+        return algorithm == CipherAlgorithm::ChaCha20Poly1305 ? EVP_chacha20_poly1305() : EVP_aes_256_gcm();
+    }
+
+    // One context per thread: frames are sealed on scheduler workers and
+    // re-initialising a context is much cheaper than allocating one
+    EVP_CIPHER_CTX* threadContext() {
+        thread_local std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(),
+                                                                                        &EVP_CIPHER_CTX_free);
+        if (!ctx) throw std::runtime_error("Failed to allocate cipher context");
+        return ctx.get();
+    }
+
+    // Nonce: 4 zero bytes then the big-endian frame index. Unique per frame
+    // because every stream has its own derived key.
+    void frameNonce(std::uint64_t index, unsigned char nonce[kNonceSize]) {
+        std::memset(nonce, 0, kNonceSize);
+        for (int i = 0; i < 8; ++i) nonce[kNonceSize - 1 - i] = static_cast<unsigned char>(index >> (8 * i));
+    }
+
+    std::runtime_error cryptoError(const std::string& what) {
+        return std::runtime_error("Encryption error: " + what);
+    }
+}
+
+ChunkCipher::ChunkCipher(const EncryptionConfig& config, std::uint64_t plaintextSize, const CipherSalt& salt)
+    : algo(config.algorithm), frame(config.frameSize), plainSize(plaintextSize) {
+    if (frame == 0) throw std::invalid_argument("Encryption frame size must be > 0");
+    std::memcpy(header.data(), kMagic, sizeof(kMagic));
+    header[8] = kVersion;
+    header[9] = static_cast<unsigned char>(algo);
+    putLe(&header[12], frame, 4);
+    putLe(&header[16], plainSize, 8);
+    std::memcpy(&header[24], salt.data(), salt.size());
+    init(config.key);
+}
+
+ChunkCipher ChunkCipher::fromHeader(const EncryptionKey& key, const unsigned char* data, std::size_t len) {
+    if (len < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not an encrypted backup (bad header)");
+    }
+    if (data[8] != kVersion) {
+        throw std::runtime_error("Unsupported encrypted backup version " + std::to_string(data[8]));
+    }
+    ChunkCipher c;
+    if (data[9] != static_cast<unsigned char>(CipherAlgorithm::Aes256Gcm)
+        && data[9] != static_cast<unsigned char>(CipherAlgorithm::ChaCha20Poly1305)) {
+        throw std::runtime_error("Unknown cipher id " + std::to_string(data[9]));
+    }
+    c.algo = static_cast<CipherAlgorithm>(data[9]);
+    c.frame = static_cast<std::uint32_t>(getLe(&data[12], 4));
+    c.plainSize = getLe(&data[16], 8);
+    if (c.frame == 0) throw std::runtime_error("Corrupt encrypted backup header (frame size 0)");
+    std::memcpy(c.header.data(), data, kHeaderSize);
+    c.init(key);
+    return c;
+}
+
+void ChunkCipher::init(const EncryptionKey& masterKey) {
+    // HKDF-SHA256 (RFC 5869) with one output block: extract, then expand
+    unsigned char prk[SHA256_DIGEST_LENGTH];
+    unsigned int prkLen = 0;
+    if (!HMAC(EVP_sha256(), &header[24], 32, masterKey.data(), masterKey.size(), prk, &prkLen)) {
+        throw cryptoError("HKDF extract failed");
+    }
+    unsigned char info[sizeof(kKeyInfo)];
+    std::memcpy(info, kKeyInfo, sizeof(kKeyInfo) - 1);
+    info[sizeof(kKeyInfo) - 1] = 0x01;
+    unsigned int okmLen = 0;
+    if (!HMAC(EVP_sha256(), prk, static_cast<int>(prkLen), info, sizeof(info), streamKey.data(), &okmLen)) {
+        throw cryptoError("HKDF expand failed");
+    }
+}
+
+CipherSalt ChunkCipher::randomSalt() {
+    CipherSalt salt{};
+    if (RAND_bytes(salt.data(), static_cast<int>(salt.size())) != 1) throw cryptoError("RAND_bytes failed");
+    return salt;
+}
+
+CipherSalt ChunkCipher::salt() const {
+    CipherSalt s{};
+    std::memcpy(s.data(), &header[24], s.size());
+    return s;
+}
+
+std::uint64_t ChunkCipher::encryptedSize(std::uint64_t plaintextSize, std::uint32_t frameSize) {
+    std::uint64_t frames = (plaintextSize + frameSize - 1) / frameSize;
+    return kHeaderSize + plaintextSize + frames * kTagSize;
+}
+
+CipherAlgorithm ChunkCipher::preferredAlgorithm() {
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul")) return CipherAlgorithm::Aes256Gcm;
+    return CipherAlgorithm::ChaCha20Poly1305;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4];
+    __cpuid(regs, 1);
+    bool aes = (regs[2] & (1 << 25)) != 0, pclmul = (regs[2] & (1 << 1)) != 0;
+    return aes && pclmul ? CipherAlgorithm::Aes256Gcm : CipherAlgorithm::ChaCha20Poly1305;
+#elif defined(__aarch64__) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) ? CipherAlgorithm::Aes256Gcm : CipherAlgorithm::ChaCha20Poly1305;
+#elif defined(__aarch64__)
+    return CipherAlgorithm::Aes256Gcm;   // crypto extensions are standard on 64-bit Apple/Windows ARM
+#else
+    return CipherAlgorithm::ChaCha20Poly1305;
+#endif
+}
+
+const char* ChunkCipher::algorithmName(CipherAlgorithm algorithm) {
+    return algorithm == CipherAlgorithm::ChaCha20Poly1305 ? "chacha20-poly1305" : "aes-256-gcm";
+}
+
+EncryptionKey ChunkCipher::loadKeyFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open encryption key file: " + path);
+    std::string raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    EncryptionKey key{};
+    if (raw.size() == key.size()) {
+        std::memcpy(key.data(), raw.data(), key.size());
+        return key;
+    }
+    std::string hex;
+    for (char c : raw) {
+        if (!std::isspace(static_cast<unsigned char>(c))) hex.push_back(c);
+    }
+    if (hex.size() != key.size() * 2
+        || !std::all_of(hex.begin(), hex.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); })) {
+        throw std::runtime_error("Encryption key file must hold 32 raw bytes or 64 hex digits: " + path);
+    }
+    for (std::size_t i = 0; i < key.size(); ++i) {
+        key[i] = static_cast<unsigned char>(std::stoi(hex.substr(2 * i, 2), nullptr, 16));
+    }
+    return key;
+}
+
+std::size_t ChunkCipher::frameCipherSize(std::uint64_t index) const {
+    std::uint64_t start = index * frame;
+    return static_cast<std::size_t>(std::min<std::uint64_t>(frame, plainSize - start)) + kTagSize;
+}
+
+void ChunkCipher::sealFrame(std::uint64_t index, const unsigned char* in, std::size_t len, unsigned char* out) const {
+    EVP_CIPHER_CTX* ctx = threadContext();
+    unsigned char nonce[kNonceSize];
+    frameNonce(index, nonce);
+    unsigned char indexLe[8];
+    putLe(indexLe, index, 8);
+
+    int outLen = 0;
+    if (EVP_EncryptInit_ex(ctx, evpCipher(algo), nullptr, streamKey.data(), nonce) != 1
+        || EVP_EncryptUpdate(ctx, nullptr, &outLen, header.data(), static_cast<int>(header.size())) != 1
+        || EVP_EncryptUpdate(ctx, nullptr, &outLen, indexLe, sizeof(indexLe)) != 1
+        || EVP_EncryptUpdate(ctx, out, &outLen, in, static_cast<int>(len)) != 1
+        || EVP_EncryptFinal_ex(ctx, out + outLen, &outLen) != 1
+        || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, static_cast<int>(kTagSize), out + len) != 1) {
+        throw cryptoError("sealing frame " + std::to_string(index) + " failed");
+    }
+}
+
+void ChunkCipher::decryptFrame(std::uint64_t index, const unsigned char* in, std::size_t len,
+                               unsigned char* out) const {
+    if (index >= frameCount() || len != frameCipherSize(index)) {
+        throw std::runtime_error("Encrypted frame " + std::to_string(index) + " has the wrong size");
+    }
+    std::size_t plainLen = len - kTagSize;
+    EVP_CIPHER_CTX* ctx = threadContext();
+    unsigned char nonce[kNonceSize];
+    frameNonce(index, nonce);
+    unsigned char indexLe[8];
+    putLe(indexLe, index, 8);
+    unsigned char tag[kTagSize];
+    std::memcpy(tag, in + plainLen, kTagSize);
+
+    int outLen = 0;
+    if (EVP_DecryptInit_ex(ctx, evpCipher(algo), nullptr, streamKey.data(), nonce) != 1
+        || EVP_DecryptUpdate(ctx, nullptr, &outLen, header.data(), static_cast<int>(header.size())) != 1
+        || EVP_DecryptUpdate(ctx, nullptr, &outLen, indexLe, sizeof(indexLe)) != 1
+        || EVP_DecryptUpdate(ctx, out, &outLen, in, static_cast<int>(plainLen)) != 1
+        || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, static_cast<int>(kTagSize), tag) != 1
+        || EVP_DecryptFinal_ex(ctx, out + outLen, &outLen) != 1) {
+        throw std::runtime_error("Encrypted frame " + std::to_string(index)
+                                 + " failed authentication (wrong key or corrupted backup)");
+    }
+}
+
+void ChunkCipher::encryptChunk(PipelineChunk& chunk) const {
+    const std::uint64_t len = chunk.data.size();
+    if (chunk.offset % frame != 0 || chunk.offset + len > plainSize
+        || (len % frame != 0 && chunk.offset + len != plainSize)) {
+        throw std::logic_error("Pipeline chunk at offset " + std::to_string(chunk.offset)
+                               + " is not aligned to encryption frames");
+    }
+    const std::uint64_t firstFrame = chunk.offset / frame;
+    const std::size_t frames = static_cast<std::size_t>((len + frame - 1) / frame);
+    const std::size_t prefix = chunk.offset == 0 ? kHeaderSize : 0;
+
+    std::vector<unsigned char> out(prefix + len + frames * kTagSize);
+    if (prefix) std::memcpy(out.data(), header.data(), kHeaderSize);
+    const unsigned char* in = chunk.data.data();
+    parallelFor(0, frames, [&](std::size_t i) {
+        std::size_t start = i * frame;
+        std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(frame, len - start));
+        sealFrame(firstFrame + i, in + start, n, out.data() + prefix + i * (frame + kTagSize));
+    });
+    chunk.data.swap(out);
+    chunk.offset = chunk.offset == 0 ? 0 : frameOffset(firstFrame);
+}
+
+std::vector<unsigned char> ChunkCipher::decryptRange(const std::string& encryptedFile, std::uint64_t offset,
+                                                     std::size_t length) const {
+    if (offset + length > plainSize) throw std::out_of_range("Range past the end of the encrypted backup");
+    std::vector<unsigned char> result;
+    if (length == 0) return result;
+
+    std::ifstream in(encryptedFile, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open encrypted file: " + encryptedFile);
+    const std::uint64_t first = offset / frame;
+    const std::uint64_t last = (offset + length - 1) / frame;
+    result.reserve(length);
+    std::vector<unsigned char> cipherBuf, plainBuf;
+    for (std::uint64_t f = first; f <= last; ++f) {
+        std::size_t n = frameCipherSize(f);
+        cipherBuf.resize(n);
+        plainBuf.resize(n - kTagSize);
+        in.seekg(static_cast<std::streamoff>(frameOffset(f)));
+        if (!in.read(reinterpret_cast<char*>(cipherBuf.data()), static_cast<std::streamsize>(n))) {
+            throw std::runtime_error("Encrypted backup is truncated at frame " + std::to_string(f));
+        }
+        decryptFrame(f, cipherBuf.data(), n, plainBuf.data());
+        std::uint64_t frameStart = f * frame;
+        std::uint64_t from = std::max(offset, frameStart) - frameStart;
+        std::uint64_t to = std::min<std::uint64_t>(offset + length, frameStart + plainBuf.size()) - frameStart;
+        result.insert(result.end(), plainBuf.begin() + static_cast<std::ptrdiff_t>(from),
+                      plainBuf.begin() + static_cast<std::ptrdiff_t>(to));
+    }
+    return result;
+}
+
+void ChunkCipher::decryptFile(const std::string& encryptedFile, const std::string& plainFile,
+                              const EncryptionKey& key) {
+    std::ifstream in(encryptedFile, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open encrypted file: " + encryptedFile);
+    unsigned char head[kHeaderSize];
+    if (!in.read(reinterpret_cast<char*>(head), kHeaderSize)) {
+        throw std::runtime_error("Encrypted backup is truncated (no header): " + encryptedFile);
+    }
+    ChunkCipher cipher = fromHeader(key, head, kHeaderSize);
+
+    std::ofstream out(plainFile, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot create " + plainFile);
+    // Never leave unauthenticated plaintext behind
+    struct RemoveOnFailure {
+        const std::string& path;
+        std::ofstream& file;
+        bool done = false;
+        ~RemoveOnFailure() {
+            if (done) return;
+            file.close();
+            std::remove(path.c_str());
+        }
+    } guard{plainFile, out};
+
+    const std::uint64_t frames = cipher.frameCount();
+    const std::size_t stride = cipher.frame + kTagSize;
+    std::vector<unsigned char> cipherBuf, plainBuf;
+    for (std::uint64_t first = 0; first < frames; first += kDecryptBatchFrames) {
+        const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(kDecryptBatchFrames, frames - first));
+        const std::uint64_t lastFrame = first + count - 1;
+        const std::size_t cipherBytes = (count - 1) * stride + cipher.frameCipherSize(lastFrame);
+        cipherBuf.resize(cipherBytes);
+        if (!in.read(reinterpret_cast<char*>(cipherBuf.data()), static_cast<std::streamsize>(cipherBytes))) {
+            throw std::runtime_error("Encrypted backup is truncated at frame " + std::to_string(first));
+        }
+        plainBuf.resize(cipherBytes - count * kTagSize);
+        parallelFor(0, count, [&](std::size_t i) {
+            cipher.decryptFrame(first + i, cipherBuf.data() + i * stride, cipher.frameCipherSize(first + i),
+                                plainBuf.data() + i * cipher.frame);
+        });
+        out.write(reinterpret_cast<const char*>(plainBuf.data()), static_cast<std::streamsize>(plainBuf.size()));
+    }
+    if (in.peek() != std::char_traits<char>::eof()) {
+        throw std::runtime_error("Encrypted backup has trailing data: " + encryptedFile);
+    }
+    if (!out.flush()) throw std::runtime_error("Write error on " + plainFile);
+    guard.done = true;
+}
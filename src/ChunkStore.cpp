@@ -0,0 +1,151 @@
+#include "ChunkStore.h"
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    constexpr const char* kRecipeMagic = "sqliteftpbackup-recipe 1";
+
+    // splitmix64 from a fixed seed: the table must never change (see ContentChunker)
+    std::array<std::uint64_t, 256> makeGearTable() {
+        std::array<std::uint64_t, 256> table{};
+        std::uint64_t state = 0x5346424344433031ULL;   // "SFBCDC01"
+        for (auto& v : table) {
+            std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            v = z ^ (z >> 31);
+        }
+        return table;
+    }
+
+    const std::array<std::uint64_t, 256>& gearTable() {
+        static const std::array<std::uint64_t, 256> table = makeGearTable();
+        return table;
+    }
+
+    // Mask of the top `bits` bits: they depend on the last 64 bytes, the low ones on fewer
+    std::uint64_t topBits(int bits) {
+        bits = std::clamp(bits, 1, 63);
+        return ~0ULL << (64 - bits);
+    }
+
+    int log2Floor(std::uint32_t v) {
+        int bits = 0;
+        while (v >>= 1) ++bits;
+        return bits;
+    }
+
+    bool isHexId(const std::string& s) {
+        return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+        });
+    }
+}
+
+ChunkingParams ChunkingParams::forAverage(std::uint32_t avgSize) {
+    ChunkingParams params;
+    params.avgSize = avgSize;
+    params.minSize = std::max<std::uint32_t>(avgSize / 4, 1);
+    params.maxSize = avgSize * 4;
+    return params;
+}
+
+ContentChunker::ContentChunker(const ChunkingParams& params) : p(params) {
+    if (p.minSize == 0 || p.minSize > p.avgSize || p.avgSize > p.maxSize) {
+        throw std::invalid_argument("Chunk sizes must satisfy 0 < min <= avg <= max");
+    }
+    const int bits = log2Floor(p.avgSize);
+    maskSmall = topBits(bits + 2);
+    maskLarge = topBits(bits - 2);
+}
+
+std::size_t ContentChunker::cut(const unsigned char* data, std::size_t len) const {
+    if (len <= p.minSize) return len;
+    const std::size_t normal = std::min<std::size_t>(p.avgSize, len);
+    const std::size_t limit = std::min<std::size_t>(p.maxSize, len);
+    const auto& gear = gearTable();
+
+    std::uint64_t hash = 0;
+    std::size_t i = p.minSize;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & maskSmall)) return i + 1;
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & maskLarge)) return i + 1;
+    }
+    return limit;
+}
+
+std::string ChunkRecipe::serialize() const {
+    std::ostringstream out;
+    out << kRecipeMagic << '\n'
+        << "hash " << Checksum::algorithmName(algorithm) << '\n'
+        << "size " << size << '\n';
+    for (const ChunkRef& c : chunks) out << c.id << ' ' << c.length << '\n';
+    return out.str();
+}
+
+ChunkRecipe ChunkRecipe::parse(const std::string& text) {
+    std::istringstream in(text);
+    std::string line;
+    if (!std::getline(in, line) || line != kRecipeMagic) throw std::runtime_error("Not a chunk recipe");
+
+    ChunkRecipe recipe;
+    std::string key, value;
+    if (!std::getline(in, line) || !(std::istringstream(line) >> key >> value) || key != "hash") {
+        throw std::runtime_error("Malformed recipe: expected 'hash'");
+    }
+    try {
+        recipe.algorithm = Checksum::parseAlgorithm(value);
+    } catch (const std::invalid_argument& ex) {
+        throw std::runtime_error(std::string("Malformed recipe: ") + ex.what());
+    }
+    if (!std::getline(in, line) || !(std::istringstream(line) >> key >> recipe.size) || key != "size") {
+        throw std::runtime_error("Malformed recipe: expected 'size'");
+    }
+
+    std::uint64_t total = 0;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        ChunkRef ref;
+        std::istringstream fields(line);
+        if (!(fields >> ref.id >> ref.length) || !isHexId(ref.id) || ref.length == 0) {
+            throw std::runtime_error("Malformed recipe line: " + line);
+        }
+        total += ref.length;
+        recipe.chunks.push_back(std::move(ref));
+    }
+    if (total != recipe.size) {
+        throw std::runtime_error("Recipe chunks add up to " + std::to_string(total) + " bytes, expected "
+                                 + std::to_string(recipe.size));
+    }
+    return recipe;
+}
+
+void ChunkIndex::load(const std::string& text) {
+    std::size_t start = 0;
+    while (start < text.size()) {
+        std::size_t end = text.find('\n', start);
+        if (end == std::string::npos) break;   // torn append: the chunk gets uploaded again
+        std::string id = text.substr(start, end - start);
+        if (!id.empty() && id.back() == '\r') id.pop_back();
+        if (isHexId(id)) ids.insert(std::move(id));
+        start = end + 1;
+    }
+}
+
+std::string ChunkIndex::chunkId(const void* data, std::size_t len) {
+    return Checksum::hexDigest(kChunkHash, data, len);
+}
+
+std::string ChunkIndex::indexDir(const std::string& baseDir) {
+    return baseDir.empty() ? std::string(kChunkDir) : baseDir + "/" + kChunkDir;
+}
+
+std::string ChunkIndex::chunkDir(const std::string& baseDir, const std::string& id) {
+    return indexDir(baseDir) + "/" + id.substr(0, 2);
+}
@@ -1,5 +1,9 @@
 #include "FtpUploader.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "HdrHistogram.h"
+#include "Probes.h"
 #include <curl/curl.h>
 #include <stdexcept>
 #include <filesystem>
@@ -9,6 +13,9 @@
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
 
 
 namespace {
@@ -20,6 +27,7 @@ namespace {
     int curlProgress(void* clientp,
                      curl_off_t dltotal, curl_off_t dlnow,
                      curl_off_t ultotal, curl_off_t ulnow) {
+        SFB_PROBE2(transfer__progress, static_cast<long long>(ulnow), static_cast<long long>(ultotal));
         auto* cb = reinterpret_cast<FtpUploader::ProgressCallback*>(clientp);
         if (cb && *cb) {
             try {
@@ -47,34 +55,140 @@ namespace {
         return totalSize;
     }
 
-    // Helper to sleep for backoff
-    void sleepForBackoff(int attempt) {
+    // Read callback for uploadStream: pull bytes from the caller's ReadCallback
+    size_t streamReadCallback(char* buffer, size_t size, size_t nitems, void* userdata) {
+        auto* read = reinterpret_cast<FtpUploader::ReadCallback*>(userdata);
+        try {
+            return (*read)(buffer, size * nitems);
+        } catch (...) {
+            // never throw from callback into curl
+            return CURL_READFUNC_ABORT;
+        }
+    }
+
+    // Write callback for downloadStream: hand body bytes to the caller's WriteCallback
+    size_t streamWriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
+        auto* write = reinterpret_cast<FtpUploader::WriteCallback*>(userdata);
+        try {
+            (*write)(ptr, size * nmemb);
+            return size * nmemb;
+        } catch (...) {
+            // never throw from callback into curl; a short count aborts
+            return 0;
+        }
+    }
+
+    struct FtpMetrics {
+        Counter& attempts;
+        Counter& failures;
+        Counter& bytes;
+        Histogram* phaseSeconds[5];
+        HdrHistogram& transferLatency;
+        HdrHistogram& retryDelay;
+    };
+
+    // Phases of one transfer, in the order curl reaches them
+    const char* const kPhases[] = {"dns", "connect", "tls", "ftp_setup", "transfer"};
+
+    FtpMetrics& ftpMetrics() {
+        static FtpMetrics metrics = [] {
+            MetricsRegistry& m = MetricsRegistry::instance();
+            FtpMetrics fm{m.counter("sqliteftpbackup_ftp_upload_attempts_total", "FTP upload attempts"),
+                          m.counter("sqliteftpbackup_ftp_upload_failures_total", "FTP upload attempts that failed"),
+                          m.counter("sqliteftpbackup_ftp_uploaded_bytes_total", "Bytes sent by FTP uploads"),
+                          {},
+                          LatencyStats::instance().histogram("ftp_transfer"),
+                          LatencyStats::instance().histogram("retry_delay")};
+            for (int i = 0; i < 5; ++i) {
+                fm.phaseSeconds[i] = &m.histogram("sqliteftpbackup_ftp_phase_seconds", "FTP transfer time by phase",
+                                                  std::string("phase=\"") + kPhases[i] + "\"");
+            }
+            return fm;
+        }();
+        return metrics;
+    }
+
+    // curl phase times are cumulative, so each phase is recorded as the
+    // delta from the previous one. When tracing, the phases are also laid
+    // out back to back from the start of curl_easy_perform.
+    void recordTransferMetrics(CURL* curl, CURLcode res, double performStartUs) {
+        FtpMetrics& m = ftpMetrics();
+        char* url = nullptr;
+        curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+        m.attempts.inc();
+        if (res != CURLE_OK) m.failures.inc();
+        curl_off_t uploaded = 0;
+        if (curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &uploaded) == CURLE_OK && uploaded > 0) {
+            m.bytes.inc(static_cast<std::uint64_t>(uploaded));
+        }
+
+        curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0, total = 0;
+        curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+        curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+        m.transferLatency.record(static_cast<std::int64_t>(total) * 1000);
+        SFB_PROBE4(transfer__end, url, static_cast<int>(res), static_cast<long long>(uploaded), static_cast<long long>(total));
+        // A reused connection reports 0 for the connect phases
+        curl_off_t connected = std::max(connect, tls);
+        curl_off_t marks[] = {dns, connect - dns, tls > 0 ? tls - connect : 0,
+                              pretransfer - std::max(connected, dns), total - pretransfer};
+        Tracer& tracer = Tracer::instance();
+        double phaseStartUs = performStartUs;
+        for (int i = 0; i < 5; ++i) {
+            curl_off_t us = std::max<curl_off_t>(0, marks[i]);
+            m.phaseSeconds[i]->observe(static_cast<double>(us) / 1e6);
+            if (tracer.isEnabled() && us > 0) {
+                TraceEvent ev;
+                ev.name = kPhases[i];
+                ev.category = "ftp";
+                ev.startUs = phaseStartUs;
+                ev.durationUs = static_cast<double>(us);
+                tracer.record(std::move(ev));
+            }
+            phaseStartUs += static_cast<double>(us);
+        }
+    }
+
+    // Helper to sleep for backoff; a fired token cuts the sleep short
+    void sleepForBackoff(int attempt, const CancellationToken* cancel) {
         using namespace std::chrono_literals;
         // Exponential backoff: base 500ms * 2^(attempt-1)
         int64_t ms = 500LL * (1LL << (std::min(attempt - 1, 6))); // cap exponent so we don't overflow
-        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        SFB_PROBE2(retry, attempt, static_cast<long long>(ms));
+        LatencyTimer timer(ftpMetrics().retryDelay);
+        if (cancel) {
+            cancel->sleepFor(std::chrono::milliseconds(ms));
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        }
+    }
+}
+
+CurlGlobal::CurlGlobal() {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        Logger::instance().warn("curl_global_init failed, continuing but curl may misbehave.");
     }
 }
 
+CurlGlobal::~CurlGlobal() {
+    curl_global_cleanup();
+}
+
 FtpUploader::FtpUploader(const std::string& host, int port,
                          const std::string& user, const std::string& pass)
     : host(host), port(port), user(user), pass(pass),
       timeoutSeconds(30), maxRetries(1), verbose(false), progressCb(nullptr),
       lastError(), sslVerify(true)
 {
-    // Initialize libcurl globally once per process. curl_global_init is safe to call multiple times,
-    // but should have matching cleanup — we will call global init here and rely on cleanup in destructor.
-    CURLcode c = curl_global_init(CURL_GLOBAL_DEFAULT);
-    if (c != CURLE_OK) {
-        Logger::instance().warn("curl_global_init failed, continuing but curl may misbehave.");
-    }
+    // libcurl's global state belongs to a CurlGlobal (main(), FtpWorkerPool)
     Logger::instance().info("FtpUploader initialized for host: " + host);
 }
 
 FtpUploader::~FtpUploader() {
+    if (curlHandle) curl_easy_cleanup(static_cast<CURL*>(curlHandle));
     Logger::instance().info("FtpUploader destroyed for host: " + host);
-    // Best-effort cleanup
-    curl_global_cleanup();
 }
 
 void FtpUploader::setTimeout(long seconds) { timeoutSeconds = seconds; }
@@ -83,6 +197,7 @@ void FtpUploader::enableVerbose(bool v) { verbose = v; }
 void FtpUploader::setProgressCallback(ProgressCallback cb) { progressCb = cb; }
 std::string FtpUploader::getLastError() const { return lastError; }
 void FtpUploader::setSslVerify(bool v) { sslVerify = v; }
+void FtpUploader::setUseTls(bool v) { useTls = v; }
 
 std::string FtpUploader::buildUrl(const std::string& remoteDir,
                                   const std::string& filename) const {
@@ -100,6 +215,16 @@ std::string FtpUploader::buildUrl(const std::string& remoteDir,
     return url.str();
 }
 
+void FtpUploader::throwIfAborted(int curlCode) {
+    if (cancel && cancel->isCancelled()
+        && (curlCode == CURLE_ABORTED_BY_CALLBACK || curlCode == CURLE_READ_ERROR
+            || curlCode == CURLE_WRITE_ERROR)) {
+        lastError = "cancelled: " + cancel->reason();
+        Logger::instance().warn("FTP transfer " + lastError);
+        throw OperationCancelled(cancel->reason());
+    }
+}
+
 void FtpUploader::throwIfFailed(int attempt, const std::string& context) {
     if (!lastError.empty() && attempt >= maxRetries) {
         Logger::instance().error(context + ": " + lastError);
@@ -107,6 +232,57 @@ void FtpUploader::throwIfFailed(int attempt, const std::string& context) {
     }
 }
 
+void* FtpUploader::prepareHandle(const std::string& url) {
+    // Reuse the handle: curl_easy_reset clears options but keeps live
+    // connections and the DNS/TLS session caches
+    if (curlHandle) {
+        curl_easy_reset(static_cast<CURL*>(curlHandle));
+    } else {
+        curlHandle = curl_easy_init();
+    }
+    CURL* curl = static_cast<CURL*>(curlHandle);
+    if (!curl) {
+        Logger::instance().error("Failed to initialize curl");
+        throw std::runtime_error("Failed to initialize curl");
+    }
+
+    // Always set URL and authentication
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    if (!user.empty()) curl_easy_setopt(curl, CURLOPT_USERNAME, user.c_str());
+    if (!pass.empty()) curl_easy_setopt(curl, CURLOPT_PASSWORD, pass.c_str());
+
+    // Require TLS unless explicitly disabled; allow toggling verification
+    curl_easy_setopt(curl, CURLOPT_USE_SSL, useTls ? CURLUSESSL_ALL : CURLUSESSL_NONE);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, sslVerify ? 1L : 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, sslVerify ? 2L : 0L);
+
+    // Create missing directories on server if curl supports it
+    curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_RETRY);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeoutSeconds);
+    curl_easy_setopt(curl, CURLOPT_FTP_RESPONSE_TIMEOUT, timeoutSeconds);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    // Write function (server replies) and verbose
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+    if (verbose) curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+
+    // Progress callback; throwing from it aborts the transfer, which is
+    // how a fired cancellation token stops curl
+    if (progressCb || cancel) {
+        transferCb = [this](double dltotal, double dlnow, double ultotal, double ulnow) {
+            if (cancel && cancel->isCancelled()) throw OperationCancelled(cancel->reason());
+            if (progressCb) progressCb(dltotal, dlnow, ultotal, ulnow);
+        };
+        // CURLOPT_XFERINFOFUNCTION requires CURLOPT_NOPROGRESS 0L
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, curlProgress);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &transferCb);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+    }
+    return curl;
+}
+
 void FtpUploader::uploadFile(const std::string& localFile,
                              const std::string& remoteDir) {
     Logger::instance().info("Preparing to upload file: " + localFile + " to " + remoteDir);
@@ -125,6 +301,7 @@ void FtpUploader::uploadFile(const std::string& localFile,
 
     while (attempt < maxRetries) {
         ++attempt;
+        if (cancel) cancel->throwIfCancelled();
         Logger::instance().info("FTP upload attempt " + std::to_string(attempt) + " to URL: " + url);
 
         FilePtr fp(fopen(localFile.c_str(), "rb"));
@@ -133,59 +310,34 @@ void FtpUploader::uploadFile(const std::string& localFile,
             throw std::runtime_error("Failed to open local file: " + localFile);
         }
 
-        CURL* curl = curl_easy_init();
-        if (!curl) {
-            Logger::instance().error("Failed to initialize curl");
-            throw std::runtime_error("Failed to initialize curl");
-        }
-
-        // Always set URL and authentication
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        if (!user.empty()) curl_easy_setopt(curl, CURLOPT_USERNAME, user.c_str());
-        if (!pass.empty()) curl_easy_setopt(curl, CURLOPT_PASSWORD, pass.c_str());
-
-        // Use SSL for FTP if available; allow toggling verification
-        curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_ALL);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, sslVerify ? 1L : 0L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, sslVerify ? 2L : 0L);
+        CURL* curl = static_cast<CURL*>(prepareHandle(url));
 
         // Upload settings
         curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
         curl_easy_setopt(curl, CURLOPT_READDATA, fp.get());
 
-        // Create missing directories on server if curl supports it
-        curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_RETRY);
-        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeoutSeconds);
-        curl_easy_setopt(curl, CURLOPT_FTP_RESPONSE_TIMEOUT, timeoutSeconds);
-
-        // Write function (server replies) and verbose
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        if (verbose) curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-
-        // Progress callback
-        if (progressCb) {
-            // CURLOPT_XFERINFOFUNCTION requires CURLOPT_NOPROGRESS 0L
-            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, curlProgress);
-            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progressCb);
-            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-        } else {
-            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
-        }
-
         // Important: set read size (optional) and file size for progress calculation
+        curl_off_t fsize = -1;
         try {
             std::uintmax_t filesize = std::filesystem::file_size(localFile);
-            curl_off_t fsize = static_cast<curl_off_t>(filesize);
+            fsize = static_cast<curl_off_t>(filesize);
             curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, fsize);
         } catch (...) {
             // If we cannot determine file size, proceed without it; progress will be less precise.
         }
+        SFB_PROBE2(transfer__start, url.c_str(), static_cast<long long>(fsize));
 
         lastError.clear();
-        CURLcode res = curl_easy_perform(curl);
+        double performStartUs = Tracer::instance().nowUs();
+        CURLcode res;
+        {
+            TraceSpan span("ftp_upload", "ftp", "attempt", attempt);
+            res = curl_easy_perform(curl);
+        }
+        recordTransferMetrics(curl, res, performStartUs);
+        throwIfAborted(res);
         long responseCode = 0;
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
-        curl_easy_cleanup(curl);
 
         if (res == CURLE_OK) {
             Logger::instance().info("FTP upload succeeded: " + filename);
@@ -195,7 +347,7 @@ void FtpUploader::uploadFile(const std::string& localFile,
             Logger::instance().warn("FTP upload attempt " + std::to_string(attempt) + " failed: " + lastError);
             if (attempt < maxRetries) {
                 Logger::instance().info("Retrying after backoff...");
-                sleepForBackoff(attempt);
+                sleepForBackoff(attempt, cancel);
             }
         }
     }
@@ -204,3 +356,213 @@ void FtpUploader::uploadFile(const std::string& localFile,
     Logger::instance().error("FTP upload failed after " + std::to_string(maxRetries) + " attempts: " + lastError);
     throw std::runtime_error("FTP upload failed: " + lastError);
 }
+
+void FtpUploader::uploadStream(ReadCallback read, const std::string& remoteDir,
+                               const std::string& filename, std::int64_t size, bool append) {
+    std::string url = buildUrl(remoteDir, filename);
+    Logger::instance().info(std::string(append ? "FTP stream append to URL: " : "FTP stream upload to URL: ") + url);
+
+    CURL* curl = static_cast<CURL*>(prepareHandle(url));
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    if (append) curl_easy_setopt(curl, CURLOPT_APPEND, 1L);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, streamReadCallback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &read);
+    if (size >= 0) {
+        curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(size));
+    }
+    SFB_PROBE2(transfer__start, url.c_str(), static_cast<long long>(size));
+    if (cancel) cancel->throwIfCancelled();
+
+    lastError.clear();
+    double performStartUs = Tracer::instance().nowUs();
+    CURLcode res;
+    {
+        TraceSpan span(append ? "ftp_append_stream" : "ftp_upload_stream", "ftp");
+        res = curl_easy_perform(curl);
+    }
+    recordTransferMetrics(curl, res, performStartUs);
+    throwIfAborted(res);
+    if (res != CURLE_OK) {
+        lastError = curl_easy_strerror(res);
+        Logger::instance().error("FTP stream upload failed: " + lastError);
+        throw std::runtime_error("FTP upload failed: " + lastError);
+    }
+    Logger::instance().info("FTP upload succeeded: " + filename);
+}
+
+void FtpUploader::downloadStream(WriteCallback write, const std::string& remoteDir,
+                                 const std::string& filename, std::int64_t offset, std::int64_t length) {
+    static Counter& downloaded = MetricsRegistry::instance().counter(
+        "sqliteftpbackup_ftp_downloaded_bytes_total", "Bytes received by FTP downloads");
+    if (length == 0) return;
+    std::string url = buildUrl(remoteDir, filename);
+    CURL* curl = static_cast<CURL*>(prepareHandle(url));
+    curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_NONE);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &write);
+    if (offset > 0 || length > 0) {
+        // "first-last" (inclusive) or "first-" for the rest of the file
+        std::string range = std::to_string(offset) + "-"
+                            + (length > 0 ? std::to_string(offset + length - 1) : std::string());
+        curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+    }
+    if (cancel) cancel->throwIfCancelled();
+
+    lastError.clear();
+    CURLcode res;
+    {
+        TraceSpan span("ftp_download", "ftp", "offset", offset);
+        res = curl_easy_perform(curl);
+    }
+    throwIfAborted(res);
+    curl_off_t received = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &received) == CURLE_OK && received > 0) {
+        downloaded.inc(static_cast<std::uint64_t>(received));
+    }
+    if (res != CURLE_OK) {
+        lastError = curl_easy_strerror(res);
+        Logger::instance().error("FTP download of " + url + " failed: " + lastError);
+        throw std::runtime_error("FTP download failed: " + lastError);
+    }
+}
+
+std::vector<RemoteEntry> FtpUploader::listDirectory(const std::string& remoteDir) {
+    // A URL ending in '/' is a directory; the custom request replaces LIST
+    std::string url = buildUrl(remoteDir, "");
+    CURL* curl = static_cast<CURL*>(prepareHandle(url));
+    curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_NONE);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "MLSD");
+    std::string listing;
+    WriteCallback append = [&listing](const char* data, std::size_t len) { listing.append(data, len); };
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &append);
+    if (cancel) cancel->throwIfCancelled();
+
+    CURLcode res;
+    {
+        TraceSpan span("ftp_mlsd", "ftp");
+        res = curl_easy_perform(curl);
+    }
+    throwIfAborted(res);
+    if (res != CURLE_OK) {
+        lastError = curl_easy_strerror(res);
+        throw std::runtime_error("FTP MLSD failed for " + url + ": " + lastError);
+    }
+    return parseMlsd(listing);
+}
+
+std::vector<RemoteEntry> FtpUploader::parseMlsd(const std::string& text) {
+    std::vector<RemoteEntry> entries;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        // Facts end at the first space; the name is everything after it
+        std::size_t space = line.find(' ');
+        if (space == std::string::npos) continue;
+        RemoteEntry entry;
+        entry.name = line.substr(space + 1);
+        std::string type;
+        std::istringstream facts(line.substr(0, space));
+        std::string fact;
+        while (std::getline(facts, fact, ';')) {
+            std::size_t eq = fact.find('=');
+            if (eq == std::string::npos) continue;
+            std::string key = fact.substr(0, eq);
+            std::string value = fact.substr(eq + 1);
+            std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (key == "type") {
+                std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+                type = value;
+            } else if (key == "size") {
+                try { entry.size = std::stoll(value); } catch (const std::exception&) {}
+            } else if (key == "modify" && value.size() >= 14) {
+                // YYYYMMDDHHMMSS[.sss], always UTC
+                std::tm tm{};
+                tm.tm_year = std::atoi(value.substr(0, 4).c_str()) - 1900;
+                tm.tm_mon = std::atoi(value.substr(4, 2).c_str()) - 1;
+                tm.tm_mday = std::atoi(value.substr(6, 2).c_str());
+                tm.tm_hour = std::atoi(value.substr(8, 2).c_str());
+                tm.tm_min = std::atoi(value.substr(10, 2).c_str());
+                tm.tm_sec = std::atoi(value.substr(12, 2).c_str());
+#if defined(_WIN32)
+                entry.modified = _mkgmtime(&tm);
+#else
+                entry.modified = timegm(&tm);
+#endif
+            }
+        }
+        if (type == "cdir" || type == "pdir" || entry.name == "." || entry.name == "..") continue;
+        entry.isDirectory = type == "dir";
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+std::int64_t FtpUploader::getRemoteFileSize(const std::string& remoteDir, const std::string& filename) {
+    std::string url = buildUrl(remoteDir, filename);
+    CURL* curl = static_cast<CURL*>(prepareHandle(url));
+    // NOBODY on an FTP URL sends SIZE (and MDTM) without transferring data
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_NONE);
+
+    TraceSpan span("ftp_size", "ftp");
+    CURLcode res = curl_easy_perform(curl);
+    if (res == CURLE_REMOTE_FILE_NOT_FOUND || res == CURLE_FTP_COULDNT_RETR_FILE
+        || res == CURLE_REMOTE_ACCESS_DENIED) {
+        return -1;
+    }
+    if (res != CURLE_OK) {
+        lastError = curl_easy_strerror(res);
+        throw std::runtime_error("FTP SIZE failed for " + url + ": " + lastError);
+    }
+    curl_off_t length = -1;
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+    return static_cast<std::int64_t>(length);
+}
+
+bool FtpUploader::deleteRemoteFile(const std::string& remoteDir, const std::string& filename) {
+    // DELE runs as a post-quote command on the directory listing URL;
+    // NOBODY skips the listing itself
+    std::string dirUrl = buildUrl(remoteDir, "");
+    CURL* curl = static_cast<CURL*>(prepareHandle(dirUrl));
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_NONE);
+    std::string command = "DELE " + filename;
+    std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> quote(
+        curl_slist_append(nullptr, command.c_str()), &curl_slist_free_all);
+    curl_easy_setopt(curl, CURLOPT_POSTQUOTE, quote.get());
+
+    TraceSpan span("ftp_delete", "ftp");
+    CURLcode res = curl_easy_perform(curl);
+    if (res != CURLE_OK) {
+        lastError = curl_easy_strerror(res);
+        Logger::instance().warn("FTP DELE " + filename + " failed: " + lastError);
+        return false;
+    }
+    Logger::instance().info("Deleted remote file: " + filename);
+    return true;
+}
+
+bool FtpUploader::renameRemoteFile(const std::string& remoteDir, const std::string& from, const std::string& to) {
+    std::string dirUrl = buildUrl(remoteDir, "");
+    CURL* curl = static_cast<CURL*>(prepareHandle(dirUrl));
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_NONE);
+    std::string rnfr = "RNFR " + from;
+    std::string rnto = "RNTO " + to;
+    std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> quote(
+        curl_slist_append(nullptr, rnfr.c_str()), &curl_slist_free_all);
+    curl_slist_append(quote.get(), rnto.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTQUOTE, quote.get());
+
+    TraceSpan span("ftp_rename", "ftp");
+    CURLcode res = curl_easy_perform(curl);
+    if (res != CURLE_OK) {
+        lastError = curl_easy_strerror(res);
+        Logger::instance().warn("FTP rename " + from + " -> " + to + " failed: " + lastError);
+        return false;
+    }
+    Logger::instance().info("Renamed remote file: " + from + " -> " + to);
+    return true;
+}
@@ -0,0 +1,89 @@
+#include "FtpWorkerPool.h"
+#include "FtpUploader.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <string>
+
+FtpWorkerPool::FtpWorkerPool(std::size_t sessions, Factory factory, std::size_t queueDepth)
+    : factory(std::move(factory)),
+      capacity(queueDepth > 0 ? queueDepth : 2 * std::max<std::size_t>(sessions, 1)) {
+    sessions = std::max<std::size_t>(sessions, 1);
+    threads.reserve(sessions);
+    for (std::size_t i = 0; i < sessions; ++i) {
+        threads.emplace_back([this, i] {
+            Tracer::instance().setThreadName("ftp-" + std::to_string(i));
+            workerLoop();
+        });
+    }
+}
+
+FtpWorkerPool::~FtpWorkerPool() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        jobs.clear();
+        idle.wait(lock, [this] { return running == 0; });
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+void FtpWorkerPool::rethrowFailure() {
+    if (failure) {
+        std::exception_ptr first = failure;
+        failure = nullptr;
+        std::rethrow_exception(first);
+    }
+}
+
+void FtpWorkerPool::submit(Job job) {
+    std::unique_lock<std::mutex> lock(mtx);
+    spaceAvailable.wait(lock, [this] { return jobs.size() < capacity || failure; });
+    rethrowFailure();
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    workAvailable.notify_one();
+}
+
+void FtpWorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    idle.wait(lock, [this] { return jobs.empty() && running == 0; });
+    rethrowFailure();
+}
+
+void FtpWorkerPool::workerLoop() {
+    std::unique_ptr<FtpUploader> session;
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            workAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            ++running;
+        }
+        spaceAvailable.notify_one();
+
+        std::exception_ptr error;
+        try {
+            if (!session) session = factory();
+            job(*session);
+        } catch (...) {
+            error = std::current_exception();
+            // The control connection may be mid-command: start the next job on a new one
+            session.reset();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            --running;
+            if (error && !failure) {
+                failure = error;
+                jobs.clear();
+            }
+            if (jobs.empty() && running == 0) idle.notify_all();
+        }
+        if (error) spaceAvailable.notify_all();
+    }
+}
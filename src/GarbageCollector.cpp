@@ -0,0 +1,269 @@
+#include "GarbageCollector.h"
+#include "BackupManifest.h"
+#include "BloomFilter.h"
+#include "ChunkStore.h"
+#include "FtpWorkerPool.h"
+#include "PageDelta.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+namespace {
+    // Deletes per pool job: large enough to amortize the hand-off, small
+    // enough to spread a subdirectory over every session
+    constexpr std::size_t kDeleteBatch = 64;
+
+    bool isHex(const std::string& s, std::size_t length) {
+        return s.size() == length && std::all_of(s.begin(), s.end(), [](char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+        });
+    }
+
+    bool endsWith(const std::string& s, const std::string& suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    std::string stripSuffix(const std::string& s, const std::string& suffix) {
+        return s.substr(0, s.size() - suffix.size());
+    }
+
+    struct FileCloser { void operator()(std::FILE* fp) const { if (fp) std::fclose(fp); } };
+    using TempFile = std::unique_ptr<std::FILE, FileCloser>;
+
+    TempFile makeTempFile() {
+        TempFile file(std::tmpfile());
+        if (!file) throw std::runtime_error("Cannot create a temporary file for garbage collection");
+        return file;
+    }
+
+    void writeLine(std::FILE* fp, const std::string& line) {
+        if (std::fputs(line.c_str(), fp) < 0 || std::fputc('\n', fp) == EOF) {
+            throw std::runtime_error("Write to garbage collection spool failed");
+        }
+    }
+}
+
+GarbageCollector::GarbageCollector(FtpUploader& ftp, FtpWorkerPool& pool, std::string remoteDir)
+    : ftp(ftp), pool(pool), remoteDir(std::move(remoteDir)) {}
+
+std::vector<GarbageCollector::Backup> GarbageCollector::findBackups(const std::vector<RemoteEntry>& entries) {
+    const std::string recipeSuffix = ChunkRecipe::recipeNameFor("");
+    const std::string manifestSuffix = BackupManifest::manifestNameFor("");
+    std::vector<Backup> backups;
+    for (const RemoteEntry& e : entries) {
+        if (e.isDirectory || e.name.find("_backup_") == std::string::npos) continue;
+        if (endsWith(e.name, recipeSuffix)) {
+            backups.push_back({stripSuffix(e.name, recipeSuffix), true, e.modified});
+        } else if (!endsWith(e.name, manifestSuffix)) {
+            backups.push_back({e.name, false, e.modified, PageDelta::isDeltaName(e.name)});
+        }
+    }
+    return backups;
+}
+
+std::vector<GarbageCollector::Backup> GarbageCollector::expired(std::vector<Backup> backups, std::size_t keep) {
+    if (keep == 0 || backups.size() <= keep) return {};
+    // Newest first; names embed the backup time, so they break ties
+    std::sort(backups.begin(), backups.end(), [](const Backup& a, const Backup& b) {
+        return a.modified != b.modified ? a.modified > b.modified : a.name > b.name;
+    });
+    // Databases whose oldest kept backup so far is a delta still need the backups it was built on
+    std::set<std::string> needBase;
+    std::vector<Backup> old;
+    for (std::size_t i = 0; i < backups.size(); ++i) {
+        const Backup& b = backups[i];
+        const std::string db = b.name.substr(0, b.name.find("_backup_"));
+        if (i < keep || needBase.count(db)) {
+            if (b.delta) {
+                needBase.insert(db);
+            } else {
+                needBase.erase(db);
+            }
+        } else {
+            old.push_back(b);
+        }
+    }
+    std::reverse(old.begin(), old.end());
+    return old;
+}
+
+void GarbageCollector::submitDeletes(const std::string& dir, const std::vector<std::string>& names) {
+    for (std::size_t i = 0; i < names.size(); i += kDeleteBatch) {
+        std::vector<std::string> batch(names.begin() + static_cast<std::ptrdiff_t>(i),
+                                       names.begin() + static_cast<std::ptrdiff_t>(std::min(names.size(), i + kDeleteBatch)));
+        pool.submit([this, dir, batch](FtpUploader& session) {
+            for (const std::string& name : batch) {
+                if (session.deleteRemoteFile(dir, name)) continue;
+                ++failedDeletes;
+                std::lock_guard<std::mutex> lock(failedMtx);
+                failedNames.push_back(name);
+            }
+        });
+    }
+}
+
+GcStats GarbageCollector::run(const GcOptions& options) {
+    Logger& log = Logger::instance();
+    TraceSpan span("garbage_collection", "backup");
+    GcStats stats;
+    const std::string prefix = options.dryRun ? "[dry run] " : "";
+
+    // 1. Retention and orphaned manifests
+    const std::vector<RemoteEntry> entries = ftp.listDirectory(remoteDir);
+    std::set<std::string> files;
+    for (const RemoteEntry& e : entries) {
+        if (!e.isDirectory) files.insert(e.name);
+    }
+    std::vector<Backup> backups = findBackups(entries);
+    std::vector<Backup> old = expired(backups, options.keepBackups);
+    std::set<std::string> doomed;
+    std::vector<std::string> backupFiles;
+    for (const Backup& b : old) {
+        doomed.insert(b.name);
+        if (!options.dryRun) stats.deletedBackups.push_back(b.name);
+        backupFiles.push_back(b.chunked ? ChunkRecipe::recipeNameFor(b.name) : b.name);
+        log.info(prefix + "Deleting expired backup " + b.name);
+    }
+    for (const std::string& name : files) {
+        const std::string manifestSuffix = BackupManifest::manifestNameFor("");
+        if (!endsWith(name, manifestSuffix)) continue;
+        const std::string backup = stripSuffix(name, manifestSuffix);
+        if (doomed.count(backup) || !files.count(backup)) {
+            backupFiles.push_back(name);
+            if (!doomed.count(backup)) ++stats.manifestsDeleted;
+        }
+    }
+    // Recipes go first: once a recipe is gone its chunks are unreferenced
+    if (!options.dryRun) {
+        submitDeletes(remoteDir, backupFiles);
+        pool.wait();
+        // A recipe still on the server still references its chunks: mark them live
+        for (const Backup& b : old) {
+            const std::string file = b.chunked ? ChunkRecipe::recipeNameFor(b.name) : b.name;
+            if (std::find(failedNames.begin(), failedNames.end(), file) == failedNames.end()) continue;
+            log.warn("Could not delete expired backup " + b.name + "; keeping it and its chunks");
+            doomed.erase(b.name);
+            stats.deletedBackups.erase(std::remove(stats.deletedBackups.begin(), stats.deletedBackups.end(), b.name),
+                                       stats.deletedBackups.end());
+        }
+    }
+    stats.backupsDeleted = options.dryRun ? old.size() : stats.deletedBackups.size();
+    stats.backupsKept = backups.size() - stats.backupsDeleted;
+
+    const std::string indexDir = ChunkIndex::indexDir(remoteDir);
+    bool hasChunkStore = std::any_of(entries.begin(), entries.end(), [](const RemoteEntry& e) {
+        return e.isDirectory && e.name == ChunkIndex::kChunkDir;
+    });
+    if (!hasChunkStore) {
+        log.info(prefix + "Garbage collection: no chunk store in " + remoteDir);
+        return stats;
+    }
+
+    // 2. Mark. The index lists every stored chunk, so its size bounds the live set.
+    std::int64_t indexBytes = ftp.getRemoteFileSize(indexDir, ChunkIndex::kIndexName);
+    const std::uint64_t idLine = ChunkIndex::chunkId("", 0).size() + 1;
+    const std::uint64_t expectedChunks = std::max<std::uint64_t>(
+        indexBytes > 0 ? static_cast<std::uint64_t>(indexBytes) / idLine : 0, 1 << 16);
+    BloomFilter live(expectedChunks, options.falsePositiveRate);
+    stats.filterBytes = live.memoryBytes();
+    std::mutex liveMtx;
+    std::size_t recipes = 0;
+    for (const Backup& b : backups) {
+        if (!b.chunked || doomed.count(b.name)) continue;
+        ++recipes;
+        const std::string recipeName = ChunkRecipe::recipeNameFor(b.name);
+        pool.submit([this, recipeName, &live, &liveMtx](FtpUploader& session) {
+            std::string text;
+            session.downloadStream([&text](const char* data, std::size_t len) { text.append(data, len); },
+                                   remoteDir, recipeName);
+            ChunkRecipe recipe = ChunkRecipe::parse(text);
+            std::lock_guard<std::mutex> lock(liveMtx);
+            for (const ChunkRef& c : recipe.chunks) live.add(c.id);
+        });
+    }
+    pool.wait();
+    log.info("Marked chunks of " + std::to_string(recipes) + " live recipes in a "
+             + std::to_string(stats.filterBytes) + "-byte filter");
+
+    // 3. Sweep, one subdirectory listing in memory at a time
+    const std::time_t cutoff = std::time(nullptr) - static_cast<std::time_t>(options.minChunkAge.count());
+    TempFile newIndex = makeTempFile();
+    TempFile garbage = makeTempFile();
+    bool warnedNoTimes = false;
+    for (const RemoteEntry& sub : ftp.listDirectory(indexDir)) {
+        // Anything that is not a chunk (or chunk subdirectory) is left alone
+        if (!sub.isDirectory || !isHex(sub.name, 2)) continue;
+        const std::string dir = indexDir + "/" + sub.name;
+        for (const RemoteEntry& chunk : ftp.listDirectory(dir)) {
+            if (chunk.isDirectory || !isHex(chunk.name, idLine - 1)) continue;
+            ++stats.chunksScanned;
+            bool keep = live.mayContain(chunk.name);
+            if (!keep && options.minChunkAge.count() > 0) {
+                if (chunk.modified == 0 && !warnedNoTimes) {
+                    log.warn("Server reports no modification times; unreferenced chunks are kept (minimum age "
+                             + std::to_string(options.minChunkAge.count()) + "s)");
+                    warnedNoTimes = true;
+                }
+                if (chunk.modified == 0 || chunk.modified > cutoff) {
+                    keep = true;
+                    ++stats.chunksTooYoung;
+                }
+            }
+            if (keep) {
+                ++stats.chunksKept;
+                writeLine(newIndex.get(), chunk.name);
+            } else {
+                writeLine(garbage.get(), sub.name + " " + chunk.name);
+                ++stats.chunksDeleted;
+                if (chunk.size > 0) stats.bytesFreed += static_cast<std::uint64_t>(chunk.size);
+            }
+        }
+    }
+
+    if (options.dryRun) {
+        log.info(prefix + "Would delete " + std::to_string(stats.chunksDeleted) + " of "
+                 + std::to_string(stats.chunksScanned) + " chunks (" + std::to_string(stats.bytesFreed) + " bytes)");
+        return stats;
+    }
+
+    // 4. The new index goes up before any chunk is deleted
+    std::fflush(newIndex.get());
+    const long indexSize = std::ftell(newIndex.get());
+    std::rewind(newIndex.get());
+    ftp.uploadStream([&newIndex](char* buf, std::size_t len) { return std::fread(buf, 1, len, newIndex.get()); },
+                     indexDir, ChunkIndex::kIndexName, indexSize);
+
+    std::rewind(garbage.get());
+    std::vector<std::string> batch;
+    std::string batchDir;
+    char line[256];
+    auto flush = [&] {
+        submitDeletes(indexDir + "/" + batchDir, batch);
+        batch.clear();
+    };
+    while (std::fgets(line, sizeof(line), garbage.get())) {
+        std::string entry(line);
+        if (!entry.empty() && entry.back() == '\n') entry.pop_back();
+        const std::size_t space = entry.find(' ');
+        if (space == std::string::npos) continue;
+        std::string dir = entry.substr(0, space);
+        if (dir != batchDir) flush();
+        batchDir = dir;
+        batch.push_back(entry.substr(space + 1));
+    }
+    flush();
+    pool.wait();
+    stats.deleteFailures = failedDeletes.load();
+
+    log.info("Garbage collection of " + remoteDir + ": deleted " + std::to_string(stats.backupsDeleted)
+             + " backups and " + std::to_string(stats.chunksDeleted) + " of " + std::to_string(stats.chunksScanned)
+             + " chunks (" + std::to_string(stats.bytesFreed) + " bytes), " + std::to_string(stats.chunksTooYoung)
+             + " unreferenced chunks too young, " + std::to_string(stats.deleteFailures) + " deletes failed");
+    return stats;
+}
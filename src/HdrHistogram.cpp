@@ -0,0 +1,248 @@
+#include "HdrHistogram.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+    int countLeadingZeros(std::uint64_t v) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        return _BitScanReverse64(&index, v) ? 63 - static_cast<int>(index) : 64;
+#else
+        return v ? __builtin_clzll(v) : 64;
+#endif
+    }
+
+    template <typename T>
+    void storeMin(std::atomic<T>& target, T value) {
+        T cur = target.load(std::memory_order_relaxed);
+        while (value < cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    template <typename T>
+    void storeMax(std::atomic<T>& target, T value) {
+        T cur = target.load(std::memory_order_relaxed);
+        while (value > cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    // One hour in nanoseconds: ample for any single backup step or transfer
+    constexpr std::int64_t kHighestNanos = 3600LL * 1000 * 1000 * 1000;
+}
+
+// -----------------------
+// HdrHistogram
+// -----------------------
+HdrHistogram::HdrHistogram(std::int64_t highest, int significantDigits)
+    : highest(highest), significantDigits(significantDigits), minValue(std::numeric_limits<std::int64_t>::max()) {
+    if (highest < 2) throw std::invalid_argument("HdrHistogram: highest trackable value must be >= 2");
+    if (significantDigits < 1 || significantDigits > 5) {
+        throw std::invalid_argument("HdrHistogram: significant digits must be 1..5");
+    }
+
+    // Sub-buckets must resolve single units up to 2 * 10^digits
+    std::int64_t largestSingleUnit = 2 * static_cast<std::int64_t>(std::pow(10, significantDigits));
+    int subBucketCountMagnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(largestSingleUnit))));
+    subBucketHalfCountMagnitude = std::max(subBucketCountMagnitude, 1) - 1;
+    subBucketCount = 1LL << (subBucketHalfCountMagnitude + 1);
+    subBucketHalfCount = subBucketCount / 2;
+    subBucketMask = subBucketCount - 1;
+
+    // Each further bucket doubles the covered range
+    std::int64_t smallestUntrackable = subBucketCount;
+    bucketCount = 1;
+    while (smallestUntrackable <= highest) {
+        if (smallestUntrackable > std::numeric_limits<std::int64_t>::max() / 2) {
+            ++bucketCount;
+            break;
+        }
+        smallestUntrackable <<= 1;
+        ++bucketCount;
+    }
+
+    countsLength = static_cast<std::size_t>((bucketCount + 1) * subBucketHalfCount);
+    counts.reset(new std::atomic<std::uint64_t>[countsLength]);
+    for (std::size_t i = 0; i < countsLength; ++i) counts[i].store(0, std::memory_order_relaxed);
+}
+
+int HdrHistogram::bucketIndex(std::int64_t value) const {
+    int pow2Ceiling = 64 - countLeadingZeros(static_cast<std::uint64_t>(value | subBucketMask));
+    return pow2Ceiling - (subBucketHalfCountMagnitude + 1);
+}
+
+std::size_t HdrHistogram::countsIndex(std::int64_t value) const {
+    int bucket = bucketIndex(value);
+    std::int64_t subBucket = value >> bucket;
+    std::int64_t bucketBase = static_cast<std::int64_t>(bucket + 1) << subBucketHalfCountMagnitude;
+    return static_cast<std::size_t>(bucketBase + (subBucket - subBucketHalfCount));
+}
+
+std::int64_t HdrHistogram::valueFromIndex(std::size_t index) const {
+    int bucket = static_cast<int>(index >> subBucketHalfCountMagnitude) - 1;
+    std::int64_t subBucket = static_cast<std::int64_t>(index & static_cast<std::size_t>(subBucketHalfCount - 1))
+                             + subBucketHalfCount;
+    if (bucket < 0) {
+        subBucket -= subBucketHalfCount;
+        bucket = 0;
+    }
+    return subBucket << bucket;
+}
+
+std::int64_t HdrHistogram::lowestEquivalentValue(std::int64_t value) const {
+    int bucket = bucketIndex(value);
+    return (value >> bucket) << bucket;
+}
+
+std::int64_t HdrHistogram::highestEquivalentValue(std::int64_t value) const {
+    int bucket = bucketIndex(value);
+    std::int64_t subBucket = value >> bucket;
+    int rangeMagnitude = subBucket >= subBucketCount ? bucket + 1 : bucket;
+    return lowestEquivalentValue(value) + (1LL << rangeMagnitude) - 1;
+}
+
+void HdrHistogram::record(std::int64_t value, std::uint64_t count) {
+    value = std::clamp<std::int64_t>(value, 0, highest);
+    counts[countsIndex(value)].fetch_add(count, std::memory_order_relaxed);
+    totalCount.fetch_add(count, std::memory_order_relaxed);
+    storeMin(minValue, value);
+    storeMax(maxValue, value);
+}
+
+std::int64_t HdrHistogram::valueAtPercentile(double percentile) const {
+    // Sum the buckets themselves so concurrent recording can't skew the target
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < countsLength; ++i) total += counts[i].load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    auto target = static_cast<std::uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+    target = std::max<std::uint64_t>(target, 1);
+
+    std::uint64_t running = 0;
+    for (std::size_t i = 0; i < countsLength; ++i) {
+        running += counts[i].load(std::memory_order_relaxed);
+        if (running >= target) {
+            return std::min(highestEquivalentValue(valueFromIndex(i)), getMax());
+        }
+    }
+    return getMax();
+}
+
+std::int64_t HdrHistogram::getMin() const {
+    return getTotalCount() == 0 ? 0 : minValue.load(std::memory_order_relaxed);
+}
+
+double HdrHistogram::getMean() const {
+    double sum = 0;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < countsLength; ++i) {
+        std::uint64_t c = counts[i].load(std::memory_order_relaxed);
+        if (c == 0) continue;
+        std::int64_t v = valueFromIndex(i);
+        // Midpoint of the slot's equivalent range
+        sum += static_cast<double>(c) * (static_cast<double>(lowestEquivalentValue(v))
+                                         + static_cast<double>(highestEquivalentValue(v))) / 2.0;
+        total += c;
+    }
+    return total ? sum / static_cast<double>(total) : 0.0;
+}
+
+void HdrHistogram::add(const HdrHistogram& other) {
+    if (other.countsLength != countsLength || other.subBucketCount != subBucketCount) {
+        throw std::invalid_argument("HdrHistogram: cannot add histograms with different layouts");
+    }
+    for (std::size_t i = 0; i < countsLength; ++i) {
+        std::uint64_t c = other.counts[i].load(std::memory_order_relaxed);
+        if (c) counts[i].fetch_add(c, std::memory_order_relaxed);
+    }
+    totalCount.fetch_add(other.getTotalCount(), std::memory_order_relaxed);
+    if (other.getTotalCount() > 0) {
+        storeMin(minValue, other.minValue.load(std::memory_order_relaxed));
+        storeMax(maxValue, other.getMax());
+    }
+}
+
+void HdrHistogram::reset() {
+    for (std::size_t i = 0; i < countsLength; ++i) counts[i].store(0, std::memory_order_relaxed);
+    totalCount.store(0);
+    minValue.store(std::numeric_limits<std::int64_t>::max());
+    maxValue.store(0);
+}
+
+// -----------------------
+// LatencyStats
+// -----------------------
+LatencyStats& LatencyStats::instance() {
+    static LatencyStats stats;
+    return stats;
+}
+
+HdrHistogram& LatencyStats::histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto& slot = histograms[name];
+    if (!slot) slot = std::make_unique<HdrHistogram>(kHighestNanos, 3);
+    return *slot;
+}
+
+std::vector<LatencyStats::Summary> LatencyStats::summaries() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Summary> out;
+    for (const auto& [name, hist] : histograms) {
+        if (hist->getTotalCount() == 0) continue;
+        Summary s;
+        s.name = name;
+        s.count = hist->getTotalCount();
+        s.p50 = hist->valueAtPercentile(50);
+        s.p90 = hist->valueAtPercentile(90);
+        s.p99 = hist->valueAtPercentile(99);
+        s.p999 = hist->valueAtPercentile(99.9);
+        s.max = hist->getMax();
+        s.mean = hist->getMean();
+        out.push_back(s);
+    }
+    return out;
+}
+
+void LatencyStats::logSummary() const {
+    // Snapshot first: logging records into the "log_write" histogram
+    std::vector<Summary> all = summaries();
+    Logger& log = Logger::instance();
+    if (all.empty()) return;
+    log.info("Latency summary (count / p50 / p90 / p99 / p99.9 / max):");
+    for (const auto& s : all) {
+        std::ostringstream oss;
+        oss << "  " << s.name << ": " << s.count
+            << " / " << formatNanos(s.p50) << " / " << formatNanos(s.p90)
+            << " / " << formatNanos(s.p99) << " / " << formatNanos(s.p999)
+            << " / " << formatNanos(s.max);
+        log.info(oss.str());
+    }
+}
+
+void LatencyStats::reset() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto& entry : histograms) entry.second->reset();
+}
+
+std::string LatencyStats::formatNanos(std::int64_t ns) {
+    char buf[32];
+    if (ns < 1000) {
+        std::snprintf(buf, sizeof(buf), "%lldns", static_cast<long long>(ns));
+    } else if (ns < 1000 * 1000) {
+        std::snprintf(buf, sizeof(buf), "%.1fus", static_cast<double>(ns) / 1e3);
+    } else if (ns < 1000LL * 1000 * 1000) {
+        std::snprintf(buf, sizeof(buf), "%.2fms", static_cast<double>(ns) / 1e6);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.2fs", static_cast<double>(ns) / 1e9);
+    }
+    return buf;
+}
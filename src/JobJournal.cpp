@@ -0,0 +1,184 @@
+#include "JobJournal.h"
+#include "Logger.h"
+#include "Probes.h"
+#include <memory>
+#include <stdexcept>
+
+namespace {
+    using StmtPtr = std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)>;
+
+    StmtPtr prepare(sqlite3* db, const char* sql) {
+        sqlite3_stmt* raw = nullptr;
+        SFB_PROBE1(stmt__prepare, sql);
+        if (sqlite3_prepare_v2(db, sql, -1, &raw, nullptr) != SQLITE_OK) {
+            throw std::runtime_error(std::string("Journal: failed to prepare statement: ") + sqlite3_errmsg(db));
+        }
+        return StmtPtr(raw, &sqlite3_finalize);
+    }
+
+    void stepDone(sqlite3* db, sqlite3_stmt* stmt) {
+        const char* sql = sqlite3_sql(stmt);
+        SFB_PROBE1(stmt__step__start, sql);
+        int rc = sqlite3_step(stmt);
+        SFB_PROBE2(stmt__step__end, sql, rc);
+        if (rc != SQLITE_DONE) {
+            throw std::runtime_error(std::string("Journal: write failed: ") + sqlite3_errmsg(db));
+        }
+    }
+
+    std::string columnText(sqlite3_stmt* stmt, int col) {
+        const unsigned char* t = sqlite3_column_text(stmt, col);
+        return t ? reinterpret_cast<const char*>(t) : "";
+    }
+}
+
+JobJournal::JobJournal(const std::string& path) : path(path) {
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::string err = db ? sqlite3_errmsg(db) : "unknown error";
+        sqlite3_close(db);
+        db = nullptr;
+        throw std::runtime_error("Can't open job journal " + path + ": " + err);
+    }
+    sqlite3_busy_timeout(db, 5000);
+    exec("PRAGMA journal_mode=WAL;");
+    exec("PRAGMA synchronous=FULL;");
+    exec(R"(CREATE TABLE IF NOT EXISTS jobs(
+        id INTEGER PRIMARY KEY AUTOINCREMENT,
+        stage TEXT NOT NULL,
+        source_db TEXT NOT NULL,
+        artifact TEXT,
+        artifact_size INTEGER DEFAULT 0,
+        artifact_digest TEXT,
+        upload_digest TEXT,
+        remote_dir TEXT,
+        remote_name TEXT,
+        remote_offset INTEGER DEFAULT 0,
+        cipher_salt BLOB,
+        started_at TEXT DEFAULT (strftime('%Y-%m-%dT%H:%M:%SZ','now')),
+        updated_at TEXT DEFAULT (strftime('%Y-%m-%dT%H:%M:%SZ','now'))
+    );)");
+    // Journals written before uploads could be encrypted
+    addColumnIfMissing("cipher_salt", "BLOB");
+    Logger::instance().info("Job journal opened: " + path);
+}
+
+JobJournal::~JobJournal() {
+    if (db) sqlite3_close(db);
+}
+
+void JobJournal::exec(const char* sql) {
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::string e = errMsg ? errMsg : "unknown error";
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Journal: " + e);
+    }
+}
+
+void JobJournal::addColumnIfMissing(const std::string& column, const std::string& definition) {
+    auto stmt = prepare(db, "SELECT 1 FROM pragma_table_info('jobs') WHERE name=?;");
+    sqlite3_bind_text(stmt.get(), 1, column.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt.get()) == SQLITE_ROW) return;
+    exec(("ALTER TABLE jobs ADD COLUMN " + column + " " + definition + ";").c_str());
+}
+
+std::optional<JobRecord> JobJournal::findUnfinished() {
+    auto stmt = prepare(db,
+        "SELECT id, stage, source_db, artifact, artifact_size, artifact_digest, upload_digest, "
+        "remote_dir, remote_name, remote_offset, cipher_salt FROM jobs WHERE stage NOT IN ('done','abandoned') ORDER BY id DESC LIMIT 1;");
+    if (sqlite3_step(stmt.get()) != SQLITE_ROW) return std::nullopt;
+
+    JobRecord r;
+    r.id = sqlite3_column_int64(stmt.get(), 0);
+    r.stage = stageFromString(columnText(stmt.get(), 1));
+    r.sourceDb = columnText(stmt.get(), 2);
+    r.artifact = columnText(stmt.get(), 3);
+    r.artifactSize = sqlite3_column_int64(stmt.get(), 4);
+    r.artifactDigest = columnText(stmt.get(), 5);
+    r.uploadDigest = columnText(stmt.get(), 6);
+    r.remoteDir = columnText(stmt.get(), 7);
+    r.remoteName = columnText(stmt.get(), 8);
+    r.remoteOffset = sqlite3_column_int64(stmt.get(), 9);
+    if (const void* salt = sqlite3_column_blob(stmt.get(), 10)) {
+        const auto* bytes = static_cast<const unsigned char*>(salt);
+        r.cipherSalt.assign(bytes, bytes + sqlite3_column_bytes(stmt.get(), 10));
+    }
+    return r;
+}
+
+std::int64_t JobJournal::begin(const std::string& sourceDb) {
+    auto stmt = prepare(db, "INSERT INTO jobs(stage, source_db) VALUES ('started', ?);");
+    sqlite3_bind_text(stmt.get(), 1, sourceDb.c_str(), -1, SQLITE_TRANSIENT);
+    stepDone(db, stmt.get());
+    return sqlite3_last_insert_rowid(db);
+}
+
+void JobJournal::recordSnapshot(std::int64_t id, const std::string& artifact, std::int64_t size,
+                                const std::string& artifactDigest, const std::vector<unsigned char>& cipherSalt) {
+    auto stmt = prepare(db,
+        "UPDATE jobs SET stage='snapshot', artifact=?, artifact_size=?, artifact_digest=?, cipher_salt=?, "
+        "updated_at=strftime('%Y-%m-%dT%H:%M:%SZ','now') WHERE id=?;");
+    sqlite3_bind_text(stmt.get(), 1, artifact.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt.get(), 2, size);
+    sqlite3_bind_text(stmt.get(), 3, artifactDigest.c_str(), -1, SQLITE_TRANSIENT);
+    if (cipherSalt.empty()) {
+        sqlite3_bind_null(stmt.get(), 4);
+    } else {
+        sqlite3_bind_blob(stmt.get(), 4, cipherSalt.data(), static_cast<int>(cipherSalt.size()), SQLITE_TRANSIENT);
+    }
+    sqlite3_bind_int64(stmt.get(), 5, id);
+    stepDone(db, stmt.get());
+}
+
+void JobJournal::recordUploadProgress(std::int64_t id, const std::string& remoteDir,
+                                      const std::string& remoteName, std::int64_t offset) {
+    auto stmt = prepare(db,
+        "UPDATE jobs SET stage='uploading', remote_dir=?, remote_name=?, remote_offset=?, "
+        "updated_at=strftime('%Y-%m-%dT%H:%M:%SZ','now') WHERE id=?;");
+    sqlite3_bind_text(stmt.get(), 1, remoteDir.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 2, remoteName.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt.get(), 3, offset);
+    sqlite3_bind_int64(stmt.get(), 4, id);
+    stepDone(db, stmt.get());
+}
+
+void JobJournal::markDone(std::int64_t id, const std::string& uploadDigest) {
+    auto stmt = prepare(db,
+        "UPDATE jobs SET stage='done', upload_digest=?, remote_offset=artifact_size, "
+        "updated_at=strftime('%Y-%m-%dT%H:%M:%SZ','now') WHERE id=?;");
+    sqlite3_bind_text(stmt.get(), 1, uploadDigest.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt.get(), 2, id);
+    stepDone(db, stmt.get());
+}
+
+void JobJournal::markAbandoned(std::int64_t id) {
+    setStage(id, JobStage::Abandoned);
+}
+
+void JobJournal::setStage(std::int64_t id, JobStage stage) {
+    auto stmt = prepare(db,
+        "UPDATE jobs SET stage=?, updated_at=strftime('%Y-%m-%dT%H:%M:%SZ','now') WHERE id=?;");
+    std::string s = stageToString(stage);
+    sqlite3_bind_text(stmt.get(), 1, s.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt.get(), 2, id);
+    stepDone(db, stmt.get());
+}
+
+std::string JobJournal::stageToString(JobStage stage) {
+    switch (stage) {
+        case JobStage::Started:   return "started";
+        case JobStage::Snapshot:  return "snapshot";
+        case JobStage::Uploading: return "uploading";
+        case JobStage::Done:      return "done";
+        case JobStage::Abandoned: return "abandoned";
+    }
+    return "started";
+}
+
+JobStage JobJournal::stageFromString(const std::string& s) {
+    if (s == "snapshot")  return JobStage::Snapshot;
+    if (s == "uploading") return JobStage::Uploading;
+    if (s == "done")      return JobStage::Done;
+    if (s == "abandoned") return JobStage::Abandoned;
+    return JobStage::Started;
+}
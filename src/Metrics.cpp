@@ -0,0 +1,319 @@
+#include "Metrics.h"
+#include "Logger.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+#define CLOSE_SOCKET closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+#define CLOSE_SOCKET close
+#endif
+
+// A scraper hanging up mid-response must not kill the process with SIGPIPE
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+namespace {
+    void atomicAdd(std::atomic<double>& target, double delta) {
+        double cur = target.load(std::memory_order_relaxed);
+        while (!target.compare_exchange_weak(cur, cur + delta, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::string formatValue(double v) {
+        if (std::isinf(v)) return v > 0 ? "+Inf" : "-Inf";
+        if (std::isnan(v)) return "NaN";
+        // Shortest text that parses back to the same double (0.1, not 0.10000000000000001)
+        char buf[32];
+        for (int precision = 6; precision <= 17; ++precision) {
+            std::snprintf(buf, sizeof(buf), "%.*g", precision, v);
+            if (std::strtod(buf, nullptr) == v) break;
+        }
+        return buf;
+    }
+
+    std::string escapeHelp(const std::string& help) {
+        std::string out;
+        for (char c : help) {
+            if (c == '\\') out += "\\\\";
+            else if (c == '\n') out += "\\n";
+            else out += c;
+        }
+        return out;
+    }
+
+    // name{labels} with an optional extra label (used for histogram "le")
+    std::string seriesName(const std::string& name, const std::string& labels, const std::string& extra = "") {
+        if (labels.empty() && extra.empty()) return name;
+        std::string joined = labels;
+        if (!extra.empty()) joined += (joined.empty() ? "" : ",") + extra;
+        return name + "{" + joined + "}";
+    }
+
+    // Wait up to timeoutMs for a readable socket; false on timeout
+    bool waitReadable(SocketHandle s, int timeoutMs) {
+#if defined(_WIN32)
+        WSAPOLLFD pfd{s, POLLRDNORM, 0};
+        return WSAPoll(&pfd, 1, timeoutMs) > 0;
+#else
+        pollfd pfd{s, POLLIN, 0};
+        return poll(&pfd, 1, timeoutMs) > 0;
+#endif
+    }
+}
+
+// -----------------------
+// Gauge / Histogram
+// -----------------------
+void Gauge::add(double delta) { atomicAdd(v, delta); }
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds(std::move(bounds)),
+      buckets(new std::atomic<std::uint64_t>[this->bounds.size() + 1]) {
+    for (std::size_t i = 0; i <= this->bounds.size(); ++i) buckets[i].store(0);
+}
+
+void Histogram::observe(double value) {
+    std::size_t i = 0;
+    while (i < bounds.size() && value > bounds[i]) ++i;
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    atomicAdd(sum, value);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snap;
+    snap.bounds = bounds;
+    std::uint64_t running = 0;
+    for (std::size_t i = 0; i <= bounds.size(); ++i) {
+        running += buckets[i].load(std::memory_order_relaxed);
+        snap.cumulative.push_back(running);
+    }
+    snap.sum = sum.load(std::memory_order_relaxed);
+    // Use the bucket total so _count always matches the +Inf bucket
+    snap.count = running;
+    return snap;
+}
+
+std::vector<double> Histogram::latencyBuckets() {
+    return {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+}
+
+// -----------------------
+// MetricsRegistry
+// -----------------------
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Series& MetricsRegistry::findOrAdd(const std::string& name, const std::string& help,
+                                                    const std::string& labels, Type type) {
+    auto it = families.find(name);
+    if (it == families.end()) {
+        it = families.emplace(name, Family{type, help, {}}).first;
+    } else if (it->second.type != type) {
+        throw std::logic_error("Metric " + name + " already registered with a different type");
+    }
+    for (auto& s : it->second.series) {
+        if (s->labels == labels) return *s;
+    }
+    it->second.series.push_back(std::make_unique<Series>());
+    it->second.series.back()->labels = labels;
+    return *it->second.series.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Series& s = findOrAdd(name, help, labels, Type::Counter);
+    if (!s.counter) s.counter = std::make_unique<Counter>();
+    return *s.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Series& s = findOrAdd(name, help, labels, Type::Gauge);
+    if (!s.gauge) s.gauge = std::make_unique<Gauge>();
+    return *s.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const std::string& labels, const std::vector<double>& bounds) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Series& s = findOrAdd(name, help, labels, Type::Histogram);
+    if (!s.histogram) s.histogram = std::make_unique<Histogram>(bounds);
+    return *s.histogram;
+}
+
+std::string MetricsRegistry::renderPrometheus() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::ostringstream out;
+    for (const auto& [name, family] : families) {
+        const char* type = family.type == Type::Counter ? "counter"
+                         : family.type == Type::Gauge   ? "gauge" : "histogram";
+        out << "# HELP " << name << " " << escapeHelp(family.help) << "\n";
+        out << "# TYPE " << name << " " << type << "\n";
+        for (const auto& s : family.series) {
+            if (s->counter) {
+                out << seriesName(name, s->labels) << " " << s->counter->value() << "\n";
+            } else if (s->gauge) {
+                out << seriesName(name, s->labels) << " " << formatValue(s->gauge->value()) << "\n";
+            } else if (s->histogram) {
+                Histogram::Snapshot snap = s->histogram->snapshot();
+                for (std::size_t i = 0; i < snap.bounds.size(); ++i) {
+                    out << seriesName(name + "_bucket", s->labels, "le=\"" + formatValue(snap.bounds[i]) + "\"")
+                        << " " << snap.cumulative[i] << "\n";
+                }
+                out << seriesName(name + "_bucket", s->labels, "le=\"+Inf\"") << " " << snap.count << "\n";
+                out << seriesName(name + "_sum", s->labels) << " " << formatValue(snap.sum) << "\n";
+                out << seriesName(name + "_count", s->labels) << " " << snap.count << "\n";
+            }
+        }
+    }
+    return out.str();
+}
+
+void MetricsRegistry::writeTextfile(const std::string& path) const {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs) throw std::runtime_error("Cannot write metrics file: " + tmp);
+        ofs << renderPrometheus();
+        if (!ofs.flush()) throw std::runtime_error("Cannot write metrics file: " + tmp);
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        throw std::runtime_error("Cannot move metrics file into place: " + path);
+    }
+}
+
+// -----------------------
+// MetricsServer
+// -----------------------
+MetricsServer::MetricsServer(MetricsRegistry& registry, int port, const std::string& bindAddress)
+    : registry(registry), port(port), bindAddress(bindAddress) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+void MetricsServer::start() {
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) throw std::runtime_error("WSAStartup failed");
+#endif
+    SocketHandle s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == static_cast<SocketHandle>(-1)) throw std::runtime_error("Metrics server: socket() failed");
+
+    int yes = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<unsigned short>(port));
+    if (inet_pton(AF_INET, bindAddress.c_str(), &addr.sin_addr) != 1) {
+        CLOSE_SOCKET(s);
+        throw std::runtime_error("Metrics server: invalid bind address " + bindAddress);
+    }
+    if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 16) != 0) {
+        CLOSE_SOCKET(s);
+        throw std::runtime_error("Metrics server: cannot listen on " + bindAddress + ":" + std::to_string(port));
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len);
+    port = ntohs(addr.sin_port);
+
+    listenSocket = static_cast<std::intptr_t>(s);
+    running.store(true);
+    thread = std::thread(&MetricsServer::serve, this);
+    Logger::instance().info("Metrics endpoint listening on http://" + bindAddress + ":" + std::to_string(port) + "/metrics");
+}
+
+void MetricsServer::stop() {
+    if (!running.exchange(false)) return;
+    if (thread.joinable()) thread.join();
+    CLOSE_SOCKET(static_cast<SocketHandle>(listenSocket));
+    listenSocket = -1;
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+std::string MetricsServer::handleRequest(const std::string& request) const {
+    std::istringstream iss(request);
+    std::string method, target;
+    iss >> method >> target;
+
+    std::string status = "200 OK";
+    std::string contentType = "text/plain; version=0.0.4; charset=utf-8";
+    std::string body;
+    if (method != "GET" && method != "HEAD") {
+        status = "405 Method Not Allowed";
+        body = "Method not allowed\n";
+    } else if (target == "/metrics" || target.rfind("/metrics?", 0) == 0) {
+        body = registry.renderPrometheus();
+    } else {
+        status = "404 Not Found";
+        body = "Not found; try /metrics\n";
+    }
+
+    std::ostringstream resp;
+    resp << "HTTP/1.1 " << status << "\r\n"
+         << "Content-Type: " << contentType << "\r\n"
+         << "Content-Length: " << body.size() << "\r\n"
+         << "Connection: close\r\n\r\n";
+    if (method != "HEAD") resp << body;
+    return resp.str();
+}
+
+void MetricsServer::serve() {
+    const SocketHandle listener = static_cast<SocketHandle>(listenSocket);
+    while (running.load()) {
+        // Short poll so stop() is noticed promptly
+        if (!waitReadable(listener, 200)) continue;
+        SocketHandle client = accept(listener, nullptr, nullptr);
+        if (client == static_cast<SocketHandle>(-1)) continue;
+
+        // Only the request line matters; read until the header ends or 8 KiB
+        std::string request;
+        char buf[1024];
+        while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos
+               && waitReadable(client, 2000)) {
+            int n = recv(client, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            request.append(buf, static_cast<std::size_t>(n));
+        }
+
+        std::string response = handleRequest(request);
+        std::size_t sent = 0;
+        while (sent < response.size()) {
+            int n = send(client, response.data() + sent, static_cast<int>(response.size() - sent), kSendFlags);
+            if (n <= 0) break;
+            sent += static_cast<std::size_t>(n);
+        }
+        CLOSE_SOCKET(client);
+    }
+}
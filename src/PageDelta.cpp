@@ -0,0 +1,246 @@
+#include "PageDelta.h"
+#include "Checksum.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    constexpr char kMagic[8] = {'S', 'F', 'B', 'D', 'E', 'L', 'T', 'A'};
+    constexpr char kMapMagic[8] = {'S', 'F', 'B', 'P', 'A', 'G', 'E', 'S'};
+    constexpr std::uint32_t kVersion = 1;
+
+    // Files are read this many bytes at a time (whole pages)
+    constexpr std::size_t kReadBytes = 4u << 20;
+    // A run is flushed at this many pages, bounding the pages held in memory
+    constexpr std::uint32_t kMaxRunPages = 1024;
+
+    void putU32(std::string& out, std::uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+
+    void putU64(std::string& out, std::uint64_t v) {
+        for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+
+    std::uint64_t getLE(const unsigned char* p, int bytes) {
+        std::uint64_t v = 0;
+        for (int i = bytes - 1; i >= 0; --i) v = (v << 8) | p[i];
+        return v;
+    }
+
+    void readExactly(std::istream& in, void* buf, std::size_t len, const std::string& file) {
+        in.read(static_cast<char*>(buf), static_cast<std::streamsize>(len));
+        if (static_cast<std::size_t>(in.gcount()) != len) throw std::runtime_error("Unexpected end of " + file);
+    }
+
+    std::ifstream openForRead(const std::string& file) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) throw std::runtime_error("Cannot open " + file);
+        return in;
+    }
+
+    // Page size from the database header; the file must be whole pages
+    std::uint32_t databasePageSize(const std::string& dbFile) {
+        unsigned char header[100];
+        std::ifstream in = openForRead(dbFile);
+        readExactly(in, header, sizeof(header), dbFile);
+        if (std::memcmp(header, "SQLite format 3", 16) != 0) {
+            throw std::runtime_error(dbFile + " is not an SQLite database");
+        }
+        std::uint32_t size = (static_cast<std::uint32_t>(header[16]) << 8) | header[17];
+        if (size == 1) size = 65536;
+        if (size < 512 || (size & (size - 1)) != 0) {
+            throw std::runtime_error(dbFile + " has an invalid page size " + std::to_string(size));
+        }
+        if (std::filesystem::file_size(dbFile) % size != 0) {
+            throw std::runtime_error(dbFile + " is not a whole number of " + std::to_string(size) + "-byte pages");
+        }
+        return size;
+    }
+
+    // Calls fn(pageNumber, page) for every page, in order
+    template <typename Fn>
+    void forEachPage(const std::string& dbFile, std::uint32_t pageSize, Fn&& fn) {
+        std::ifstream in = openForRead(dbFile);
+        std::vector<char> buf(std::max<std::size_t>(kReadBytes / pageSize, 1) * pageSize);
+        std::uint64_t page = 0;
+        for (;;) {
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            const std::size_t n = static_cast<std::size_t>(in.gcount());
+            for (std::size_t off = 0; off + pageSize <= n; off += pageSize) fn(page++, buf.data() + off);
+            if (n < buf.size()) break;
+        }
+        if (in.bad()) throw std::runtime_error("Read of " + dbFile + " failed");
+    }
+}
+
+void PageMap::save(const std::string& path, std::int64_t backupId) const {
+    std::string header(kMapMagic, sizeof(kMapMagic));
+    putU32(header, kVersion);
+    putU32(header, pageSize);
+    putU64(header, static_cast<std::uint64_t>(backupId));
+    putU64(header, hashes.size());
+    std::string body;
+    body.reserve(hashes.size() * 8);
+    for (std::uint64_t h : hashes) putU64(body, h);
+
+    // Replaced atomically: a torn map would yield deltas against the wrong pages
+    const std::string part = path + ".part";
+    {
+        std::ofstream out(part, std::ios::binary | std::ios::trunc);
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+        out.write(body.data(), static_cast<std::streamsize>(body.size()));
+        out.close();
+        if (out.fail()) throw std::runtime_error("Write to " + part + " failed");
+    }
+    std::filesystem::rename(part, path);
+}
+
+std::optional<std::pair<std::int64_t, PageMap>> PageMap::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return std::nullopt;
+    unsigned char header[32];
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (in.gcount() != sizeof(header) || std::memcmp(header, kMapMagic, sizeof(kMapMagic)) != 0
+        || getLE(header + 8, 4) != kVersion) {
+        return std::nullopt;
+    }
+    PageMap map;
+    map.pageSize = static_cast<std::uint32_t>(getLE(header + 12, 4));
+    const auto id = static_cast<std::int64_t>(getLE(header + 16, 8));
+    const std::uint64_t count = getLE(header + 24, 8);
+    std::vector<unsigned char> body(static_cast<std::size_t>(count) * 8);
+    in.read(reinterpret_cast<char*>(body.data()), static_cast<std::streamsize>(body.size()));
+    if (static_cast<std::size_t>(in.gcount()) != body.size()) return std::nullopt;
+    map.hashes.resize(static_cast<std::size_t>(count));
+    for (std::size_t i = 0; i < map.hashes.size(); ++i) map.hashes[i] = getLE(body.data() + 8 * i, 8);
+    return std::make_pair(id, std::move(map));
+}
+
+bool PageDelta::isDeltaName(const std::string& remoteName) {
+    auto endsWith = [&remoteName](const std::string& suffix) {
+        return remoteName.size() >= suffix.size()
+               && remoteName.compare(remoteName.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return endsWith(kSuffix) || endsWith(std::string(kSuffix) + ".enc");
+}
+
+std::uint32_t PageDelta::pageSize(const std::string& dbFile) {
+    return databasePageSize(dbFile);
+}
+
+PageMap PageDelta::hashPages(const std::string& dbFile) {
+    PageMap map;
+    map.pageSize = databasePageSize(dbFile);
+    map.hashes.reserve(static_cast<std::size_t>(std::filesystem::file_size(dbFile) / map.pageSize));
+    forEachPage(dbFile, map.pageSize, [&map](std::uint64_t, const char* page) {
+        map.hashes.push_back(Checksum::xxh3(page, map.pageSize));
+    });
+    return map;
+}
+
+PageDeltaStats PageDelta::write(const std::string& dbFile, const PageMap& base, const std::string& deltaFile,
+                                PageMap& pages) {
+    pages.pageSize = databasePageSize(dbFile);
+    pages.hashes.clear();
+    if (pages.pageSize != base.pageSize) {
+        throw std::runtime_error("Page size of " + dbFile + " changed from " + std::to_string(base.pageSize)
+                                 + " to " + std::to_string(pages.pageSize) + ": a full backup is needed");
+    }
+    const std::uint32_t pageSize = pages.pageSize;
+    const std::uint64_t pageCount = std::filesystem::file_size(dbFile) / pageSize;
+    pages.hashes.reserve(static_cast<std::size_t>(pageCount));
+
+    std::ofstream out(deltaFile, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot create " + deltaFile);
+    std::string header(kMagic, sizeof(kMagic));
+    putU32(header, kVersion);
+    putU32(header, pageSize);
+    putU64(header, base.pageCount());
+    putU64(header, pageCount);
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    PageDeltaStats stats;
+    stats.pages = pageCount;
+    std::uint64_t runStart = 0;
+    std::string run;   // pages of the run being collected
+    auto flush = [&] {
+        if (run.empty()) return;
+        std::string head;
+        putU64(head, runStart);
+        putU32(head, static_cast<std::uint32_t>(run.size() / pageSize));
+        out.write(head.data(), static_cast<std::streamsize>(head.size()));
+        out.write(run.data(), static_cast<std::streamsize>(run.size()));
+        ++stats.runs;
+        run.clear();
+    };
+    forEachPage(dbFile, pageSize, [&](std::uint64_t page, const char* data) {
+        const std::uint64_t hash = Checksum::xxh3(data, pageSize);
+        pages.hashes.push_back(hash);
+        if (page < base.pageCount() && base.hashes[static_cast<std::size_t>(page)] == hash) {
+            flush();
+            return;
+        }
+        if (!run.empty() && (runStart + run.size() / pageSize != page || run.size() / pageSize >= kMaxRunPages)) {
+            flush();
+        }
+        if (run.empty()) runStart = page;
+        run.append(data, pageSize);
+        ++stats.changedPages;
+    });
+    flush();
+    out.close();
+    if (out.fail()) throw std::runtime_error("Write to " + deltaFile + " failed");
+    if (pages.pageCount() != pageCount) throw std::runtime_error(dbFile + " changed while the delta was written");
+    stats.bytes = std::filesystem::file_size(deltaFile);
+    return stats;
+}
+
+PageDeltaStats PageDelta::apply(const std::string& deltaFile, const std::string& dbFile) {
+    std::ifstream in = openForRead(deltaFile);
+    unsigned char header[32];
+    readExactly(in, header, sizeof(header), deltaFile);
+    if (std::memcmp(header, kMagic, sizeof(kMagic)) != 0 || getLE(header + 8, 4) != kVersion) {
+        throw std::runtime_error(deltaFile + " is not a page delta");
+    }
+    const auto pageSize = static_cast<std::uint32_t>(getLE(header + 12, 4));
+    const std::uint64_t basePages = getLE(header + 16, 8);
+    PageDeltaStats stats;
+    stats.pages = getLE(header + 24, 8);
+    if (pageSize == 0 || std::filesystem::file_size(dbFile) != basePages * pageSize) {
+        throw std::runtime_error(deltaFile + " does not follow " + dbFile + ": expected "
+                                 + std::to_string(basePages) + " pages of " + std::to_string(pageSize) + " bytes");
+    }
+
+    {
+        std::fstream db(dbFile, std::ios::binary | std::ios::in | std::ios::out);
+        if (!db) throw std::runtime_error("Cannot open " + dbFile);
+        std::vector<char> buf;
+        unsigned char runHeader[12];
+        for (;;) {
+            in.read(reinterpret_cast<char*>(runHeader), sizeof(runHeader));
+            if (in.gcount() == 0 && in.eof()) break;
+            if (in.gcount() != sizeof(runHeader)) throw std::runtime_error("Truncated run header in " + deltaFile);
+            const std::uint64_t first = getLE(runHeader, 8);
+            const auto count = static_cast<std::uint32_t>(getLE(runHeader + 8, 4));
+            if (count == 0 || count > kMaxRunPages || first + count > stats.pages) {
+                throw std::runtime_error("Bad run of " + std::to_string(count) + " pages at page "
+                                         + std::to_string(first) + " in " + deltaFile);
+            }
+            buf.resize(static_cast<std::size_t>(count) * pageSize);
+            readExactly(in, buf.data(), buf.size(), deltaFile);
+            db.seekp(static_cast<std::streamoff>(first * pageSize));
+            db.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+            stats.changedPages += count;
+            ++stats.runs;
+        }
+        db.close();
+        if (db.fail()) throw std::runtime_error("Write to " + dbFile + " failed");
+    }
+    // A shrunk database drops its tail; a grown one got every new page from the delta
+    std::filesystem::resize_file(dbFile, stats.pages * pageSize);
+    stats.bytes = std::filesystem::file_size(deltaFile);
+    return stats;
+}
@@ -0,0 +1,206 @@
+#include "PerfCounters.h"
+#include "Logger.h"
+#include <cstdio>
+#include <sstream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+    std::atomic<bool> warnedUnavailable{false};
+
+#if defined(__linux__)
+    struct EventSpec {
+        std::uint32_t type;
+        std::uint64_t config;
+    };
+
+    // Same order as PerfEvent
+    const EventSpec kEventSpecs[PerfSample::kEvents] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    };
+
+    int openCounter(const EventSpec& spec, int& lastErrno) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = spec.type;
+        attr.config = spec.config;
+        attr.disabled = 1;
+        attr.inherit = 1;   // include threads spawned during the phase
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // Kernel time matters for syscall-heavy phases; fall back to user
+        // space only when perf_event_paranoid forbids it
+        for (int excludeKernel = 0; excludeKernel <= 1; ++excludeKernel) {
+            attr.exclude_kernel = excludeKernel;
+            long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fd >= 0) return static_cast<int>(fd);
+            lastErrno = errno;
+            if (errno != EACCES && errno != EPERM) break;
+        }
+        return -1;
+    }
+
+    // Counter value, scaled up if the PMU multiplexed it
+    bool readCounter(int fd, std::uint64_t& value) {
+        std::uint64_t data[3] = {0, 0, 0};  // value, time enabled, time running
+        if (read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) return false;
+        if (data[2] == 0) {
+            value = 0;
+        } else if (data[2] < data[1]) {
+            value = static_cast<std::uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+        } else {
+            value = data[0];
+        }
+        return true;
+    }
+#endif
+}
+
+// -----------------------
+// PerfSample
+// -----------------------
+double PerfSample::ipc() const {
+    if (!has(PerfEvent::Cycles) || !has(PerfEvent::Instructions) || get(PerfEvent::Cycles) == 0) return 0.0;
+    return static_cast<double>(get(PerfEvent::Instructions)) / static_cast<double>(get(PerfEvent::Cycles));
+}
+
+double PerfSample::perMiB(PerfEvent e) const {
+    if (!has(e) || bytes == 0) return 0.0;
+    return static_cast<double>(get(e)) / (static_cast<double>(bytes) / (1024.0 * 1024.0));
+}
+
+// -----------------------
+// PerfCounters
+// -----------------------
+PerfCounters& PerfCounters::instance() {
+    static PerfCounters counters;
+    return counters;
+}
+
+void PerfCounters::accumulate(const std::string& phase, const PerfSample& sample) {
+    std::lock_guard<std::mutex> lock(mtx);
+    PerfSample& acc = phases[phase];
+    for (std::size_t i = 0; i < PerfSample::kEvents; ++i) {
+        acc.values[i] += sample.values[i];
+        // A counter is only reported if it worked every time
+        acc.available[i] = (acc.runs == 0 ? true : acc.available[i]) && sample.available[i];
+    }
+    acc.runs += 1;
+    acc.bytes += sample.bytes;
+    acc.seconds += sample.seconds;
+}
+
+std::map<std::string, PerfSample> PerfCounters::results() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return phases;
+}
+
+void PerfCounters::reset() {
+    std::lock_guard<std::mutex> lock(mtx);
+    phases.clear();
+}
+
+const char* PerfCounters::eventName(PerfEvent e) {
+    switch (e) {
+        case PerfEvent::Cycles:          return "cycles";
+        case PerfEvent::Instructions:    return "instructions";
+        case PerfEvent::CacheMisses:     return "cache-misses";
+        case PerfEvent::BranchMisses:    return "branch-misses";
+        case PerfEvent::ContextSwitches: return "context-switches";
+        case PerfEvent::PageFaults:      return "page-faults";
+        case PerfEvent::Count:           break;
+    }
+    return "unknown";
+}
+
+void PerfCounters::logSummary() const {
+    auto all = results();
+    if (all.empty()) return;
+    Logger& log = Logger::instance();
+    log.info("Perf counters per phase:");
+    for (const auto& [name, s] : all) {
+        std::ostringstream oss;
+        oss.setf(std::ios::fixed);
+        oss.precision(3);
+        oss << "  " << name << ": " << s.seconds << "s";
+        if (s.has(PerfEvent::Cycles) && s.has(PerfEvent::Instructions)) {
+            oss.precision(2);
+            oss << ", IPC " << s.ipc();
+        }
+        for (PerfEvent e : {PerfEvent::CacheMisses, PerfEvent::BranchMisses,
+                            PerfEvent::ContextSwitches, PerfEvent::PageFaults}) {
+            if (!s.has(e)) continue;
+            oss << ", " << eventName(e) << " " << s.get(e);
+            if (s.bytes > 0) {
+                oss.precision(1);
+                oss << " (" << s.perMiB(e) << "/MiB)";
+            }
+        }
+        if (s.bytes > 0) oss << ", " << s.bytes << " bytes";
+        log.info(oss.str());
+    }
+}
+
+// -----------------------
+// PerfPhase
+// -----------------------
+PerfPhase::PerfPhase(std::string name)
+    : active(PerfCounters::instance().isEnabled()), name(std::move(name)) {
+    fds.fill(-1);
+    if (!active) return;
+#if defined(__linux__)
+    int lastErrno = 0;
+    std::string missing;
+    for (std::size_t i = 0; i < PerfSample::kEvents; ++i) {
+        fds[i] = openCounter(kEventSpecs[i], lastErrno);
+        if (fds[i] < 0) missing += std::string(missing.empty() ? "" : ", ") + PerfCounters::eventName(static_cast<PerfEvent>(i));
+    }
+    if (!missing.empty() && !warnedUnavailable.exchange(true)) {
+        std::string hint = (lastErrno == EACCES || lastErrno == EPERM)
+                               ? "; check /proc/sys/kernel/perf_event_paranoid"
+                               : "; the CPU's PMU may not be exposed (e.g. inside a VM)";
+        Logger::instance().warn("Perf counters unavailable (" + missing + "): " + std::strerror(lastErrno) + hint);
+    }
+    for (int fd : fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#else
+    if (!warnedUnavailable.exchange(true)) {
+        Logger::instance().warn("Perf counters are only supported on Linux; recording wall time only");
+    }
+#endif
+    start = std::chrono::steady_clock::now();
+}
+
+PerfPhase::~PerfPhase() {
+    if (!active) return;
+    PerfSample sample;
+    sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sample.bytes = bytes;
+#if defined(__linux__)
+    for (std::size_t i = 0; i < PerfSample::kEvents; ++i) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        sample.available[i] = readCounter(fds[i], sample.values[i]);
+        close(fds[i]);
+    }
+#endif
+    PerfCounters::instance().accumulate(name, sample);
+}
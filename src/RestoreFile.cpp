@@ -0,0 +1,120 @@
+#include "RestoreFile.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#if defined(_WIN32)
+namespace {
+    std::string lastErrorText() {
+        return "error " + std::to_string(GetLastError());
+    }
+}
+
+RestoreFile::RestoreFile(const std::string& path, std::uint64_t size) : filePath(path), fileSize(size) {
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot create " + path + ": " + lastErrorText());
+    handle = h;
+
+    FILE_ALLOCATION_INFO alloc{};
+    alloc.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+    reserved = SetFileInformationByHandle(h, FileAllocationInfo, &alloc, sizeof(alloc)) != 0;
+    FILE_END_OF_FILE_INFO eof{};
+    eof.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFileInformationByHandle(h, FileEndOfFileInfo, &eof, sizeof(eof))) {
+        std::string err = lastErrorText();
+        CloseHandle(h);
+        handle = nullptr;
+        throw std::runtime_error("Cannot size " + path + ": " + err);
+    }
+}
+
+RestoreFile::~RestoreFile() {
+    if (handle) CloseHandle(static_cast<HANDLE>(handle));
+}
+
+void RestoreFile::writeAt(std::uint64_t offset, const void* data, std::size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        OVERLAPPED at{};
+        at.Offset = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(len, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(static_cast<HANDLE>(handle), p, chunk, &written, &at) || written == 0) {
+            throw std::runtime_error("Write to " + filePath + " failed: " + lastErrorText());
+        }
+        p += written;
+        offset += written;
+        len -= written;
+    }
+}
+
+void RestoreFile::close() {
+    if (!handle) return;
+    HANDLE h = static_cast<HANDLE>(handle);
+    handle = nullptr;
+    bool ok = FlushFileBuffers(h) != 0;
+    std::string err = ok ? std::string() : lastErrorText();
+    CloseHandle(h);
+    if (!ok) throw std::runtime_error("Flush of " + filePath + " failed: " + err);
+}
+#else
+RestoreFile::RestoreFile(const std::string& path, std::uint64_t size) : filePath(path), fileSize(size) {
+    fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot create " + path + ": " + std::strerror(errno));
+
+    int rc = 0;
+#if defined(__linux__)
+    rc = size > 0 ? posix_fallocate(fd, 0, static_cast<off_t>(size)) : 0;
+    reserved = rc == 0;
+    // Filesystems without fallocate still get the size, as a sparse file
+    if (rc == EOPNOTSUPP || rc == EINVAL) rc = 0;
+#endif
+    if (rc == 0 && ftruncate(fd, static_cast<off_t>(size)) != 0) rc = errno;
+    if (rc != 0) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error("Cannot reserve " + std::to_string(size) + " bytes for " + path + ": "
+                                 + std::strerror(rc));
+    }
+}
+
+RestoreFile::~RestoreFile() {
+    if (fd >= 0) ::close(fd);
+}
+
+void RestoreFile::writeAt(std::uint64_t offset, const void* data, std::size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            throw std::runtime_error("Write to " + filePath + " failed: " + (n < 0 ? std::strerror(errno) : "no progress"));
+        }
+        p += n;
+        offset += static_cast<std::uint64_t>(n);
+        len -= static_cast<std::size_t>(n);
+    }
+}
+
+void RestoreFile::close() {
+    if (fd < 0) return;
+    int rc = fsync(fd) == 0 ? 0 : errno;
+    if (::close(fd) != 0 && rc == 0) rc = errno;
+    fd = -1;
+    if (rc != 0) throw std::runtime_error("Flush of " + filePath + " failed: " + std::strerror(rc));
+}
+#endif
@@ -0,0 +1,285 @@
+#include "Scheduler.h"
+#include "Logger.h"
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    using Clock = std::chrono::system_clock;
+
+    std::tm toLocal(std::time_t t) {
+        std::tm tm_now;
+#if defined(_WIN32)
+        localtime_s(&tm_now, &t);
+#else
+        localtime_r(&t, &tm_now);
+#endif
+        return tm_now;
+    }
+
+    std::string formatLocal(Clock::time_point tp) {
+        std::tm tm_now = toLocal(Clock::to_time_t(tp));
+        std::ostringstream oss;
+        oss << std::put_time(&tm_now, "%Y-%m-%d %H:%M:%S");
+        return oss.str();
+    }
+
+    // Let mktime fold overflowing fields (minute 60, day 32, ...) back into range
+    std::time_t normalize(std::tm& tm) {
+        tm.tm_isdst = -1;
+        return std::mktime(&tm);
+    }
+
+    std::vector<std::string> split(const std::string& s, char sep) {
+        std::vector<std::string> out;
+        std::string item;
+        std::istringstream iss(s);
+        while (std::getline(iss, item, sep)) out.push_back(item);
+        return out;
+    }
+
+    int parseNumber(const std::string& s, const std::string& field) {
+        if (s.empty() || !std::all_of(s.begin(), s.end(), ::isdigit)) {
+            throw std::invalid_argument("Invalid number '" + s + "' in cron field '" + field + "'");
+        }
+        return std::stoi(s);
+    }
+
+    // Parse one cron field into a bitset; returns true if the field was not '*'
+    template<std::size_t N>
+    bool parseField(const std::string& field, int lo, int hi, std::bitset<N>& bits) {
+        bool restricted = false;
+        for (const auto& part : split(field, ',')) {
+            std::string range = part;
+            int step = 1;
+            auto slash = part.find('/');
+            if (slash != std::string::npos) {
+                range = part.substr(0, slash);
+                step = parseNumber(part.substr(slash + 1), field);
+                if (step <= 0) throw std::invalid_argument("Cron step must be > 0 in '" + field + "'");
+            }
+
+            int from = lo, to = hi;
+            if (range == "*") {
+                if (step != 1) restricted = true;
+            } else {
+                restricted = true;
+                auto dash = range.find('-');
+                if (dash != std::string::npos) {
+                    from = parseNumber(range.substr(0, dash), field);
+                    to = parseNumber(range.substr(dash + 1), field);
+                } else {
+                    from = parseNumber(range, field);
+                    to = (slash != std::string::npos) ? hi : from;
+                }
+            }
+
+            if (from < lo || to > hi || from > to) {
+                throw std::invalid_argument("Cron field '" + field + "' out of range "
+                                            + std::to_string(lo) + "-" + std::to_string(hi));
+            }
+            for (int v = from; v <= to; v += step) bits.set(static_cast<std::size_t>(v));
+        }
+        return restricted;
+    }
+
+    std::chrono::seconds parseInterval(const std::string& spec, bool& ok) {
+        ok = false;
+        std::string s = spec;
+        if (s.rfind("@every", 0) == 0) {
+            s = s.substr(6);
+            s.erase(0, s.find_first_not_of(' '));
+        }
+        if (s.empty() || s.find(' ') != std::string::npos) return std::chrono::seconds(0);
+
+        long long mult = 1;
+        char unit = s.back();
+        if (!::isdigit(static_cast<unsigned char>(unit))) {
+            switch (unit) {
+                case 's': mult = 1; break;
+                case 'm': mult = 60; break;
+                case 'h': mult = 3600; break;
+                case 'd': mult = 86400; break;
+                default: return std::chrono::seconds(0);
+            }
+            s.pop_back();
+        }
+        if (s.empty() || !std::all_of(s.begin(), s.end(), ::isdigit)) return std::chrono::seconds(0);
+
+        ok = true;
+        return std::chrono::seconds(std::stoll(s) * mult);
+    }
+}
+
+// -----------------------
+// CronExpression
+// -----------------------
+CronExpression::CronExpression(const std::string& exprIn) : expr(exprIn) {
+    std::string e = expr;
+    if (e == "@hourly")       e = "0 * * * *";
+    else if (e == "@daily")   e = "0 0 * * *";
+    else if (e == "@weekly")  e = "0 0 * * 0";
+    else if (e == "@monthly") e = "0 0 1 * *";
+
+    std::istringstream iss(e);
+    std::vector<std::string> fields;
+    std::string f;
+    while (iss >> f) fields.push_back(f);
+    if (fields.size() != 5) {
+        throw std::invalid_argument("Cron expression must have 5 fields: '" + expr + "'");
+    }
+
+    parseField(fields[0], 0, 59, minutes);
+    parseField(fields[1], 0, 23, hours);
+    domRestricted = parseField(fields[2], 1, 31, daysOfMonth);
+    parseField(fields[3], 1, 12, months);
+    dowRestricted = parseField(fields[4], 0, 7, daysOfWeek);
+    if (daysOfWeek.test(7)) daysOfWeek.set(0); // 7 is an alias for Sunday
+}
+
+bool CronExpression::dayMatches(int mday, int wday) const {
+    bool dom = daysOfMonth.test(static_cast<std::size_t>(mday));
+    bool dow = daysOfWeek.test(static_cast<std::size_t>(wday));
+    // cron(8): if both fields are restricted, either one matching is enough
+    if (domRestricted && dowRestricted) return dom || dow;
+    if (domRestricted) return dom;
+    if (dowRestricted) return dow;
+    return true;
+}
+
+CronExpression::TimePoint CronExpression::next(TimePoint after) const {
+    std::tm tm = toLocal(Clock::to_time_t(after));
+    tm.tm_sec = 0;
+    tm.tm_min += 1;
+    normalize(tm);
+
+    // Jump field by field; bounded so impossible dates terminate
+    for (int guard = 0; guard < 200000; ++guard) {
+        if (!months.test(static_cast<std::size_t>(tm.tm_mon + 1))) {
+            tm.tm_mon += 1; tm.tm_mday = 1; tm.tm_hour = 0; tm.tm_min = 0;
+            normalize(tm);
+            continue;
+        }
+        if (!dayMatches(tm.tm_mday, tm.tm_wday)) {
+            tm.tm_mday += 1; tm.tm_hour = 0; tm.tm_min = 0;
+            normalize(tm);
+            continue;
+        }
+        if (!hours.test(static_cast<std::size_t>(tm.tm_hour))) {
+            tm.tm_hour += 1; tm.tm_min = 0;
+            normalize(tm);
+            continue;
+        }
+        if (!minutes.test(static_cast<std::size_t>(tm.tm_min))) {
+            tm.tm_min += 1;
+            normalize(tm);
+            continue;
+        }
+        return Clock::from_time_t(normalize(tm));
+    }
+    throw std::runtime_error("Cron expression never fires: " + expr);
+}
+
+// -----------------------
+// Schedule
+// -----------------------
+Schedule::Schedule(const std::string& spec) {
+    bool ok = false;
+    interval = parseInterval(spec, ok);
+    if (ok) {
+        if (interval.count() <= 0) throw std::invalid_argument("Schedule interval must be > 0: " + spec);
+        return;
+    }
+    cron.emplace_back(spec);
+}
+
+Schedule::TimePoint Schedule::next(TimePoint after) const {
+    if (isInterval()) return after + interval;
+    return cron.front().next(after);
+}
+
+std::string Schedule::describe() const {
+    if (isInterval()) return "every " + std::to_string(interval.count()) + "s";
+    return "cron '" + cron.front().str() + "'";
+}
+
+// -----------------------
+// Scheduler
+// -----------------------
+void Scheduler::addJob(const std::string& name, const Schedule& schedule, Job job,
+                       std::chrono::seconds jitter) {
+    auto now = Clock::now();
+    Entry e{name, schedule, std::move(job), jitter, now, now};
+    e.baseTime = schedule.isInterval() ? now : schedule.next(now);
+    e.fireTime = withJitter(e.baseTime, jitter);
+    Logger::instance().info("Scheduled job '" + name + "' (" + schedule.describe()
+                            + ", jitter " + std::to_string(jitter.count()) + "s), first run at "
+                            + formatLocal(e.fireTime));
+    jobs.push_back(std::move(e));
+}
+
+Schedule::TimePoint Scheduler::withJitter(Schedule::TimePoint base, std::chrono::seconds jitter) const {
+    if (jitter.count() <= 0) return base;
+    static thread_local std::mt19937_64 gen{std::random_device{}()};
+    std::uniform_int_distribution<long long> dist(0, std::chrono::milliseconds(jitter).count());
+    return base + std::chrono::milliseconds(dist(gen));
+}
+
+void Scheduler::reschedule(Entry& e) {
+    auto now = Clock::now();
+    auto next = e.schedule.next(e.baseTime);
+    std::size_t skipped = 0;
+    while (next <= now) {
+        next = e.schedule.next(next);
+        ++skipped;
+    }
+    if (skipped > 0) {
+        skippedRuns += skipped;
+        Logger::instance().warn("Job '" + e.name + "' overran its schedule, skipped "
+                                + std::to_string(skipped) + " run(s)");
+    }
+    e.baseTime = next;
+    e.fireTime = withJitter(next, e.jitter);
+}
+
+void Scheduler::run() {
+    if (jobs.empty()) {
+        Logger::instance().warn("Scheduler started with no jobs");
+        return;
+    }
+
+    Logger::instance().info("Scheduler running " + std::to_string(jobs.size()) + " job(s)");
+    // Sleep in short slices so stop() from a signal handler is noticed promptly
+    const auto slice = std::chrono::milliseconds(200);
+
+    while (!stopRequested.load()) {
+        auto due = std::min_element(jobs.begin(), jobs.end(),
+                                    [](const Entry& a, const Entry& b) { return a.fireTime < b.fireTime; });
+        auto now = Clock::now();
+        if (due->fireTime > now) {
+            std::this_thread::sleep_for(std::min<Clock::duration>(due->fireTime - now, slice));
+            continue;
+        }
+
+        Logger::instance().info("Running scheduled job '" + due->name + "'");
+        auto started = std::chrono::steady_clock::now();
+        try {
+            due->job();
+        } catch (const std::exception& ex) {
+            Logger::instance().error("Scheduled job '" + due->name + "' failed: " + ex.what());
+        } catch (...) {
+            Logger::instance().error("Scheduled job '" + due->name + "' failed with unknown exception");
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - started).count();
+
+        reschedule(*due);
+        Logger::instance().info("Job '" + due->name + "' finished in " + std::to_string(ms)
+                                + " ms, next run at " + formatLocal(due->fireTime));
+    }
+    Logger::instance().info("Scheduler stopped");
+}
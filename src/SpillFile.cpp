@@ -0,0 +1,134 @@
+#include "SpillFile.h"
+#include "Logger.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    fs::path spillDirectory(const SpillPolicy& policy) {
+        fs::path dir = policy.directory.empty() ? fs::temp_directory_path() : fs::path(policy.directory);
+        fs::create_directories(dir);
+        return dir;
+    }
+
+    // Unique visible name, for when an anonymous file is not possible
+    fs::path uniquePath(const fs::path& dir, const std::string& name) {
+        static std::atomic<unsigned> counter{0};
+#if defined(_WIN32)
+        int pid = _getpid();
+#else
+        int pid = static_cast<int>(getpid());
+#endif
+        return dir / (name + "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp");
+    }
+}
+
+SpillFile::SpillFile(int fd, std::string path, std::string name, SpillKind kind)
+    : fd_(fd), path_(std::move(path)), name_(std::move(name)), kind_(kind) {}
+
+SpillFile::~SpillFile() {
+#if defined(__linux__)
+    if (fd_ >= 0) close(fd_);
+#endif
+    if (kind_ == SpillKind::NamedDisk) {
+        std::error_code ec;
+        fs::remove(path_, ec);
+    }
+}
+
+std::unique_ptr<SpillFile> SpillFile::create(const SpillPolicy& policy, std::uint64_t expectedSize,
+                                             const std::string& name) {
+    std::uint64_t limit = policy.memoryLimitBytes ? policy.memoryLimitBytes : availableMemory() / 4;
+
+#if defined(__linux__)
+    auto fdPath = [](int fd) { return "/proc/self/fd/" + std::to_string(fd); };
+
+    if (policy.allowMemory && expectedSize <= limit) {
+        int fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+        if (fd >= 0) return std::unique_ptr<SpillFile>(new SpillFile(fd, fdPath(fd), name, SpillKind::Memory));
+        Logger::instance().warn(std::string("memfd_create failed, spilling to disk: ") + std::strerror(errno));
+    }
+
+    fs::path dir = spillDirectory(policy);
+    int fd = -1;
+#if defined(O_TMPFILE)
+    fd = open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) return std::unique_ptr<SpillFile>(new SpillFile(fd, fdPath(fd), name, SpillKind::AnonymousDisk));
+#endif
+    // Filesystem without O_TMPFILE: create, then drop the name right away
+    fs::path p = uniquePath(dir, name);
+    fd = open(p.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create spill file in " + dir.string() + ": " + std::strerror(errno));
+    }
+    unlink(p.c_str());
+    return std::unique_ptr<SpillFile>(new SpillFile(fd, fdPath(fd), name, SpillKind::AnonymousDisk));
+#else
+    (void)limit;
+    (void)expectedSize;
+    fs::path p = uniquePath(spillDirectory(policy), name);
+    std::ofstream create(p, std::ios::binary);
+    if (!create) throw std::runtime_error("Cannot create spill file: " + p.string());
+    return std::unique_ptr<SpillFile>(new SpillFile(-1, p.string(), name, SpillKind::NamedDisk));
+#endif
+}
+
+std::uint64_t SpillFile::size() const {
+#if defined(__linux__)
+    struct stat st;
+    if (fd_ >= 0 && fstat(fd_, &st) == 0) return static_cast<std::uint64_t>(st.st_size);
+#endif
+    std::error_code ec;
+    auto n = fs::file_size(path_, ec);
+    return ec ? 0 : static_cast<std::uint64_t>(n);
+}
+
+std::uint64_t SpillFile::availableMemory() {
+#if defined(__linux__)
+    // MemAvailable counts reclaimable page cache, unlike free pages
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while (std::getline(meminfo, line)) {
+        if (line.rfind("MemAvailable:", 0) == 0) return std::stoull(line.substr(13)) * 1024;  // kB
+    }
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    return pages > 0 && pageSize > 0 ? static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize) : 0;
+#elif defined(_WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? static_cast<std::uint64_t>(status.ullAvailPhys) : 0;
+#else
+    return 0;
+#endif
+}
+
+const char* SpillFile::kindToString(SpillKind kind) {
+    switch (kind) {
+        case SpillKind::Memory:        return "memory";
+        case SpillKind::AnonymousDisk: return "anonymous disk file";
+        case SpillKind::NamedDisk:     return "temporary file";
+    }
+    return "unknown";
+}
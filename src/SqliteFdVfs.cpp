@@ -0,0 +1,189 @@
+#include "SqliteFdVfs.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+    const char kPrefix[] = "/proc/self/fd/";
+
+    const char kJournalSuffix[] = "-journal";
+
+    // `suffix`, if given, receives what follows the digits; otherwise nothing may
+    bool parseFd(const char* path, int& fd, const char** suffix = nullptr) {
+        if (!path || std::strncmp(path, kPrefix, sizeof(kPrefix) - 1) != 0) return false;
+        const char* digits = path + sizeof(kPrefix) - 1;
+        if (*digits < '0' || *digits > '9') return false;
+        fd = 0;
+        const char* c = digits;
+        for (; *c >= '0' && *c <= '9'; ++c) {
+            if (fd > 100000000) return false;
+            fd = fd * 10 + (*c - '0');
+        }
+        if (suffix) {
+            *suffix = c;
+            return true;
+        }
+        return *c == '\0';
+    }
+
+    // "/proc/self/fd/N-journal": the rollback journal of a database served here
+    bool isFdJournal(const char* path) {
+        int fd;
+        const char* suffix = nullptr;
+        return parseFd(path, fd, &suffix) && std::strcmp(suffix, kJournalSuffix) == 0;
+    }
+
+#if defined(__linux__)
+    struct FdFile {
+        sqlite3_file base;   // must be first
+        int fd;
+    };
+
+    int fdOf(sqlite3_file* f) { return reinterpret_cast<FdFile*>(f)->fd; }
+
+    int fdClose(sqlite3_file* f) {
+        close(fdOf(f));
+        return SQLITE_OK;
+    }
+
+    int fdRead(sqlite3_file* f, void* buf, int amount, sqlite3_int64 offset) {
+        auto* out = static_cast<char*>(buf);
+        int got = 0;
+        while (got < amount) {
+            ssize_t n = pread(fdOf(f), out + got, static_cast<std::size_t>(amount - got), offset + got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return SQLITE_IOERR_READ;
+            if (n == 0) break;
+            got += static_cast<int>(n);
+        }
+        if (got < amount) {
+            // SQLite requires the unread tail to be zeroed
+            std::memset(out + got, 0, static_cast<std::size_t>(amount - got));
+            return SQLITE_IOERR_SHORT_READ;
+        }
+        return SQLITE_OK;
+    }
+
+    int fdWrite(sqlite3_file* f, const void* buf, int amount, sqlite3_int64 offset) {
+        const auto* in = static_cast<const char*>(buf);
+        int put = 0;
+        while (put < amount) {
+            ssize_t n = pwrite(fdOf(f), in + put, static_cast<std::size_t>(amount - put), offset + put);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return SQLITE_IOERR_WRITE;
+            put += static_cast<int>(n);
+        }
+        return SQLITE_OK;
+    }
+
+    int fdTruncate(sqlite3_file* f, sqlite3_int64 size) {
+        return ftruncate(fdOf(f), static_cast<off_t>(size)) == 0 ? SQLITE_OK : SQLITE_IOERR_TRUNCATE;
+    }
+
+    int fdSync(sqlite3_file* f, int) {
+        return fdatasync(fdOf(f)) == 0 ? SQLITE_OK : SQLITE_IOERR_FSYNC;
+    }
+
+    int fdFileSize(sqlite3_file* f, sqlite3_int64* size) {
+        struct stat st;
+        if (fstat(fdOf(f), &st) != 0) return SQLITE_IOERR_FSTAT;
+        *size = static_cast<sqlite3_int64>(st.st_size);
+        return SQLITE_OK;
+    }
+
+    // Private to this process: no other connection can contend for it
+    int fdLock(sqlite3_file*, int) { return SQLITE_OK; }
+    int fdCheckReservedLock(sqlite3_file*, int* out) {
+        *out = 0;
+        return SQLITE_OK;
+    }
+    int fdFileControl(sqlite3_file*, int, void*) { return SQLITE_NOTFOUND; }
+    int fdSectorSize(sqlite3_file*) { return 4096; }
+    int fdDeviceCharacteristics(sqlite3_file*) { return 0; }
+
+    const sqlite3_io_methods kFdMethods = {
+        1,  // iVersion: no shared memory, so no WAL
+        fdClose, fdRead, fdWrite, fdTruncate, fdSync, fdFileSize,
+        fdLock, fdLock, fdCheckReservedLock, fdFileControl,
+        fdSectorSize, fdDeviceCharacteristics,
+        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+    };
+
+    sqlite3_vfs* defaultVfs = nullptr;
+
+    int vfsOpen(sqlite3_vfs*, const char* name, sqlite3_file* file, int flags, int* outFlags) {
+        int fd = -1;
+        int own = -1;
+        if (isFdJournal(name)) {
+            // A journal needs a name only to be found again after a crash,
+            // which cannot happen to a private anonymous database
+            own = memfd_create("sqlite-journal", MFD_CLOEXEC);
+        } else if (parseFd(name, fd)) {
+            own = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        } else {
+            return defaultVfs->xOpen(defaultVfs, name, file, flags, outFlags);
+        }
+        if (own < 0) return SQLITE_CANTOPEN;
+        auto* p = reinterpret_cast<FdFile*>(file);
+        p->fd = own;
+        p->base.pMethods = &kFdMethods;
+        if (outFlags) *outFlags = flags;
+        return SQLITE_OK;
+    }
+
+    // The anonymous journal goes away when it is closed; nothing is left to delete or find
+    int vfsDelete(sqlite3_vfs*, const char* name, int syncDir) {
+        if (isFdJournal(name)) return SQLITE_OK;
+        return defaultVfs->xDelete(defaultVfs, name, syncDir);
+    }
+
+    int vfsAccess(sqlite3_vfs*, const char* name, int flags, int* out) {
+        if (isFdJournal(name)) {
+            *out = 0;
+            return SQLITE_OK;
+        }
+        return defaultVfs->xAccess(defaultVfs, name, flags, out);
+    }
+
+    int vfsFullPathname(sqlite3_vfs*, const char* name, int nOut, char* out) {
+        int fd;
+        if (!parseFd(name, fd)) return defaultVfs->xFullPathname(defaultVfs, name, nOut, out);
+        if (static_cast<int>(std::strlen(name)) >= nOut) return SQLITE_CANTOPEN;
+        sqlite3_snprintf(nOut, out, "%s", name);
+        return SQLITE_OK;
+    }
+#endif
+}
+
+bool SqliteFdVfs::isFdPath(const std::string& path) {
+    int fd;
+    return parseFd(path.c_str(), fd);
+}
+
+const char* SqliteFdVfs::name() {
+#if defined(__linux__)
+    static const char* registered = [] {
+        defaultVfs = sqlite3_vfs_find(nullptr);
+        static sqlite3_vfs vfs = *defaultVfs;
+        vfs.zName = "sqliteftpbackup-fd";
+        vfs.pNext = nullptr;
+        vfs.szOsFile = std::max(defaultVfs->szOsFile, static_cast<int>(sizeof(FdFile)));
+        vfs.xOpen = vfsOpen;
+        vfs.xFullPathname = vfsFullPathname;
+        vfs.xDelete = vfsDelete;
+        vfs.xAccess = vfsAccess;
+        return sqlite3_vfs_register(&vfs, 0) == SQLITE_OK ? vfs.zName : nullptr;
+    }();
+    return registered;
+#else
+    return nullptr;
+#endif
+}
@@ -1,5 +1,13 @@
 #include "SqliteHelper.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "HdrHistogram.h"
+#include "PerfCounters.h"
+#include "Probes.h"
+#include "SqliteFdVfs.h"
+#include "Checksum.h"
+#include "TaskScheduler.h"
+#include "Tracer.h"
 #include <iostream>
 #include <random>
 #include <sstream>
@@ -7,9 +15,12 @@
 #include <chrono>
 #include <ctime>
 #include <iomanip>
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <cstdlib> // getenv
+#include <cstring>
+#include <filesystem>
 
 namespace {
     struct Person {
@@ -18,29 +29,127 @@ namespace {
         std::string email;
         std::string createdAt;
     };
+
+    struct BackupMetrics {
+        Counter& pagesCopied;
+        Counter& busyRetries;
+        Histogram& stepSeconds;
+        HdrHistogram& stepLatency;
+    };
+
+    BackupMetrics& backupMetrics() {
+        MetricsRegistry& m = MetricsRegistry::instance();
+        static BackupMetrics metrics{
+            m.counter("sqliteftpbackup_sqlite_backup_pages_copied_total", "Pages copied by the SQLite online backup"),
+            m.counter("sqliteftpbackup_sqlite_busy_retries_total", "Backup steps retried because the source was BUSY/LOCKED"),
+            m.histogram("sqliteftpbackup_sqlite_backup_step_seconds", "Latency of one sqlite3_backup_step call"),
+            LatencyStats::instance().histogram("sqlite_backup_step")};
+        return metrics;
+    }
+
+    // Anonymous spill files (/proc/self/fd/N) go through SqliteFdVfs and
+    // keep their rollback journal in memory
+    int openDatabase(const std::string& path, sqlite3** db) {
+        const bool fdPath = SqliteFdVfs::isFdPath(path);
+        int rc = sqlite3_open_v2(path.c_str(), db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                                 fdPath ? SqliteFdVfs::name() : nullptr);
+        if (rc == SQLITE_OK && fdPath) sqlite3_exec(*db, "PRAGMA journal_mode=MEMORY;", nullptr, nullptr, nullptr);
+        return rc;
+    }
+
+    using DbPtr = std::unique_ptr<sqlite3, decltype(&sqlite3_close)>;
+    using StmtPtr = std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)>;
+
+    // Read-only connection for checks of snapshots and restored copies
+    DbPtr openReadOnly(const std::string& path, const char* purpose) {
+        sqlite3* raw = nullptr;
+        const bool fdPath = SqliteFdVfs::isFdPath(path);
+        int rc = sqlite3_open_v2(path.c_str(), &raw, SQLITE_OPEN_READONLY, fdPath ? SqliteFdVfs::name() : nullptr);
+        DbPtr db(raw, &sqlite3_close);
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error("Can't open " + path + " for " + purpose + ": "
+                                     + (raw ? sqlite3_errmsg(raw) : "unknown error"));
+        }
+        return db;
+    }
+
+    StmtPtr prepareOn(sqlite3* db, const std::string& sql, const std::string& path) {
+        sqlite3_stmt* raw = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &raw, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("Can't read " + path + ": " + sqlite3_errmsg(db));
+        }
+        return StmtPtr(raw, &sqlite3_finalize);
+    }
+
+    std::string quoteIdentifier(const std::string& name) {
+        std::string quoted = "\"";
+        for (char c : name) {
+            quoted += c;
+            if (c == '"') quoted += '"';
+        }
+        return quoted + "\"";
+    }
+
+    TableDigest digestTable(const std::string& path, const std::string& table) {
+        DbPtr db = openReadOnly(path, "digests");
+        StmtPtr stmt = prepareOn(db.get(), "SELECT * FROM " + quoteIdentifier(table) + ";", path);
+        std::unique_ptr<Checksum> hash = Checksum::create(ChecksumAlgorithm::Xxh3);
+        TableDigest digest;
+        digest.table = table;
+        const int columns = sqlite3_column_count(stmt.get());
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+            ++digest.rows;
+            for (int c = 0; c < columns; ++c) {
+                // The type and length go in too, so ("ab", "c") and ("a", "bc") differ
+                const unsigned char type = static_cast<unsigned char>(sqlite3_column_type(stmt.get(), c));
+                hash->update(&type, 1);
+                if (type == SQLITE_INTEGER) {
+                    const sqlite3_int64 v = sqlite3_column_int64(stmt.get(), c);
+                    hash->update(&v, sizeof(v));
+                } else if (type == SQLITE_FLOAT) {
+                    const double v = sqlite3_column_double(stmt.get(), c);
+                    hash->update(&v, sizeof(v));
+                } else if (type != SQLITE_NULL) {
+                    const void* data = type == SQLITE_BLOB ? sqlite3_column_blob(stmt.get(), c)
+                                                           : static_cast<const void*>(sqlite3_column_text(stmt.get(), c));
+                    const std::int64_t len = sqlite3_column_bytes(stmt.get(), c);
+                    hash->update(&len, sizeof(len));
+                    if (len > 0) hash->update(data, static_cast<std::size_t>(len));
+                }
+            }
+        }
+        if (rc != SQLITE_DONE) throw std::runtime_error("Can't read table " + table + " of " + path + ": " + sqlite3_errmsg(db.get()));
+        digest.checksum = hash->hex();
+        return digest;
+    }
 }
 
-SqliteHelper::SqliteHelper(const std::string& dbPathPrefix) {
-    // Generate timestamped filename
-    auto now = std::chrono::system_clock::now();
-    auto t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm_now;
+SqliteHelper::SqliteHelper(const std::string& dbPathPrefix, bool appendTimestamp) {
+    if (appendTimestamp) {
+        // Generate timestamped filename
+        auto now = std::chrono::system_clock::now();
+        auto t = std::chrono::system_clock::to_time_t(now);
+        std::tm tm_now;
 #if defined(_WIN32)
-    localtime_s(&tm_now, &t);
+        localtime_s(&tm_now, &t);
 #else
-    localtime_r(&t, &tm_now);
+        localtime_r(&t, &tm_now);
 #endif
 
-    std::ostringstream oss;
-    oss << dbPathPrefix << "_"
-        << std::put_time(&tm_now, "%Y-%m-%d_%H-%M-%S")
-        << ".sqlite";
+        std::ostringstream oss;
+        oss << dbPathPrefix << "_"
+            << std::put_time(&tm_now, "%Y-%m-%d_%H-%M-%S")
+            << ".sqlite";
 
-    dbPath = oss.str();
+        dbPath = oss.str();
+    } else {
+        dbPath = dbPathPrefix;
+    }
 
     Logger::instance().info("Opening SQLite database: " + dbPath);
 
-    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
+    if (openDatabase(dbPath, &db) != SQLITE_OK) {
         std::string err = sqlite3_errmsg(db) ? sqlite3_errmsg(db) : "Unknown sqlite open error";
         Logger::instance().error("Can't open SQLite DB: " + err);
         throw std::runtime_error("Can't open SQLite DB: " + err);
@@ -55,6 +164,7 @@ SqliteHelper::~SqliteHelper() {
 }
 
 void SqliteHelper::createTable() {
+    TraceSpan span("createTable", "sqlite");
     Logger::instance().info("Creating table 'people' if not exists...");
     const char* sql = R"(CREATE TABLE IF NOT EXISTS people(
         id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -74,6 +184,8 @@ void SqliteHelper::createTable() {
 }
 
 void SqliteHelper::insertRandomRows(int count) {
+    TraceSpan span("insertRandomRows", "sqlite", "rows", count);
+    PerfPhase perf("insertRandomRows");
     Logger::instance().info("Inserting " + std::to_string(count) + " random rows...");
 
     if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
@@ -82,6 +194,7 @@ void SqliteHelper::insertRandomRows(int count) {
 
     sqlite3_stmt* rawStmt = nullptr;
     const char* sql = "INSERT INTO people (first_name,last_name,email,created_at) VALUES (?,?,?,?);";
+    SFB_PROBE1(stmt__prepare, sql);
     if (sqlite3_prepare_v2(db, sql, -1, &rawStmt, nullptr) != SQLITE_OK) {
         Logger::instance().error("Failed to prepare insert statement");
         throw std::runtime_error("Failed to prepare insert statement");
@@ -126,7 +239,10 @@ void SqliteHelper::insertRandomRows(int count) {
                 throw std::runtime_error("Failed to bind values at row " + std::to_string(i));
             }
 
-            if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+            SFB_PROBE1(stmt__step__start, sql);
+            int rc = sqlite3_step(stmt.get());
+            SFB_PROBE2(stmt__step__end, sql, rc);
+            if (rc != SQLITE_DONE) {
                 throw std::runtime_error("Insert failed at row " + std::to_string(i));
             }
             sqlite3_reset(stmt.get());
@@ -145,6 +261,7 @@ void SqliteHelper::insertRandomRows(int count) {
 }
 
 void SqliteHelper::dumpToFile(const std::string& dumpFile) {
+    PerfPhase perf("dumpToFile");
     Logger::instance().info("Dumping database to SQL file: " + dumpFile);
     std::ofstream out(dumpFile);
     if (!out.is_open()) {
@@ -171,45 +288,165 @@ void SqliteHelper::dumpToFile(const std::string& dumpFile) {
             << id << ", '" << first_name << "', '" << last_name << "', '" << email << "', '" << created_at << "');\n";
         ++rowCount;
     }
+    perf.addBytes(static_cast<std::uint64_t>(out.tellp()));
 
     Logger::instance().info("Dumped " + std::to_string(rowCount) + " rows to file successfully.");
 }
 
-void SqliteHelper::backupToFile(const std::string& dumpFile) {
+void SqliteHelper::backupToFile(const std::string& dumpFile, const CancellationToken* cancel) {
+    TraceSpan span("backupToFile", "sqlite");
+    PerfPhase perf("backupToFile");
     Logger::instance().info("Performing binary backup to file: " + dumpFile);
+    if (cancel) cancel->throwIfCancelled();
 
     sqlite3* destDb = nullptr;
-    if (sqlite3_open(dumpFile.c_str(), &destDb) != SQLITE_OK) {
-        std::string err = sqlite3_errmsg(destDb) ? sqlite3_errmsg(destDb) : "unknown error";
-        if (destDb) sqlite3_close(destDb);
-        throw std::runtime_error("Failed to open destination DB: " + err);
+    {
+        TraceSpan openSpan("backup_open_dest", "sqlite");
+        if (openDatabase(dumpFile, &destDb) != SQLITE_OK) {
+            std::string err = sqlite3_errmsg(destDb) ? sqlite3_errmsg(destDb) : "unknown error";
+            if (destDb) sqlite3_close(destDb);
+            throw std::runtime_error("Failed to open destination DB: " + err);
+        }
     }
 
     std::unique_ptr<sqlite3, decltype(&sqlite3_close)> destGuard(destDb, &sqlite3_close);
 
-    sqlite3_backup* backup = sqlite3_backup_init(destDb, "main", db, "main");
+    // The copy is discarded if the backup fails, so it needs no rollback journal
+    sqlite3_exec(destDb, "PRAGMA journal_mode=OFF;", nullptr, nullptr, nullptr);
+
+    // Background mode copies from its own connection, so only the backup's
+    // reads go through the throttled VFS and this thread's priority drops
+    std::unique_ptr<ScopedIoPriority> ioPriority;
+    std::unique_ptr<sqlite3, decltype(&sqlite3_close)> sourceGuard(nullptr, &sqlite3_close);
+    sqlite3* sourceDb = db;
+    if (backgroundIo.enabled) {
+        ioPriority = std::make_unique<ScopedIoPriority>(backgroundIo.ioClass);
+        sqlite3* bgDb = nullptr;
+        int rc = sqlite3_open_v2(BackgroundIoVfs::uri(dbPath, backgroundIo).c_str(), &bgDb,
+                                 SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr);
+        sourceGuard.reset(bgDb);
+        if (rc != SQLITE_OK) {
+            std::string err = bgDb && sqlite3_errmsg(bgDb) ? sqlite3_errmsg(bgDb) : "unknown error";
+            throw std::runtime_error("Failed to open source DB for background backup: " + err);
+        }
+        sourceDb = bgDb;
+    }
+
+    sqlite3_backup* backup = sqlite3_backup_init(destDb, "main", sourceDb, "main");
     if (!backup) {
         std::string err = sqlite3_errmsg(destDb) ? sqlite3_errmsg(destDb) : "unknown error";
         throw std::runtime_error("sqlite3_backup_init failed: " + err);
     }
 
+    BackupMetrics& metrics = backupMetrics();
     int rc = SQLITE_OK;
     do {
-        rc = sqlite3_backup_step(backup, 1024);
+        int remainingBefore = sqlite3_backup_remaining(backup);
+        auto stepStart = std::chrono::steady_clock::now();
+        {
+            TraceSpan stepSpan("backup_step", "sqlite", "remaining_pages", remainingBefore);
+            SFB_PROBE1(backup__step__start, remainingBefore);
+            rc = sqlite3_backup_step(backup, 1024);
+            SFB_PROBE3(backup__step__end, rc, sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup));
+        }
+        auto stepTime = std::chrono::steady_clock::now() - stepStart;
+        metrics.stepSeconds.observe(std::chrono::duration<double>(stepTime).count());
+        metrics.stepLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(stepTime).count());
+        if (rc == SQLITE_OK || rc == SQLITE_DONE) {
+            // remaining() is 0 before the first step, so fall back to the total
+            int before = remainingBefore > 0 ? remainingBefore : sqlite3_backup_pagecount(backup);
+            int copied = before - sqlite3_backup_remaining(backup);
+            if (copied > 0) metrics.pagesCopied.inc(static_cast<std::uint64_t>(copied));
+        }
         if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            metrics.busyRetries.inc();
+            TraceSpan waitSpan("backup_busy_wait", "sqlite");
             sqlite3_sleep(50); // avoid tight loop
         }
+        if (cancel && cancel->isCancelled() && rc != SQLITE_DONE) {
+            sqlite3_backup_finish(backup);
+            Logger::instance().warn("Binary backup to " + dumpFile + " cancelled: " + cancel->reason());
+            throw OperationCancelled(cancel->reason());
+        }
     } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
 
-    int rcFinish = sqlite3_backup_finish(backup);
+    int rcFinish;
+    {
+        TraceSpan finishSpan("backup_finish", "sqlite");
+        rcFinish = sqlite3_backup_finish(backup);
+    }
     if (rc != SQLITE_DONE || rcFinish != SQLITE_OK) {
         std::string err = sqlite3_errmsg(destDb) ? sqlite3_errmsg(destDb) : "unknown error";
         throw std::runtime_error("sqlite3_backup failed: " + err);
     }
+    std::error_code sizeError;
+    auto dumpSize = std::filesystem::file_size(dumpFile, sizeError);
+    if (!sizeError) perf.addBytes(static_cast<std::uint64_t>(dumpSize));
 
     Logger::instance().info("Binary backup completed successfully to: " + dumpFile);
 }
 
+void SqliteHelper::vacuumToFile(const std::string& dumpFile, const CancellationToken* cancel) {
+    TraceSpan span("vacuumToFile", "sqlite");
+    PerfPhase perf("vacuumToFile");
+    Logger::instance().info("Performing compacting backup (VACUUM INTO) to file: " + dumpFile);
+    if (cancel) cancel->throwIfCancelled();
+
+    // A URI connection of its own: the target of an fd path needs its VFS named in a URI
+    std::unique_ptr<ScopedIoPriority> ioPriority;
+    if (backgroundIo.enabled) ioPriority = std::make_unique<ScopedIoPriority>(backgroundIo.ioClass);
+    const std::string source = backgroundIo.enabled ? BackgroundIoVfs::uri(dbPath, backgroundIo) : dbPath;
+    sqlite3* raw = nullptr;
+    int rc = sqlite3_open_v2(source.c_str(), &raw, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr);
+    DbPtr sourceDb(raw, &sqlite3_close);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to open source DB for VACUUM INTO: "
+                                 + std::string(raw ? sqlite3_errmsg(raw) : "unknown error"));
+    }
+    sqlite3_busy_timeout(sourceDb.get(), 5000);
+
+    auto pragma = [&](const char* sql) {
+        StmtPtr stmt = prepareOn(sourceDb.get(), sql, dbPath);
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW) {
+            throw std::runtime_error(std::string(sql) + " failed: " + sqlite3_errmsg(sourceDb.get()));
+        }
+        return sqlite3_column_int64(stmt.get(), 0);
+    };
+    const std::int64_t pageSize = pragma("PRAGMA page_size;");
+    if (pageSize <= 0) throw std::runtime_error("Invalid page size " + std::to_string(pageSize) + " of " + dbPath);
+    const std::int64_t pages = pragma("PRAGMA page_count;");
+    const std::int64_t freePages = pragma("PRAGMA freelist_count;");
+
+    // The statement runs to completion in one step; the progress handler is where it can stop
+    if (cancel) {
+        sqlite3_progress_handler(sourceDb.get(), 1000, [](void* token) {
+            return static_cast<const CancellationToken*>(token)->isCancelled() ? 1 : 0;
+        }, const_cast<CancellationToken*>(cancel));
+    }
+    const std::string target = SqliteFdVfs::isFdPath(dumpFile)
+                                   ? "file:" + dumpFile + "?vfs=" + SqliteFdVfs::name()
+                                   : dumpFile;
+    StmtPtr vacuum = prepareOn(sourceDb.get(), "VACUUM INTO ?;", dbPath);
+    sqlite3_bind_text(vacuum.get(), 1, target.c_str(), -1, SQLITE_TRANSIENT);
+    rc = sqlite3_step(vacuum.get());
+    if (rc != SQLITE_DONE) {
+        if (cancel && cancel->isCancelled()) {
+            Logger::instance().warn("Compacting backup to " + dumpFile + " cancelled: " + cancel->reason());
+            throw OperationCancelled(cancel->reason());
+        }
+        throw std::runtime_error("VACUUM INTO failed: " + std::string(sqlite3_errmsg(sourceDb.get())));
+    }
+
+    std::error_code sizeError;
+    const auto dumpSize = static_cast<std::int64_t>(std::filesystem::file_size(dumpFile, sizeError));
+    if (sizeError) throw std::runtime_error("Can't stat " + dumpFile + ": " + sizeError.message());
+    perf.addBytes(static_cast<std::uint64_t>(dumpSize));
+    Logger::instance().info("Compacting backup completed to: " + dumpFile + " (" + std::to_string(dumpSize / pageSize)
+                            + " of " + std::to_string(pages) + " pages, " + std::to_string(freePages)
+                            + " of them free, " + std::to_string(std::max<std::int64_t>(pages * pageSize - dumpSize, 0) / 1024)
+                            + " KiB smaller)");
+}
+
 int SqliteHelper::getRowCount() {
     sqlite3_stmt* rawStmt = nullptr;
     const char* sql = "SELECT COUNT(*) FROM people;";
@@ -227,6 +464,76 @@ int SqliteHelper::getRowCount() {
     return count;
 }
 
+std::string SqliteHelper::checkIntegrity(const std::string& path, bool quick) {
+    TraceSpan span(quick ? "quick_check" : "integrity_check", "sqlite");
+    DbPtr check = openReadOnly(path, "checking");
+    StmtPtr stmt = prepareOn(check.get(), quick ? "PRAGMA quick_check(1);" : "PRAGMA integrity_check(1);", path);
+    if (sqlite3_step(stmt.get()) != SQLITE_ROW) {
+        throw std::runtime_error(std::string("Can't check ") + path + ": " + sqlite3_errmsg(check.get()));
+    }
+    const unsigned char* result = sqlite3_column_text(stmt.get(), 0);
+    return result ? reinterpret_cast<const char*>(result) : "";
+}
+
+std::optional<ChangeStamp> SqliteHelper::changeStamp(const std::string& path) {
+    namespace fs = std::filesystem;
+    ChangeStamp stamp;
+    std::error_code ec;
+    unsigned char header[100];
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) return std::nullopt;
+    }
+    if (std::memcmp(header, "SQLite format 3", 16) != 0) return std::nullopt;
+    auto be32 = [&header](int off) {
+        return (std::uint32_t(header[off]) << 24) | (std::uint32_t(header[off + 1]) << 16)
+               | (std::uint32_t(header[off + 2]) << 8) | header[off + 3];
+    };
+    stamp.changeCounter = be32(24);
+    stamp.pageCount = be32(28);
+    stamp.fileSize = fs::file_size(path, ec);
+    if (ec) return std::nullopt;
+    stamp.modified = fs::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) return std::nullopt;
+
+    // In WAL mode commits only append frames, so the -wal file and the
+    // wal-index header (its commit counter and last valid frame) tell them apart
+    const std::string wal = path + "-wal";
+    const std::uintmax_t walSize = fs::file_size(wal, ec);
+    if (ec || walSize == 0) return stamp;
+    stamp.walSize = walSize;
+    stamp.walModified = fs::last_write_time(wal, ec).time_since_epoch().count();
+    if (ec) return std::nullopt;
+    // The header is kept twice; copies that differ mean a writer is updating it
+    unsigned char index[96];
+    {
+        std::ifstream in(path + "-shm", std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(index), sizeof(index))) return std::nullopt;
+    }
+    const bool initialized = index[12] != 0;
+    if (!initialized || std::memcmp(index, index + 48, 48) != 0) return std::nullopt;
+    stamp.walIndex = Checksum::xxh3(index, 48);
+    return stamp;
+}
+
+std::vector<TableDigest> SqliteHelper::tableDigests(const std::string& path) {
+    TraceSpan span("table_digests", "sqlite");
+    std::vector<TableDigest> digests;
+    {
+        DbPtr db = openReadOnly(path, "digests");
+        StmtPtr stmt = prepareOn(db.get(), "SELECT name FROM sqlite_master WHERE type='table' ORDER BY name;", path);
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+            TableDigest d;
+            d.table = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+            digests.push_back(std::move(d));
+        }
+        if (rc != SQLITE_DONE) throw std::runtime_error("Can't list the tables of " + path + ": " + sqlite3_errmsg(db.get()));
+    }
+    parallelFor(0, digests.size(), [&](std::size_t i) { digests[i] = digestTable(path, digests[i].table); });
+    return digests;
+}
+
 std::string SqliteHelper::randomFirstName(int idx) const {
     static const std::string names[] = {"Anna","David","Maya","Liam","Sophie","Alex","Nora","Arman","Karen","Sara"};
     if (idx < 0 || idx > 9) idx = 0;
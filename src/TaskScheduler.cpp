@@ -0,0 +1,250 @@
+#include "TaskScheduler.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    // Index of the current thread in its scheduler, or npos for outside threads
+    constexpr std::size_t kNotAWorker = static_cast<std::size_t>(-1);
+    thread_local const TaskScheduler* tlsScheduler = nullptr;
+    thread_local std::size_t tlsWorkerIndex = kNotAWorker;
+
+    std::size_t configuredWorkers = 0;
+    bool configuredPin = false;
+    std::atomic<bool> instanceCreated{false};
+
+    void pinCurrentThread(std::size_t index) {
+        unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+        std::size_t cpu = index % cpus;
+#if defined(_WIN32)
+        SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)cpu; // affinity not supported on this platform
+#endif
+    }
+}
+
+// -----------------------
+// TaskScheduler
+// -----------------------
+TaskScheduler::TaskScheduler(std::size_t workerCount, bool pinWorkers) {
+    if (workerCount == 0) workerCount = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t i = 0; i < workerCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i < workerCount; ++i) {
+        workers[i]->thread = std::thread(&TaskScheduler::workerLoop, this, i, pinWorkers);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+        stopping.store(true);
+    }
+    sleepCv.notify_all();
+    for (auto& w : workers) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::instance() {
+    static TaskScheduler scheduler(configuredWorkers, configuredPin);
+    instanceCreated.store(true);
+    return scheduler;
+}
+
+void TaskScheduler::configure(std::size_t workerCount, bool pinWorkers) {
+    if (instanceCreated.load()) {
+        Logger::instance().warn("TaskScheduler already started; configure() ignored");
+        return;
+    }
+    configuredWorkers = workerCount;
+    configuredPin = pinWorkers;
+}
+
+void TaskScheduler::submit(Task task) {
+    // Workers keep their own spawned tasks local; outside threads spread round-robin
+    std::size_t target = (tlsScheduler == this && tlsWorkerIndex != kNotAWorker)
+                             ? tlsWorkerIndex
+                             : nextWorker.fetch_add(1) % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[target]->mtx);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+    pending.fetch_add(1);
+    submitted.fetch_add(1);
+    {
+        // Taking the lock orders this wakeup against a worker about to sleep
+        std::lock_guard<std::mutex> lock(sleepMtx);
+    }
+    sleepCv.notify_one();
+}
+
+bool TaskScheduler::popLocal(std::size_t index, Task& out) {
+    Worker& w = *workers[index];
+    std::lock_guard<std::mutex> lock(w.mtx);
+    if (w.tasks.empty()) return false;
+    out = std::move(w.tasks.back());
+    w.tasks.pop_back();
+    pending.fetch_sub(1);
+    return true;
+}
+
+bool TaskScheduler::steal(std::size_t thief, Task& out) {
+    const std::size_t n = workers.size();
+    const std::size_t start = (thief == kNotAWorker) ? nextWorker.load() : thief + 1;
+    for (std::size_t k = 0; k < n; ++k) {
+        std::size_t victim = (start + k) % n;
+        if (victim == thief) continue;
+        Worker& w = *workers[victim];
+        std::unique_lock<std::mutex> lock(w.mtx, std::try_to_lock);
+        if (!lock.owns_lock() || w.tasks.empty()) continue;
+        out = std::move(w.tasks.front());
+        w.tasks.pop_front();
+        pending.fetch_sub(1);
+        if (thief != kNotAWorker) workers[thief]->steals.fetch_add(1);
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::execute(Task& task) {
+    try {
+        task();
+    } catch (const std::exception& ex) {
+        Logger::instance().error(std::string("Unhandled exception in scheduled task: ") + ex.what());
+    } catch (...) {
+        Logger::instance().error("Unhandled unknown exception in scheduled task");
+    }
+}
+
+bool TaskScheduler::runOne() {
+    const std::size_t self = (tlsScheduler == this) ? tlsWorkerIndex : kNotAWorker;
+    Task task;
+    if ((self != kNotAWorker && popLocal(self, task)) || steal(self, task)) {
+        execute(task);
+        if (self != kNotAWorker) workers[self]->executed.fetch_add(1);
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::workerLoop(std::size_t index, bool pin) {
+    tlsScheduler = this;
+    tlsWorkerIndex = index;
+    if (pin) pinCurrentThread(index);
+    Tracer::instance().setThreadName("worker " + std::to_string(index));
+
+    while (!stopping.load()) {
+        if (runOne()) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMtx);
+        // Timed wait: a steal can fail on try_lock contention while pending > 0
+        sleepCv.wait_for(lock, std::chrono::milliseconds(10),
+                         [this] { return stopping.load() || pending.load() > 0; });
+    }
+}
+
+TaskScheduler::Stats TaskScheduler::getStats() const {
+    Stats stats;
+    stats.submitted = submitted.load();
+    for (const auto& w : workers) {
+        WorkerStats ws;
+        {
+            std::lock_guard<std::mutex> lock(w->mtx);
+            ws.queueDepth = w->tasks.size();
+        }
+        ws.executed = w->executed.load();
+        ws.steals = w->steals.load();
+        stats.executed += ws.executed;
+        stats.steals += ws.steals;
+        stats.queueDepth += ws.queueDepth;
+        stats.workers.push_back(ws);
+    }
+    return stats;
+}
+
+void TaskScheduler::logStats() const {
+    Stats st = getStats();
+    std::ostringstream oss;
+    oss << "TaskScheduler: " << st.workers.size() << " workers, submitted " << st.submitted
+        << ", executed by workers " << st.executed << ", steals " << st.steals
+        << ", queued " << st.queueDepth;
+    Logger::instance().info(oss.str());
+}
+
+// -----------------------
+// TaskGroup
+// -----------------------
+TaskGroup::TaskGroup(TaskScheduler& scheduler) : scheduler(scheduler) {}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // Never throw from destructor; callers that care call wait() themselves
+    }
+}
+
+void TaskGroup::run(TaskScheduler::Task task) {
+    pending.fetch_add(1);
+    scheduler.submit([this, task = std::move(task)] {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!error) error = std::current_exception();
+        }
+        pending.fetch_sub(1);
+    });
+}
+
+void TaskGroup::wait() {
+    for (int idle = 0; pending.load() > 0;) {
+        if (scheduler.runOne()) {
+            idle = 0;
+        } else if (++idle < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void parallelFor(std::size_t begin, std::size_t end,
+                 const std::function<void(std::size_t)>& fn, std::size_t grain) {
+    if (begin >= end) return;
+    grain = std::max<std::size_t>(1, grain);
+    TaskGroup group;
+    for (std::size_t lo = begin; lo < end; lo += grain) {
+        std::size_t hi = std::min(end, lo + grain);
+        group.run([&fn, lo, hi] {
+            for (std::size_t i = lo; i < hi; ++i) fn(i);
+        });
+    }
+    group.wait();
+}
@@ -0,0 +1,171 @@
+#include "Tracer.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    // Buffer of the current thread; owned by the tracer so it outlives the thread
+    thread_local void* tlsBuffer = nullptr;
+
+    void appendJsonString(std::ostringstream& out, const std::string& s) {
+        out << '"';
+        for (char c : s) {
+            switch (c) {
+                case '"':  out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out << buf;
+                    } else {
+                        out << c;
+                    }
+            }
+        }
+        out << '"';
+    }
+}
+
+// -----------------------
+// Tracer
+// -----------------------
+Tracer::Tracer() : epoch(std::chrono::steady_clock::now()) {}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+double Tracer::nowUs() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+Tracer::ThreadBuffer& Tracer::localBuffer() {
+    if (!tlsBuffer) {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(mtx);
+        buffer->tid = static_cast<std::uint32_t>(buffers.size() + 1);
+        buffers.push_back(buffer);
+        tlsBuffer = buffer.get();
+    }
+    return *static_cast<ThreadBuffer*>(tlsBuffer);
+}
+
+void Tracer::record(TraceEvent event) {
+    ThreadBuffer& buf = localBuffer();
+    std::lock_guard<std::mutex> lock(buf.mtx);
+    if (buf.events.size() >= maxEventsPerThread) {
+        ++buf.dropped;
+        return;
+    }
+    buf.events.push_back(std::move(event));
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    ThreadBuffer& buf = localBuffer();
+    std::lock_guard<std::mutex> lock(buf.mtx);
+    buf.name = name;
+}
+
+std::string Tracer::toChromeJson() const {
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&] {
+        if (!first) out << ",\n";
+        first = false;
+    };
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& buf : buffers) {
+        std::lock_guard<std::mutex> bufLock(buf->mtx);
+        if (!buf->name.empty()) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buf->tid << ",\"args\":{\"name\":";
+            appendJsonString(out, buf->name);
+            out << "}}";
+        }
+        for (const auto& ev : buf->events) {
+            separator();
+            out << "{\"name\":";
+            appendJsonString(out, ev.name);
+            out << ",\"cat\":";
+            appendJsonString(out, ev.category);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buf->tid
+                << ",\"ts\":" << ev.startUs << ",\"dur\":" << ev.durationUs;
+            if (ev.argName) {
+                out << ",\"args\":{";
+                appendJsonString(out, ev.argName);
+                out << ":" << ev.argValue << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+void Tracer::writeChromeTrace(const std::string& path) const {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) throw std::runtime_error("Cannot write trace file: " + path);
+    ofs << toChromeJson();
+    if (!ofs.flush()) throw std::runtime_error("Cannot write trace file: " + path);
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& buf : buffers) {
+        std::lock_guard<std::mutex> bufLock(buf->mtx);
+        buf->events.clear();
+        buf->dropped = 0;
+    }
+}
+
+std::size_t Tracer::eventCount() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::size_t n = 0;
+    for (const auto& buf : buffers) {
+        std::lock_guard<std::mutex> bufLock(buf->mtx);
+        n += buf->events.size();
+    }
+    return n;
+}
+
+std::uint64_t Tracer::droppedCount() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::uint64_t n = 0;
+    for (const auto& buf : buffers) {
+        std::lock_guard<std::mutex> bufLock(buf->mtx);
+        n += buf->dropped;
+    }
+    return n;
+}
+
+// -----------------------
+// TraceSpan
+// -----------------------
+TraceSpan::TraceSpan(const char* name, const char* category, const char* argName, std::int64_t argValue)
+    : active(Tracer::instance().isEnabled()) {
+    if (!active) return;
+    event.name = name;
+    event.category = category;
+    event.argName = argName;
+    event.argValue = argValue;
+    event.startUs = Tracer::instance().nowUs();
+}
+
+TraceSpan::TraceSpan(const std::string& name, const char* category, const char* argName, std::int64_t argValue)
+    : TraceSpan(name.c_str(), category, argName, argValue) {}
+
+TraceSpan::~TraceSpan() {
+    if (!active) return;
+    Tracer& tracer = Tracer::instance();
+    event.durationUs = tracer.nowUs() - event.startUs;
+    tracer.record(std::move(event));
+}
@@ -0,0 +1,139 @@
+#include "BackgroundIo.h"
+#include "Metrics.h"
+#include "SqliteHelper.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class BackgroundIoTest : public ::testing::Test {
+protected:
+    const std::string sourceDb = "test_background_source.sqlite";
+    const std::string copyDb = "test_background_copy.sqlite";
+
+    void SetUp() override { removeFiles(); }
+    void TearDown() override { removeFiles(); }
+
+    void removeFiles() {
+        std::filesystem::remove(sourceDb);
+        std::filesystem::remove(copyDb);
+    }
+
+    double secondsFor(SqliteHelper& source, const BackgroundIoPolicy& policy) {
+        std::filesystem::remove(copyDb);
+        source.setBackgroundIo(policy);
+        auto start = std::chrono::steady_clock::now();
+        source.backupToFile(copyDb);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+TEST(RateLimiterTest, BurstIsFreeThenRateHolds) {
+    RateLimiter limiter(1000, 100);
+    EXPECT_EQ(limiter.acquire(100), 0.0);
+
+    // 200 units past an empty bucket at 1000/s: about 0.2 s
+    auto start = std::chrono::steady_clock::now();
+    limiter.acquire(100);
+    limiter.acquire(100);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_GE(elapsed, 0.15);
+    EXPECT_LT(elapsed, 1.0);
+}
+
+TEST(RateLimiterTest, OversizedRequestIsAdmittedAndPaidBack) {
+    RateLimiter limiter(1000, 10);
+    double waited = limiter.acquire(110);   // 100 units of debt
+    EXPECT_NEAR(waited, 0.1, 0.02);
+}
+
+TEST(ScopedIoPriorityTest, NormalIsANoOp) {
+    ScopedIoPriority priority(IoPriorityClass::Normal);
+    EXPECT_FALSE(priority.applied());
+}
+
+TEST(ScopedIoPriorityTest, LowerAndRestoreDoNotThrow) {
+    for (IoPriorityClass c : {IoPriorityClass::Idle, IoPriorityClass::BestEffortLow}) {
+        EXPECT_NO_THROW({ ScopedIoPriority priority(c); });
+    }
+}
+
+TEST(BackgroundIoVfsTest, UriEscapesThePath) {
+    BackgroundIoPolicy policy;
+    policy.dropCache = false;
+    std::string uri = BackgroundIoVfs::uri("dir/a?b#c%d.sqlite", policy);
+    EXPECT_EQ(uri.rfind("file:dir/a%3Fb%23c%25d.sqlite?mode=ro&vfs=", 0), 0u) << uri;
+    EXPECT_EQ(uri.find("max_mbps"), std::string::npos);
+}
+
+TEST_F(BackgroundIoTest, BackupThroughBackgroundVfsIsComplete) {
+    SqliteHelper source(sourceDb, false);
+    source.createTable();
+    source.insertRandomRows(300);
+
+    for (bool direct : {false, true}) {
+        BackgroundIoPolicy policy;
+        policy.enabled = true;
+        policy.directIo = direct;   // falls back to buffered reads where O_DIRECT is refused
+        policy.maxIops = 100000;
+        secondsFor(source, policy);
+
+        SqliteHelper copy(copyDb, false);
+        EXPECT_EQ(copy.getRowCount(), 300);
+    }
+}
+
+TEST_F(BackgroundIoTest, IopsCapSlowsTheBackup) {
+    SqliteHelper source(sourceDb, false);
+    source.createTable();
+    source.insertRandomRows(2000);
+    double pages = static_cast<double>(std::filesystem::file_size(sourceDb)) / 4096;
+
+    BackgroundIoPolicy policy;
+    policy.enabled = true;
+    double uncapped = secondsFor(source, policy);
+
+    // One read per page; a tenth of a second's worth is burst
+    policy.maxIops = 200;
+    double expected = (pages - 20) / 200;
+    double capped = secondsFor(source, policy);
+    ASSERT_GT(expected, 0.05) << "source database too small for the cap to show";
+    EXPECT_GE(capped, expected * 0.8);
+    EXPECT_GT(capped, uncapped);
+
+    SqliteHelper copy(copyDb, false);
+    EXPECT_EQ(copy.getRowCount(), 2000);
+}
+
+#if defined(__linux__)
+TEST_F(BackgroundIoTest, PagesTheBackupCachedAreDropped) {
+    {
+        SqliteHelper source(sourceDb, false);
+        source.createTable();
+        source.insertRandomRows(2000);
+    }
+    // Start cold, as if the application had not touched the file in a while
+    int fd = open(sourceDb.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    Counter& dropped = MetricsRegistry::instance().counter(
+        "sqliteftpbackup_source_cache_pages_dropped_total", "Page-cache pages released behind the backup reader");
+    std::uint64_t before = dropped.value();
+
+    SqliteHelper source(sourceDb, false);
+    BackgroundIoPolicy policy;
+    policy.enabled = true;
+    secondsFor(source, policy);
+    EXPECT_GT(dropped.value(), before);
+
+    SqliteHelper copy(copyDb, false);
+    EXPECT_EQ(copy.getRowCount(), 2000);
+}
+#endif
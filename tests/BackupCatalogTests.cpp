@@ -0,0 +1,93 @@
+#include "BackupCatalog.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <stdexcept>
+
+class BackupCatalogTest : public ::testing::Test {
+protected:
+    const std::string path = "test_catalog.sqlite";
+    const std::string exported = "test_catalog_export.sqlite";
+
+    void SetUp() override { removeFiles(); }
+    void TearDown() override { removeFiles(); }
+
+    void removeFiles() {
+        for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+        std::filesystem::remove(exported);
+    }
+
+    static CatalogEntry entry(const std::string& db, std::int64_t at, const std::string& name,
+                              std::int64_t parent = 0) {
+        CatalogEntry e;
+        e.dbId = db;
+        e.createdAt = at;
+        e.size = 4096;
+        e.hash = "blake3:00ff";
+        e.remoteDir = "backups";
+        e.remoteName = name;
+        e.parentId = parent;
+        return e;
+    }
+};
+
+TEST_F(BackupCatalogTest, LatestAndPointInTime) {
+    BackupCatalog catalog(path);
+    catalog.record(entry("app", 100, "app_1"));
+    catalog.record(entry("app", 300, "app_3"));
+    catalog.record(entry("app", 200, "app_2"));
+    catalog.record(entry("other", 400, "other_4"));
+
+    EXPECT_EQ(catalog.latest("app")->remoteName, "app_3");
+    EXPECT_EQ(catalog.latest("app", 299)->remoteName, "app_2");
+    EXPECT_EQ(catalog.latest("app", 200)->remoteName, "app_2");
+    EXPECT_FALSE(catalog.latest("app", 99).has_value());
+    EXPECT_FALSE(catalog.latest("missing").has_value());
+    EXPECT_EQ(catalog.list("app").size(), 3u);
+    EXPECT_EQ(catalog.list("app", 1).front().remoteName, "app_3");
+}
+
+TEST_F(BackupCatalogTest, RecordingSameRemoteFileReplacesIt) {
+    BackupCatalog catalog(path);
+    catalog.record(entry("app", 100, "app_1"));
+    CatalogEntry again = entry("app", 150, "app_1");
+    again.format = BackupFormat::Chunked;
+    catalog.record(again);
+
+    EXPECT_EQ(catalog.size(), 1u);
+    auto found = catalog.find("backups", "app_1");
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->createdAt, 150);
+    EXPECT_EQ(found->format, BackupFormat::Chunked);
+
+    EXPECT_TRUE(catalog.remove("backups", "app_1"));
+    EXPECT_FALSE(catalog.remove("backups", "app_1"));
+    EXPECT_EQ(catalog.size(), 0u);
+}
+
+TEST_F(BackupCatalogTest, ChainListsBaseFirst) {
+    BackupCatalog catalog(path);
+    std::int64_t base = catalog.record(entry("app", 100, "base"));
+    std::int64_t d1 = catalog.record(entry("app", 200, "delta1", base));
+    std::int64_t d2 = catalog.record(entry("app", 300, "delta2", d1));
+
+    auto chain = catalog.chain(d2);
+    ASSERT_EQ(chain.size(), 3u);
+    EXPECT_EQ(chain[0].remoteName, "base");
+    EXPECT_EQ(chain[0].parentId, 0);
+    EXPECT_EQ(chain[2].remoteName, "delta2");
+
+    catalog.remove("backups", "base");
+    EXPECT_THROW(catalog.chain(d2), std::runtime_error);
+}
+
+TEST_F(BackupCatalogTest, ExportIsAStandaloneCopy) {
+    {
+        BackupCatalog catalog(path);
+        catalog.record(entry("app", 100, "app_1"));
+        catalog.exportTo(exported);
+        catalog.exportTo(exported);   // replaces an earlier export
+    }
+    BackupCatalog copy(exported);
+    EXPECT_EQ(copy.size(), 1u);
+    EXPECT_EQ(copy.latest("app")->hash, "blake3:00ff");
+}
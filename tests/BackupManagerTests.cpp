@@ -0,0 +1,83 @@
+#include "BackupManager.h"
+#include "Checksum.h"
+#include "JobJournal.h"
+#include "SqliteHelper.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Nothing listens on port 1, so every upload fails fast and no server is needed
+class BackupManagerTest : public ::testing::Test {
+protected:
+    const std::string dir = "test_backup_manager";
+    const std::string journalPath = dir + "/journal.sqlite";
+
+    void SetUp() override {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+    }
+    void TearDown() override { std::filesystem::remove_all(dir); }
+
+    void configure(BackupManager& manager) {
+        manager.setFtpTls(false);
+        manager.setJournal(journalPath);
+        manager.setCatalog(dir + "/catalog.sqlite");
+        manager.setIncremental(4);
+    }
+
+    std::int64_t journalSnapshot(const std::string& source, const std::string& artifact, const std::string& content) {
+        { SqliteHelper db(source, false); db.createTable(); }
+        std::ofstream(artifact, std::ios::binary) << content;
+        JobJournal journal(journalPath);
+        std::int64_t id = journal.begin(source);
+        journal.recordSnapshot(id, artifact, static_cast<std::int64_t>(content.size()),
+                               Checksum::hexDigest(ChecksumAlgorithm::Sha256, content.data(), content.size()));
+        return id;
+    }
+};
+
+TEST_F(BackupManagerTest, ResumedDeltaWithoutPageMapIsAbandoned) {
+    const std::string source = dir + "/source.sqlite";
+
+    // A delta left behind by a crash, whose parent's page map has since been deleted
+    const std::string delta = dir + "/db_backup_20260101_000000.sqlite.delta";
+    const std::int64_t staleJob = journalSnapshot(source, delta, std::string(1000, 'd'));
+    ASSERT_FALSE(std::filesystem::exists(dir + "/catalog.sqlite.db.pages"));
+
+    {
+        BackupManager manager(dir + "/db", "127.0.0.1", 1, "user", "pass", "backups", false, 1, 1, 2);
+        configure(manager);
+        EXPECT_FALSE(manager.run());   // the fresh backup cannot reach the server
+    }
+
+    EXPECT_FALSE(std::filesystem::exists(delta));
+    JobJournal journal(journalPath);
+    auto job = journal.findUnfinished();
+    ASSERT_TRUE(job.has_value());
+    EXPECT_NE(job->id, staleJob);
+    EXPECT_EQ(job->sourceDb, source);
+    // No page map to diff against, so the replacement is a full snapshot
+    EXPECT_EQ(job->artifact.find(".delta"), std::string::npos);
+}
+
+TEST_F(BackupManagerTest, ResumedSnapshotThatChangedIsAbandoned) {
+    const std::string source = dir + "/source.sqlite";
+    const std::string snapshot = dir + "/db_backup_20260101_000000.sqlite";
+    const std::int64_t staleJob = journalSnapshot(source, snapshot, std::string(1000, 's'));
+    // Same size, different bytes: only the digest notices
+    std::ofstream(snapshot, std::ios::binary) << std::string(999, 's') << 'x';
+
+    {
+        BackupManager manager(dir + "/db", "127.0.0.1", 1, "user", "pass", "backups", false, 1, 1, 2);
+        configure(manager);
+        EXPECT_FALSE(manager.run());
+    }
+
+    EXPECT_FALSE(std::filesystem::exists(snapshot));
+    JobJournal journal(journalPath);
+    auto job = journal.findUnfinished();
+    ASSERT_TRUE(job.has_value());
+    EXPECT_NE(job->id, staleJob);
+    EXPECT_FALSE(job->artifactDigest.empty());
+}
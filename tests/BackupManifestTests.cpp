@@ -0,0 +1,111 @@
+#include "BackupManifest.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <stdexcept>
+
+namespace {
+    std::vector<unsigned char> randomBytes(std::size_t n, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<unsigned char> v(n);
+        for (auto& b : v) b = static_cast<unsigned char>(rng());
+        return v;
+    }
+
+    BackupManifest build(const std::vector<unsigned char>& data, std::uint32_t leafSize,
+                         ChecksumAlgorithm algorithm = ChecksumAlgorithm::Xxh3) {
+        BackupManifest m(algorithm, leafSize);
+        m.update(data.data(), data.size());
+        m.finish();
+        return m;
+    }
+}
+
+TEST(BackupManifestTest, StreamingSplitDoesNotChangeTheTree) {
+    auto data = randomBytes(100000, 1);
+    BackupManifest whole = build(data, 4096);
+
+    std::mt19937 rng(2);
+    BackupManifest pieces(ChecksumAlgorithm::Xxh3, 4096);
+    for (std::size_t off = 0; off < data.size();) {
+        std::size_t n = std::min<std::size_t>(data.size() - off, rng() % 9000);
+        pieces.update(data.data() + off, n);
+        off += n;
+    }
+    pieces.finish();
+
+    EXPECT_EQ(pieces.leafCount(), 25u);
+    EXPECT_EQ(pieces.fileSize(), data.size());
+    EXPECT_EQ(pieces.rootHex(), whole.rootHex());
+    EXPECT_TRUE(pieces.diff(whole).empty());
+}
+
+TEST(BackupManifestTest, DiffFindsExactlyTheChangedLeaves) {
+    auto data = randomBytes(37 * 1000, 3);
+    BackupManifest before = build(data, 1000);
+    data[5 * 1000 + 17] ^= 0xff;
+    data[30 * 1000] ^= 0x01;
+    data.back() ^= 0x80;
+    BackupManifest after = build(data, 1000);
+
+    EXPECT_NE(before.rootHex(), after.rootHex());
+    EXPECT_EQ(after.diff(before), (std::vector<std::size_t>{5, 30, 36}));
+    EXPECT_EQ(before.diff(after), (std::vector<std::size_t>{5, 30, 36}));
+}
+
+TEST(BackupManifestTest, DiffReportsGrownAndShrunkTails) {
+    auto data = randomBytes(10 * 512, 4);
+    BackupManifest small = build(data, 512);
+    data.resize(data.size() + 3 * 512 + 10, 0x5a);
+    BackupManifest large = build(data, 512);
+
+    // Leaf 9 is unchanged; leaves 10..13 exist only in the larger file
+    EXPECT_EQ(large.diff(small), (std::vector<std::size_t>{10, 11, 12, 13}));
+    EXPECT_EQ(small.diff(large), (std::vector<std::size_t>{10, 11, 12, 13}));
+}
+
+TEST(BackupManifestTest, VerifyLeafChecksRangeContent) {
+    auto data = randomBytes(2500, 5);
+    BackupManifest m = build(data, 1000);
+    ASSERT_EQ(m.leafCount(), 3u);
+    EXPECT_EQ(m.leafRange(2).first, 2000u);
+    EXPECT_EQ(m.leafRange(2).second, 500u);
+    EXPECT_EQ(m.leafAt(1999), 1u);
+    EXPECT_EQ(m.leafAt(2500), 2u);
+
+    EXPECT_TRUE(m.verifyLeaf(1, data.data() + 1000, 1000));
+    EXPECT_TRUE(m.verifyLeaf(2, data.data() + 2000, 500));
+    EXPECT_FALSE(m.verifyLeaf(1, data.data(), 1000));
+    EXPECT_FALSE(m.verifyLeaf(2, data.data() + 2000, 499));
+    EXPECT_FALSE(m.verifyLeaf(3, data.data(), 0));
+}
+
+TEST(BackupManifestTest, SerializeRoundTrips) {
+    auto data = randomBytes(7777, 6);
+    for (ChecksumAlgorithm algorithm : {ChecksumAlgorithm::Crc32c, ChecksumAlgorithm::Blake3}) {
+        BackupManifest m = build(data, 1024, algorithm);
+        BackupManifest parsed = BackupManifest::parse(m.serialize());
+        EXPECT_EQ(parsed.algorithm(), algorithm);
+        EXPECT_EQ(parsed.leafSize(), 1024u);
+        EXPECT_EQ(parsed.fileSize(), data.size());
+        EXPECT_EQ(parsed.rootHex(), m.rootHex());
+        EXPECT_EQ(parsed.serialize(), m.serialize());
+    }
+
+    BackupManifest empty = build({}, 1024);
+    EXPECT_EQ(empty.leafCount(), 1u);
+    EXPECT_EQ(BackupManifest::parse(empty.serialize()).rootHex(), empty.rootHex());
+}
+
+TEST(BackupManifestTest, RejectsTamperedOrMismatchedManifests) {
+    auto data = randomBytes(5000, 7);
+    std::string text = build(data, 1000).serialize();
+
+    std::string tampered = text;
+    tampered[tampered.size() - 2] = tampered[tampered.size() - 2] == '0' ? '1' : '0';
+    EXPECT_THROW(BackupManifest::parse(tampered), std::runtime_error);
+    EXPECT_THROW(BackupManifest::parse("not a manifest"), std::runtime_error);
+    EXPECT_THROW(BackupManifest::parse(text.substr(0, text.rfind('\n', text.size() - 2) + 1)), std::runtime_error);
+
+    EXPECT_THROW(build(data, 1000).diff(build(data, 500)), std::invalid_argument);
+    EXPECT_THROW(BackupManifest(ChecksumAlgorithm::Xxh3, 0), std::invalid_argument);
+}
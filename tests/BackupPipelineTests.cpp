@@ -0,0 +1,78 @@
+#include "BackupPipeline.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <numeric>
+
+TEST(BackupPipelineTest, RingPreservesOrderUnderBackpressure) {
+    SpscRing<int> ring(4);
+    const int count = 10000;
+
+    std::thread producer([&] {
+        for (int i = 0; i < count; ++i) ring.push(i);
+        ring.close();
+    });
+
+    int expected = 0;
+    int value = 0;
+    while (ring.pop(value)) {
+        ASSERT_EQ(value, expected);
+        ++expected;
+    }
+    producer.join();
+    EXPECT_EQ(expected, count);
+    EXPECT_LE(ring.size(), ring.capacity());
+}
+
+TEST(BackupPipelineTest, StreamsFileThroughStagesInOrder) {
+    const std::string path = "pipeline_source.bin";
+    std::vector<char> content(300000);
+    std::iota(content.begin(), content.end(), 0);
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+
+    BackupPipeline pipeline(2);
+    pipeline.setSource("read", BackupPipeline::fileSource(path, 4096));
+    std::uint64_t nextIndex = 0;
+    pipeline.addStage("check", [&](PipelineChunk& c) {
+        EXPECT_EQ(c.index, nextIndex++);
+    });
+    // Two transforms that cancel out, to exercise stage-to-stage wakeups
+    auto invert = [](PipelineChunk& c) { for (auto& b : c.data) b = static_cast<unsigned char>(~b); };
+    pipeline.addStage("invert", invert);
+    pipeline.addStage("restore", invert);
+    std::vector<char> received;
+    pipeline.setSink("collect", [&](PipelineReader& in) {
+        char buf[1000];
+        while (std::size_t n = in.read(buf, sizeof(buf))) received.insert(received.end(), buf, buf + n);
+    });
+    pipeline.run();
+
+    EXPECT_EQ(received, content);
+    ASSERT_EQ(pipeline.getStats().size(), 5u);
+    EXPECT_EQ(pipeline.getStats().front().bytes, content.size());
+    EXPECT_EQ(pipeline.getStats().back().bytes, content.size());
+    std::filesystem::remove(path);
+}
+
+TEST(BackupPipelineTest, StageFailureAbortsAndRethrows) {
+    BackupPipeline pipeline(2);
+    int produced = 0;
+    pipeline.setSource("endless", [&](PipelineChunk& c) {
+        c.data.assign(16, 0);
+        return ++produced < 1000000;
+    });
+    pipeline.addStage("fail", [](PipelineChunk& c) {
+        if (c.index == 5) throw std::runtime_error("boom");
+    });
+    pipeline.setSink("drain", [](PipelineReader& in) {
+        PipelineChunk c;
+        while (in.next(c)) {}
+    });
+
+    EXPECT_THROW(pipeline.run(), std::runtime_error);
+    EXPECT_LT(produced, 1000000);
+}
@@ -0,0 +1,145 @@
+#include "Cancellation.h"
+#include "FtpUploader.h"
+#include "SqliteHelper.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+TEST(CancellationTokenTest, CancelKeepsTheFirstReason) {
+    CancellationToken token;
+    EXPECT_FALSE(token.isCancelled());
+    EXPECT_NO_THROW(token.throwIfCancelled());
+    token.cancel("first");
+    token.cancel("second");
+    EXPECT_TRUE(token.isCancelled());
+    EXPECT_EQ(token.reason(), "first");
+    EXPECT_THROW(token.throwIfCancelled(), OperationCancelled);
+}
+
+TEST(CancellationTokenTest, DeadlineFires) {
+    CancellationToken token;
+    token.setTimeout(std::chrono::milliseconds(50));
+    EXPECT_FALSE(token.isCancelled());
+    EXPECT_LE(token.remaining(), std::chrono::milliseconds(50));
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    EXPECT_TRUE(token.isCancelled());
+    EXPECT_EQ(token.reason(), "deadline exceeded");
+}
+
+TEST(CancellationTokenTest, ChildFollowsParent) {
+    CancellationToken parent;
+    CancellationToken child(&parent);
+    parent.cancelFromSignal(SIGTERM);
+    EXPECT_TRUE(child.isCancelled());
+    EXPECT_EQ(child.reason(), "terminated (SIGTERM)");
+
+    // ...but not the other way round
+    CancellationToken other;
+    CancellationToken otherChild(&other);
+    otherChild.cancel();
+    EXPECT_FALSE(other.isCancelled());
+}
+
+TEST(CancellationTokenTest, SleepIsCutShort) {
+    CancellationToken token;
+    std::thread canceller([&token] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        token.cancel("stop");
+    });
+    auto start = Clock::now();
+    EXPECT_THROW(token.sleepFor(std::chrono::seconds(10)), OperationCancelled);
+    EXPECT_LT(secondsSince(start), 1.0);
+    canceller.join();
+}
+
+class CancelledBackupTest : public ::testing::Test {
+protected:
+    const std::string sourceDb = "test_cancel_source.sqlite";
+    const std::string copyDb = "test_cancel_copy.sqlite";
+    void SetUp() override { removeFiles(); }
+    void TearDown() override { removeFiles(); }
+    void removeFiles() {
+        std::filesystem::remove(sourceDb);
+        std::filesystem::remove(copyDb);
+    }
+};
+
+TEST_F(CancelledBackupTest, BackupStopsWhenCancelled) {
+    SqliteHelper source(sourceDb, false);
+    source.createTable();
+    source.insertRandomRows(20);
+
+    CancellationToken token;
+    token.cancel("window closed");
+    EXPECT_THROW(source.backupToFile(copyDb, &token), OperationCancelled);
+    EXPECT_THROW(source.vacuumToFile(copyDb, &token), OperationCancelled);
+
+    // An untouched token does not get in the way
+    CancellationToken idle;
+    source.backupToFile(copyDb, &idle);
+    SqliteHelper copy(copyDb, false);
+    EXPECT_EQ(copy.getRowCount(), 20);
+}
+
+TEST(CancelledUploadTest, RetrySleepsAreInterrupted) {
+    const std::string file = "test_cancel_upload.txt";
+    std::ofstream(file) << "payload";
+
+    // Nothing listens on port 1: each attempt fails at once, then backs off
+    FtpUploader uploader("127.0.0.1", 1, "user", "pass");
+    uploader.setRetries(6);
+    CancellationToken token;
+    token.setTimeout(std::chrono::milliseconds(300));
+    uploader.setCancellationToken(&token);
+
+    auto start = Clock::now();
+    EXPECT_THROW(uploader.uploadFile(file, "dir"), OperationCancelled);
+    EXPECT_LT(secondsSince(start), 2.0);   // backoff alone would be 15.5 s
+    std::filesystem::remove(file);
+}
+
+#if !defined(_WIN32)
+TEST(CancelledUploadTest, StalledTransferIsAborted) {
+    // A server that accepts the connection and never sends its greeting
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listener, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(listen(listener, 1), 0);
+    socklen_t len = sizeof(addr);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+
+    FtpUploader uploader("127.0.0.1", ntohs(addr.sin_port), "user", "pass");
+    uploader.setTimeout(60);
+    uploader.setUseTls(false);
+    CancellationToken token;
+    token.setTimeout(std::chrono::milliseconds(200));
+    uploader.setCancellationToken(&token);
+
+    auto start = Clock::now();
+    EXPECT_THROW(uploader.uploadStream([](char*, std::size_t) { return std::size_t(0); }, "dir", "file.bin", 0),
+                 OperationCancelled);
+    EXPECT_LT(secondsSince(start), 3.0);   // far below the 60 s response timeout
+    close(listener);
+}
+#endif
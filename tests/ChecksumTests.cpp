@@ -0,0 +1,109 @@
+#include "Checksum.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <stdexcept>
+
+namespace {
+    // Deterministic input shared with the reference values below
+    std::vector<unsigned char> pattern(std::size_t n) {
+        std::vector<unsigned char> v(n);
+        for (std::size_t i = 0; i < n; ++i) v[i] = static_cast<unsigned char>((i * 31 + 7) & 0xff);
+        return v;
+    }
+
+    const SimdLevel kAllLevels[] = {SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2, SimdLevel::Avx512};
+}
+
+class ChecksumTest : public ::testing::Test {
+protected:
+    SimdLevel saved = SimdLevel::Avx512;
+    void SetUp() override { saved = Checksum::maxSimdLevel(); }
+    void TearDown() override { Checksum::setMaxSimdLevel(saved); }
+};
+
+TEST_F(ChecksumTest, MatchesReferenceDigests) {
+    // Reference values from xxhsum/b3sum/the iSCSI CRC32C check value
+    struct Vector { std::size_t len; const char* xxh3; const char* blake3; };
+    const Vector vectors[] = {
+        {0, "2d06800538d394c2", "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+        {3, "15f7093b173d005c", "545a7476d63b5a22936f733cd2cb89f162a7d864cb01b8b88437a36627b1303a"},
+        {200, "12fdb864685f344d", "8ac869dbbe1bde2e2218b2ea12ab47917829f29f28be3e8fee7ced730512a828"},
+        {5000, "559fff92c2b7f8ee", "a3d69d42e4f8b44ec13499a8c2d7bec15bd61e33716dce27a725ae331dc18165"},
+        {100000, "ccf90df7e7e37036", "4e14b1e550c5a286b2fa16dc0046a7291b3c0cb164d880200354a68982e113ef"},
+    };
+    for (SimdLevel level : kAllLevels) {
+        Checksum::setMaxSimdLevel(level);
+        EXPECT_EQ(Checksum::crc32c("123456789", 9), 0xE3069283u);
+        EXPECT_EQ(Checksum::hexDigest(ChecksumAlgorithm::Sha256, "abc", 3),
+                  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        for (const auto& v : vectors) {
+            auto data = pattern(v.len);
+            EXPECT_EQ(Checksum::hexDigest(ChecksumAlgorithm::Xxh3, data.data(), data.size()), v.xxh3)
+                << "len " << v.len << ", level " << static_cast<int>(level);
+            EXPECT_EQ(Checksum::hexDigest(ChecksumAlgorithm::Blake3, data.data(), data.size()), v.blake3)
+                << "len " << v.len << ", level " << static_cast<int>(level);
+        }
+    }
+}
+
+TEST_F(ChecksumTest, StreamingMatchesOneShotForAnySplit) {
+    auto data = pattern(300 * 1000);
+    std::mt19937 rng(7);
+    for (ChecksumAlgorithm algorithm : {ChecksumAlgorithm::Crc32c, ChecksumAlgorithm::Xxh3,
+                                        ChecksumAlgorithm::Blake3, ChecksumAlgorithm::Sha256}) {
+        for (SimdLevel level : kAllLevels) {
+            Checksum::setMaxSimdLevel(level);
+            const std::string expected = Checksum::hexDigest(algorithm, data.data(), data.size());
+            auto h = Checksum::create(algorithm);
+            for (std::size_t off = 0; off < data.size();) {
+                std::size_t n = std::min<std::size_t>(data.size() - off, rng() % 20000);
+                h->update(data.data() + off, n);
+                off += n;
+            }
+            EXPECT_EQ(h->hex(), expected) << Checksum::algorithmName(algorithm) << " " << h->implementation();
+        }
+    }
+}
+
+TEST_F(ChecksumTest, KernelsAgreeAcrossLevels) {
+    auto data = pattern(1 << 20);
+    Checksum::setMaxSimdLevel(SimdLevel::Scalar);
+    const std::uint32_t crc = Checksum::crc32c(data.data(), data.size());
+    const std::uint64_t xxh = Checksum::xxh3(data.data(), data.size());
+    for (SimdLevel level : kAllLevels) {
+        Checksum::setMaxSimdLevel(level);
+        EXPECT_EQ(Checksum::crc32c(data.data(), data.size()), crc);
+        EXPECT_EQ(Checksum::xxh3(data.data(), data.size()), xxh);
+    }
+}
+
+TEST_F(ChecksumTest, DigestDoesNotEndTheStream) {
+    auto data = pattern(4096);
+    auto h = Checksum::create(ChecksumAlgorithm::Blake3);
+    h->update(data.data(), 1000);
+    const std::string partial = h->hex();
+    EXPECT_EQ(partial, h->hex());
+    h->update(data.data() + 1000, data.size() - 1000);
+    EXPECT_EQ(h->hex(), Checksum::hexDigest(ChecksumAlgorithm::Blake3, data.data(), data.size()));
+}
+
+TEST_F(ChecksumTest, LabelsAndNames) {
+    auto xxh = Checksum::create(ChecksumAlgorithm::Xxh3);
+    EXPECT_EQ(xxh->label(), "xxh3:2d06800538d394c2");
+    auto sha = Checksum::create(ChecksumAlgorithm::Sha256);
+    EXPECT_EQ(sha->label(), sha->hex());   // journals always stored bare SHA-256 hex
+
+    for (ChecksumAlgorithm algorithm : {ChecksumAlgorithm::Sha256, ChecksumAlgorithm::Crc32c,
+                                        ChecksumAlgorithm::Xxh3, ChecksumAlgorithm::Blake3}) {
+        EXPECT_EQ(Checksum::parseAlgorithm(Checksum::algorithmName(algorithm)), algorithm);
+    }
+    EXPECT_THROW(Checksum::parseAlgorithm("md5"), std::invalid_argument);
+}
+
+TEST_F(ChecksumTest, MaxSimdLevelCapsTheKernel) {
+    SimdLevel previous = Checksum::setMaxSimdLevel(SimdLevel::Scalar);
+    EXPECT_EQ(Checksum::maxSimdLevel(), SimdLevel::Scalar);
+    EXPECT_STREQ(Checksum::create(ChecksumAlgorithm::Xxh3)->implementation(), "scalar");
+    EXPECT_STREQ(Checksum::create(ChecksumAlgorithm::Crc32c)->implementation(), "scalar");
+    EXPECT_EQ(Checksum::setMaxSimdLevel(previous), SimdLevel::Scalar);
+}
@@ -0,0 +1,103 @@
+#include "ChunkStore.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <stdexcept>
+
+namespace {
+    std::vector<unsigned char> randomBytes(std::size_t n, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<unsigned char> v(n);
+        for (auto& b : v) b = static_cast<unsigned char>(rng());
+        return v;
+    }
+
+    // Split a whole buffer the way the upload sink does
+    std::vector<std::string> chunkIds(const ContentChunker& chunker, const std::vector<unsigned char>& data,
+                                      std::vector<std::size_t>* sizes = nullptr) {
+        std::vector<std::string> ids;
+        for (std::size_t off = 0; off < data.size();) {
+            std::size_t n = chunker.cut(data.data() + off, data.size() - off);
+            ids.push_back(ChunkIndex::chunkId(data.data() + off, n));
+            if (sizes) sizes->push_back(n);
+            off += n;
+        }
+        return ids;
+    }
+}
+
+TEST(ChunkStoreTest, ChunkSizesStayWithinBounds) {
+    ContentChunker chunker(ChunkingParams::forAverage(8 * 1024));
+    auto data = randomBytes(4 << 20, 1);
+    std::vector<std::size_t> sizes;
+    chunkIds(chunker, data, &sizes);
+
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        total += sizes[i];
+        EXPECT_LE(sizes[i], 32u * 1024);
+        if (i + 1 < sizes.size()) {
+            EXPECT_GE(sizes[i], 2u * 1024);
+        }
+    }
+    EXPECT_EQ(total, data.size());
+    // Normalized chunking keeps the mean near the target
+    const double mean = static_cast<double>(total) / sizes.size();
+    EXPECT_GT(mean, 6 * 1024.0);
+    EXPECT_LT(mean, 12 * 1024.0);
+}
+
+TEST(ChunkStoreTest, InsertedBytesOnlyChangeNearbyChunks) {
+    ContentChunker chunker(ChunkingParams::forAverage(8 * 1024));
+    auto data = randomBytes(2 << 20, 2);
+    auto before = chunkIds(chunker, data);
+
+    auto rows = randomBytes(300, 3);
+    data.insert(data.begin() + (1 << 20), rows.begin(), rows.end());
+    auto after = chunkIds(chunker, data);
+
+    std::set<std::string> known(before.begin(), before.end());
+    std::size_t fresh = 0;
+    for (const auto& id : after) fresh += known.count(id) == 0;
+    EXPECT_LE(fresh, 3u) << "of " << after.size() << " chunks";
+}
+
+TEST(ChunkStoreTest, CutNeverExceedsAvailableBytes) {
+    ContentChunker chunker;
+    auto data = randomBytes(1000, 4);
+    EXPECT_EQ(chunker.cut(data.data(), 0), 0u);
+    EXPECT_EQ(chunker.cut(data.data(), data.size()), data.size());
+    EXPECT_THROW(ContentChunker(ChunkingParams{100, 50, 200}), std::invalid_argument);
+}
+
+TEST(ChunkStoreTest, RecipeRoundTrips) {
+    ChunkRecipe recipe;
+    recipe.size = 15;
+    recipe.chunks = {{ChunkIndex::chunkId("0123456789", 10), 10}, {ChunkIndex::chunkId("abcde", 5), 5}};
+    ChunkRecipe parsed = ChunkRecipe::parse(recipe.serialize());
+    EXPECT_EQ(parsed.algorithm, ChecksumAlgorithm::Blake3);
+    EXPECT_EQ(parsed.size, 15u);
+    ASSERT_EQ(parsed.chunks.size(), 2u);
+    EXPECT_EQ(parsed.chunks[1].id, recipe.chunks[1].id);
+    EXPECT_EQ(parsed.chunks[1].length, 5u);
+
+    recipe.size = 16;
+    EXPECT_THROW(ChunkRecipe::parse(recipe.serialize()), std::runtime_error);
+    EXPECT_THROW(ChunkRecipe::parse("sqliteftpbackup-recipe 1\nhash blake3\nsize 1\nzz 1\n"), std::runtime_error);
+    EXPECT_THROW(ChunkRecipe::parse("hello"), std::runtime_error);
+}
+
+TEST(ChunkStoreTest, IndexIgnoresTornLastLine) {
+    const std::string a = ChunkIndex::chunkId("a", 1);
+    const std::string b = ChunkIndex::chunkId("b", 1);
+    ChunkIndex index;
+    index.load(a + "\n" + b.substr(0, 20));
+    EXPECT_TRUE(index.contains(a));
+    EXPECT_FALSE(index.contains(b));
+    EXPECT_TRUE(index.add(b));
+    EXPECT_FALSE(index.add(b));
+    EXPECT_EQ(index.size(), 2u);
+
+    EXPECT_EQ(ChunkIndex::chunkDir("backups", a), "backups/chunks/" + a.substr(0, 2));
+    EXPECT_EQ(ChunkIndex::indexDir(""), "chunks");
+}
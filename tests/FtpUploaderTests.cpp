@@ -67,3 +67,22 @@ TEST_F(FtpUploaderTest, SetTimeoutAndRetries) {
     // For now, just ensure these calls do not throw
     SUCCEED();
 }
+
+// Test MLSD listing parsing
+TEST_F(FtpUploaderTest, ParseMlsdListing) {
+    auto entries = FtpUploader::parseMlsd(
+        "type=cdir;modify=20240101000000; .\r\n"
+        "type=pdir;modify=20240101000000; ..\r\n"
+        "type=file;size=1234;modify=20240102030405; db_backup_1.sqlite\r\n"
+        "Type=dir;Modify=20240101000000; chunks\r\n"
+        "type=file;size=7; name with spaces\r\n");
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].name, "db_backup_1.sqlite");
+    EXPECT_FALSE(entries[0].isDirectory);
+    EXPECT_EQ(entries[0].size, 1234);
+    EXPECT_EQ(entries[0].modified, 1704164645);
+    EXPECT_EQ(entries[1].name, "chunks");
+    EXPECT_TRUE(entries[1].isDirectory);
+    EXPECT_EQ(entries[2].name, "name with spaces");
+    EXPECT_EQ(entries[2].modified, 0);
+}
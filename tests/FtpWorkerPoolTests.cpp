@@ -0,0 +1,55 @@
+#include "FtpWorkerPool.h"
+#include "FtpUploader.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    // Sessions are only constructed, never connected
+    FtpWorkerPool::Factory localSessions(std::atomic<int>& created) {
+        return [&created] {
+            ++created;
+            return std::make_unique<FtpUploader>("127.0.0.1", 21, "user", "pass");
+        };
+    }
+}
+
+TEST(FtpWorkerPoolTest, RunsEveryJobOnPerThreadSessions) {
+    std::atomic<int> created{0};
+    std::atomic<int> done{0};
+    std::mutex mtx;
+    std::set<FtpUploader*> sessions;
+    {
+        FtpWorkerPool pool(3, localSessions(created));
+        for (int i = 0; i < 50; ++i) {
+            pool.submit([&](FtpUploader& ftp) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> lock(mtx);
+                sessions.insert(&ftp);
+                ++done;
+            });
+        }
+        pool.wait();
+        EXPECT_EQ(done.load(), 50);
+    }
+    EXPECT_LE(created.load(), 3);
+    EXPECT_EQ(static_cast<int>(sessions.size()), created.load());
+}
+
+TEST(FtpWorkerPoolTest, FirstFailureIsRethrownAndDropsTheQueue) {
+    std::atomic<int> created{0};
+    std::atomic<int> ran{0};
+    FtpWorkerPool pool(1, localSessions(created), 100);
+    pool.submit([](FtpUploader&) { throw std::runtime_error("boom"); });
+    for (int i = 0; i < 20; ++i) pool.submit([&ran](FtpUploader&) { ++ran; });
+    EXPECT_THROW(pool.wait(), std::runtime_error);
+    EXPECT_LT(ran.load(), 20);
+
+    // The pool keeps working after a failure has been collected
+    pool.submit([&ran](FtpUploader&) { ran = 100; });
+    pool.wait();
+    EXPECT_EQ(ran.load(), 100);
+}
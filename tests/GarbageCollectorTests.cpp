@@ -0,0 +1,139 @@
+#include "BloomFilter.h"
+#include "ChunkStore.h"
+#include "FtpWorkerPool.h"
+#include "GarbageCollector.h"
+#include "LoopbackFtpServer.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+    RemoteEntry file(const std::string& name, std::time_t modified = 0) {
+        RemoteEntry e;
+        e.name = name;
+        e.modified = modified;
+        return e;
+    }
+}
+
+TEST(BloomFilterTest, NeverMissesAnAddedKey) {
+    BloomFilter filter(10000);
+    for (int i = 0; i < 10000; ++i) filter.add("chunk-" + std::to_string(i));
+    for (int i = 0; i < 10000; ++i) EXPECT_TRUE(filter.mayContain("chunk-" + std::to_string(i)));
+}
+
+TEST(BloomFilterTest, FalsePositiveRateNearTarget) {
+    BloomFilter filter(20000, 0.01);
+    EXPECT_EQ(filter.hashCount(), 7u);
+    EXPECT_LE(filter.memoryBytes(), 20000u * 10 / 8 + 8);   // ~9.6 bits per key
+    for (int i = 0; i < 20000; ++i) filter.add("live-" + std::to_string(i));
+
+    int hits = 0;
+    const int probes = 100000;
+    for (int i = 0; i < probes; ++i) hits += filter.mayContain("dead-" + std::to_string(i));
+    EXPECT_LT(hits, probes * 2 / 100);
+}
+
+TEST(BloomFilterTest, RejectsBadRate) {
+    EXPECT_THROW(BloomFilter(10, 0.0), std::invalid_argument);
+    EXPECT_THROW(BloomFilter(10, 1.0), std::invalid_argument);
+}
+
+TEST(GarbageCollectorTest, FindsPlainAndChunkedBackups) {
+    std::vector<RemoteEntry> entries = {
+        file("db_backup_20240101_000000.sqlite"),
+        file("db_backup_20240101_000000.sqlite.manifest"),
+        file("db_backup_20240102_000000.sqlite.recipe"),
+        file("notes.txt"),
+    };
+    RemoteEntry chunks;
+    chunks.name = "chunks";
+    chunks.isDirectory = true;
+    entries.push_back(chunks);
+
+    auto backups = GarbageCollector::findBackups(entries);
+    ASSERT_EQ(backups.size(), 2u);
+    EXPECT_EQ(backups[0].name, "db_backup_20240101_000000.sqlite");
+    EXPECT_FALSE(backups[0].chunked);
+    EXPECT_EQ(backups[1].name, "db_backup_20240102_000000.sqlite");
+    EXPECT_TRUE(backups[1].chunked);
+}
+
+TEST(GarbageCollectorTest, ExpiresAllButNewestOldestFirst) {
+    std::vector<GarbageCollector::Backup> backups = {
+        {"b", false, 200}, {"d", true, 400}, {"a", false, 100}, {"c", true, 300},
+    };
+    auto old = GarbageCollector::expired(backups, 2);
+    ASSERT_EQ(old.size(), 2u);
+    EXPECT_EQ(old[0].name, "a");
+    EXPECT_EQ(old[1].name, "b");
+
+    EXPECT_TRUE(GarbageCollector::expired(backups, 0).empty());
+    EXPECT_TRUE(GarbageCollector::expired(backups, 4).empty());
+}
+
+TEST(GarbageCollectorTest, KeepsTheChainOfAKeptDelta) {
+    std::vector<RemoteEntry> entries = {
+        file("db_backup_1.sqlite", 100),
+        file("db_backup_2.sqlite", 200),
+        file("db_backup_3.sqlite.delta", 300),
+        file("db_backup_4.sqlite.delta.enc", 400),
+        file("other_backup_1.sqlite", 150),
+    };
+    auto backups = GarbageCollector::findBackups(entries);
+    EXPECT_TRUE(backups[3].delta);
+    EXPECT_FALSE(backups[1].delta);
+
+    // The newest backup is a delta: the older delta and the full backup under it stay
+    auto old = GarbageCollector::expired(backups, 1);
+    ASSERT_EQ(old.size(), 2u);
+    EXPECT_EQ(old[0].name, "db_backup_1.sqlite");
+    EXPECT_EQ(old[1].name, "other_backup_1.sqlite");
+}
+
+TEST(GarbageCollectorTest, RecipeThatCannotBeDeletedKeepsItsChunks) {
+    LoopbackFtpServer server;
+    server.start();
+    // Two chunked backups, each with a chunk of its own
+    std::string chunkPaths[2];
+    for (int i = 0; i < 2; ++i) {
+        const std::string content = "chunk " + std::to_string(i);
+        ChunkRecipe recipe;
+        recipe.size = content.size();
+        recipe.chunks.push_back({ChunkIndex::chunkId(content.data(), content.size()),
+                                 static_cast<std::uint32_t>(content.size())});
+        const std::string& id = recipe.chunks.back().id;
+        chunkPaths[i] = "/" + ChunkIndex::chunkDir("backups", id) + "/" + id;
+        server.putFile(chunkPaths[i], content);
+        server.putFile("/backups/db_backup_2024010" + std::to_string(i + 1) + "_000000.sqlite.recipe",
+                       recipe.serialize());
+    }
+    server.putFile("/backups/chunks/index", "");
+    const std::string oldRecipe = "/backups/db_backup_20240101_000000.sqlite.recipe";
+    server.failDelete(oldRecipe);
+
+    auto session = [&server] {
+        auto ftp = std::make_unique<FtpUploader>("127.0.0.1", server.getPort(), "user", "pass");
+        ftp->setUseTls(false);
+        return ftp;
+    };
+    std::unique_ptr<FtpUploader> control = session();
+    FtpWorkerPool pool(2, session);
+    GcOptions options;
+    options.keepBackups = 1;
+    options.minChunkAge = std::chrono::seconds(0);
+    GcStats stats = GarbageCollector(*control, pool, "backups").run(options);
+
+    // The old backup could not be deleted, so it is still a backup and its chunk still live
+    EXPECT_TRUE(server.hasFile(oldRecipe));
+    EXPECT_TRUE(server.hasFile(chunkPaths[0]));
+    EXPECT_TRUE(server.hasFile(chunkPaths[1]));
+    EXPECT_EQ(stats.backupsDeleted, 0u);
+    EXPECT_TRUE(stats.deletedBackups.empty());
+    EXPECT_EQ(stats.backupsKept, 2u);
+    EXPECT_EQ(stats.chunksScanned, 2u);
+    EXPECT_EQ(stats.chunksDeleted, 0u);
+    EXPECT_EQ(stats.deleteFailures, 1u);
+    server.stop();
+}
@@ -0,0 +1,92 @@
+#include "HdrHistogram.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Reported values may differ from the exact ones by the histogram's precision
+    void expectWithinPrecision(std::int64_t actual, std::int64_t expected) {
+        EXPECT_LE(std::llabs(actual - expected), std::max<std::int64_t>(1, expected / 1000))
+            << "actual " << actual << ", expected " << expected;
+    }
+}
+
+TEST(HdrHistogramTest, PercentilesOfUniformValues) {
+    HdrHistogram h(3600LL * 1000 * 1000, 3);
+    for (std::int64_t v = 1; v <= 100000; ++v) h.record(v);
+
+    EXPECT_EQ(h.getTotalCount(), 100000u);
+    EXPECT_EQ(h.getMin(), 1);
+    EXPECT_EQ(h.getMax(), 100000);
+    expectWithinPrecision(h.valueAtPercentile(50), 50000);
+    expectWithinPrecision(h.valueAtPercentile(90), 90000);
+    expectWithinPrecision(h.valueAtPercentile(99), 99000);
+    expectWithinPrecision(h.valueAtPercentile(99.9), 99900);
+    EXPECT_EQ(h.valueAtPercentile(100), 100000);
+    EXPECT_NEAR(h.getMean(), 50000.5, 50);
+}
+
+TEST(HdrHistogramTest, KeepsPrecisionAcrossMagnitudes) {
+    HdrHistogram h(3600LL * 1000 * 1000 * 1000, 3);
+    // 99 fast values and one slow outlier, nine orders of magnitude apart
+    for (int i = 0; i < 99; ++i) h.record(1234);
+    h.record(1234567890123LL);
+
+    expectWithinPrecision(h.valueAtPercentile(50), 1234);
+    expectWithinPrecision(h.valueAtPercentile(99), 1234);
+    EXPECT_EQ(h.valueAtPercentile(99.9), 1234567890123LL);
+    for (std::int64_t v : {1LL, 999LL, 2047LL, 123456LL, 987654321LL}) {
+        EXPECT_LE(h.lowestEquivalentValue(v), v);
+        EXPECT_GE(h.highestEquivalentValue(v), v);
+        EXPECT_LE(h.highestEquivalentValue(v) - h.lowestEquivalentValue(v), std::max<std::int64_t>(1, v / 1000));
+    }
+}
+
+TEST(HdrHistogramTest, ClampsOutOfRangeValues) {
+    HdrHistogram h(1000, 2);
+    h.record(-5);
+    h.record(5000);
+    EXPECT_EQ(h.getMin(), 0);
+    EXPECT_EQ(h.getMax(), 1000);
+}
+
+TEST(HdrHistogramTest, ConcurrentRecordingAndMerge) {
+    HdrHistogram a(1000000, 3), b(1000000, 3);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&a, t] { for (int i = 1; i <= 5000; ++i) a.record(i * (t + 1)); });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(a.getTotalCount(), 20000u);
+
+    b.record(999999);
+    b.add(a);
+    EXPECT_EQ(b.getTotalCount(), 20001u);
+    EXPECT_EQ(b.getMax(), 999999);
+    EXPECT_EQ(b.getMin(), 1);
+
+    b.reset();
+    EXPECT_EQ(b.getTotalCount(), 0u);
+    EXPECT_EQ(b.valueAtPercentile(99), 0);
+}
+
+TEST(LatencyStatsTest, SummariesCoverRecordedHistograms) {
+    LatencyStats stats;
+    HdrHistogram& steps = stats.histogram("steps");
+    for (int i = 1; i <= 1000; ++i) steps.record(i * 1000LL);
+    stats.histogram("unused");
+
+    auto all = stats.summaries();
+    ASSERT_EQ(all.size(), 1u);
+    EXPECT_EQ(all[0].name, "steps");
+    EXPECT_EQ(all[0].count, 1000u);
+    expectWithinPrecision(all[0].p50, 500000);
+    expectWithinPrecision(all[0].p999, 999000);
+    EXPECT_EQ(all[0].max, 1000000);
+
+    EXPECT_EQ(LatencyStats::formatNanos(850), "850ns");
+    EXPECT_EQ(LatencyStats::formatNanos(12400), "12.4us");
+    EXPECT_EQ(LatencyStats::formatNanos(3210000), "3.21ms");
+    EXPECT_EQ(LatencyStats::formatNanos(1500000000), "1.50s");
+}
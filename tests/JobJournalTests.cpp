@@ -0,0 +1,103 @@
+#include "JobJournal.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+
+class JobJournalTest : public ::testing::Test {
+protected:
+    const std::string path = "test_journal.sqlite";
+
+    void SetUp() override { removeFiles(); }
+    void TearDown() override { removeFiles(); }
+
+    void removeFiles() {
+        for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    }
+};
+
+TEST_F(JobJournalTest, EmptyJournalHasNoUnfinishedJob) {
+    JobJournal journal(path);
+    EXPECT_FALSE(journal.findUnfinished().has_value());
+}
+
+TEST_F(JobJournalTest, ProgressSurvivesReopen) {
+    std::int64_t id = 0;
+    {
+        JobJournal journal(path);
+        id = journal.begin("source.sqlite");
+        journal.recordSnapshot(id, "snap.sqlite", 4096, "9f86d081884c7d65");
+        journal.recordUploadProgress(id, "backups", "snap.sqlite", 1024);
+    }
+
+    JobJournal reopened(path);
+    auto job = reopened.findUnfinished();
+    ASSERT_TRUE(job.has_value());
+    EXPECT_EQ(job->id, id);
+    EXPECT_EQ(job->stage, JobStage::Uploading);
+    EXPECT_EQ(job->sourceDb, "source.sqlite");
+    EXPECT_EQ(job->artifact, "snap.sqlite");
+    EXPECT_EQ(job->artifactSize, 4096);
+    EXPECT_EQ(job->artifactDigest, "9f86d081884c7d65");
+    EXPECT_EQ(job->remoteDir, "backups");
+    EXPECT_EQ(job->remoteName, "snap.sqlite");
+    EXPECT_EQ(job->remoteOffset, 1024);
+}
+
+TEST_F(JobJournalTest, FinishedJobsAreNotReturned) {
+    JobJournal journal(path);
+    std::int64_t done = journal.begin("a.sqlite");
+    journal.recordSnapshot(done, "a_snap.sqlite", 10, "abc");
+    journal.markDone(done, "abc");
+    std::int64_t abandoned = journal.begin("b.sqlite");
+    journal.markAbandoned(abandoned);
+    EXPECT_FALSE(journal.findUnfinished().has_value());
+
+    std::int64_t started = journal.begin("c.sqlite");
+    auto job = journal.findUnfinished();
+    ASSERT_TRUE(job.has_value());
+    EXPECT_EQ(job->id, started);
+    EXPECT_EQ(job->stage, JobStage::Started);
+}
+
+TEST_F(JobJournalTest, CipherSaltSurvivesReopen) {
+    const std::vector<unsigned char> salt(32, 0x5c);
+    {
+        JobJournal journal(path);
+        journal.recordSnapshot(journal.begin("plain.sqlite"), "plain_snap.sqlite", 10, "abc");
+        EXPECT_TRUE(journal.findUnfinished()->cipherSalt.empty());
+        journal.recordSnapshot(journal.begin("enc.sqlite"), "enc_snap.sqlite", 10, "def", salt);
+    }
+
+    JobJournal reopened(path);
+    auto job = reopened.findUnfinished();
+    ASSERT_TRUE(job.has_value());
+    EXPECT_EQ(job->cipherSalt, salt);
+}
+
+TEST_F(JobJournalTest, OlderJournalGainsCipherSalt) {
+    sqlite3* raw = nullptr;
+    ASSERT_EQ(sqlite3_open(path.c_str(), &raw), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(raw,
+        "CREATE TABLE jobs(id INTEGER PRIMARY KEY AUTOINCREMENT, stage TEXT NOT NULL, source_db TEXT NOT NULL, "
+        "artifact TEXT, artifact_size INTEGER DEFAULT 0, artifact_digest TEXT, upload_digest TEXT, remote_dir TEXT, "
+        "remote_name TEXT, remote_offset INTEGER DEFAULT 0, started_at TEXT, updated_at TEXT);"
+        "INSERT INTO jobs(stage, source_db, artifact, artifact_size, artifact_digest) "
+        "VALUES ('snapshot', 'old.sqlite', 'old_snap', 7, 'abc');",
+        nullptr, nullptr, nullptr), SQLITE_OK);
+    sqlite3_close(raw);
+
+    JobJournal journal(path);
+    auto job = journal.findUnfinished();
+    ASSERT_TRUE(job.has_value());
+    EXPECT_EQ(job->artifact, "old_snap");
+    EXPECT_EQ(job->artifactDigest, "abc");
+    EXPECT_TRUE(job->cipherSalt.empty());
+    journal.recordSnapshot(job->id, "old_snap", 7, "abc", std::vector<unsigned char>(32, 1));
+    EXPECT_EQ(journal.findUnfinished()->cipherSalt.size(), 32u);
+}
+
+TEST(JobJournalStageTest, StageNamesRoundTrip) {
+    for (JobStage s : {JobStage::Started, JobStage::Snapshot, JobStage::Uploading,
+                       JobStage::Done, JobStage::Abandoned}) {
+        EXPECT_EQ(JobJournal::stageFromString(JobJournal::stageToString(s)), s);
+    }
+}
@@ -0,0 +1,109 @@
+#include "Metrics.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+TEST(MetricsTest, CountersAreExactUnderConcurrency) {
+    MetricsRegistry registry;
+    Counter& c = registry.counter("test_events_total", "Events");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&c] { for (int i = 0; i < 10000; ++i) c.inc(); });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(c.value(), 40000u);
+    // Same name and labels return the same series
+    EXPECT_EQ(&registry.counter("test_events_total", "Events"), &c);
+}
+
+TEST(MetricsTest, RendersPrometheusTextFormat) {
+    MetricsRegistry registry;
+    registry.counter("test_requests_total", "Requests", "code=\"200\"").inc(3);
+    registry.gauge("test_temperature", "Temperature").set(21.5);
+    Histogram& h = registry.histogram("test_latency_seconds", "Latency", "", {0.1, 1});
+    h.observe(0.05);
+    h.observe(0.5);
+    h.observe(5);
+
+    std::string text = registry.renderPrometheus();
+    EXPECT_NE(text.find("# TYPE test_requests_total counter\n"), std::string::npos);
+    EXPECT_NE(text.find("test_requests_total{code=\"200\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("test_temperature 21.5\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE test_latency_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"0.1\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"1\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_count 3\n"), std::string::npos);
+}
+
+TEST(MetricsTest, RejectsTypeMismatch) {
+    MetricsRegistry registry;
+    registry.counter("test_thing", "Thing");
+    EXPECT_THROW(registry.gauge("test_thing", "Thing"), std::logic_error);
+}
+
+TEST(MetricsTest, WritesTextfileAtomically) {
+    MetricsRegistry registry;
+    registry.counter("test_written_total", "Written").inc();
+    const std::string path = "metrics_test.prom";
+    registry.writeTextfile(path);
+
+    std::ifstream ifs(path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    EXPECT_NE(ss.str().find("test_written_total 1"), std::string::npos);
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+    ifs.close();
+    std::filesystem::remove(path);
+}
+
+TEST(MetricsServerTest, HandlesRequests) {
+    MetricsRegistry registry;
+    registry.counter("test_hits_total", "Hits").inc(7);
+    MetricsServer server(registry, 0);
+
+    std::string ok = server.handleRequest("GET /metrics HTTP/1.1\r\nHost: x\r\n\r\n");
+    EXPECT_EQ(ok.rfind("HTTP/1.1 200 OK", 0), 0u);
+    EXPECT_NE(ok.find("test_hits_total 7"), std::string::npos);
+    EXPECT_EQ(server.handleRequest("GET / HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 404", 0), 0u);
+    EXPECT_EQ(server.handleRequest("POST /metrics HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 405", 0), 0u);
+}
+
+#if !defined(_WIN32)
+TEST(MetricsServerTest, ServesOverLoopback) {
+    MetricsRegistry registry;
+    registry.gauge("test_up", "Up").set(1);
+    MetricsServer server(registry, 0);
+    server.start();
+    ASSERT_GT(server.getPort(), 0);
+
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<unsigned short>(server.getPort()));
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    ASSERT_EQ(connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    const std::string req = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(send(s, req.data(), req.size(), 0), static_cast<ssize_t>(req.size()));
+
+    std::string resp;
+    char buf[512];
+    ssize_t n;
+    while ((n = recv(s, buf, sizeof(buf), 0)) > 0) resp.append(buf, static_cast<std::size_t>(n));
+    close(s);
+    server.stop();
+
+    EXPECT_EQ(resp.rfind("HTTP/1.1 200 OK", 0), 0u);
+    EXPECT_NE(resp.find("test_up 1"), std::string::npos);
+}
+#endif
@@ -0,0 +1,102 @@
+#include "PageDelta.h"
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+class PageDeltaTest : public ::testing::Test {
+protected:
+    const std::string dbPath = "test_page_delta.sqlite";
+    const std::string basePath = "test_page_delta_base.sqlite";
+    const std::string deltaPath = "test_page_delta.delta";
+    const std::string mapPath = "test_page_delta.pages";
+
+    void SetUp() override { removeFiles(); }
+    void TearDown() override { removeFiles(); }
+
+    void removeFiles() {
+        for (const std::string& p : {dbPath, basePath, deltaPath, mapPath}) std::filesystem::remove(p);
+    }
+
+    void exec(const std::string& sql) {
+        sqlite3* db = nullptr;
+        ASSERT_EQ(sqlite3_open(dbPath.c_str(), &db), SQLITE_OK);
+        ASSERT_EQ(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr), SQLITE_OK) << sqlite3_errmsg(db);
+        sqlite3_close(db);
+    }
+
+    static std::string contents(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+};
+
+TEST_F(PageDeltaTest, AppliedDeltasReproduceEachSnapshot) {
+    exec("PRAGMA page_size=4096; CREATE TABLE t(id INTEGER PRIMARY KEY, v TEXT);"
+         "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 2000)"
+         " INSERT INTO t SELECT i, printf('%0200d', i) FROM n;");
+    PageMap map = PageDelta::hashPages(dbPath);
+    EXPECT_EQ(map.pageSize, 4096u);
+    EXPECT_EQ(map.pageCount() * 4096, std::filesystem::file_size(dbPath));
+    std::filesystem::copy_file(dbPath, basePath);
+
+    // One changed row touches a few pages; new rows grow the file
+    exec("UPDATE t SET v = 'changed' WHERE id = 1000;"
+         "INSERT INTO t SELECT id + 2000, v FROM t WHERE id <= 500;");
+    PageMap next;
+    PageDeltaStats written = PageDelta::write(dbPath, map, deltaPath, next);
+    EXPECT_EQ(written.pages, next.pageCount());
+    EXPECT_GT(written.changedPages, 0u);
+    EXPECT_LT(written.changedPages, next.pageCount() / 2);
+    EXPECT_LT(written.bytes, std::filesystem::file_size(dbPath) / 2);
+
+    PageDeltaStats applied = PageDelta::apply(deltaPath, basePath);
+    EXPECT_EQ(applied.changedPages, written.changedPages);
+    EXPECT_EQ(contents(basePath), contents(dbPath));
+
+    // A shrinking database truncates the restored file
+    exec("DELETE FROM t WHERE id > 100; VACUUM;");
+    PageMap shrunk;
+    PageDelta::write(dbPath, next, deltaPath, shrunk);
+    PageDelta::apply(deltaPath, basePath);
+    EXPECT_EQ(contents(basePath), contents(dbPath));
+}
+
+TEST_F(PageDeltaTest, RejectsADeltaForAnotherBase) {
+    exec("CREATE TABLE t(v); INSERT INTO t VALUES (randomblob(100000));");
+    PageMap map = PageDelta::hashPages(dbPath);
+    std::filesystem::copy_file(dbPath, basePath);
+    exec("INSERT INTO t VALUES (randomblob(100000));");
+    PageMap next;
+    PageDelta::write(dbPath, map, deltaPath, next);
+
+    PageDelta::apply(deltaPath, basePath);
+    // Applying it twice finds the base already grown
+    EXPECT_THROW(PageDelta::apply(deltaPath, basePath), std::runtime_error);
+}
+
+TEST_F(PageDeltaTest, PageMapRoundTrip) {
+    PageMap map;
+    map.pageSize = 8192;
+    map.hashes = {1, 2, 0xffffffffffffffffULL};
+    map.save(mapPath, 42);
+
+    auto loaded = PageMap::load(mapPath);
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->first, 42);
+    EXPECT_EQ(loaded->second.pageSize, 8192u);
+    EXPECT_EQ(loaded->second.hashes, map.hashes);
+
+    std::ofstream(mapPath, std::ios::binary | std::ios::trunc) << "garbage";
+    EXPECT_FALSE(PageMap::load(mapPath).has_value());
+    EXPECT_FALSE(PageMap::load("test_page_delta_missing.pages").has_value());
+}
+
+TEST_F(PageDeltaTest, RecognizesDeltaNames) {
+    EXPECT_TRUE(PageDelta::isDeltaName("db_backup_2024-01-01_00-00-00.sqlite.delta"));
+    EXPECT_TRUE(PageDelta::isDeltaName("db_backup_2024-01-01_00-00-00.sqlite.delta.enc"));
+    EXPECT_FALSE(PageDelta::isDeltaName("db_backup_2024-01-01_00-00-00.sqlite"));
+    EXPECT_FALSE(PageDelta::isDeltaName("db_backup_2024-01-01_00-00-00.sqlite.enc"));
+}
@@ -0,0 +1,56 @@
+#include "PerfCounters.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+class PerfCountersTest : public ::testing::Test {
+protected:
+    void SetUp() override { PerfCounters::instance().reset(); }
+    void TearDown() override {
+        PerfCounters::instance().setEnabled(false);
+        PerfCounters::instance().reset();
+    }
+};
+
+TEST_F(PerfCountersTest, DisabledPhasesRecordNothing) {
+    { PerfPhase phase("ignored"); }
+    EXPECT_TRUE(PerfCounters::instance().results().empty());
+}
+
+TEST_F(PerfCountersTest, PhaseIsRecordedEvenWithoutCounters) {
+    PerfCounters::instance().setEnabled(true);
+    for (int run = 0; run < 2; ++run) {
+        PerfPhase phase("work");
+        std::vector<int> data(1 << 20, 1);
+        volatile long sum = 0;
+        for (int v : data) sum = sum + v;
+        phase.addBytes(data.size() * sizeof(int));
+    }
+
+    auto results = PerfCounters::instance().results();
+    ASSERT_EQ(results.count("work"), 1u);
+    const PerfSample& s = results["work"];
+    EXPECT_EQ(s.runs, 2u);
+    EXPECT_EQ(s.bytes, 2u * (1u << 20) * sizeof(int));
+    EXPECT_GT(s.seconds, 0.0);
+    // Where the PMU is accessible the counters must have counted something
+    if (s.has(PerfEvent::Instructions)) {
+        EXPECT_GT(s.get(PerfEvent::Instructions), 0u);
+    }
+    if (s.has(PerfEvent::PageFaults)) {
+        EXPECT_GT(s.get(PerfEvent::PageFaults), 0u);
+    }
+}
+
+TEST(PerfSampleTest, DerivedRatios) {
+    PerfSample s;
+    s.values[static_cast<std::size_t>(PerfEvent::Cycles)] = 1000;
+    s.values[static_cast<std::size_t>(PerfEvent::Instructions)] = 2500;
+    s.values[static_cast<std::size_t>(PerfEvent::CacheMisses)] = 300;
+    s.available.fill(true);
+    s.bytes = 3 * 1024 * 1024;
+    EXPECT_DOUBLE_EQ(s.ipc(), 2.5);
+    EXPECT_DOUBLE_EQ(s.perMiB(PerfEvent::CacheMisses), 100.0);
+
+    s.available[static_cast<std::size_t>(PerfEvent::Cycles)] = false;
+    EXPECT_DOUBLE_EQ(s.ipc(), 0.0);
+}
@@ -0,0 +1,27 @@
+#include "Probes.h"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+    int sideEffects = 0;
+    int touch() { return ++sideEffects; }
+}
+
+TEST(ProbesTest, ProbesAcceptTypicalArguments) {
+    std::string url = "ftp://example/backup.sqlite";
+    long long bytes = 4096;
+    SFB_PROBE0(test__noargs);
+    SFB_PROBE2(transfer__start, url.c_str(), bytes);
+    SFB_PROBE4(transfer__end, url.c_str(), 0, bytes, 1234LL);
+    SUCCEED();
+}
+
+TEST(ProbesTest, DisabledProbesDoNotEvaluateArguments) {
+    sideEffects = 0;
+    SFB_PROBE1(test__side_effect, touch());
+#if SFB_USDT_ENABLED
+    EXPECT_EQ(sideEffects, 1);
+#else
+    EXPECT_EQ(sideEffects, 0);
+#endif
+}
@@ -0,0 +1,63 @@
+#include "RestoreFile.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+class RestoreFileTest : public ::testing::Test {
+protected:
+    const std::string path = "test_restore_file.bin";
+
+    void SetUp() override { std::filesystem::remove(path); }
+    void TearDown() override { std::filesystem::remove(path); }
+
+    std::string contents() const {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+};
+
+TEST_F(RestoreFileTest, CreatedAtFinalSize) {
+    RestoreFile file(path, 1 << 20);
+    EXPECT_EQ(std::filesystem::file_size(path), 1u << 20);
+    file.close();
+    EXPECT_EQ(std::filesystem::file_size(path), 1u << 20);
+}
+
+TEST_F(RestoreFileTest, ParallelWritesLandAtTheirOffsets) {
+    constexpr std::size_t kBlock = 64 * 1024;
+    constexpr std::size_t kBlocks = 32;
+    {
+        RestoreFile file(path, kBlock * kBlocks);
+        // Each thread writes every fourth block, back to front
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&file, t] {
+                for (std::size_t b = kBlocks; b-- > 0;) {
+                    if (b % 4 != t) continue;
+                    std::string block(kBlock, static_cast<char>('a' + b % 26));
+                    file.writeAt(b * kBlock, block.data(), block.size());
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        file.close();
+    }
+
+    std::string data = contents();
+    ASSERT_EQ(data.size(), kBlock * kBlocks);
+    for (std::size_t b = 0; b < kBlocks; ++b) {
+        EXPECT_EQ(data[b * kBlock], static_cast<char>('a' + b % 26));
+        EXPECT_EQ(data[(b + 1) * kBlock - 1], static_cast<char>('a' + b % 26));
+    }
+}
+
+TEST_F(RestoreFileTest, TruncatesAnExistingFile) {
+    std::ofstream(path, std::ios::binary) << std::string(1000, 'x');
+    RestoreFile file(path, 10);
+    file.writeAt(0, "0123456789", 10);
+    file.close();
+    EXPECT_EQ(contents(), "0123456789");
+}
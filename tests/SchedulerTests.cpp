@@ -0,0 +1,74 @@
+#include "Scheduler.h"
+#include <gtest/gtest.h>
+#include <ctime>
+#include <thread>
+#include <atomic>
+
+namespace {
+    // Build a local time point for the given calendar date
+    std::chrono::system_clock::time_point localTime(int year, int mon, int day, int hour, int min) {
+        std::tm tm{};
+        tm.tm_year = year - 1900;
+        tm.tm_mon = mon - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_min = min;
+        tm.tm_isdst = -1;
+        return std::chrono::system_clock::from_time_t(std::mktime(&tm));
+    }
+}
+
+TEST(SchedulerTest, CronStepFiresOnNextMatchingMinute) {
+    CronExpression cron("*/15 * * * *");
+    auto next = cron.next(localTime(2025, 9, 22, 19, 23));
+    EXPECT_EQ(next, localTime(2025, 9, 22, 19, 30));
+
+    // Strictly after: an exact match moves on to the following slot
+    next = cron.next(localTime(2025, 9, 22, 19, 30));
+    EXPECT_EQ(next, localTime(2025, 9, 22, 19, 45));
+}
+
+TEST(SchedulerTest, CronRollsOverDaysAndMonths) {
+    CronExpression daily("30 2 * * *");
+    EXPECT_EQ(daily.next(localTime(2025, 12, 31, 3, 0)), localTime(2026, 1, 1, 2, 30));
+
+    // 2025-09-22 is a Monday; next Saturday 00:00 is 2025-09-27
+    CronExpression weekend("0 0 * * 6,7");
+    EXPECT_EQ(weekend.next(localTime(2025, 9, 22, 19, 23)), localTime(2025, 9, 27, 0, 0));
+}
+
+TEST(SchedulerTest, InvalidSpecsThrow) {
+    EXPECT_THROW(CronExpression("* * *"), std::invalid_argument);
+    EXPECT_THROW(CronExpression("61 * * * *"), std::invalid_argument);
+    EXPECT_THROW(CronExpression("*/0 * * * *"), std::invalid_argument);
+    EXPECT_THROW(Schedule("0s"), std::invalid_argument);
+    EXPECT_THROW(CronExpression("0 0 30 2 *").next(localTime(2025, 1, 1, 0, 0)), std::runtime_error);
+}
+
+TEST(SchedulerTest, IntervalSpecs) {
+    EXPECT_EQ(Schedule("90").getInterval(), std::chrono::seconds(90));
+    EXPECT_EQ(Schedule("5m").getInterval(), std::chrono::seconds(300));
+    EXPECT_EQ(Schedule("@every 2h").getInterval(), std::chrono::seconds(7200));
+    EXPECT_FALSE(Schedule("@hourly").isInterval());
+}
+
+TEST(SchedulerTest, RunsJobsWithoutOverlapUntilStopped) {
+    Scheduler scheduler;
+    std::atomic<int> running{0};
+    std::atomic<int> maxRunning{0};
+    std::atomic<int> runs{0};
+
+    scheduler.addJob("slow", Schedule("1s"), [&] {
+        int now = ++running;
+        maxRunning = std::max(maxRunning.load(), now);
+        // Overrun the 1s interval so the next fire must be skipped, not queued
+        std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+        --running;
+        if (++runs == 2) scheduler.stop();
+    });
+
+    scheduler.run();
+    EXPECT_EQ(runs.load(), 2);
+    EXPECT_EQ(maxRunning.load(), 1);
+    EXPECT_GE(scheduler.getSkippedRuns(), 1u);
+}
@@ -58,3 +58,108 @@ TEST_F(SqliteHelperTest, InsertRandomRowsWorks) {
     int rowCount = dbHelper->getRowCount();
     EXPECT_EQ(rowCount, 10);
 }
+
+TEST_F(SqliteHelperTest, CheckIntegrityOfBackupCopy) {
+    dbHelper->createTable();
+    dbHelper->insertRandomRows(50);
+    const std::string copy = "test_db_check_copy.sqlite";
+    dbHelper->backupToFile(copy);
+    EXPECT_EQ(SqliteHelper::checkIntegrity(copy), "ok");
+    EXPECT_EQ(SqliteHelper::checkIntegrity(copy, false), "ok");
+
+    // A file that is not a database cannot be checked
+    std::ofstream(copy, std::ios::binary | std::ios::trunc) << std::string(4096, 'x');
+    EXPECT_THROW(SqliteHelper::checkIntegrity(copy), std::runtime_error);
+    std::filesystem::remove(copy);
+}
+
+TEST_F(SqliteHelperTest, TableDigestsMatchOnlyIdenticalContents) {
+    dbHelper->createTable();
+    dbHelper->insertRandomRows(200);
+    const std::string copy = "test_db_digest_copy.sqlite";
+    const std::string again = "test_db_digest_again.sqlite";
+    dbHelper->backupToFile(copy);
+    dbHelper->backupToFile(again);
+
+    std::vector<TableDigest> source = SqliteHelper::tableDigests(copy);
+    ASSERT_FALSE(source.empty());
+    EXPECT_EQ(SqliteHelper::tableDigests(again), source);
+
+    // One more row changes the count and the checksum of its table
+    dbHelper->insertRandomRows(1);
+    dbHelper->backupToFile(again);
+    std::vector<TableDigest> changed = SqliteHelper::tableDigests(again);
+    ASSERT_EQ(changed.size(), source.size());
+    auto people = [](const std::vector<TableDigest>& digests) {
+        for (const TableDigest& d : digests) {
+            if (d.table == "people") return d;
+        }
+        return TableDigest{};
+    };
+    EXPECT_EQ(people(changed).rows, people(source).rows + 1);
+    EXPECT_NE(people(changed).checksum, people(source).checksum);
+    std::filesystem::remove(copy);
+    std::filesystem::remove(again);
+}
+
+TEST_F(SqliteHelperTest, ChangeStampMovesOnlyWithCommits) {
+    dbHelper->createTable();
+    dbHelper->insertRandomRows(10);
+    const std::string path = dbHelper->getDbPath();
+    auto before = SqliteHelper::changeStamp(path);
+    ASSERT_TRUE(before.has_value());
+    EXPECT_EQ(SqliteHelper::changeStamp(path), before);
+    dbHelper->getRowCount();
+    EXPECT_EQ(SqliteHelper::changeStamp(path), before);
+    dbHelper->insertRandomRows(1);
+    auto after = SqliteHelper::changeStamp(path);
+    ASSERT_TRUE(after.has_value());
+    EXPECT_NE(*after, *before);
+    EXPECT_NE(after->changeCounter, before->changeCounter);
+
+    // In WAL mode commits land in the -wal file and its index, not the header
+    const std::string walDb = "test_db_stamp_wal.sqlite";
+    sqlite3* wal = nullptr;
+    ASSERT_EQ(sqlite3_open(walDb.c_str(), &wal), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(wal, "PRAGMA journal_mode=WAL; CREATE TABLE t(v); INSERT INTO t VALUES (1);",
+                           nullptr, nullptr, nullptr), SQLITE_OK);
+    auto walBefore = SqliteHelper::changeStamp(walDb);
+    ASSERT_TRUE(walBefore.has_value());
+    EXPECT_GT(walBefore->walSize, 0u);
+    EXPECT_EQ(SqliteHelper::changeStamp(walDb), walBefore);
+    ASSERT_EQ(sqlite3_exec(wal, "INSERT INTO t VALUES (2);", nullptr, nullptr, nullptr), SQLITE_OK);
+    auto walAfter = SqliteHelper::changeStamp(walDb);
+    ASSERT_TRUE(walAfter.has_value());
+    EXPECT_NE(*walAfter, *walBefore);
+    EXPECT_EQ(walAfter->changeCounter, walBefore->changeCounter);
+    sqlite3_close(wal);
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(walDb + suffix);
+
+    std::ofstream("test_db_stamp_garbage.sqlite", std::ios::binary) << std::string(200, 'x');
+    EXPECT_FALSE(SqliteHelper::changeStamp("test_db_stamp_garbage.sqlite").has_value());
+    std::filesystem::remove("test_db_stamp_garbage.sqlite");
+}
+
+TEST_F(SqliteHelperTest, VacuumToFileLeavesOutFreePages) {
+    dbHelper->createTable();
+    dbHelper->insertRandomRows(5000);
+    {
+        sqlite3* raw = nullptr;
+        ASSERT_EQ(sqlite3_open(dbHelper->getDbPath().c_str(), &raw), SQLITE_OK);
+        ASSERT_EQ(sqlite3_exec(raw, "DELETE FROM people WHERE id % 4 != 0;", nullptr, nullptr, nullptr), SQLITE_OK);
+        sqlite3_close(raw);
+    }
+    const std::string full = "test_db_vacuum_full.sqlite";
+    const std::string compacted = "test_db_vacuum_compacted.sqlite";
+    dbHelper->backupToFile(full);
+    dbHelper->vacuumToFile(compacted);
+
+    EXPECT_LT(std::filesystem::file_size(compacted), std::filesystem::file_size(full) / 2);
+    EXPECT_EQ(SqliteHelper::checkIntegrity(compacted, false), "ok");
+    EXPECT_EQ(SqliteHelper::tableDigests(compacted), SqliteHelper::tableDigests(full));
+
+    // VACUUM INTO does not overwrite a database
+    EXPECT_THROW(dbHelper->vacuumToFile(compacted), std::runtime_error);
+    std::filesystem::remove(full);
+    std::filesystem::remove(compacted);
+}
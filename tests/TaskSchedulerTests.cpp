@@ -0,0 +1,61 @@
+#include "TaskScheduler.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+TEST(TaskSchedulerTest, ParallelForVisitsEveryIndexOnce) {
+    std::vector<std::atomic<int>> hits(1000);
+    parallelFor(0, hits.size(), [&](std::size_t i) { ++hits[i]; }, 16);
+    for (const auto& h : hits) EXPECT_EQ(h.load(), 1);
+}
+
+TEST(TaskSchedulerTest, TaskGroupRethrowsFirstException) {
+    TaskGroup group;
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 8; ++i) {
+        group.run([&, i] {
+            ++ran;
+            if (i == 3) throw std::runtime_error("task failed");
+        });
+    }
+    EXPECT_THROW(group.wait(), std::runtime_error);
+    EXPECT_EQ(ran.load(), 8);
+}
+
+TEST(TaskSchedulerTest, NestedWaitDoesNotDeadlockSingleWorker) {
+    TaskScheduler scheduler(1);
+    std::atomic<int> inner{0};
+    TaskGroup outer(scheduler);
+    outer.run([&] {
+        // Waiting inside a task must help run the inner tasks
+        TaskGroup nested(scheduler);
+        for (int i = 0; i < 10; ++i) nested.run([&] { ++inner; });
+        nested.wait();
+    });
+    outer.wait();
+    EXPECT_EQ(inner.load(), 10);
+}
+
+TEST(TaskSchedulerTest, IdleWorkersStealQueuedTasks) {
+    TaskScheduler scheduler(4);
+    std::atomic<int> done{0};
+    TaskGroup group(scheduler);
+    group.run([&] {
+        // Spawned from a worker, so all 64 land on that worker's own deque
+        for (int i = 0; i < 64; ++i) {
+            group.run([&] {
+                volatile double x = 0;
+                for (int k = 0; k < 20000; ++k) x = x + k;
+                ++done;
+            });
+        }
+    });
+    group.wait();
+
+    auto stats = scheduler.getStats();
+    EXPECT_EQ(done.load(), 64);
+    EXPECT_EQ(stats.workers.size(), 4u);
+    EXPECT_EQ(stats.submitted, 65u);
+    EXPECT_EQ(stats.queueDepth, 0u);
+}
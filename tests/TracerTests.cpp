@@ -0,0 +1,59 @@
+#include "Tracer.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+class TracerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Tracer::instance().clear();
+        Tracer::instance().setEnabled(true);
+    }
+    void TearDown() override {
+        Tracer::instance().setEnabled(false);
+        Tracer::instance().clear();
+    }
+};
+
+TEST_F(TracerTest, DisabledSpansRecordNothing) {
+    Tracer::instance().setEnabled(false);
+    { TraceSpan span("ignored"); }
+    EXPECT_EQ(Tracer::instance().eventCount(), 0u);
+}
+
+TEST_F(TracerTest, NestedSpansAreContained) {
+    {
+        TraceSpan outer("outer", "test");
+        TraceSpan inner("inner", "test", "chunk", 42);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ASSERT_EQ(Tracer::instance().eventCount(), 2u);
+
+    std::string json = Tracer::instance().toChromeJson();
+    EXPECT_NE(json.find("\"name\":\"outer\""), std::string::npos);
+    EXPECT_NE(json.find("\"args\":{\"chunk\":42}"), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+}
+
+TEST_F(TracerTest, EachThreadGetsItsOwnTrack) {
+    Tracer::instance().setThreadName("test main");
+    std::thread t([] {
+        Tracer::instance().setThreadName("test \"worker\"");
+        TraceSpan span("on_worker");
+    });
+    t.join();
+    { TraceSpan span("on_main"); }
+
+    std::string json = Tracer::instance().toChromeJson();
+    EXPECT_NE(json.find("\"args\":{\"name\":\"test main\"}"), std::string::npos);
+    // Names are JSON-escaped
+    EXPECT_NE(json.find("test \\\"worker\\\""), std::string::npos);
+    EXPECT_EQ(Tracer::instance().eventCount(), 2u);
+}
+
+TEST_F(TracerTest, PerThreadCapDropsExcessEvents) {
+    Tracer::instance().setMaxEventsPerThread(3);
+    for (int i = 0; i < 5; ++i) TraceSpan span("capped");
+    Tracer::instance().setMaxEventsPerThread(1 << 20);
+    EXPECT_EQ(Tracer::instance().eventCount(), 3u);
+    EXPECT_EQ(Tracer::instance().droppedCount(), 2u);
+}